@@ -20,6 +20,17 @@
 using namespace std;
 
 #include <QList>
+#include <QThread>
+
+#include "rdtsc.h"
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#ifdef SYS_memfd_create
+#define GEDDEI_MIRRORED_BUFFER
+#endif
+#endif
 
 #include "processor.h"
 #include "buffer.h"
@@ -30,6 +41,22 @@ using namespace Geddei;
 namespace Geddei
 {
 
+/**
+ * Counts, into a PortCounters, the time from the first call of waiting() to
+ * the end of its scope. Costs nothing if we never have to wait.
+ */
+class WaitTimer
+{
+public:
+	WaitTimer(PortCounters& _c): m_c(_c), m_start(0) {}
+	~WaitTimer() { if (m_start) { m_c.waits++; m_c.waitTime += rdtscElapsed(m_start); } }
+	void waiting() { if (!m_start) m_start = rdtsc(); }
+
+private:
+	PortCounters& m_c;
+	realTime m_start;
+};
+
 ostream &operator<<(ostream &out, Buffer &me)
 {
 	out << "[";
@@ -40,22 +67,17 @@ ostream &operator<<(ostream &out, Buffer &me)
 	return out << " ]";
 }
 
-Buffer::Buffer(uint size, Type const& _type) : theDataFlux(QFastMutex::Recursive)
+Buffer::Buffer(uint size, Type const& _type) : theDataFlux(QFastMutex::Recursive), theData(0), theSize(0), theMirrored(false)
 {
 	theDataFlux.lock();
-	theSize = 4;
-	theLogSize = 2;
-	while (theSize < size) { theSize <<= 1; theLogSize++; }
-/*#ifdef EDEBUG
-	if (theSize != size)
-		qDebug("*** Buffer increased from %d to %d in order that it be a power of 2.", size, theSize);
-#endif*/
-	theMask = theSize - 1;
+	allocateUNSAFE(size);
 	readPos = 0;
 	writePos = 0;
 	theUsed = 0;
-	theData = new float[theSize];
-	for (uint i = 0; i < theSize; i++) theData[i] = i + 0.666;
+	m_released = 0;
+	m_soleReader = 0;
+	m_lockFree = 0;
+	m_writerTask = 0;
 	theType = _type;
 	lastScratch = new BufferInfo(theData, this, theMask, BufferInfo::Foreign, BufferInfo::Write);
 	if (MESSAGES) qDebug("Creating new scratch: %p", lastScratch);
@@ -71,8 +93,7 @@ Buffer::~Buffer()
 	theDataFlux.lock();
 	while (theReaders.size())
 		delete theReaders.takeLast();
-	delete [] theData;
-	theData = 0;
+	deallocateUNSAFE();
 	theDataFlux.unlock();
 	if (MESSAGES) qDebug("< ~Buffer");
 }
@@ -80,22 +101,12 @@ Buffer::~Buffer()
 void Buffer::resize(uint size)
 {
 	theDataFlux.lock();
-	delete [] theData;
-	theData = 0;
-
-	theSize = 4;
-	theLogSize = 2;
-	while (theSize < size) { theSize <<= 1; theLogSize++; }
-/*#ifdef EDEBUG
-	if (theSize != size)
-		qWarning("*** WARNING: Buffer increased from %d to %d in order that it be a power of 2.", size, theSize);
-#endif*/
-	theMask = theSize - 1;
+	suspendSoleUNSAFE();
+	allocateUNSAFE(size);
 	readPos = 0;
 	writePos = 0;
 	theUsed = 0;
-	theData = new float[theSize];
-	for (uint i = 0; i < theSize; i++) theData[i] = i + 0.666;
+	m_released = 0;
 
 	if (lastScratch->isReferenced())
 		qFatal("FATAL: Resizing buffer when scratch BufferData objects are still around.");
@@ -110,10 +121,70 @@ void Buffer::resize(uint size)
 		i->lastRead->theData = theData;
 		i->lastRead->theMask = theMask;
 	}
+	updateSoleReaderUNSAFE();
 
 	theDataFlux.unlock();
 }
 
+void Buffer::allocateUNSAFE(uint size)
+{
+	deallocateUNSAFE();
+
+#ifdef GEDDEI_MIRRORED_BUFFER
+	// Round up to a whole number of pages and map the same memory twice in a
+	// row, so that any window of upto theSize elements is contiguous.
+	uint pageElements = qMax<uint>(sysconf(_SC_PAGESIZE) / sizeof(float), 1u);
+	uint mirroredSize = qMax(size, 4u);
+	mirroredSize = (mirroredSize + pageElements - 1) / pageElements * pageElements;
+	size_t bytes = mirroredSize * sizeof(float);
+	int fd = syscall(SYS_memfd_create, "geddei-buffer", 0);
+	if (fd != -1)
+	{
+		void *base = MAP_FAILED;
+		if (ftruncate(fd, bytes) == 0)
+			base = mmap(0, bytes * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (base != MAP_FAILED)
+		{
+			if (mmap(base, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED &&
+				mmap((char *)base + bytes, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED)
+			{
+				theData = (float *)base;
+				theSize = mirroredSize;
+				theMask = ~(uint)0;
+				theMirrored = true;
+			}
+			else
+				munmap(base, bytes * 2);
+		}
+		close(fd);
+	}
+	if (!theMirrored && MESSAGES) qDebug("Couldn't map mirrored buffer; falling back to power of 2 sized buffer.");
+#endif
+
+	if (!theMirrored)
+	{
+		theSize = 4;
+		while (theSize < size) theSize <<= 1;
+		theMask = theSize - 1;
+		theData = new float[theSize];
+	}
+	for (uint i = 0; i < theSize; i++) theData[i] = i + 0.666;
+}
+
+void Buffer::deallocateUNSAFE()
+{
+	if (!theData)
+		return;
+#ifdef GEDDEI_MIRRORED_BUFFER
+	if (theMirrored)
+		munmap(theData, theSize * sizeof(float) * 2);
+	else
+#endif
+		delete [] theData;
+	theData = 0;
+	theMirrored = false;
+}
+
 void Buffer::debug()
 {
 	QFastMutexLocker lock(&theDataFlux);
@@ -133,7 +204,7 @@ void Buffer::debug()
 		if (p == thePlungers.end()) out += " "; else out += "#";
 		out += (writePos == i) ? "W" : " ";
 
-		out += ":" + QString::number(theData[i & theMask]) + ":";
+		out += ":" + QString::number(theData[i]) + ":";
 	}
 	out += "]";
 	qDebug("%s", qPrintable(out));
@@ -141,30 +212,74 @@ void Buffer::debug()
 
 void Buffer::updateUNSAFE()
 {
-	// figure out how much theUsed will be moved on.
+	// figure out how much theUsed will be moved on; that's as far as the
+	// slowest reader has got since we last moved on.
+	// NOTE: theUsed may be increasing under our feet if the writer is on the
+	// lock-free path, so we can't work it out from that.
 	if (MESSAGES) qDebug("Updating position");
-	uint newUsed = 0;
+	uint moveBy = theReaders.size() ? Undefined : uint(theUsed);
 	foreach (BufferReader* i, theReaders)
-		if (newUsed < i->theUsed)
-			newUsed = i->theUsed;
-
-	uint moveBy = theUsed - newUsed;
+		moveBy = qMin(moveBy, i->m_consumed - m_released);
 	if (MESSAGES) qDebug("Moving by %d", moveBy);
 
 	// clear old plunger (if any) - could be multiple due to potential for skipping
-	if (MESSAGES) qDebug("Next plunger is %d away", (nextPlungerUNSAFE() - readPos) & theMask);
+	if (MESSAGES) qDebug("Next plunger is %d away", distance(readPos, nextPlungerUNSAFE()));
 	while (1)
 		if (thePlungers.begin() != thePlungers.end())
-			if (((*thePlungers.begin() - readPos) & theMask) < moveBy)
+			if (distance(readPos, *thePlungers.begin()) < moveBy)
 				thePlungers.removeFirst();
 			else
 				break;
 		else
 			break;
 
-	readPos = (readPos + moveBy) & theMask;
-	theUsed -= moveBy;
+	readPos = wrap(readPos + moveBy);
+	m_released += moveBy;
+	theUsed.fetchAndAddOrdered(-int(moveBy));
+	updateSoleReaderUNSAFE();
+	wakeWriter();
+}
+
+void Buffer::suspendSoleUNSAFE()
+{
+	// Whoever's on the lock-free path went there before seeing this, so
+	// once they've all left nobody is.
+	m_soleReader.fetchAndStoreOrdered(0);
+	while (int(m_lockFree))
+		QThread::yieldCurrentThread();
+}
+
+void Buffer::updateSoleReaderUNSAFE()
+{
+	if (theReaders.size() == 1 && theTrapdoors.isEmpty() && thePlungers.isEmpty())
+		m_soleReader = theReaders.first();
+	else
+		m_soleReader = 0;
+}
+
+void Buffer::releaseSole(uint elements)
+{
+	// Only the sole reader calls this, and only it moves readPos and
+	// m_released, so there's nobody to race with.
+	readPos = wrap(readPos + elements);
+	m_released += elements;
+	theUsed.fetchAndAddOrdered(-int(elements));
+	wakeWriter();
+}
+
+void Buffer::wakeReadersUNSAFE()
+{
+	theDataIn.wakeAll();
+	foreach (BufferReader* i, theReaders)
+		if (i->m_task)
+			i->m_task->wake();
+}
+
+void Buffer::wakeWriter()
+{
 	theDataOut.wakeAll();
+	if (m_writerTask)
+		m_writerTask->wake();
 }
 
 void Buffer::appendPlunger()
@@ -173,7 +288,7 @@ void Buffer::appendPlunger()
 	QFastMutexLocker lock(&theDataFlux);
 
 #ifdef EDEBUG
-	if (theSize - theUsed == 0 && !thePlungers.count())
+	if (theSize - uint(theUsed) == 0 && !thePlungers.count())
 		qWarning("*** WARNING: appendPlunger(): Size of buffer is critically low (size: %d).\n"
 				 "             There is not enough room for one plunger. Please\n"
 				 "             make use of Processor::specifyOutputSpace().", theSize);
@@ -183,10 +298,13 @@ void Buffer::appendPlunger()
 	// will be confused with 0 (theUsed & theMark == 0), and so a reader will erroneously
 	// exit immediately.
 	waitForFreeUNSAFE(1);
+	suspendSoleUNSAFE();
 	thePlungers.push_back(writePos);
+	m_counters.plungers++;
+	updateSoleReaderUNSAFE();
 	if (MESSAGES) qDebug("Waking readers...");
-	theDataIn.wakeAll();
-	theDataOut.wakeAll();
+	wakeReadersUNSAFE();
+	wakeWriter();
 }
 
 void Buffer::discardNextPlunger()
@@ -203,6 +321,8 @@ void Buffer::discardNextPlungerUNSAFE()
 	if (MESSAGES) qDebug("* discardNextPlungerUNSAFE");
 	if (thePlungers.begin() != thePlungers.end())
 		thePlungers.removeFirst();
+	updateSoleReaderUNSAFE();
+	wakeReadersUNSAFE();
 }
 
 bool Buffer::trapdoorUNSAFE() const
@@ -219,10 +339,12 @@ void Buffer::openTrapdoor(const Processor *processor)
 	if (MESSAGES) qDebug("> openTrapdoor %p (for %p: %s)", this, processor, processor ? qPrintable(processor->name()) : "<n/a>");
 	if (MESSAGES) qDebug("= openTrapdoor(%p): Going to lock mutex: %p", this, &theDataFlux);
 	theDataFlux.lock();
+	suspendSoleUNSAFE();
 	theTrapdoors.push_back(processor);
+	updateSoleReaderUNSAFE();
 	if (MESSAGES) qDebug("Size: %d", theTrapdoors.size());
-	theDataIn.wakeAll();
-	theDataOut.wakeAll();
+	wakeReadersUNSAFE();
+	wakeWriter();
 	theDataFlux.unlock();
 	if (MESSAGES) qDebug("< openTrapdoor");
 }
@@ -241,8 +363,9 @@ void Buffer::closeTrapdoor(const Processor *processor)
 		if (*i == processor) break;
 	assert(i != theTrapdoors.end());	// assert trapdoor is open.
 	theTrapdoors.erase(i);
-	theDataIn.wakeAll();
-	theDataOut.wakeAll();
+	updateSoleReaderUNSAFE();
+	wakeReadersUNSAFE();
+	wakeWriter();
 	theDataFlux.unlock();
 	if (MESSAGES) qDebug("< closeTrapdoor");
 }
@@ -259,7 +382,7 @@ int Buffer::nextPlungerUNSAFE(uint pos, uint ignore) const
 	QList<uint>::const_iterator ii = thePlungers.begin();
 
 	// First we skip down the plunger list until we find the first plunger at or past 'pos'
-	for (; ii != thePlungers.end() && ((*ii - readPos) & theMask) < ((pos - readPos) & theMask); ii++) {}
+	for (; ii != thePlungers.end() && distance(readPos, *ii) < distance(readPos, pos); ii++) {}
 
 	// Then we skip upto ignore plungers from the list while they are situated on 'pos'
 	for (uint i = 0; i < ignore && ii != thePlungers.end() && *ii == pos; i++, ii++) {}
@@ -268,7 +391,7 @@ int Buffer::nextPlungerUNSAFE(uint pos, uint ignore) const
 	if (ii == thePlungers.end()) return -1;
 
 	// Otherwise return the relative position of the next plunger
-	return (*ii - pos) & theMask;
+	return distance(pos, *ii);
 }
 
 /**
@@ -283,13 +406,15 @@ uint Buffer::waitForUNSAFE(uint elements) const
 	int nextPlunger = -1;
 	while (!trapdoorUNSAFE())
 	{
+		// The writer may push without theDataFlux, so take a ticket first.
+		int ticket = theDataIn.sequence();
 		if (nextPlunger == -1) nextPlunger = nextPlungerUNSAFE();
 		if (nextPlunger < signed(elements) && nextPlunger != -1)
 		{	if (MESSAGES) qDebug("Too close. Exiting...");
 			return nextPlunger;
 		}
-		if (theUsed >= elements) return elements;
-		theDataIn.wait(&theDataFlux);
+		if (uint(theUsed) >= elements) return elements;
+		theDataIn.waitFrom(ticket, &theDataFlux);
 	}
 	return Undefined;
 }
@@ -297,9 +422,11 @@ uint Buffer::waitForUNSAFE(uint elements) const
 uint Buffer::waitForUNSAFE(uint elements, const BufferReader *reader) const
 {
 	if (MESSAGES) qDebug("Waiting for %d elements...", elements);
+	WaitTimer t(reader->m_counters);
 	int nextPlunger = -1;
 	while (!trapdoorUNSAFE())
 	{
+		int ticket = theDataIn.sequence();
 		if (nextPlunger == -1)
 			nextPlunger = nextPlungerUNSAFE(reader->readPos, reader->theAlreadyPlungedHere);
 
@@ -307,9 +434,10 @@ uint Buffer::waitForUNSAFE(uint elements, const BufferReader *reader) const
 		{	if (MESSAGES) qDebug("Too close. Exiting...");
 			return nextPlunger;
 		}
-		if (reader->theUsed >= elements) return elements;
+		if (uint(reader->theUsed) >= elements) return elements;
 
-		theDataIn.wait(&theDataFlux);
+		t.waiting();
+		theDataIn.waitFrom(ticket, &theDataFlux);
 	}
 	return Undefined;
 }
@@ -317,9 +445,12 @@ uint Buffer::waitForUNSAFE(uint elements, const BufferReader *reader) const
 uint Buffer::waitForIgnorePlungersUNSAFE(uint elements, const BufferReader *reader) const
 {
 	if (MESSAGES) qDebug("Waiting for %d elements, ignoring plungers...", elements);
+	WaitTimer t(reader->m_counters);
 	while (!trapdoorUNSAFE())
-	{	if (reader->theUsed >= elements) return elements;
-		theDataIn.wait(&theDataFlux);
+	{	int ticket = theDataIn.sequence();
+		if (uint(reader->theUsed) >= elements) return elements;
+		t.waiting();
+		theDataIn.waitFrom(ticket, &theDataFlux);
 	}
 	return Undefined;
 }
@@ -327,15 +458,19 @@ uint Buffer::waitForIgnorePlungersUNSAFE(uint elements, const BufferReader *read
 uint Buffer::elementsFree() const
 {
 	if (MESSAGES) qDebug("= elementsFree");
-	QFastMutexLocker lock(&theDataFlux);
-	return theSize - theUsed;
+	return theSize - uint(theUsed);
 }
 
 void Buffer::waitForFreeUNSAFE(uint elements) const
 {
-	if (MESSAGES) qDebug("> waitForFreeUNSAFE(%d): size: %d, used: %d", elements, theSize, theUsed);
-	while (theSize - theUsed < elements && !trapdoorUNSAFE())
-		theDataOut.wait(&theDataFlux);
+	if (MESSAGES) qDebug("> waitForFreeUNSAFE(%d): size: %d, used: %d", elements, theSize, int(theUsed));
+	WaitTimer t(m_counters);
+	// The sole reader may free space without theDataFlux, so take a ticket
+	// before each check.
+	for (int ticket = theDataOut.sequence(); theSize - uint(theUsed) < elements && !trapdoorUNSAFE(); ticket = theDataOut.sequence())
+	{	t.waiting();
+		theDataOut.waitFrom(ticket, &theDataFlux);
+	}
 	if (MESSAGES) qDebug("< waitForFreeUNSAFE(%d)", elements);
 }
 
@@ -349,6 +484,19 @@ void Buffer::waitForFreeElements(uint elements) const
 BufferData Buffer::makeScratchElements(uint elements, bool autoPush)
 {
 	if (MESSAGES) qDebug("> makeScratchElements");
+	{	LockFree f(this);
+		if (soleReader() && theSize - uint(theUsed) >= elements && !lastScratch->isReferenced())
+		{
+			// Lock-free: there's enough room already and only we (the writer)
+			// touch lastScratch and writePos.
+			lastScratch->theAccessibleSize = elements;
+			lastScratch->theEndType = autoPush ? BufferInfo::Activate : BufferInfo::Forget;
+			lastScratch->m_sampleSize = theType->size();
+			lastScratch->theValid = true;
+			if (MESSAGES) qDebug("< makeScratchElements (lock-free)");
+			return BufferData(lastScratch, writePos);
+		}
+	}
 	QFastMutexLocker lock(&theDataFlux);
 	if (MESSAGES) qDebug("* makeScratchElements (elements: %d)", elements);
 #ifdef EDEBUG
@@ -387,18 +535,39 @@ BufferData Buffer::makeScratchElements(uint elements, bool autoPush)
 void Buffer::pushScratch(const BufferData &data)
 {
 	if (MESSAGES) qDebug("> pushScratch");
-	QFastMutexLocker lock(&theDataFlux);
-	if (MESSAGES) qDebug("* pushScratch");
 	//TODO: change to Fatal.
 	assert(data.info() == lastScratch);
+	{	LockFree f(this);
+		if (BufferReader* r = soleReader())
+		{
+			// Lock-free: publish the data by bumping the fill counts (which
+			// are full barriers), ours first so we never appear to have less
+			// than the reader thinks it has.
+			lastScratch->invalidateAndIgnore();
+			writePos = wrap(writePos + lastScratch->theAccessibleSize);
+			theUsed.fetchAndAddOrdered(lastScratch->theAccessibleSize);
+			r->theUsed.fetchAndAddOrdered(lastScratch->theAccessibleSize);
+			m_counters.elements += lastScratch->theAccessibleSize;
+			m_counters.sampleFill(theUsed);
+			theDataIn.wakeAll();
+			if (r->m_task)
+				r->m_task->wake();
+			if (MESSAGES) qDebug("< pushScratch (lock-free)");
+			return;
+		}
+	}
+	QFastMutexLocker lock(&theDataFlux);
+	if (MESSAGES) qDebug("* pushScratch");
 	lastScratch->invalidateAndIgnore();
 
-	writePos = (writePos + lastScratch->theAccessibleSize) & theMask;
-	theUsed += lastScratch->theAccessibleSize;
+	writePos = wrap(writePos + lastScratch->theAccessibleSize);
+	theUsed.fetchAndAddOrdered(lastScratch->theAccessibleSize);
 	foreach (BufferReader* i, theReaders)
-		i->theUsed += lastScratch->theAccessibleSize;
+		i->theUsed.fetchAndAddOrdered(lastScratch->theAccessibleSize);
+	m_counters.elements += lastScratch->theAccessibleSize;
+	m_counters.sampleFill(theUsed);
 
-	theDataIn.wakeAll();
+	wakeReadersUNSAFE();
 	if (MESSAGES) qDebug("< pushScratch");
 }
 
@@ -439,7 +608,10 @@ void Buffer::pushData(const BufferData &data)
 		lastScratch->invalidateAndIgnore();
 	}
 
-	if (writePos + data.theVisibleSize > theSize)
+	if (theMirrored)
+		// Our end is always contiguous; only the source might roll over.
+		data.copyTo(theData + writePos, data.theVisibleSize);
+	else if (writePos + data.theVisibleSize > theSize)
 	{	uint sizeFirstPart = theSize - writePos, sizeSecondPart = data.theVisibleSize - (theSize - writePos);
 		float *firstPart = theData + writePos, *secondPart = theData;
 		if (data.rollsOver())
@@ -465,11 +637,13 @@ void Buffer::pushData(const BufferData &data)
 		}
 		else
 			memcpy(theData + writePos, data.theInfo->theData + data.theOffset, data.theVisibleSize * 4);
-	writePos = (writePos + data.theVisibleSize) & theMask;
-	theUsed += data.theVisibleSize;
+	writePos = wrap(writePos + data.theVisibleSize);
+	theUsed.fetchAndAddOrdered(data.theVisibleSize);
 	foreach (BufferReader* i, theReaders)
-		i->theUsed += data.theVisibleSize;
-	theDataIn.wakeAll();
+		i->theUsed.fetchAndAddOrdered(data.theVisibleSize);
+	m_counters.elements += data.theVisibleSize;
+	m_counters.sampleFill(theUsed);
+	wakeReadersUNSAFE();
 	if (MESSAGES) qDebug("< pushData");
 }
 
@@ -488,11 +662,20 @@ void Buffer::push(const BufferData &data)
 				 "             This push will be ignored.");
 }
 
+PortCounters Buffer::counters() const
+{
+	PortCounters ret = m_counters;
+	ret.capacity = theSize;
+	ret.sampleSize = theType.size();
+	return ret;
+}
+
 void Buffer::clear()
 {
 	if (MESSAGES) qDebug("> clear");
 	QFastMutexLocker lock(&theDataFlux);
 	if (MESSAGES) qDebug("* clear");
+	suspendSoleUNSAFE();
 	if (lastScratch->isReferenced())
 	{
 #ifdef EDEBUG
@@ -504,11 +687,13 @@ void Buffer::clear()
 	writePos = 0;
 	readPos = 0;
 	theUsed = 0;
+	m_released = 0;
 	for (uint i = 0; i < theSize; i++) theData[i] = i + 0.667;
 	foreach (BufferReader* i, theReaders)
 		i->clearUNSAFE();
 	thePlungers.clear();
-	theDataOut.wakeAll();
+	updateSoleReaderUNSAFE();
+	wakeWriter();
 	if (MESSAGES) qDebug("< clear");
 }
 
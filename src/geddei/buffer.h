@@ -25,21 +25,30 @@ using namespace std;
 #include <QThread>
 #include <QMutex>
 #include <QVector>
+#include <QAtomicInt>
+#include <QAtomicPointer>
 
 #include <exscalibar.h>
 #ifdef __GEDDEI_BUILD
 #include "qfastwaitcondition.h"
 #include "bufferdata.h"
+#include "counters.h"
 #include "type.h"
 #include "transmissiontype.h"
 #else
 #include <qtextra/qfastwaitcondition.h>
 #include <geddei/bufferdata.h>
+#include <geddei/counters.h>
 #include <geddei/type.h>
 #include <geddei/transmissiontype.h>
 #endif
 using namespace Geddei;
 
+namespace QtExtra
+{
+class QTask;
+}
+
 namespace Geddei
 {
 
@@ -49,8 +58,29 @@ class Processor;
 /** @internal @ingroup Geddei
  * @brief Class to encompass an efficient threadsafe databank.
  * @author Gav Wood <gav@kde.org>
+ *
+ * Where the platform allows, the databank is a "mirrored" ring: the same
+ * physical pages are mapped twice, back-to-back, so that any window of up to
+ * size() elements starting anywhere in the ring is contiguous in memory. In
+ * this case the BufferInfo objects handed out are given a mask of ~0 and
+ * BufferData never has to roll over. Otherwise we fall back to a masked,
+ * power-of-two sized ring.
+ *
+ * In the common case of exactly one reader, no plungers and no open trapdoors
+ * (see soleReader()) scratches are made and pushed and reads are made and
+ * released without taking theDataFlux. The writer only ever moves writePos and
+ * the reader only ever moves readPos; the fill counts are atomic and are the
+ * only state both sides touch. Anything that changes whether the lock-free
+ * path may be used (a reader coming or going, a plunger or a trapdoor) first
+ * waits for those already on it to finish; see suspendSoleUNSAFE(). Since
+ * those paths wake without theDataFlux, waiters take a ticket from their
+ * QFastWaitCondition before checking what they wait for.
+ *
+ * Whenever data, space or a plunger arrives, the task of each reader (for new
+ * data) or the writer (for new space) is woken through QTask::wake(), so the
+ * scheduler need not poll them.
  */
-class Buffer: public ScratchOwner
+class DLLEXPORT Buffer: public ScratchOwner
 {
 	friend class BufferReader;
 
@@ -166,6 +196,20 @@ public:
 	 */
 	Buffer &operator<<(const BufferData &data) { push(data); return *this; }
 
+	/**
+	 * Sets the task that writes to this buffer. It will be woken whenever
+	 * space is freed.
+	 */
+	void setWriterTask(QtExtra::QTask *task) { m_writerTask = task; }
+
+	/**
+	 * @return A snapshot of the writer's counters: elements and plungers
+	 * pushed, time spent waiting for space and the fill level at each push.
+	 *
+	 * Thread-safe (though only approximate while the writer is running).
+	 */
+	PortCounters counters() const;
+
 	void debug();
 
 private:
@@ -208,12 +252,95 @@ private:
 	 */
 	int nextPlungerUNSAFE(uint pos, uint ignore) const;
 
+	/**
+	 * Recalculates m_soleReader. Must be called whenever theReaders,
+	 * theTrapdoors or thePlungers change.
+	 */
+	void updateSoleReaderUNSAFE();
+
+	/**
+	 * Stops the lock-free path from being taken and waits for anyone already
+	 * on it to finish. Must be called before changing theReaders,
+	 * theTrapdoors, thePlungers or the positions, and followed by
+	 * updateSoleReaderUNSAFE() once done.
+	 */
+	void suspendSoleUNSAFE();
+
+	/**
+	 * Marks a (possible) trip down the lock-free path for its lifetime.
+	 */
+	class LockFree
+	{
+	public:
+		LockFree(Buffer const* _b): m_b(_b) { m_b->m_lockFree.fetchAndAddOrdered(1); }
+		~LockFree() { m_b->m_lockFree.fetchAndAddOrdered(-1); }
+	private:
+		Buffer const* m_b;
+	};
+
+	/**
+	 * @return The only reader of this buffer if we may currently use the
+	 * lock-free path, or zero otherwise.
+	 *
+	 * Thread-safe.
+	 */
+	BufferReader *soleReader() const { return m_soleReader; }
+
+	/**
+	 * Lock-free version of updateUNSAFE() for when the sole reader has just
+	 * finished with @a elements elements.
+	 */
+	void releaseSole(uint elements);
+
+	/**
+	 * Wakes anyone (thread or task) waiting on the readers' side.
+	 */
+	void wakeReadersUNSAFE();
+
+	/**
+	 * Wakes anyone (thread or task) waiting on the writer's side.
+	 * Thread-safe.
+	 */
+	void wakeWriter();
+
+	/**
+	 * (Re)allocates the databank to hold at least @a size elements, setting
+	 * theData, theSize, theMask and theMirrored accordingly. Any previous
+	 * databank is freed first.
+	 */
+	void allocateUNSAFE(uint size);
+
+	/**
+	 * Frees the databank, if any.
+	 */
+	void deallocateUNSAFE();
+
+	/**
+	 * Wraps a position that may be up to twice the size of the buffer back
+	 * into the ring.
+	 */
+	uint wrap(uint pos) const { return pos < theSize ? pos : pos - theSize; }
+
+	/**
+	 * @return The number of elements from position @a from forwards to
+	 * position @a to.
+	 */
+	uint distance(uint from, uint to) const { return to >= from ? to - from : to + theSize - from; }
+
 	mutable QFastWaitCondition theDataIn, theDataOut;
 	mutable QFastMutex theDataFlux;
 
 	float *theData;
-	uint theLogSize, theSize, theMask, theUsed;
+	uint theSize, theMask;
+	QAtomicInt theUsed;
+	bool theMirrored;
 	uint readPos, writePos;
+	uint m_released;
+	QAtomicPointer<BufferReader> m_soleReader;
+	mutable QAtomicInt m_lockFree;
+	QtExtra::QTask *m_writerTask;
+	// Only ever touched by the writer (or under theDataFlux).
+	mutable PortCounters m_counters;
 	BufferInfo *lastScratch;
 	Type theType;
 	QVector<const Processor *> theTrapdoors;
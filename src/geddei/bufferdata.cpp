@@ -33,56 +33,56 @@ BufferData &BufferData::fake()
 	return *(theFake = new BufferData(true));
 }
 
-BufferData::BufferData(bool valid) : theWritePointer(0)
+BufferData::BufferData(bool valid) : theWritePointer(0), theBorrowed(false)
 {
 	theInfo = new BufferInfo(valid ? Undefined : 0, 0, valid ? new float[1] : 0, 0, BufferInfo::Ignore, 0, valid, valid ? BufferInfo::Write : BufferInfo::Read, valid ? BufferInfo::Managed : BufferInfo::Foreign, false);
 	theOffset = 0;
 	theVisibleSize = valid ? Undefined : 0;
 }
 
-BufferData::BufferData(uint size, uint sampleSize, float *data, ScratchOwner *scratch, BufferInfo::Legacy endType, uint offset, uint mask) : theWritePointer(0)
+BufferData::BufferData(uint size, uint sampleSize, float *data, ScratchOwner *scratch, BufferInfo::Legacy endType, uint offset, uint mask) : theWritePointer(0), theBorrowed(false)
 {
 	theInfo = new BufferInfo(size, sampleSize, data ? data : new float[size], scratch, endType, mask, true, BufferInfo::Write, data ? BufferInfo::Foreign : BufferInfo::Managed, false);
 	theOffset = offset;
 	theVisibleSize = size;
 }
 
-BufferData::BufferData(uint size, uint sampleSize, float *data, ScreenOwner *screen, BufferInfo::Legacy endType, uint offset, uint mask) : theWritePointer(0)
+BufferData::BufferData(uint size, uint sampleSize, float *data, ScreenOwner *screen, BufferInfo::Legacy endType, uint offset, uint mask) : theWritePointer(0), theBorrowed(false)
 {
 	theInfo = new BufferInfo(size, sampleSize, data ? data : new float[size], screen, endType, mask, true, BufferInfo::Read, data ? BufferInfo::Foreign : BufferInfo::Managed, false);
 	theOffset = offset;
 	theVisibleSize = size;
 }
 
-BufferData::BufferData(uint size, uint sampleSize) : theWritePointer(0)
+BufferData::BufferData(uint size, uint sampleSize) : theWritePointer(0), theBorrowed(false)
 {
 	theInfo = new BufferInfo(size, sampleSize, new float[size], 0, BufferInfo::Ignore, ~(uint)(0), true, BufferInfo::Write, BufferInfo::Managed, false);
 	theVisibleSize = size;
 	theOffset = 0;
 }
 
-BufferData::BufferData(const float *data, uint size, uint sampleSize) : theWritePointer(0)
+BufferData::BufferData(const float *data, uint size, uint sampleSize) : theWritePointer(0), theBorrowed(false)
 {
 	theInfo = new BufferInfo(size, sampleSize, (float *)data, 0, BufferInfo::Ignore, ~(uint)(0), true, BufferInfo::Read, BufferInfo::Foreign, false);
 	theVisibleSize = size;
 	theOffset = 0;
 }
 
-BufferData::BufferData(float *data, uint size, uint sampleSize) : theWritePointer(0)
+BufferData::BufferData(float *data, uint size, uint sampleSize) : theWritePointer(0), theBorrowed(false)
 {
 	theInfo = new BufferInfo(size, sampleSize, data, 0, BufferInfo::Ignore, ~(uint)(0), true, BufferInfo::Write, BufferInfo::Foreign, false);
 	theVisibleSize = size;
 	theOffset = 0;
 }
 
-BufferData::BufferData(BufferInfo *info, uint offset): theInfo(info), theWritePointer(0)
+BufferData::BufferData(BufferInfo *info, uint offset): theInfo(info), theWritePointer(0), theBorrowed(false)
 {
 	theInfo->reference();
 	theVisibleSize = theInfo->theAccessibleSize;
 	theOffset = offset;
 }
 
-BufferData::BufferData(const BufferData &source) : theWritePointer(0)
+BufferData::BufferData(const BufferData &source) : theWritePointer(0), theBorrowed(false)
 {
 	theInfo = source.theInfo;
 	theInfo->reference();
@@ -90,22 +90,44 @@ BufferData::BufferData(const BufferData &source) : theWritePointer(0)
 	theOffset = source.theOffset;
 }
 
+BufferData::BufferData(const BufferData &source, uint index, uint amount) : theWritePointer(0), theBorrowed(true)
+{
+	theInfo = source.theInfo;
+	theVisibleSize = source.theVisibleSize;
+	theOffset = source.theOffset;
+	if (!isNull())
+	{
+#ifdef EDEBUG
+		assert(theInfo->m_sampleSize);
+		assert(index + amount <= source.samples());
+#endif
+		if (theInfo->theMask == (uint)~0)
+			theOffset += index * theInfo->m_sampleSize;
+		else
+			theOffset = (theOffset + index * theInfo->m_sampleSize) & theInfo->theMask;
+		theVisibleSize = amount * theInfo->m_sampleSize;
+	}
+}
+
 BufferData::~BufferData()
 {
 	if (theWritePointer)
 		endWritePointer();
-	theInfo->unreference(*this);
+	if (!theBorrowed)
+		theInfo->unreference(*this);
 }
 
 BufferData &BufferData::operator=(const BufferData &source)
 {
-	if (source.theInfo != theInfo)
+	if (source.theInfo != theInfo || theBorrowed)
 	{
 		if (theWritePointer)
 			endWritePointer();
-		theInfo->unreference(*this);
+		if (!theBorrowed)
+			theInfo->unreference(*this);
 		theInfo = source.theInfo;
 		theInfo->reference();
+		theBorrowed = false;
 	}
 	theVisibleSize = source.theVisibleSize;
 	theOffset = source.theOffset;
@@ -223,6 +245,56 @@ const BufferData &BufferData::dontRollOver(bool makeCopy) const
 	return *this;
 }
 
+uint BufferData::spans(ConstSpan* _s) const
+{
+	if (!isValid() || isNull() || !theVisibleSize)
+		return 0;
+	if (!rollsOver())
+	{	_s[0] = ConstSpan(firstPart(), theVisibleSize);
+		return 1;
+	}
+	_s[0] = ConstSpan(firstPart(), sizeFirstPart());
+	_s[1] = ConstSpan(secondPart(), sizeSecondPart());
+	return 2;
+}
+
+uint BufferData::spans(MutableSpan* _s)
+{
+	ConstSpan s[2];
+	uint ret = ((BufferData const*)this)->spans(s);
+	for (uint i = 0; i < ret; i++)
+		_s[i] = MutableSpan(const_cast<float*>(s[i].data), s[i].elements);
+	return ret;
+}
+
+uint BufferData::sampleSpans(ConstSpan* _s, uint* _straddle) const
+{
+	if (_straddle)
+		*_straddle = Undefined;
+	uint ret = spans(_s);
+	uint ss = sampleSize();
+	if (ret < 2 || !ss || !(_s[0].elements % ss))
+		return ret;
+
+	// Part of a sample is either side of the roll over; leave it out of both.
+	uint whole = _s[0].elements / ss;
+	uint rest = ss - _s[0].elements % ss;
+	if (_straddle)
+		*_straddle = whole;
+	_s[0].elements = whole * ss;
+	_s[1] = ConstSpan(_s[1].data + rest, _s[1].elements - rest);
+	return ret;
+}
+
+uint BufferData::sampleSpans(MutableSpan* _s, uint* _straddle)
+{
+	ConstSpan s[2];
+	uint ret = ((BufferData const*)this)->sampleSpans(s, _straddle);
+	for (uint i = 0; i < ret; i++)
+		_s[i] = MutableSpan(const_cast<float*>(s[i].data), s[i].elements);
+	return ret;
+}
+
 const BufferData BufferData::sample(uint index) const
 {
 #ifdef EDEBUG
@@ -285,10 +357,10 @@ const BufferData BufferData::mid(uint start, uint length) const
 	if (!isNull())
 	{
 		if (theInfo->theMask == (uint)~0)
-			// wrap around according to size as it's a custom buffer and mask is unavailable.
-			// NOTE: the buffer is theAccessibleSize big (it does not just refer to the
-			//       usable content (as it does with foreign Buffer theDatas)).
-			ret.theOffset = (theOffset + start) % theInfo->theAccessibleSize;
+			// no mask means either a plain array or a mirrored Buffer ring; either way
+			// the data is contiguous from theOffset, so there's nothing to wrap.
+			// NOTE: for mirrored rings theOffset may well be beyond theAccessibleSize.
+			ret.theOffset = theOffset + start;
 		else
 			ret.theOffset = (theOffset + start) & theInfo->theMask;	// normally should just wrap around according to mask
 		ret.theVisibleSize = length;
@@ -302,7 +374,7 @@ BufferData BufferData::mid(uint start, uint length)
 	if (!isNull())
 	{
 		if (theInfo->theMask == (uint)~0)
-			ret.theOffset = (theOffset + start) % theInfo->theAccessibleSize;
+			ret.theOffset = theOffset + start;
 		else
 			ret.theOffset = (theOffset + start) & theInfo->theMask;
 		ret.theVisibleSize = length;
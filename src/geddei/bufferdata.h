@@ -210,7 +210,11 @@ class DLLEXPORT BufferData
 
 	float *theWritePointer;
 
+	// True if we hold no reference to theInfo; see the borrowing constructor.
+	bool theBorrowed;
+
 	friend class Buffer;
+	friend class BufferDatas;
 	friend class BufferReader;
 	friend class RLConnection;
 	friend class LxConnection;
@@ -228,6 +232,9 @@ class DLLEXPORT BufferData
 	 * Check to see if the rollover functionality of the buffer data chunk is used.
 	 * If so, two seperate sends of sizes firstPart() and secondPart() would be needed.
 	 * Otherwise, just firstPart() is needed.
+	 *
+	 * Data from a mirrored Buffer (and plain arrays) have a mask of ~0 and so
+	 * never roll over.
 	 */
 	bool rollsOver() const { return theOffset + theVisibleSize - 1 > theInfo->theMask; }
 	uint sizeOnlyPart() const { return theVisibleSize; }
@@ -269,6 +276,17 @@ class DLLEXPORT BufferData
 
 	BufferData(BufferInfo *info, uint offset);
 
+	/**
+	 * Makes a view of @a amount samples of @a source starting at sample
+	 * @a index, as samples() would, but without taking a reference to the
+	 * data. It must therefore not outlive @a source (or rather the last
+	 * reference to the data); copies made of it are ordinary references and
+	 * have no such restriction.
+	 *
+	 * Used by BufferDatas to slice without touching the reference count.
+	 */
+	BufferData(const BufferData &source, uint index, uint amount);
+
 public:
 	/** @internal
 	 * Provides debug information on this class.
@@ -728,6 +746,77 @@ public:
 		theWritePointer = 0;
 	}
 
+	/**
+	 * A run of elements that are contiguous in memory; see spans().
+	 */
+	template<class F> struct Span
+	{
+		Span(): data(0), elements(0) {}
+		Span(F* _data, uint _elements): data(_data), elements(_elements) {}
+
+		F* data;
+		uint elements;
+	};
+	typedef Span<float const> ConstSpan;
+	typedef Span<float> MutableSpan;
+
+	/**
+	 * Gives our elements, in order, as the runs they are stored in, without
+	 * copying anything. Unlike readPointer() this is always free, so use it
+	 * in preference for tight loops over the data:
+	 *
+	 * @code
+	 * BufferData::ConstSpan s[2];
+	 * for (uint p = 0, n = d.spans(s); p < n; p++)
+	 *	for (uint i = 0; i < s[p].elements; i++)
+	 *		total += s[p].data[i];
+	 * @endcode
+	 *
+	 * There are two only when we roll over the end of a Buffer that isn't
+	 * mirrored.
+	 *
+	 * @param spans Array of at least two, to be populated.
+	 * @return The number of spans populated; zero if we're null.
+	 */
+	uint spans(ConstSpan* spans) const;
+
+	/** @overload
+	 * Gives our elements, in order, as the runs they are stored in, for
+	 * writing. Unlike writePointer(), there's nothing to do after.
+	 */
+	uint spans(MutableSpan* spans);
+
+	/**
+	 * As spans(), but each run is whole samples, for kernels that work a
+	 * sample at a time. If we roll over part way through a sample, that
+	 * sample is in neither run (either of which may then be empty) but comes
+	 * between them; its index is given in @a straddle. It must be got at with
+	 * the () operator or copied out with sample().
+	 *
+	 * @code
+	 * BufferData::ConstSpan s[2];
+	 * uint straddle;
+	 * for (uint p = 0, n = d.sampleSpans(s, &straddle); p < n; p++)
+	 * {
+	 *	if (p && straddle != Undefined)
+	 *		doSample(d.sample(straddle));
+	 *	for (float const* i = s[p].data; i < s[p].data + s[p].elements; i += d.sampleSize())
+	 *		doSample(i);
+	 * }
+	 * @endcode
+	 *
+	 * @param spans Array of at least two, to be populated.
+	 * @param straddle If non-zero, populated with the index of the sample that
+	 * is left out, or Undefined if there is none.
+	 * @return The number of spans populated; zero if we're null.
+	 */
+	uint sampleSpans(ConstSpan* spans, uint* straddle = 0) const;
+
+	/** @overload
+	 * As spans(), but each run is whole samples, for writing.
+	 */
+	uint sampleSpans(MutableSpan* spans, uint* straddle = 0);
+
 	/**
 	 * Assignment operator. This is used to set this BufferData object to
 	 * become equivalent to the BufferData object @a source.
@@ -22,56 +22,72 @@
 namespace Geddei
 {
 
-BufferDatas &BufferDatas::operator=(const BufferDatas &src)
+void BufferDatas::allocate(uint count)
 {
+	theCount = count;
+	theData = theCount <= InlineCount ? theInline : new const BufferData *[theCount];
 	for (uint i = 0; i < theCount; i++)
+		theData[i] = 0;
+}
+
+void BufferDatas::release(uint i)
+{
+	if (isInSlot(theData[i]))
+		theData[i]->~BufferData();
+	else
 		delete theData[i];
-	delete [] theData;
-	theCount = src.theCount;
-	theData = new const BufferData *[theCount];
+	theData[i] = 0;
+}
+
+void BufferDatas::releaseAll()
+{
+	for (uint i = 0; i < theCount; i++)
+		release(i);
+	if (theData != theInline)
+		delete [] theData;
+}
+
+BufferDatas &BufferDatas::operator=(const BufferDatas &src)
+{
+	if (&src == this)
+		return *this;
+	releaseAll();
+	allocate(src.theCount);
 	for (uint i = 0; i < theCount; i++)
-		theData[i] = new BufferData(*(src.theData[i]));
+		if (src.theData[i])
+			copyData(i, *(src.theData[i]));
 	return *this;
 }
 
 BufferDatas::BufferDatas(const BufferDatas &src)
 {
-	theCount = src.theCount;
-	theData = new const BufferData *[theCount];
+	allocate(src.theCount);
 	for (uint i = 0; i < theCount; i++)
-		theData[i] = src.theData[i] ? new BufferData(*(src.theData[i])) : 0;
+		if (src.theData[i])
+			copyData(i, *(src.theData[i]));
 }
 
-BufferDatas::BufferDatas(uint count) : theCount(count)
+BufferDatas::BufferDatas(uint count)
 {
-	theData = new const BufferData *[count];
-	for (uint i = 0; i < theCount; i++)
-		theData[i] = 0;
+	allocate(count);
 }
 
 BufferDatas::~BufferDatas()
 {
-	for (uint i = 0; i < theCount; i++)
-		delete theData[i];
-	delete [] theData;
+	releaseAll();
 }
 
 void BufferDatas::resize(uint count)
 {
-	for (uint i = 0; i < theCount; i++)
-		delete theData[i];
-	delete [] theData;
-	theCount = count;
-	theData = new const BufferData *[theCount];
-	for (uint i = 0; i < theCount; i++)
-		theData[i] = 0;
+	releaseAll();
+	allocate(count);
 }
 
 const BufferDatas BufferDatas::samples(uint index, uint amount) const
 {
 	BufferDatas ret(theCount);
 	for (uint i = 0; i < theCount; i++)
-		ret.copyData(i, theData[i]->samples(index, amount));
+		ret.theData[i] = i < InlineCount ? new (ret.slot(i)) BufferData(*theData[i], index, amount) : new BufferData(*theData[i], index, amount);
 	return ret;
 }
 
@@ -79,16 +95,14 @@ BufferDatas BufferDatas::samples(uint index, uint amount)
 {
 	BufferDatas ret(theCount);
 	for (uint i = 0; i < theCount; i++)
-		ret.copyData(i, theData[i]->samples(index, amount));
+		ret.theData[i] = i < InlineCount ? new (ret.slot(i)) BufferData(*theData[i], index, amount) : new BufferData(*theData[i], index, amount);
 	return ret;
 }
 
 void BufferDatas::nullify()
 {
 	for (uint i = 0; i < theCount; i++)
-	{	delete theData[i];
-		theData[i] = 0;
-	}
+		release(i);
 }
 
 }
@@ -18,6 +18,8 @@
 
 #pragma once
 
+#include <new>
+
 #include <exscalibar.h>
 #ifdef __GEDDEI_BUILD
 
@@ -46,8 +48,23 @@ namespace Geddei
 class DLLEXPORT BufferDatas
 {
 	friend class SubProcessor;
+
+	// The first InlineCount BufferData objects (and pointers to them) live in
+	// here rather than on the heap, so slicing with samples() costs no
+	// allocation for anything short of a very wide Processor.
+	enum { InlineCount = 4 };
+	union Slot { char theBytes[sizeof(BufferData)]; void *theAlign; };
+
 	uint theCount;
 	const BufferData **theData;
+	const BufferData *theInline[InlineCount];
+	Slot theSlots[InlineCount];
+
+	void allocate(uint count);
+	void release(uint i);
+	void releaseAll();
+	BufferData *slot(uint i) { return (BufferData *)(theSlots + i); }
+	bool isInSlot(const BufferData *d) const { return d >= (const BufferData *)theSlots && d < (const BufferData *)(theSlots + InlineCount); }
 
 public:
 	/** @internal
@@ -61,10 +78,12 @@ public:
 	 *
 	 * This should not need to be used in normal operation.
 	 *
+	 * Any BufferData already at @a i is discarded first.
+	 *
 	 * @param i The index to be poplulated.
 	 * @param d The BufferData object to be "duplicated".
 	 */
-	void copyData(uint i, const BufferData &d) { theData[i] = new BufferData(d); }
+	void copyData(uint i, const BufferData &d) { release(i); theData[i] = i < InlineCount ? new (slot(i)) BufferData(d) : new BufferData(d); }
 
 	/** @internal
 	 * Sets the BufferData at index @a i to be a reference to the BufferData at
@@ -81,6 +100,10 @@ public:
 	/** @internal
 	 * Get a subset of samples from the BufferData objects.
 	 *
+	 * The BufferData objects of the result are views that hold no reference
+	 * to the data, so it must not outlive this object (or, at least, the
+	 * data it refers to). Copying it gives ordinary references.
+	 *
 	 * This should not need to be used in normal operation.
 	 *
 	 * @return The array containing only a subset of samples from each of the
@@ -35,13 +35,17 @@ BufferReader::BufferReader(Buffer *buffer)
 
 	m_lastReadSize = 0;
 	QFastMutexLocker lock(&theBuffer->theDataFlux);
+	theBuffer->suspendSoleUNSAFE();
 	readPos = theBuffer->readPos;
 	theUsed = theBuffer->theUsed;
+	m_consumed = theBuffer->m_released;
 	theToBeSkipped = 0;
 	theAlreadyPlungedHere = 0;
-	theBuffer->theReaders.append(this);
-
+	m_task = 0;
 	lastRead = new BufferInfo(theBuffer->theData, this, theBuffer->theMask, BufferInfo::Foreign, BufferInfo::Read);
+
+	theBuffer->theReaders.append(this);
+	theBuffer->updateSoleReaderUNSAFE();
 }
 
 BufferReader::~BufferReader()
@@ -49,11 +53,15 @@ BufferReader::~BufferReader()
 	if (MESSAGES) qDebug("> [%p] ~BufferData()", this);
 
 	QFastMutexLocker lock(&theBuffer->theDataFlux);
+	theBuffer->suspendSoleUNSAFE();
 	clearUNSAFE();
 	delete lastRead;
 	theBuffer->theReaders.removeOne(this);
-	theBuffer->theDataIn.wakeAll();
-	theBuffer->theDataOut.wakeAll();
+	// We may have been holding the others back.
+	theBuffer->updateUNSAFE();
+	theBuffer->updateSoleReaderUNSAFE();
+	theBuffer->wakeReadersUNSAFE();
+	theBuffer->wakeWriter();
 }
 
 void BufferReader::debug()
@@ -66,6 +74,7 @@ void BufferReader::skipPlunger()
 	if (MESSAGES) qDebug("> skipPlunger (rP: %d, tAPH: %d)", readPos, theAlreadyPlungedHere);
 	QFastMutexLocker lock(&theBuffer->theDataFlux);
 	theAlreadyPlungedHere++;
+	m_counters.plungers++;
 	if (MESSAGES) qDebug("< skipPlunger (rP: %d, tAPH: %d)", readPos, theAlreadyPlungedHere);
 }
 
@@ -74,7 +83,7 @@ uint BufferReader::elementsReady() const
 	if (MESSAGES) qDebug("= elementsReady (rP: %d, tAPH: %d", readPos, theAlreadyPlungedHere);
 	QFastMutexLocker lock(&theBuffer->theDataFlux);
 	int untilPlunger = theBuffer->nextPlungerUNSAFE(readPos, theAlreadyPlungedHere);
-	if (untilPlunger == -1 || untilPlunger > signed(theUsed))
+	if (untilPlunger == -1 || untilPlunger > int(theUsed))
 		return theUsed;
 	else
 		return untilPlunger;
@@ -130,8 +139,8 @@ void BufferReader::skipElementsUNSAFE(uint elements)
 //	if (theBuffer->nextPlungerUNSAFE(readPos, theAlreadyPlungedHere) != -1)
 	if (uint(theBuffer->nextPlungerUNSAFE(readPos, theAlreadyPlungedHere)) < elements + m_lastReadSize)
 	{	if (qMESSAGES) qDebug("= skipElementsUNSAFE: Plunger detected in stream. Waiting for last read (%p) to end...", lastRead);
-		while (lastRead->isActive() && !theBuffer->trapdoorUNSAFE())
-			theBuffer->theDataOut.wait(&theBuffer->theDataFlux);
+		for (int ticket = theBuffer->theDataOut.sequence(); lastRead->isActive() && !theBuffer->trapdoorUNSAFE(); ticket = theBuffer->theDataOut.sequence())
+			theBuffer->theDataOut.waitFrom(ticket, &theBuffer->theDataFlux);
 		if (qMESSAGES) qDebug("= skipElementsUNSAFE: Last read done (%p)...", lastRead);
 	}
 
@@ -154,8 +163,10 @@ void BufferReader::skipElementsUNSAFE(uint elements)
 		if (theToBeSkipped) qWarning("*** STRANGE: Still have elements to skip inside a clear skipElements.");
 #endif
 		if (qMESSAGES) qDebug("= skipElementsUNSAFE: Artificially moving pointers...");
-		readPos = (readPos + elements) & theBuffer->theMask;
-		theUsed -= elements;
+		readPos = theBuffer->wrap(readPos + elements);
+		theUsed.fetchAndAddOrdered(-int(elements));
+		m_consumed += elements;
+		m_counters.elements += elements;
 		theAlreadyPlungedHere = 0;
 		theBuffer->updateUNSAFE();
 	}
@@ -165,6 +176,21 @@ void BufferReader::skipElementsUNSAFE(uint elements)
 const BufferData BufferReader::readElements(uint elements, bool autoFree)
 {
 	if (MESSAGES) qDebug("> [%p] readElements(%d)", this, elements);
+	{	Buffer::LockFree f(theBuffer);
+		if (theBuffer->soleReader() == this && uint(theUsed) >= elements && !lastRead->isActive())
+		{
+			// Lock-free: the data's already there and there are no plungers
+			// to stop short at, so just hand it over.
+			lastRead->theValid = true;
+			lastRead->theAccessibleSize = elements;
+			lastRead->theEndType = autoFree ? BufferInfo::Activate : BufferInfo::Forget;
+			lastRead->m_sampleSize = theBuffer->theType->size();
+			lastRead->thePlunger = false;
+			m_lastReadSize = elements;
+			if (MESSAGES) qDebug("< [%p] readElements (lock-free, r: %p)", this, lastRead);
+			return BufferData(lastRead, readPos);
+		}
+	}
 	QFastMutexLocker lock(&theBuffer->theDataFlux);
 #ifdef EDEBUG
 	if (elements > theBuffer->size())
@@ -213,6 +239,26 @@ const BufferData BufferReader::readElements(uint elements, bool autoFree)
 void BufferReader::haveRead(const BufferData &data)
 {
 	if (MESSAGES) qDebug("> haveRead");
+	{	Buffer::LockFree f(theBuffer);
+		if (theBuffer->soleReader() == this && data.info() == lastRead && !lastRead->thePlunger && !theToBeSkipped)
+		{
+			// Lock-free: nothing to skip and no plungers to retire.
+			uint elements = lastRead->theAccessibleSize;
+			lastRead->invalidateAndIgnore();
+			if (elements)
+			{	m_counters.sampleFill(theUsed);
+				m_counters.elements += elements;
+				readPos = theBuffer->wrap(readPos + elements);
+				theUsed.fetchAndAddOrdered(-int(elements));
+				m_consumed += elements;
+				theAlreadyPlungedHere = 0;
+				theBuffer->releaseSole(elements);
+			}
+			m_lastReadSize = 0;
+			if (MESSAGES) qDebug("< haveRead (lock-free)");
+			return;
+		}
+	}
 	QFastMutexLocker lock(&theBuffer->theDataFlux);
 	if (!data.info()->isLive())
 	{	qWarning("*** ERROR: Cannot haveRead() on a non-live BufferInfo (v: %d, t: %s)", data.info()->theValid, data.info()->theLife == BufferInfo::Foreign ? "F" : "M");
@@ -226,11 +272,17 @@ void BufferReader::haveRead(const BufferData &data)
 	if (MESSAGES) qDebug("= [%p] haveRead(%p)", this, data.info());
 	lastRead->invalidateAndIgnore();
 	if (lastRead->theAccessibleSize)
-	{	readPos = (readPos + lastRead->theAccessibleSize) & theBuffer->theMask;
-		theUsed -= lastRead->theAccessibleSize;
+	{	m_counters.sampleFill(theUsed);
+		m_counters.elements += lastRead->theAccessibleSize;
+		readPos = theBuffer->wrap(readPos + lastRead->theAccessibleSize);
+		theUsed.fetchAndAddOrdered(-int(lastRead->theAccessibleSize));
+		m_consumed += lastRead->theAccessibleSize;
 		theAlreadyPlungedHere = 0;
 	}
-	if (lastRead->thePlunger) theAlreadyPlungedHere++;
+	if (lastRead->thePlunger)
+	{	theAlreadyPlungedHere++;
+		m_counters.plungers++;
+	}
 	m_lastReadSize = 0;
 	uint skipNow = theToBeSkipped;
 	theToBeSkipped = 0;
@@ -252,16 +304,25 @@ void BufferReader::forgetRead(const BufferData &data)
 	m_lastReadSize = 0;
 	uint skipNow = theToBeSkipped;
 	theToBeSkipped = 0;
-	if (MESSAGES) qDebug("= [%p] forgetRead (skipNow: %d, theUsed: %d)", this, skipNow, theUsed);
+	if (MESSAGES) qDebug("= [%p] forgetRead (skipNow: %d, theUsed: %d)", this, skipNow, int(theUsed));
 	if (skipNow) skipElementsUNSAFE(skipNow);
 	theBuffer->updateUNSAFE();
 	if (MESSAGES) qDebug("< [%p] forgetRead ", this);
 }
 
+PortCounters BufferReader::counters() const
+{
+	PortCounters ret = m_counters;
+	ret.capacity = theBuffer->size();
+	ret.sampleSize = theBuffer->type().size();
+	return ret;
+}
+
 void BufferReader::clearUNSAFE()
 {
 	if (MESSAGES) qDebug("> [%p] clearUNSAFE()", this);
 	theUsed = 0;
+	m_consumed = 0;
 	readPos = 0;
 	theAlreadyPlungedHere = 0;
 	theToBeSkipped = 0;
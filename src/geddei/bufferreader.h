@@ -38,12 +38,23 @@ class Processor;
  * @brief Conspirator class for conducting read operations on Buffer objects.
  * @author Gav Wood <gav@kde.org>
  */
-class BufferReader : public ScreenOwner
+class DLLEXPORT BufferReader : public ScreenOwner
 {
 	friend class Buffer;
 	Buffer *theBuffer;
 	BufferInfo *lastRead;
-	uint readPos, m_lastReadSize, theUsed, theToBeSkipped, theAlreadyPlungedHere;
+	uint readPos, m_lastReadSize, theToBeSkipped, theAlreadyPlungedHere;
+	QAtomicInt theUsed;
+
+	// Total elements we've moved past since the last clear; compared against
+	// Buffer::m_released to know how far the Buffer may move on.
+	uint m_consumed;
+
+	// The task that reads through us, if any; woken when there's something new to read.
+	QtExtra::QTask *m_task;
+
+	// Only ever touched by the reader (or under theDataFlux).
+	mutable PortCounters m_counters;
 
 	/**
 	 * The guts of skipElements. Do not use directly.
@@ -58,6 +69,20 @@ class BufferReader : public ScreenOwner
 public:
 	uint lastReadSize() const { return m_lastReadSize; }
 
+	/**
+	 * Sets the task that reads through us. It will be woken whenever data or
+	 * a plunger arrives.
+	 */
+	void setTask(QtExtra::QTask *task) { m_task = task; }
+
+	/**
+	 * @return A snapshot of our counters: elements and plungers read past,
+	 * time spent waiting for data and the fill level at each read.
+	 *
+	 * Thread-safe (though only approximate while the reader is running).
+	 */
+	PortCounters counters() const;
+
 	void openTrapdoor(const Processor *processor);
 	void closeTrapdoor(const Processor *processor);
 
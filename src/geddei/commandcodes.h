@@ -40,5 +40,10 @@ enum Command
 	SpecifyTypes,
 	InitFromProperties,
 	ProcessChunks,
-	DefineIO
+	DefineIO,
+	Credit,
+	ShareRing,
+	SharedTransfer,
+	SetLinkCodec,
+	EncodedTransfer
 };
@@ -0,0 +1,64 @@
+/* Copyright 2003, 2004, 2005, 2007, 2009, 2010 Gavin Wood <gav@kde.org>
+ *
+ * This file is part of Exscalibar.
+ *
+ * Exscalibar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Exscalibar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Exscalibar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QUrl>
+
+#include "counters.h"
+using namespace Geddei;
+
+namespace Geddei
+{
+
+static QString dumpName(QString const& _n)
+{
+	return QString::fromLatin1(QUrl::toPercentEncoding(_n));
+}
+
+static QString dumpPort(char const* _what, QString const& _name, int _i, PortCounters const& _c)
+{
+	return QString("%1 name=%2 index=%3 elements=%4 samples=%5 plungers=%6 waits=%7 waittime=%8 fill=%9 fillmax=%10 capacity=%11\n")
+		.arg(_what).arg(_name).arg(_i)
+		.arg(_c.elements).arg(_c.samples()).arg(_c.plungers)
+		.arg(_c.waits).arg(_c.waitTime, 0, 'g', 9)
+		.arg(_c.averageFill(), 0, 'f', 1).arg(_c.fillMax).arg(_c.capacity);
+}
+
+QString ProcessorCounters::dump() const
+{
+	QString n = dumpName(name);
+	QString ret = QString("processor name=%1 type=%2 time=%3 cycles=%4 dispatches=%5 busy=%6 starved=%7 stalled=%8 calls=%9 chunks=%10 subtime=%11\n")
+		.arg(n).arg(dumpName(type)).arg(time, 0, 'f', 6)
+		.arg(cycles).arg(dispatches).arg(busyTime, 0, 'g', 9)
+		.arg(starved).arg(stalled)
+		.arg(sub.calls).arg(sub.chunks).arg(sub.time, 0, 'g', 9);
+	for (int i = 0; i < inputs.count(); i++)
+		ret += dumpPort("input", n, i, inputs[i]);
+	for (int i = 0; i < outputs.count(); i++)
+		ret += dumpPort("output", n, i, outputs[i]);
+	return ret;
+}
+
+QString dumpCounters(QList<ProcessorCounters> const& _c)
+{
+	QString ret;
+	foreach (ProcessorCounters const& c, _c)
+		ret += c.dump();
+	return ret;
+}
+
+}
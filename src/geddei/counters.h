@@ -0,0 +1,144 @@
+/* Copyright 2003, 2004, 2005, 2007, 2009, 2010 Gavin Wood <gav@kde.org>
+ *
+ * This file is part of Exscalibar.
+ *
+ * Exscalibar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Exscalibar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Exscalibar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QString>
+#include <QVector>
+#include <QList>
+
+#include <exscalibar.h>
+
+namespace Geddei
+{
+
+/** @ingroup Geddei
+ * @brief Performance counters for one end of a connection.
+ * @author Gav Wood <gav@kde.org>
+ *
+ * For an output these are kept by the Buffer being written to; for an input
+ * by the BufferReader reading from it. Each is only ever updated by the one
+ * thread (or task) that owns that end and with no extra locking, so a
+ * snapshot taken from elsewhere is consistent only to within a few
+ * operations.
+ *
+ * Remote outputs (i.e. those going over a network link) have no Buffer on
+ * this side and report nothing; look at the input end on the remote host.
+ */
+struct DLLEXPORT PortCounters
+{
+	PortCounters(): elements(0), plungers(0), waits(0), waitTime(0.0), fillTotal(0), fillSamples(0), fillMax(0), capacity(0), sampleSize(1) {}
+
+	/// Elements pushed (for an output) or read past (for an input).
+	quint64 elements;
+	/// Plungers pushed or read past.
+	quint64 plungers;
+	/// Number of times we actually had to block; for space at an output or for data at an input.
+	quint64 waits;
+	/// Total seconds spent so blocked.
+	double waitTime;
+	/// Sum of the fill level, in elements, sampled on each push (output) or read (input).
+	quint64 fillTotal;
+	/// Number of times the fill level was sampled.
+	quint64 fillSamples;
+	/// Highest fill level sampled.
+	uint fillMax;
+	/// Size of the Buffer in elements. Filled in on snapshot.
+	uint capacity;
+	/// Elements per sample of the connection's type. Filled in on snapshot.
+	uint sampleSize;
+
+	void sampleFill(uint _fill) { fillTotal += _fill; fillSamples++; if (_fill > fillMax) fillMax = _fill; }
+	double averageFill() const { return fillSamples ? double(fillTotal) / double(fillSamples) : 0.0; }
+	quint64 samples() const { return sampleSize ? elements / sampleSize : elements; }
+};
+
+/** @ingroup Geddei
+ * @brief Performance counters for a SubProcessor.
+ * @author Gav Wood <gav@kde.org>
+ */
+struct DLLEXPORT SubProcessorCounters
+{
+	SubProcessorCounters(): calls(0), chunks(0), time(0.0) {}
+
+	/// Number of processChunks() calls.
+	quint64 calls;
+	/// Total chunks processed.
+	quint64 chunks;
+	/// Total seconds spent in processChunks().
+	double time;
+
+	SubProcessorCounters& operator+=(SubProcessorCounters const& _c) { calls += _c.calls; chunks += _c.chunks; time += _c.time; return *this; }
+};
+
+/** @ingroup Geddei
+ * @brief Snapshot of a Processor's performance counters.
+ * @author Gav Wood <gav@kde.org>
+ *
+ * Obtained through Processor::counters() or, for a whole network,
+ * ProcessorGroup::counters(). All figures are cumulative since the Processor
+ * was created, so the difference between two snapshots gives the figures
+ * for the period between them.
+ *
+ * The dump format (see dump()) is line-oriented plain text, one line for the
+ * Processor and one per port, each a keyword followed by space-separated
+ * key=value pairs:
+ *
+ * @code
+ * processor name=<name> type=<type> time=<s> cycles=<n> dispatches=<n> busy=<s> starved=<n> stalled=<n> calls=<n> chunks=<n> subtime=<s>
+ * input name=<name> index=<i> elements=<n> samples=<n> plungers=<n> waits=<n> waittime=<s> fill=<avg> fillmax=<n> capacity=<n>
+ * output name=<name> index=<i> ...
+ * @endcode
+ *
+ * Names are percent-encoded so that they contain no spaces.
+ */
+struct DLLEXPORT ProcessorCounters
+{
+	ProcessorCounters(): time(0.0), cycles(0), dispatches(0), busyTime(0.0), starved(0), stalled(0) {}
+
+	QString name;
+	QString type;
+	/// Steady time (in seconds) at which the snapshot was taken.
+	double time;
+	/// Number of processing cycles done (i.e. Processor::guardsCrossed()).
+	quint64 cycles;
+	/// Number of times we were run by the scheduler (task-based Processors only).
+	quint64 dispatches;
+	/// Total seconds spent running under the scheduler (task-based Processors only).
+	double busyTime;
+	/// Number of dispatches that found too little input to do a cycle (CoProcessors only).
+	quint64 starved;
+	/// Number of dispatches that found too little output space to do a cycle (CoProcessors only).
+	quint64 stalled;
+	/// Summed over all of a DomProcessor's SubProcessors, primary and workers. Empty otherwise.
+	SubProcessorCounters sub;
+	QVector<PortCounters> inputs;
+	QVector<PortCounters> outputs;
+
+	/**
+	 * @return The snapshot in dump format, newline-terminated.
+	 */
+	QString dump() const;
+};
+
+/**
+ * @return All of @a _c in dump format.
+ */
+DLLEXPORT QString dumpCounters(QList<ProcessorCounters> const& _c);
+
+}
@@ -18,12 +18,18 @@
 
 #include <cmath>
 
+#include <QThread>
+
+#include "qscheduler.h"
+
 #include "dxcoupling.h"
 #include "dscoupling.h"
 #include "subprocessor.h"
 #include "domprocessor.h"
 #include "subprocessorfactory.h"
 #include "processorforwarder.h"
+#include "processorgroup.h"
+#include "fusion.h"
 
 #define MESSAGES 0
 #define hMESSAGES 0
@@ -36,7 +42,25 @@ DomProcessor::DomProcessor(SubProcessor *primary):
 	CoProcessor("DomProcessor", primary->theMulti),
 	thePrimary(primary),
 	theCurrentIns(0),
-	theCurrentOuts(0)
+	theCurrentOuts(0),
+	thePrimaryThroughput(0.0),
+	theStateful(0),
+	theWarmUp(0),
+	theStateHolder(0),
+	theMaxBatches(1),
+	theAutotune(false),
+	theStartWorkers(0),
+	theActiveWorkers(0),
+	theFitChunks(1),
+	theMaxTuneChunks(1),
+	theTuneChunks(0),
+	theTunePrevChunks(0),
+	theTuneStart(0.0),
+	theTuneDone(0),
+	theTuneBatches(0),
+	theTuneBaseline(0.0),
+	theTrial(NoTrial),
+	theNextTrial(GrowTrial)
 {
 	primary->thePrimaryOf = this;
 }
@@ -44,13 +68,33 @@ DomProcessor::DomProcessor(SubProcessor *primary):
 DomProcessor::DomProcessor(const QString &primaryType):
 	CoProcessor("DomProcessor", (thePrimary = SubProcessorFactory::create(primaryType))->theMulti),
 	theCurrentIns(0),
-	theCurrentOuts(0)
+	theCurrentOuts(0),
+	thePrimaryThroughput(0.0),
+	theStateful(0),
+	theWarmUp(0),
+	theStateHolder(0),
+	theMaxBatches(1),
+	theAutotune(false),
+	theStartWorkers(0),
+	theActiveWorkers(0),
+	theFitChunks(1),
+	theMaxTuneChunks(1),
+	theTuneChunks(0),
+	theTunePrevChunks(0),
+	theTuneStart(0.0),
+	theTuneDone(0),
+	theTuneBatches(0),
+	theTuneBaseline(0.0),
+	theTrial(NoTrial),
+	theNextTrial(GrowTrial)
 {
 	thePrimary->thePrimaryOf = this;
 }
 
 DomProcessor::~DomProcessor()
 {
+	while (theStitches.size())
+		delete theStitches.takeLast();
 	while (theWorkers.size())
 		delete theWorkers.takeLast();
 	assert(theWorkers.isEmpty());
@@ -83,9 +127,9 @@ bool DomProcessor::createAndAddWorker()
 	return true;
 }
 
-bool DomProcessor::createAndAddWorker(const QString &host, uint key)
+bool DomProcessor::createAndAddWorker(const QString &host, uint key, LinkCodec::Mode codec)
 {
-	return ProcessorForwarder::createCoupling(this, host, key, thePrimary->type()) != 0;
+	return ProcessorForwarder::createCoupling(this, host, key, thePrimary->type(), codec) != 0;
 }
 
 void DomProcessor::wantToStopNow()
@@ -94,6 +138,8 @@ void DomProcessor::wantToStopNow()
 
 	if (MESSAGES) qDebug("DomProcessor[%s]: %d workers.", qPrintable(theName), theWorkers.count());
 
+	CoProcessor::wantToStopNow();
+
 	if (MESSAGES) qDebug("DomProcessor[%s]: OK.", qPrintable(theName));
 }
 
@@ -107,13 +153,40 @@ void DomProcessor::haveStoppedNow()
 
 	theCurrentIns.nullify();
 	theCurrentOuts.nullify();
+	while (!theBatches.isEmpty())
+		delete theBatches.takeLast();
+
+	if (theAutotune)
+		for (; theActiveWorkers; theActiveWorkers--)
+			if (isLocal(theActiveWorkers - 1))
+				releaseCore();
+	theTuneChunks = 0;
 }
 
 void DomProcessor::specifyInputSpace(QVector<uint> &samples)
 {
 	theWantChunks = theWorkers.count() + 1;
 
-	if (theAlterBuffer)
+	if (theAutotune)
+	{
+		// Before we start it's for sizing the buffers, so give the most we'll ever want.
+		// The cache-sized share is capped so that the whole batch, over all
+		// the workers we might use, fits the "Optimal Throughput" buffer size.
+		uint shares = theMaxBatches > 1 ? 1 : theWorkers.count() + 1;
+		if (!theTuneChunks)
+		{
+			uint optimalSamples = Undefined;
+			for (uint i = 0; i < (uint)samples.count(); i++)
+				optimalSamples = min(optimalSamples, theOptimalThroughput / max(1u, input(i).readType().size()));
+			uint optimalChunks = optimalSamples > theSamplesIn ? (optimalSamples - theSamplesIn) / max(1u, theSamplesStep) + 1 : 1;
+			theMaxTuneChunks = max(1u, min(theFitChunks * 4, optimalChunks / shares));
+		}
+		if (theTuneChunks)
+			theWantChunks = theTuneChunks * (theMaxBatches > 1 ? 1 : theActiveWorkers + 1);
+		else
+			theWantChunks = theMaxTuneChunks * shares;
+	}
+	else if (theAlterBuffer)
 	{
 		uint minimumSamples = theWorkers.count() * theSamplesStep + theSamplesIn;
 		uint optimalSamples = Undefined;
@@ -126,6 +199,10 @@ void DomProcessor::specifyInputSpace(QVector<uint> &samples)
 
 	}
 
+	// When pipelined, each batch goes whole to one worker, so make it the size of a single share.
+	if (theMaxBatches > 1 && !theAutotune)
+		theWantChunks /= theWorkers.count() + 1;
+
 	theWantSamples = (theWantChunks - 1) * theSamplesStep + theSamplesIn;
 
 	for (uint i = 0; i < (uint)samples.count(); i++)
@@ -136,7 +213,7 @@ void DomProcessor::specifyInputSpace(QVector<uint> &samples)
 
 void DomProcessor::requireInputSpace(QVector<uint> &samples)
 {
-	uint minimumSize = theSamplesIn + theSamplesStep * theWorkers.count();
+	uint minimumSize = theSamplesIn + (theMaxBatches > 1 ? 0 : theSamplesStep * theActiveWorkers);
 	for (uint i = 0; i < (uint)samples.count(); i++)
 		samples[i] = minimumSize;
 }
@@ -154,6 +231,22 @@ bool DomProcessor::processorStarted()
 	theCurrentIns.resize(numInputs());
 	theCurrentOuts.resize(numOutputs());
 
+	if (theAutotune)
+	{
+		// Start with as many as we were asked for, or as many as the budget allows.
+		theActiveWorkers = 0;
+		while (theActiveWorkers < min<uint>(theStartWorkers, theWorkers.count()) && (!isLocal(theActiveWorkers) || claimCore()))
+			theActiveWorkers++;
+		theTuneChunks = min(theFitChunks, theMaxTuneChunks);
+		theTuneStart = QScheduler::steadyTime();
+		theTuneDone = 0;
+		theTuneBatches = 0;
+		theTrial = NoTrial;
+		theNextTrial = GrowTrial;
+	}
+	else
+		theActiveWorkers = theWorkers.count();
+
 	// Start all sub-processors
 	foreach (DxCoupling* w, theWorkers)
 		w->go();
@@ -168,6 +261,7 @@ bool DomProcessor::serviceSubs()
 		foreach (DxCoupling* w, theWorkers)
 			if (!w->isReady())
 				return false;
+		stitch();
 		for (uint i = 0; i < theCurrentOuts.count(); i++)
 			output(i) << theCurrentOuts[i];
 		theCurrentIns.nullify();
@@ -181,13 +275,63 @@ bool DomProcessor::serviceSubs()
 	return true;
 }
 
+ProcessorCounters DomProcessor::counters() const
+{
+	ProcessorCounters ret = CoProcessor::counters();
+	ret.sub = thePrimary->counters();
+	foreach (DxCoupling* w, theWorkers)
+		ret.sub += w->counters();
+	return ret;
+}
+
 int DomProcessor::canProcess()
 {
+	if (theMaxBatches > 1)
+	{
+		retireBatches();
+		if (theAutotune)
+			autotune();
+		if (!theBatches.isEmpty())
+		{
+			if (uint(theBatches.count()) >= theMaxBatches)
+				return NoWork;
+			// Don't let cyclesReady() near a plunger (which it would pass on
+			// at once) until everything ahead of it is out.
+			for (uint i = 0; i < numInputs(); i++)
+				if (input(i).samplesReady() < theWantSamples)
+					return NoWork;
+		}
+		return CanWork;
+	}
 	if (!serviceSubs())
 		return NoWork;
+	// Nothing's in flight, so now's when the batch size may change.
+	if (theAutotune)
+		autotune();
 	return CanWork;
 }
 
+int DomProcessor::processPartial(uint _samples)
+{
+	uint chunks = (_samples - theSamplesIn) / theSamplesStep + 1;
+	for (uint i = 0; i < theCurrentIns.count(); i++)
+		theCurrentIns.copyData(i, input(i).peekSamples(_samples));	// normally would be theWantSamples
+	for (uint i = 0; i < theCurrentOuts.count(); i++)
+		theCurrentOuts.copyData(i, output(i).makeScratchSamples(chunks * theSamplesOut));	// normally would be theWantChunks * theSamplesOut
+	handOffState(theStateful);
+	if (theWorkers.count())
+		thePrimary->doChunks(theCurrentIns, theCurrentOuts, chunks);
+	else
+		thePrimary->doOwnChunks(theCurrentIns, theCurrentOuts, chunks);
+	for (uint i = 0; i < theCurrentOuts.count(); i++)
+		output(i) << theCurrentOuts[i];
+	theCurrentIns.nullify();
+	theCurrentOuts.nullify();
+	for (uint i = 0; i < theCurrentIns.count(); i++)
+		input(i).readSamples(_samples);	// normally would be theWantSamples - theSamplesIn + theSamplesStep
+	return DidWork;
+}
+
 int DomProcessor::process()
 {
 	uint samples = Undefined;
@@ -198,46 +342,255 @@ int DomProcessor::process()
 	{
 		qDebug() << "*** Stream discontinuity!";
 		// stream discontinuity.
-		uint chunks = (samples - theSamplesIn) / theSamplesStep + 1;
-		for (uint i = 0; i < theCurrentIns.count(); i++)
-			theCurrentIns.copyData(i, input(i).peekSamples(samples));	// normally would be theWantSamples
-		for (uint i = 0; i < theCurrentOuts.count(); i++)
-			theCurrentOuts.copyData(i, output(i).makeScratchSamples(chunks * theSamplesOut));	// normally would be theWantChunks * theSamplesOut
-		if (theWorkers.count())
-			thePrimary->processChunks(theCurrentIns, theCurrentOuts, chunks);
-		else
-			thePrimary->processOwnChunks(theCurrentIns, theCurrentOuts, chunks);
-		for (uint i = 0; i < theCurrentOuts.count(); i++)
-			output(i) << theCurrentOuts[i];
-		theCurrentIns.nullify();
-		theCurrentOuts.nullify();
-		for (uint i = 0; i < theCurrentIns.count(); i++)
-			input(i).readSamples(samples);	// normally would be theWantSamples - theSamplesIn + theSamplesStep
-		return DidWork;
+		if (!theBatches.isEmpty())
+			return NoWork;
+		return processPartial(samples);
 	}
+	else if (theMaxBatches > 1)
+		return processPipelined();
 	else
 	{
-		uint chunksEach = theWantChunks / (theWorkers.count() + 1);
+		shareChunks(theWantChunks);
+		theTuneDone += theWantChunks;
+		theTuneBatches++;
 		for (uint i = 0; i < theCurrentIns.count(); i++)
 			theCurrentIns.copyData(i, input(i).peekSamples(theWantSamples));
 		for (uint i = 0; i < theCurrentOuts.count(); i++)
 			theCurrentOuts.copyData(i, output(i).makeScratchSamples(theWantChunks * theSamplesOut));
-		for (int i = 0; i <= theWorkers.count(); i++)
+		for (uint i = 0, start = 0; i <= theActiveWorkers; start += theShares[i], i++)
 		{
-			BufferDatas ins = theCurrentIns.samples(i * chunksEach * theSamplesStep, (chunksEach - 1) * theSamplesStep + theSamplesIn);
-			BufferDatas outs = theCurrentOuts.samples(i * chunksEach * theSamplesOut, chunksEach * theSamplesOut);
+			uint chunks = theShares[i];
+			if (!chunks)
+				continue;
+			uint warmUp = 0;
+			if (theStateful && !start)
+				handOffState(statefulSub(i));
+			else if (theStateful)
+			{
+				// shareChunks() makes sure there's always enough before us.
+				statefulSub(i)->resetState();
+				warmUp = theWarmUp;
+			}
+			if (theStateful && start + chunks == theWantChunks)
+				theStateHolder = statefulSub(i);
+			BufferDatas ins = theCurrentIns.samples((start - warmUp) * theSamplesStep, (chunks + warmUp - 1) * theSamplesStep + theSamplesIn);
+			BufferDatas outs = theCurrentOuts.samples(start * theSamplesOut, chunks * theSamplesOut);
+			if (warmUp)
+			{
+				Stitch* s = new Stitch;
+				s->start = start;
+				s->warmUp = warmUp;
+				s->chunks = chunks;
+				s->outs.resize(numOutputs());
+				for (uint o = 0; o < numOutputs(); o++)
+				{
+					uint sampleSize = output(o).writeType().size();
+					s->outs.setData(o, new BufferData((chunks + warmUp) * theSamplesOut * sampleSize, sampleSize));
+				}
+				theStitches.append(s);
+				outs = s->outs;
+				chunks += warmUp;
+			}
 			if (!theWorkers.count())
-				thePrimary->processOwnChunks(ins, outs, chunksEach);
-			else if (i == theWorkers.count())
-				thePrimary->processChunks(ins, outs, chunksEach);
+				thePrimary->doOwnChunks(ins, outs, chunks);
+			else if (i == theActiveWorkers)
+			{
+				double s = QScheduler::steadyTime();
+				thePrimary->doChunks(ins, outs, chunks);
+				double elapsed = QScheduler::steadyTime() - s;
+				if (elapsed > 0.0)
+					thePrimaryThroughput = DxCoupling::averageThroughput(thePrimaryThroughput, chunks / elapsed);
+			}
 			else
-				theWorkers[i]->processChunks(ins, outs, chunksEach);
+				theWorkers[i]->processChunks(ins, outs, chunks);
 		}
 		serviceSubs();
 		return DidWork;
 	}
 }
 
+void DomProcessor::shareChunks(uint _chunks)
+{
+	uint n = theActiveWorkers + 1;
+	theShares.resize(n);
+	theIdleBatches.resize(n);
+
+	// Rate for each, the primary last. Those we don't know yet get the average.
+	QVector<double> rate(n);
+	double known = 0.0;
+	uint knownCount = 0;
+	for (uint i = 0; i < n; i++)
+	{	rate[i] = i < n - 1 ? theWorkers[i]->throughput() : thePrimaryThroughput;
+		if (rate[i] > 0.0)
+		{	known += rate[i];
+			knownCount++;
+		}
+	}
+	double total = 0.0;
+	for (uint i = 0; i < n; i++)
+	{	if (rate[i] <= 0.0)
+			rate[i] = knownCount ? known / knownCount : 1.0;
+		total += rate[i];
+	}
+
+	// Share in proportion, so all should finish together. Anyone left out
+	// for too long gets a single chunk, so we notice if they've sped up.
+	uint given = 0;
+	uint fastest = n - 1;
+	QVector<bool> probe(n, false);
+	for (uint i = 0; i < n; i++)
+	{	theShares[i] = uint(_chunks * rate[i] / total);
+		if (theShares[i] || i == n - 1 || ++theIdleBatches[i] >= ProbePeriod)
+		{	theIdleBatches[i] = 0;
+			probe[i] = !theShares[i] && i != n - 1;
+			theShares[i] = max(1u, theShares[i]);
+		}
+		given += theShares[i];
+		if (rate[i] > rate[fastest])
+			fastest = i;
+	}
+
+	// Rounding leftovers go to (or come from) the fastest. Excess comes from
+	// anyone but a prober, unless there's no other way, else it'd never be measured.
+	if (given < _chunks)
+		theShares[fastest] += _chunks - given;
+	for (bool probes = false, taken = true; given > _chunks; probes = probes || !taken)
+	{	taken = false;
+		for (uint i = 0; i < n && given > _chunks; i++)
+			if ((probes || !probe[i]) && (theShares[i] > 1 || (theShares[i] && i != n - 1)))
+			{	theShares[i]--;
+				given--;
+				taken = true;
+			}
+	}
+
+	// A stateful primary's later segments need enough before them to warm
+	// up on; any without go to the one before.
+	if (theStateful && theWarmUp == Undefined)
+	{	theShares.fill(0);
+		theShares[n - 1] = _chunks;
+	}
+	else if (theStateful)
+		for (uint i = 0, start = 0, last = n; i < n; i++)
+			if (theShares[i])
+			{	start += theShares[i];
+				if (last < n && start - theShares[i] < theWarmUp)
+				{	theShares[last] += theShares[i];
+					theShares[i] = 0;
+				}
+				else
+					last = i;
+			}
+
+	if (theDebug && lMESSAGES)
+		for (uint i = 0; i < n; i++)
+			qDebug("shareChunks (%s): %d: rate=%f, chunks=%d", qPrintable(name()), i, rate[i], theShares[i]);
+}
+
+StatefulSubProcessor* DomProcessor::statefulSub(uint _i) const
+{
+	if (_i == theActiveWorkers)
+		return theStateful;
+	return static_cast<StatefulSubProcessor*>(static_cast<DSCoupling*>(theWorkers[_i])->theSubProc);
+}
+
+void DomProcessor::handOffState(StatefulSubProcessor* _to)
+{
+	if (_to && theStateHolder && theStateHolder != _to)
+		_to->importState(static_cast<StatefulSubProcessor*>(theStateHolder)->exportState());
+	theStateHolder = _to;
+}
+
+void DomProcessor::stitch()
+{
+	while (theStitches.size())
+	{
+		Stitch* s = theStitches.takeFirst();
+		for (uint i = 0; i < theCurrentOuts.count(); i++)
+			theCurrentOuts[i].samples(s->start * theSamplesOut, s->chunks * theSamplesOut).copyFrom(s->outs[i].samples(s->warmUp * theSamplesOut, s->chunks * theSamplesOut));
+		delete s;
+	}
+}
+
+DxCoupling* DomProcessor::freeWorker() const
+{
+	// The fastest one that's free.
+	DxCoupling* ret = 0;
+	foreach (DxCoupling* w, theWorkers.mid(0, theActiveWorkers))
+	{
+		bool busy = false;
+		foreach (Batch* b, theBatches)
+			if (!b->done && b->worker == w)
+			{	busy = true;
+				break;
+			}
+		if (!busy && (!ret || w->throughput() > ret->throughput()))
+			ret = w;
+	}
+	return ret;
+}
+
+void DomProcessor::retireBatches()
+{
+	foreach (Batch* b, theBatches)
+		if (!b->done && b->worker->isReady())
+			b->done = true;
+
+	while (!theBatches.isEmpty() && theBatches.first()->done)
+	{
+		Batch* b = theBatches.first();
+		for (uint i = 0; i < b->outs.count(); i++)
+			if (output(i).maximumScratchSamples(0) < b->outs[i].samples())
+				return;
+		for (uint i = 0; i < b->outs.count(); i++)
+			output(i) << b->outs[i];
+		delete theBatches.takeFirst();
+	}
+}
+
+int DomProcessor::processPipelined()
+{
+	Batch* b = new Batch;
+	b->worker = freeWorker();
+	b->done = !b->worker;
+
+	// Take our own copy of the input, since the next batch will want to read
+	// on before this one's done. The overlap is left behind for it.
+	b->ins.resize(numInputs());
+	for (uint i = 0; i < numInputs(); i++)
+	{
+		BufferData d = input(i).peekSamples(theWantSamples);
+		BufferData* c = new BufferData(d.elements(), d.sampleSize());
+		c->copyFrom(d);
+		b->ins.setData(i, c);
+	}
+	for (uint i = 0; i < numInputs(); i++)
+	{
+		BufferData d = input(i).readSamples(theWantChunks * theSamplesStep);
+		d.nullify();
+	}
+
+	b->outs.resize(numOutputs());
+	for (uint i = 0; i < numOutputs(); i++)
+	{
+		uint sampleSize = output(i).writeType().size();
+		b->outs.setData(i, new BufferData(theWantChunks * theSamplesOut * sampleSize, sampleSize));
+	}
+
+	theBatches.append(b);
+	theTuneDone += theWantChunks;
+	theTuneBatches++;
+	if (b->worker)
+		b->worker->processChunks(b->ins, b->outs, theWantChunks);
+	else if (theWorkers.count())
+		thePrimary->doChunks(b->ins, b->outs, theWantChunks);
+	else
+		thePrimary->doOwnChunks(b->ins, b->outs, theWantChunks);
+
+	retireBatches();
+	return DidWork;
+}
+
 bool DomProcessor::verifyAndSpecifyTypes(const Types &inTypes, Types &outTypes)
 {
 	// We can use just verifyAndSpecifyTypes here, since the outTypes will be recorded
@@ -253,8 +606,34 @@ bool DomProcessor::verifyAndSpecifyTypes(const Types &inTypes, Types &outTypes)
 		outTypes.fillEmpty(outTypes[0]);
 
 	if (ret)
+	{
 		foreach (DxCoupling* w, theWorkers)
 			w->specifyTypes(inTypes, outTypes);
+
+		// A stateful primary can be split only over local workers, and only
+		// a batch at a time.
+		theStateful = dynamic_cast<StatefulSubProcessor*>(thePrimary);
+		theStateHolder = 0;
+		if (theStateful)
+		{
+			theWarmUp = theStateful->warmUpChunks();
+			foreach (DxCoupling* w, theWorkers)
+				if (!dynamic_cast<DSCoupling*>(w))
+					theWarmUp = Undefined;
+			if (theMaxBatches > 1)
+				qWarning("*** WARNING: DomProcessor[%s]: Stateful SubProcessor %s can have only one batch in flight.", qPrintable(theName), qPrintable(thePrimary->type()));
+			theMaxBatches = 1;
+		}
+
+		// Working set of a chunk, in and out.
+		uint bytes = 0;
+		for (uint i = 0; i < inTypes.count(); i++)
+			bytes += theSamplesStep * inTypes[i].size() * sizeof(float);
+		for (uint i = 0; i < outTypes.count(); i++)
+			if (outTypes.populated(i))
+				bytes += theSamplesOut * outTypes[i].size() * sizeof(float);
+		theFitChunks = max(1u, getCacheSize() / max(1u, bytes));
+	}
 	return ret;
 }
 
@@ -269,6 +648,8 @@ PropertiesInfo DomProcessor::specifyProperties() const
 						 ("Alter Buffer", true, "Change buffer size according to optimal configuration.")
 						 ("Optimal Throughput", 262144, "Optimal size of buffer for maximum throughput in elements.")
 						 ("Additional Threads", 0, "Extra threads to use for data parallelism.")
+						 ("Autotune", false, "Find the batch size and number of workers at runtime by measuring throughput, keeping within the group's core budget. \"Additional Threads\" then gives only how many workers to start with.")
+						 ("Batches In Flight", 1, "Most batches to have in flight at once. With 1, each batch is split over all workers and they must all finish before the next; above 1, each batch goes whole to the next free worker and the results are pushed in order as they come in. { Value >= 1 }")
 						 ("Debug", false, "Debug this DomProcessor.");
 }
 
@@ -280,7 +661,13 @@ void DomProcessor::initFromProperties(const Properties &properties)
 	theAlterBuffer = tp["Alter Buffer"].toBool();
 	theOptimalThroughput = tp["Optimal Throughput"].toInt();
 	theDebug = tp["Debug"].toBool();
-	for (int i = 0; i < tp["Additional Threads"].toInt(); i++)
+	theMaxBatches = max(1, tp["Batches In Flight"].toInt());
+	theAutotune = tp["Autotune"].toBool();
+	theStartWorkers = max(0, tp["Additional Threads"].toInt());
+	uint workers = theStartWorkers;
+	if (theAutotune)
+		workers = max<uint>(workers, group() ? group()->coreBudget() : max(0, QThread::idealThreadCount() - 1));
+	for (uint i = 0; i < workers; i++)
 		createAndAddWorker();
 	thePrimary->initFromProperties(wp);
 	foreach (DxCoupling* w, theWorkers)
@@ -292,6 +679,210 @@ void DomProcessor::initFromProperties(const Properties &properties)
 		onIOSetup();
 }
 
+bool DomProcessor::isLocal(uint _i) const
+{
+	return dynamic_cast<DSCoupling*>(theWorkers[_i]);
+}
+
+uint DomProcessor::activeLocalWorkers() const
+{
+	uint ret = 0;
+	for (uint i = 0; i < theActiveWorkers; i++)
+		if (isLocal(i))
+			ret++;
+	return ret;
+}
+
+bool DomProcessor::claimCore()
+{
+	// Remote workers use their own host's cores, so only local ones count.
+	return group() ? group()->claimCore() : activeLocalWorkers() < uint(max(0, QThread::idealThreadCount() - 1));
+}
+
+void DomProcessor::releaseCore()
+{
+	if (group())
+		group()->releaseCore();
+}
+
+bool DomProcessor::tryTrial(int _t)
+{
+	switch (_t)
+	{
+	case GrowTrial:
+		if (theTuneChunks >= theMaxTuneChunks)
+			return false;
+		theTunePrevChunks = theTuneChunks;
+		theTuneChunks = min(theTuneChunks * 2, theMaxTuneChunks);
+		return true;
+	case ShrinkTrial:
+		if (theTuneChunks <= 1)
+			return false;
+		theTunePrevChunks = theTuneChunks;
+		theTuneChunks /= 2;
+		return true;
+	case AddTrial:
+		if (theActiveWorkers >= (uint)theWorkers.count() || (isLocal(theActiveWorkers) && !claimCore()))
+			return false;
+		theActiveWorkers++;
+		return true;
+	case DropTrial:
+		if (!theActiveWorkers)
+			return false;
+		theActiveWorkers--;
+		if (isLocal(theActiveWorkers))
+			releaseCore();
+		return true;
+	default:
+		return false;
+	}
+}
+
+void DomProcessor::undoTrial(int _t)
+{
+	switch (_t)
+	{
+	case GrowTrial: case ShrinkTrial:
+		theTuneChunks = theTunePrevChunks;
+		break;
+	case AddTrial:
+		theActiveWorkers--;
+		if (isLocal(theActiveWorkers))
+			releaseCore();
+		break;
+	case DropTrial:
+		// Someone else may have had it in the meantime.
+		if (!isLocal(theActiveWorkers) || claimCore())
+			theActiveWorkers++;
+		break;
+	}
+}
+
+void DomProcessor::autotune()
+{
+	double now = QScheduler::steadyTime();
+	if (theTuneBatches < TuneBatches || now - theTuneStart < 0.05)
+		return;
+	double rate = theTuneDone / (now - theTuneStart);
+	theTuneStart = now;
+	theTuneDone = 0;
+	theTuneBatches = 0;
+
+	if (theDebug && lMESSAGES) qDebug("autotune (%s): trial=%d, rate=%f (was %f), chunks=%d, workers=%d, primary=%fns/chunk", qPrintable(name()), theTrial, rate, theTuneBaseline, theTuneChunks, theActiveWorkers, thePrimaryThroughput > 0.0 ? 1e9 / thePrimaryThroughput : 0.0);
+
+	if (theTrial != NoTrial)
+	{
+		// Anything that takes more must pay for itself; giving back a worker need only cost nothing.
+		if (rate > theTuneBaseline * (theTrial == DropTrial ? 0.95 : 1.05))
+		{
+			theTuneBaseline = rate;
+			if (tryTrial(theTrial))
+				return;
+		}
+		else
+			undoTrial(theTrial);
+		// Take the next window to measure afresh what we've settled on.
+		theNextTrial = theTrial % (TrialCount - 1) + 1;
+		theTrial = NoTrial;
+		return;
+	}
+
+	theTuneBaseline = rate;
+	for (int i = 1; i < TrialCount; i++, theNextTrial = theNextTrial % (TrialCount - 1) + 1)
+		if (tryTrial(theNextTrial))
+		{	theTrial = theNextTrial;
+			return;
+		}
+}
+
+static QList<SubProcessor*> fusionStages(SubProcessor* _s)
+{
+	if (Fusion* f = dynamic_cast<Fusion*>(_s))
+		return f->stages();
+	return QList<SubProcessor*>() << _s;
+}
+
+DomProcessor* DomProcessor::fusable() const
+{
+	uint sinkIndex;
+	DomProcessor* n = dynamic_cast<DomProcessor*>(localSink(0, &sinkIndex));
+	if (isRunning() || numInputs() != 1 || numOutputs() != 1 || multi() != NotMulti || !n || n == this || sinkIndex)
+		return 0;
+	if (n->isRunning() || n->numInputs() != 1 || n->numOutputs() != 1 || n->multi() != NotMulti || n->group() != group())
+		return 0;
+
+	// Only local workers can be remade as the fused type.
+	QList<DxCoupling*> workers = theWorkers;
+	workers += n->theWorkers;
+	foreach (DxCoupling* w, workers)
+		if (!dynamic_cast<DSCoupling*>(w))
+			return 0;
+	if ((theWorkers.count() || n->theWorkers.count()) && !SubProcessorFactory::available(thePrimary->type() + "|" + n->thePrimary->type()))
+		return 0;
+
+	// A Fusion isn't stateful, so neither its workers' split nor its hand-off
+	// of state between batches would be done with any care.
+	QList<SubProcessor*> stages = fusionStages(thePrimary);
+	stages += fusionStages(n->thePrimary);
+	foreach (SubProcessor* s, stages)
+		if (dynamic_cast<StatefulSubProcessor*>(s))
+			return 0;
+
+	// As Fusion will want.
+	SubProcessor* p = fusionStages(thePrimary).last();
+	SubProcessor* s = fusionStages(n->thePrimary).first();
+	if (s->theIn >= p->theOut && s->theStep >= p->theOut && !(s->theIn % p->theOut) && !(s->theStep % p->theOut) && p->theNumOutputs == 1 && s->theNumInputs == 1)
+		return n;
+	return 0;
+}
+
+void DomProcessor::fuse(DomProcessor* _n)
+{
+	if (MESSAGES) qDebug("DomProcessor[%s]: Fusing with %s.", qPrintable(theName), qPrintable(_n->name()));
+
+	// Each stage's properties are stashed once more than the last's.
+	QList<SubProcessor*> stages = fusionStages(thePrimary);
+	uint mine = stages.count();
+	stages += fusionStages(_n->thePrimary);
+	Properties theirs = _n->theProperties;
+	for (uint i = 0; i < mine; i++)
+		theirs = theirs.stashed();
+	theProperties = theProperties + theirs;
+
+	// The old primaries live on as stages; as ever, we never delete them.
+	Fusion* f = new Fusion(stages);
+	f->initFromStages();
+	f->thePrimaryOf = this;
+	thePrimary = f;
+
+	adoptOutputs(_n);
+
+	uint workers = max(theWorkers.count(), _n->theWorkers.count());
+	while (theWorkers.size())
+		delete theWorkers.takeLast();
+	for (uint i = 0; i < workers; i++)
+		createAndAddWorker();
+	onIOSetup();
+}
+
+bool DomProcessor::foldable() const
+{
+	Processor* s = localSource(0);
+	return !isRunning() && !theWorkers.count() && multi() == NotMulti && numInputs() == 1 && numOutputs() == 1 && isConnected(0)
+		&& !theOutputs[0]->m_sub && thePrimary->isInplace() && s && !s->isRunning() && s->group() == group();
+}
+
+void DomProcessor::fold()
+{
+	uint sourceIndex;
+	Processor* s = localSource(0, &sourceIndex);
+	if (MESSAGES) qDebug("DomProcessor[%s]: Folding into output %d of %s.", qPrintable(theName), sourceIndex, qPrintable(s->name()));
+	LxConnection* c = &output(0);
+	s->adoptOutput(sourceIndex, this, 0);
+	c->setSub(thePrimary);
+	thePrimary->thePrimaryOf = 0;
+}
+
 void DomProcessor::onIOSetup()
 {
 	thePrimary->defineIO(numInputs(), numOutputs());
@@ -39,6 +39,7 @@ namespace Geddei
 class DSCoupling;
 class DxCoupling;
 class SubProcessor;
+class StatefulSubProcessor;
 
 /** @ingroup Geddei
  * @brief The Processor-derived class for handling SubProcessor objects.
@@ -83,6 +84,25 @@ class SubProcessor;
  * SubProcessor for you, using the SubProcessorFactory. This, of course, only
  * works if the SubProcessor class you have constructed the DomProcessor with
  * is available as a plugin. If not you'll just have to use addWorker.
+ *
+ * By default each batch of input is split over the primary and all the
+ * workers in proportion to their measured throughput (see
+ * DxCoupling::throughput()), so that a slow remote worker gets less to do, and
+ * the next batch waits until every share is done. Set the
+ * "Batches In Flight" property above 1 to have each batch handed whole to the
+ * next free worker (or done by the primary if none is free) instead; outputs
+ * are then pushed in order as their batches finish. This costs a copy of the
+ * data in and out, but no worker need sit idle while a slower one catches up.
+ *
+ * Set the "Autotune" property to have the batch size and number of workers
+ * found at runtime instead. Enough local workers are made up front to fill
+ * the ProcessorGroup's core budget (see ProcessorGroup::setCoreBudget()),
+ * but each takes a core from the budget only while it's active. Batches
+ * start sized so each share's data fits in the level 2 cache; then, every
+ * few batches, one change is tried (doubling or halving the share, or
+ * taking on or letting go of a worker) and kept only if the measured
+ * throughput says it paid. The buffers are sized for the largest share it
+ * may try, four times the cache-fit one, over every worker made.
  */
 class DLLEXPORT DomProcessor: public CoProcessor
 {
@@ -110,6 +130,70 @@ class DLLEXPORT DomProcessor: public CoProcessor
 	BufferDatas theCurrentIns;
 	BufferDatas theCurrentOuts;
 	bool serviceSubs();
+	int processPartial(uint _samples);
+
+	//* Throughput-weighted sharing of each batch between the workers and the primary (last).
+	enum { ProbePeriod = 16 };	///< Most batches a worker may go without any chunks, so its throughput stays current.
+	QVector<uint> theShares;
+	QVector<uint> theIdleBatches;
+	double thePrimaryThroughput;
+	void shareChunks(uint _chunks);
+
+	//* Stateful primaries: later segments are warmed up on the input before them, and the state is handed on between batches.
+	struct Stitch
+	{
+		BufferDatas outs;	///< Output of the warm-up and the segment together.
+		uint start;
+		uint warmUp;
+		uint chunks;
+	};
+	StatefulSubProcessor* theStateful;	///< Our primary, if it's stateful.
+	uint theWarmUp;	///< Chunks to warm up a segment, or Undefined if we can't split.
+	SubProcessor* theStateHolder;	///< Whichever did the last chunks, so has the state for the next.
+	QList<Stitch*> theStitches;
+	StatefulSubProcessor* statefulSub(uint _i) const;
+	void handOffState(StatefulSubProcessor* _to);
+	void stitch();
+
+	//* Pipelined mode (theMaxBatches > 1): several whole batches in flight, each with its own copy of the data.
+	struct Batch
+	{
+		BufferDatas ins;
+		BufferDatas outs;
+		DxCoupling* worker;	///< Zero if done by the primary.
+		bool done;
+	};
+	uint theMaxBatches;
+	QList<Batch*> theBatches;	///< Oldest first.
+	DxCoupling* freeWorker() const;
+	void retireBatches();
+	int processPipelined();
+
+	//* Autotuning: chunks per share and how many workers are active, found by trial as we go.
+	enum { TuneBatches = 8 };	///< Fewest batches in a tuning window.
+	enum { NoTrial = 0, GrowTrial, ShrinkTrial, AddTrial, DropTrial, TrialCount };
+	bool theAutotune;
+	uint theStartWorkers;	///< Workers to have active at the start.
+	uint theActiveWorkers;	///< Workers given anything to do. Only the first few of theWorkers when autotuning.
+	uint theFitChunks;	///< Chunks per share for the primary's working set to fit in cache.
+	uint theMaxTuneChunks;	///< Most chunks per share we may tune to, so a batch fits the "Optimal Throughput" buffer size.
+	uint theTuneChunks;	///< Chunks per share we're using now; zero if not started.
+	uint theTunePrevChunks;
+	double theTuneStart;
+	uint theTuneDone;	///< Chunks dispatched in the current window.
+	uint theTuneBatches;	///< Batches dispatched in the current window.
+	double theTuneBaseline;	///< Chunks per second of the configuration we're trialing against.
+	int theTrial;
+	int theNextTrial;
+	/// @return true if theWorkers[@a _i] runs on this host, and so needs a core from our budget.
+	bool isLocal(uint _i) const;
+	/// @return How many of the active workers are local.
+	uint activeLocalWorkers() const;
+	bool claimCore();
+	void releaseCore();
+	bool tryTrial(int _t);
+	void undoTrial(int _t);
+	void autotune();
 
 	virtual bool processorStarted();
 	virtual int canProcess();
@@ -177,12 +261,55 @@ public:
 	 * @param host The host on which the SubProcessor should be added. This
 	 * must be running the Geddei nodeserver.
 	 * @param key The session key under which the SubProcessor will be added.
+	 * @param codec How data should be coded on the wire to and from it; see
+	 * LinkCodec.
 	 * @return true iff a worker was added.
 	 */
-	bool createAndAddWorker(const QString &host, uint key);
+	bool createAndAddWorker(const QString &host, uint key, LinkCodec::Mode codec = LinkCodec::Raw);
 
 	SubProcessor* primary() const { return thePrimary; }
 
+	/** @internal
+	 * Finds whether we may take on the work of the DomProcessor our output
+	 * feeds with fuse(). That needs us both to have a single, fixed, input
+	 * and output with a plain local connection between, be in the same
+	 * ProcessorGroup, have only local workers, and have SubProcessors that
+	 * would make a valid Fusion. Types must have been confirmed.
+	 *
+	 * @return The DomProcessor, or zero if there's none we may fuse with.
+	 */
+	DomProcessor* fusable() const;
+
+	/** @internal
+	 * Takes on the work of @a next, which should have come from fusable().
+	 * Our primary becomes a Fusion of ours and its, we take over its outputs
+	 * and we have as many workers as the larger of us had. The connection
+	 * between us is deleted and @a next is left with nothing to do.
+	 */
+	void fuse(DomProcessor* next);
+
+	/** @internal
+	 * Finds whether we may be folded into our input connection with fold():
+	 * we must have an in-place primary (see SubProcessor::isInplace()), no
+	 * workers and a plain local connection in from a Processor in the same
+	 * ProcessorGroup. Types must have been confirmed.
+	 */
+	bool foldable() const;
+
+	/** @internal
+	 * Has the Processor feeding us take over our output connection, which
+	 * does our primary's work on the way through (see LxConnection::setSub()).
+	 * The connection between us is deleted and we are left with nothing to
+	 * do.
+	 */
+	void fold();
+
+	/**
+	 * As Processor::counters(), but also gives the SubProcessor counters,
+	 * summed over the primary and all local workers.
+	 */
+	virtual ProcessorCounters counters() const;
+
 	/**
 	 * Constructor. A valid primary SubProcessor must be passed in @a primary.
 	 * This is to determine the type of DomProcessor, and provide at leat one
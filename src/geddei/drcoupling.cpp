@@ -16,6 +16,8 @@
  * along with Exscalibar.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <QVarLengthArray>
+
 #include "qsocketsession.h"
 
 #include "domprocessor.h"
@@ -28,7 +30,7 @@
 namespace Geddei
 {
 
-DRCoupling::DRCoupling(DomProcessor *dom, QTcpSocket *remote) : DxCoupling(dom), theRemote(remote), m_isReady(true)
+DRCoupling::DRCoupling(DomProcessor *dom, QIODevice *remote) : DxCoupling(dom), theRemote(remote), m_isReady(true), m_codec(LinkCodec::Raw)
 {
 	if (MESSAGES) qDebug("DRC: Handshaking...");
 	theRemote.handshake(true);
@@ -63,10 +65,28 @@ void DRCoupling::setCredentials(const QString &remoteHost, uint remoteKey, uint
 	theRemoteSubProcessorKey = remoteSubProcessorKey;
 }
 
+bool DRCoupling::setCodec(LinkCodec::Mode codec)
+{
+	QFastMutexLocker lock(&theComm);
+	theRemote.sendByte(SetLinkCodec);
+	theRemote.safeSendWord((uint32_t)codec);
+	bool ok = false;
+	if (theRemote.waitForAck(&ok) && ok)
+		m_codec = codec;
+	if (MESSAGES) qDebug("= DRCoupling::setCodec(): %s.", LinkCodec::name(m_codec));
+	return ok;
+}
+
 void DRCoupling::specifyTypes(const Types &inTypes, const Types &outTypes)
 {
 	if (MESSAGES) qDebug("> DRCoupling::specifyTypes()");
 	QFastMutexLocker lock(&theComm);
+	// The remote side starts its codecs afresh too.
+	m_inCodecs.fill(LinkCodec(m_codec), inTypes.count());
+	for (uint i = 0; i < inTypes.count(); i++)
+		m_inCodecs[i].setType(inTypes[i]);
+	m_outCodecs.fill(LinkCodec(m_codec), outTypes.count());
+	m_encoded.resize(inTypes.count());
 	theRemote.sendByte(SpecifyTypes);
 	// Send inTypes.count(), Go through each of inTypes, sending each one.
 	theRemote.safeSendWord(inTypes.count());
@@ -97,27 +117,54 @@ void DRCoupling::processChunks(BufferDatas const& _ins, BufferDatas& _outs, uint
 	if (MESSAGES) qDebug("> DRCoupling::processChunks() (%d chunks)", _chunks);
 	m_outs = _outs;
 	m_isReady = false;
+	noteStarted(_chunks);
 	QFastMutexLocker lock(&theComm);
-	theRemote.sendByte(ProcessChunks);
-	// Go through each BufferData in d, send each
-	theRemote.safeSendWord(_ins.size());
+	// The whole request goes in one send: the header words, with each input's
+	// data straight from its BufferData between them.
+	typedef QSocketSession::Chunk Chunk;
+	uchar command = ProcessChunks;
+	bool coded = m_codec != LinkCodec::Raw;
+	if (coded && (uint)m_inCodecs.size() != _ins.size())
+	{	m_inCodecs.fill(LinkCodec(m_codec), _ins.size());
+		m_encoded.resize(_ins.size());
+	}
+	QVarLengthArray<int32_t, 32> words(3 + 3 * _ins.size() + 2 * _outs.size());
+	QVarLengthArray<Chunk, 32> chunks;
+	int32_t *w = words.data();
+	chunks.append(Chunk(&command, 1));
+	*w = _ins.size();
+	chunks.append(Chunk(w++, 4));
 	for (uint i = 0; i < _ins.size(); i++)
-	{	// TODO: maybe take this into BufferData?
-		theRemote.safeSendWord(_ins[i].elements());
-		theRemote.safeSendWord(_ins[i].sampleSize());
-		if (_ins[i].rollsOver())
-		{	theRemote.safeSendWordArray((int *)_ins[i].firstPart(), _ins[i].sizeFirstPart());
-			theRemote.safeSendWordArray((int *)_ins[i].secondPart(), _ins[i].sizeSecondPart());
+	{	w[0] = _ins[i].elements();
+		w[1] = _ins[i].sampleSize();
+		if (coded)
+		{	m_inCodecs[i].encode(_ins[i], m_encoded[i]);
+			w[2] = m_encoded[i].size();
+			chunks.append(Chunk(w, 12));
+			chunks.append(Chunk(m_encoded[i].data(), m_encoded[i].size()));
+			w += 3;
 		}
 		else
-			theRemote.safeSendWordArray((int *)_ins[i].firstPart(), _ins[i].sizeOnlyPart());
+		{	chunks.append(Chunk(w, 8));
+			if (_ins[i].rollsOver())
+			{	chunks.append(Chunk(_ins[i].firstPart(), 4 * _ins[i].sizeFirstPart()));
+				chunks.append(Chunk(_ins[i].secondPart(), 4 * _ins[i].sizeSecondPart()));
+			}
+			else
+				chunks.append(Chunk(_ins[i].firstPart(), 4 * _ins[i].sizeOnlyPart()));
+			w += 2;
+		}
 	}
-	theRemote.safeSendWord(_outs.size());
-	for (uint i = 0; i < _outs.size(); i++)
-	{	theRemote.safeSendWord(_outs[i].elements());
-		theRemote.safeSendWord(_outs[i].sampleSize());
+	*w = _outs.size();
+	chunks.append(Chunk(w++, 4));
+	for (uint i = 0; i < _outs.size(); i++, w += 2)
+	{	w[0] = _outs[i].elements();
+		w[1] = _outs[i].sampleSize();
+		chunks.append(Chunk(w, 8));
 	}
-	theRemote.safeSendWord(_chunks);
+	*w = _chunks;
+	chunks.append(Chunk(w, 4));
+	theRemote.sendChunks(chunks.data(), chunks.size());
 	if (MESSAGES) qDebug("< DRCoupling::processChunks()");
 }
 
@@ -129,12 +176,30 @@ bool DRCoupling::isReady()
 	QFastMutexLocker lock(&theComm);
 	if (theRemote.bytesAvailable())
 	{
+		if (m_codec != LinkCodec::Raw && (uint)m_outCodecs.size() != m_outs.size())
+			m_outCodecs.fill(LinkCodec(m_codec), m_outs.size());
 		for (uint i = 0; i < m_outs.size(); i++)
-		{	theRemote.safeReceiveWordArray((int *)m_outs[i].firstPart(), m_outs[i].sizeFirstPart());
-			theRemote.safeReceiveWordArray((int *)m_outs[i].secondPart(), m_outs[i].sizeSecondPart());
-		}
+			if (m_codec != LinkCodec::Raw)
+			{	uint bytes = theRemote.safeReceiveWord<uint32_t>();
+				if (bytes > m_outCodecs[i].maxEncodedSize(m_outs[i].elements()))
+				{	qWarning("*** ERROR: DRCoupling: %s output of %d elements claims %d bytes, more than it could be. Closing.", LinkCodec::name(m_codec), m_outs[i].elements(), bytes);
+					theRemote.close();
+					break;
+				}
+				QByteArray coded(bytes, 0);
+				theRemote.receiveChunk((uchar *)coded.data(), coded.size());
+				if (!m_outCodecs[i].decode(coded, m_outs[i]))
+				{	qWarning("*** ERROR: DRCoupling: Couldn't decode %s output. Closing.", LinkCodec::name(m_codec));
+					theRemote.close();
+				}
+			}
+			else
+			{	theRemote.safeReceiveWordArray((int *)m_outs[i].firstPart(), m_outs[i].sizeFirstPart());
+				theRemote.safeReceiveWordArray((int *)m_outs[i].secondPart(), m_outs[i].sizeSecondPart());
+			}
 		theRemote.safeReceiveWord<int>();
 		m_outs.nullify();
+		noteFinished();
 		m_isReady = true;
 	}
 	if (MESSAGES) qDebug("< DRCoupling::isReady(): Returning (isReady=%d)", m_isReady);
@@ -24,11 +24,13 @@
 #ifdef __GEDDEI_BUILD
 #include "qsocketsession.h"
 #include "dxcoupling.h"
+#include "linkcodec.h"
 #include "qfastwaitcondition.h"
 #else
 #include <qtextra/qfastwaitcondition.h>
 #include <qtextra/qsocketsession.h>
 #include <geddei/dxcoupling.h>
+#include <geddei/linkcodec.h>
 #endif
 using namespace Geddei;
 
@@ -48,7 +50,8 @@ class BufferReader;
  *
  * This class represents the left side of a remote DRCoupling.
  * All overrided commands are essentially just passed down the line
- * with arguments serialised as neccessary.
+ * with arguments serialised as neccessary. The data of each input and output
+ * may be coded on the way; see setCodec().
  */
 class DRCoupling: virtual public DxCoupling
 {
@@ -68,6 +71,15 @@ class DRCoupling: virtual public DxCoupling
 	mutable BufferDatas m_outs;
 	bool m_isReady;
 
+	/**
+	 * The codec for each input and output, all in mode m_codec, and space
+	 * for the coded data of each input.
+	 */
+	LinkCodec::Mode m_codec;
+	QVector<LinkCodec> m_inCodecs;
+	QVector<LinkCodec> m_outCodecs;
+	QVector<QByteArray> m_encoded;
+
 public:
 	/**
 	 * Sets up the essential information about the SubProc on the remote end.
@@ -75,10 +87,18 @@ public:
 	 */
 	void setCredentials(const QString &remoteHost, uint remoteKey, uint remoteSubProcessorKey);
 
+	/**
+	 * Asks the remote side to code the data of inputs and outputs with
+	 * @a codec from now on. Must be done before any processChunks().
+	 *
+	 * @return true if it will.
+	 */
+	bool setCodec(LinkCodec::Mode codec);
+
 	/**
 	 * Basic constructor.
 	 */
-	DRCoupling(DomProcessor *dom, QTcpSocket *sink);
+	DRCoupling(DomProcessor *dom, QIODevice *sink);
 
 	/**
 	 * Default destructor.
@@ -38,10 +38,12 @@ int DSCoupling::doWork()
 {
 	if (!m_isReady)
 	{
-		theSubProc->processChunks(m_ins, m_outs, m_chunks);
+		theSubProc->doChunks(m_ins, m_outs, m_chunks);
 		m_ins.nullify();
 		m_outs.nullify();
+		noteFinished();
 		m_isReady = true;
+		theDomProcessor->wake();
 		return DidWork;
 	}
 	return NoWork;
@@ -49,6 +51,8 @@ int DSCoupling::doWork()
 
 void DSCoupling::go()
 {
+	// Run alongside our DomProcessor.
+	setPool(theDomProcessor->pool());
 	QTask::start();
 }
 
@@ -62,7 +66,9 @@ void DSCoupling::processChunks(BufferDatas const& _ins, BufferDatas& _outs, uint
 	m_ins = _ins;
 	m_outs = _outs;
 	m_chunks = _chunks;
+	noteStarted(_chunks);
 	m_isReady = false;
+	wake();
 }
 
 bool DSCoupling::isReady()
@@ -91,6 +97,11 @@ void DSCoupling::defineIO(uint inputs, uint outputs)
 	theSubProc->defineIO(inputs, outputs);
 }
 
+SubProcessorCounters DSCoupling::counters() const
+{
+	return theSubProc->counters();
+}
+
 }
 
 #undef MESSAGES
@@ -51,6 +51,7 @@ public:
 	virtual void go();
 	virtual void stop();
 	virtual void defineIO(uint numInputs, uint numOutputs);
+	virtual SubProcessorCounters counters() const;
 
 private:
 	DSCoupling(DomProcessor *dom, SubProcessor *subProc);
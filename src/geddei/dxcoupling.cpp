@@ -19,6 +19,7 @@
 #include <cmath>
 using namespace std;
 
+#include "qscheduler.h"
 #include "domprocessor.h"
 #include "bufferreader.h"
 #include "dxcoupling.h"
@@ -28,7 +29,7 @@ using namespace std;
 namespace Geddei
 {
 
-DxCoupling::DxCoupling(DomProcessor *dom): theDomProcessor(dom)
+DxCoupling::DxCoupling(DomProcessor *dom): theDomProcessor(dom), m_started(0.0), m_chunks(0), m_throughput(0.0)
 {
 }
 
@@ -36,6 +37,21 @@ DxCoupling::~DxCoupling()
 {
 }
 
+void DxCoupling::noteStarted(uint _chunks)
+{
+	m_started = QScheduler::steadyTime();
+	m_chunks = _chunks;
+}
+
+void DxCoupling::noteFinished()
+{
+	double elapsed = QScheduler::steadyTime() - m_started;
+	if (!m_chunks || elapsed <= 0.0)
+		return;
+	m_throughput = averageThroughput(m_throughput, m_chunks / elapsed);
+	m_chunks = 0;
+}
+
 }
 
 #undef MESSAGES
@@ -23,9 +23,11 @@
 #include <exscalibar.h>
 #ifdef __GEDDEI_BUILD
 #include "qfastwaitcondition.h"
+#include "counters.h"
 #include "xxcoupling.h"
 #else
 #include <qtextra/qfastwaitcondition.h>
+#include <geddei/counters.h>
 #include <geddei/xxcoupling.h>
 #endif
 
@@ -116,9 +118,42 @@ public:
 	 */
 	virtual void defineIO(uint numInputs, uint numOutputs) = 0;
 
+	/**
+	 * @return A snapshot of the SubProcessor's performance counters, if it is
+	 * local. Empty otherwise.
+	 */
+	virtual SubProcessorCounters counters() const { return SubProcessorCounters(); }
+
+	/**
+	 * @return Our measured throughput in chunks per second, a moving average
+	 * over the last few processChunks() calls, or zero if we've yet to do any.
+	 * This includes any time spent waiting to be run or on the network.
+	 */
+	double throughput() const { return m_throughput; }
+
+	/**
+	 * Folds a new throughput measurement @a _new into the moving average
+	 * @a _old (zero meaning there is none yet).
+	 */
+	static double averageThroughput(double _old, double _new) { return _old > 0.0 ? _old * 0.75 + _new * 0.25 : _new; }
+
 protected:
+	/**
+	 * Call at the start of processChunks(), with the number of chunks.
+	 */
+	void noteStarted(uint _chunks);
+
+	/**
+	 * Call once the chunks from the last processChunks() are done.
+	 */
+	void noteFinished();
+
 	DomProcessor *theDomProcessor;
-	uint theLastTimeTaken;
+
+private:
+	double m_started;
+	uint m_chunks;
+	double m_throughput;
 };
 
 }
@@ -0,0 +1,208 @@
+/* Copyright 2003, 2004, 2005, 2007, 2009, 2010 Gavin Wood <gav@kde.org>
+ *
+ * This file is part of Exscalibar.
+ *
+ * Exscalibar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Exscalibar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Exscalibar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QStringList>
+
+#include "globals.h"
+#include "fusion.h"
+using namespace Geddei;
+
+#define MESSAGES 0
+
+namespace Geddei
+{
+
+static QString fusionType(QList<SubProcessor*> const& _stages)
+{
+	QStringList ret;
+	foreach (SubProcessor* s, _stages)
+		ret += s->type();
+	return ret.join("|");
+}
+
+Fusion::Fusion(QList<SubProcessor*> const& _stages): SubProcessor(fusionType(_stages)), m_stages(_stages), m_tileChunks(1)
+{
+	assert(!m_stages.isEmpty());
+}
+
+Fusion::~Fusion()
+{
+	while (!m_scratch.isEmpty())
+		delete m_scratch.takeLast();
+	while (!m_stages.isEmpty())
+		delete m_stages.takeLast();
+}
+
+QString Fusion::type() const
+{
+	return fusionType(m_stages);
+}
+
+uint Fusion::interBytes(uint _chunks, QVector<uint>* _samples) const
+{
+	uint ret = 0;
+	uint samples = (_chunks - 1) * theStep + theIn;
+	for (int i = 0; i < m_stages.count() - 1; i++)
+	{
+		samples = ((samples - m_stages[i]->theIn) / m_stages[i]->theStep + 1) * m_stages[i]->theOut;
+		if (_samples)
+			(*_samples)[i] = samples;
+		ret += samples * m_interScopes[i] * sizeof(float);
+	}
+	return ret;
+}
+
+void Fusion::processChunks(const BufferDatas &in, BufferDatas &out, uint chunks) const
+{
+	processTiles(in, out, chunks, false);
+}
+
+void Fusion::processOwnChunks(const BufferDatas &in, BufferDatas &out, uint chunks)
+{
+	processTiles(in, out, chunks, true);
+}
+
+void Fusion::processTiles(const BufferDatas &in, BufferDatas &out, uint chunks, bool _own) const
+{
+	for (uint c = 0; c < chunks; c += m_tileChunks)
+	{
+		uint tile = min(m_tileChunks, chunks - c);
+		uint samples = (tile - 1) * theStep + theIn;
+		BufferDatas d = in.samples(c * theStep, samples);
+		for (int i = 0; i < m_stages.count(); i++)
+		{
+			SubProcessor* s = m_stages[i];
+			uint sc = (samples - s->theIn) / s->theStep + 1;
+			BufferDatas o(1);
+			if (i == m_stages.count() - 1)
+				o = out.samples(c * theOut, tile * theOut);
+			else
+			{
+				samples = sc * s->theOut;
+				o.copyData(0, m_scratch[i]->leftSamples(samples));
+			}
+			if (_own)
+				s->doOwnChunks(d, o, sc);
+			else
+				s->doChunks(d, o, sc);
+			d = o;
+		}
+	}
+}
+
+PropertiesInfo Fusion::specifyProperties() const
+{
+	PropertiesInfo ret = m_stages.last()->specifyProperties();
+	for (int i = m_stages.count() - 2; i >= 0; i--)
+		ret = m_stages[i]->specifyProperties() + ret.stashed();
+	return ret;
+}
+
+void Fusion::initFromProperties(const Properties& _p)
+{
+	Properties p = _p;
+	foreach (SubProcessor* s, m_stages)
+	{
+		Properties rest = p.unstash();
+		s->initFromProperties(p);
+		p = rest;
+	}
+	setupIO(m_stages.first()->theNumInputs, m_stages.last()->theNumOutputs);
+}
+
+void Fusion::initFromStages()
+{
+	setupIO(m_stages.first()->theNumInputs, m_stages.last()->theNumOutputs);
+}
+
+void Fusion::updateFromProperties(const Properties& _p)
+{
+	Properties p = _p;
+	foreach (SubProcessor* s, m_stages)
+	{
+		Properties rest = p.unstash();
+		s->updateFromProperties(p);
+		p = rest;
+	}
+}
+
+bool Fusion::verifyAndSpecifyTypes(const Types &inTypes, Types &outTypes)
+{
+	while (!m_scratch.isEmpty())
+		delete m_scratch.takeLast();
+	m_interScopes.resize(m_stages.count() - 1);
+
+	Types t = inTypes;
+	uint in = 0, step = 0, out = 0;
+	for (int i = 0; i < m_stages.count(); i++)
+	{
+		SubProcessor* s = m_stages[i];
+		if (i)
+		{
+			SubProcessor* p = m_stages[i - 1];
+			if (!(s->theIn >= p->theOut && s->theStep >= p->theOut && !(s->theIn % p->theOut) && !(s->theStep % p->theOut) && p->theNumOutputs == 1 && s->theNumInputs == 1))
+			{
+				qDebug("WARNING: Could not initialise - incompatible SubProcessors: %s(%d, %d, %d) === %s(%d, %d, %d).", qPrintable(p->theType), p->theIn, p->theStep, p->theOut, qPrintable(s->theType), s->theIn, s->theStep, s->theOut);
+				return false;
+			}
+		}
+		if (i == m_stages.count() - 1)
+		{
+			if (!s->proxyVSTypes(t, outTypes))
+				return false;
+		}
+		else
+		{
+			Types r(1);
+			if (!s->proxyVSTypes(t, r) || !r.populated(0))
+				return false;
+			m_interScopes[i] = r[0]->size();
+			t = r;
+		}
+
+		// Fold this stage into what we have so far, as Combination does.
+		if (!i)
+		{	in = s->theIn;
+			step = s->theStep;
+		}
+		else
+		{	in += step * (s->theIn / out - 1);
+			step = step * s->theStep / out;
+		}
+		out = s->theOut;
+	}
+	setupSamplesIO(in, step, out);
+
+	// As many chunks at once as keep everything between stages in half the cache.
+	uint first = interBytes(1);
+	uint each = max(1u, interBytes(2) - first);
+	uint budget = getCacheSize() / 2;
+	m_tileChunks = budget > first ? (budget - first) / each + 1 : 1;
+
+	QVector<uint> samples(m_stages.count() - 1);
+	interBytes(m_tileChunks, &samples);
+	for (int i = 0; i < m_stages.count() - 1; i++)
+		m_scratch.append(new BufferData(samples[i] * m_interScopes[i], m_interScopes[i]));
+
+	if (MESSAGES) qDebug("Fusion: Setting up IO: %d->%d, %d/%d => %d, %d chunks per tile", theNumInputs, theNumOutputs, theIn, theStep, theOut, m_tileChunks);
+	return true;
+}
+
+}
+
+#undef MESSAGES
@@ -0,0 +1,107 @@
+/* Copyright 2003, 2004, 2005, 2007, 2009, 2010 Gavin Wood <gav@kde.org>
+ *
+ * This file is part of Exscalibar.
+ *
+ * Exscalibar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Exscalibar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Exscalibar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QList>
+#include <QVector>
+
+#include <exscalibar.h>
+#ifdef __GEDDEI_BUILD
+#include "subprocessor.h"
+#else
+#include <geddei/subprocessor.h>
+#endif
+
+namespace Geddei
+{
+
+/** @ingroup Geddei
+ * @brief A SubProcessor that runs a chain of others as one.
+ * @author Gav Wood <gav@kde.org>
+ *
+ * Like Combination, but for any number of SubProcessor objects, each feeding
+ * the next. Rather than taking each stage over the whole of a batch in turn,
+ * the batch is split into tiles small enough that the data between stages
+ * (kept in scratch space of our own) stays in the level 2 cache, and each
+ * tile is taken through the whole chain before the next is begun. Put it in
+ * a DomProcessor and the chain is scheduled as one; each worker, having its
+ * own Fusion object, has its own scratch space.
+ *
+ * Each stage but the last must have a single output, and each but the first
+ * a single input. Each stage's samples in and step must be multiples of the
+ * previous stage's samples out.
+ *
+ * SubProcessorFactory gives one for a type of the stages' types separated
+ * by "|", e.g. "Window|FFT|Bark|DeciBel|Log".
+ */
+class DLLEXPORT Fusion: public SubProcessor
+{
+public:
+	/**
+	 * Constructs a Fusion of @a stages, which it adopts.
+	 *
+	 * @param stages The SubProcessor objects, each feeding the next.
+	 */
+	Fusion(QList<SubProcessor*> const& stages);
+	~Fusion();
+
+	QList<SubProcessor*> const& stages() const { return m_stages; }
+
+	/**
+	 * @return The number of our chunks taken through the chain at once.
+	 * Valid once the types are confirmed.
+	 */
+	uint tileChunks() const { return m_tileChunks; }
+
+	/** @internal
+	 * For when the stages have already been initialised: sets up our inputs
+	 * and outputs from theirs, rather than initialising them again with
+	 * initFromProperties().
+	 */
+	void initFromStages();
+
+private:
+	virtual void processChunks(const BufferDatas &in, BufferDatas &out, uint chunks) const;
+	virtual void processOwnChunks(const BufferDatas &in, BufferDatas &out, uint chunks);
+	virtual PropertiesInfo specifyProperties() const;
+	virtual void initFromProperties(const Properties &p);
+	virtual void updateFromProperties(Properties const&p);
+	virtual bool verifyAndSpecifyTypes(const Types &inTypes, Types &outTypes);
+	virtual QString type() const;
+
+	/**
+	 * @return The total size in bytes of the data between stages when
+	 * doing @a chunks of our chunks at once. The number of samples going
+	 * into each stage but the first is put in @a samples, if given.
+	 */
+	uint interBytes(uint chunks, QVector<uint>* samples = 0) const;
+
+	/**
+	 * Takes @a chunks of our chunks through the stages a tile at a time, with
+	 * each stage's doOwnChunks() if @a own, or its doChunks() otherwise.
+	 */
+	void processTiles(const BufferDatas &in, BufferDatas &out, uint chunks, bool own) const;
+
+	QList<SubProcessor*> m_stages;
+	QVector<uint> m_interScopes;	///< Sample size of the data going into each stage but the first.
+	uint m_tileChunks;
+	mutable QList<BufferData*> m_scratch;	///< Data going into each stage but the first; big enough for a tile.
+};
+
+}
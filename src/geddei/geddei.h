@@ -26,10 +26,14 @@
 #include "multisource.h"
 #include "multisink.h"
 #include "combination.h"
+#include "fusion.h"
 #include "subprocessor.h"
+#include "typedsubprocessor.h"
 #include "processor.h"
+#include "counters.h"
 #include "bufferdatas.h"
 #include "bufferdata.h"
+#include "linkcodec.h"
 #include "domprocessor.h"
 #include "processorfactory.h"
 #include "subprocessorfactory.h"
@@ -50,9 +54,13 @@
 #include <geddei/multisink.h>
 #include <geddei/subprocessor.h>
 #include <geddei/combination.h>
+#include <geddei/fusion.h>
+#include <geddei/typedsubprocessor.h>
 #include <geddei/processor.h>
+#include <geddei/counters.h>
 #include <geddei/bufferdatas.h>
 #include <geddei/bufferdata.h>
+#include <geddei/linkcodec.h>
 #include <geddei/domprocessor.h>
 #include <geddei/processorfactory.h>
 #include <geddei/subprocessorfactory.h>
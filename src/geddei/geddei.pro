@@ -11,8 +11,11 @@ HEADERS += buffer.h \
 	bufferinfo.h \
 	bufferdata.h \
 	bufferdatas.h \
+	linkcodec.h \
 	bufferreader.h \
 	combination.h \
+	counters.h \
+	fusion.h \
 	commandcodes.h \
 	connection.h \
 	domprocessor.h \
@@ -46,6 +49,7 @@ HEADERS += buffer.h \
 	splitter.h \
 	subprocessor.h \
 	subprocessorfactory.h \
+	typedsubprocessor.h \
 	wave.h \
 	xlconnection.h \
 	xlconnectionreal.h \
@@ -70,8 +74,11 @@ SOURCES += buffer.cpp \
 	bufferinfo.cpp \
 	bufferdata.cpp \
 	bufferdatas.cpp \
+	linkcodec.cpp \
 	bufferreader.cpp \
 	combination.cpp \
+	counters.cpp \
+	fusion.cpp \
 	connection.cpp \
 	domprocessor.cpp \
 	drcoupling.cpp \
@@ -19,6 +19,9 @@
 #include <cstdlib>
 
 #include <qapplication.h>
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
 
 #include "exscalibar.h"
 
@@ -91,4 +94,14 @@ QStringList getPaths()
 	return ret;
 }
 
+uint getCacheSize()
+{
+#ifdef _SC_LEVEL2_CACHE_SIZE
+	long s = sysconf(_SC_LEVEL2_CACHE_SIZE);
+	if (s > 0)
+		return s;
+#endif
+	return 256 * 1024;
+}
+
 };
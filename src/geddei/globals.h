@@ -235,4 +235,6 @@ namespace Geddei
 	DLLEXPORT const char *getVersion();
 	DLLEXPORT uint getConfig();
 	DLLEXPORT QStringList getPaths();
+	/// Size in bytes of the level 2 (per core) cache, or a guess if we can't tell.
+	DLLEXPORT uint getCacheSize();
 }
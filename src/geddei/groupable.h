@@ -69,6 +69,11 @@ public:
 	 */
 	void setNoGroup();
 
+	/**
+	 * @return The ProcessorGroup the object is in, or zero if none.
+	 */
+	ProcessorGroup* group() const { return theGroup; }
+
 	virtual QString name() const = 0;
 	virtual bool confirmTypes() = 0;
 	virtual bool go() = 0;
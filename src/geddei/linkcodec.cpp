@@ -0,0 +1,326 @@
+/* Copyright 2003, 2004, 2005, 2007, 2009, 2010 Gavin Wood <gav@kde.org>
+ *
+ * This file is part of Exscalibar.
+ *
+ * Exscalibar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Exscalibar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Exscalibar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cassert>
+#include <cmath>
+#include <cfloat>
+#include <cstring>
+using namespace std;
+
+#include "bufferdata.h"
+#include "contiguous.h"
+#include "mark.h"
+#include "linkcodec.h"
+using namespace Geddei;
+
+#define MESSAGES 0
+
+namespace Geddei
+{
+
+// Encoded data:
+//   word sampleSize
+//   Lossless: blocks of up to 32 elements, each a byte of width, then each
+//     element XOR the one a sample before in width bits, LSB first.
+//   Lossy: word ranges (1 or sampleSize), then that many (min, max) pairs;
+//     a NaN pair marks an element sent exactly, as a word. Then each element
+//     in 2 (Half, Quantised16), 1 (Quantised8) or 4 (exact) bytes.
+// All little-endian.
+
+static inline uint32_t bitsOf(float _f) { uint32_t r; memcpy(&r, &_f, 4); return r; }
+static inline float floatOf(uint32_t _b) { float r; memcpy(&r, &_b, 4); return r; }
+
+static inline uchar *putWord(uchar *_p, uint32_t _w)
+{
+	_p[0] = _w; _p[1] = _w >> 8; _p[2] = _w >> 16; _p[3] = _w >> 24;
+	return _p + 4;
+}
+
+static inline uint32_t getWord(uchar const *_p)
+{
+	return uint32_t(_p[0]) | (uint32_t(_p[1]) << 8) | (uint32_t(_p[2]) << 16) | (uint32_t(_p[3]) << 24);
+}
+
+// Round to nearest even; out of range goes to infinity.
+static uint16_t halfOf(float _f)
+{
+	uint32_t x = bitsOf(_f);
+	uint32_t sign = (x >> 16) & 0x8000;
+	int e = (x >> 23) & 0xff;
+	uint32_t m = x & 0x7fffff;
+	if (e == 0xff)
+		return sign | 0x7c00 | (m ? 0x200 : 0);
+	int he = e - 112;
+	if (he >= 31)
+		return sign | 0x7c00;
+	uint32_t h;
+	uint shift;
+	if (he <= 0)
+	{	if (he < -10)
+			return sign;
+		m |= 0x800000;
+		shift = 14 - he;
+		h = m >> shift;
+	}
+	else
+	{	shift = 13;
+		h = (he << 10) | (m >> 13);
+	}
+	uint32_t rest = m & ((1u << shift) - 1);
+	uint32_t half = 1u << (shift - 1);
+	if (rest > half || (rest == half && (h & 1)))
+		h++;
+	return sign | h;
+}
+
+static float floatOfHalf(uint16_t _h)
+{
+	uint32_t sign = uint32_t(_h & 0x8000) << 16;
+	uint32_t e = (_h >> 10) & 0x1f;
+	uint32_t m = _h & 0x3ff;
+	if (e == 0)
+	{	float f = m * (1.f / 16777216.f);
+		return sign ? -f : f;
+	}
+	if (e == 31)
+		return floatOf(sign | 0x7f800000 | (m << 13));
+	return floatOf(sign | ((e + 112) << 23) | (m << 13));
+}
+
+void LinkCodec::setType(Type const& _type)
+{
+	m_mins.clear();
+	m_maxs.clear();
+	m_exact = 0;
+	if (_type.isNull())
+		return;
+	m_exact = _type->size() - _type->arity();
+	if (_type.isA<Contiguous>())
+	{	m_mins.append(_type.asA<Contiguous>().min());
+		m_maxs.append(_type.asA<Contiguous>().max());
+	}
+	else if (_type.isA<Mark>())
+		for (uint i = 0; i < _type->arity(); i++)
+		{	m_mins.append(_type.asA<Mark>().min(i));
+			m_maxs.append(_type.asA<Mark>().max(i));
+		}
+	reset();
+}
+
+void LinkCodec::encode(BufferData const& _data, QByteArray& o_out)
+{
+	assert(m_mode != Raw);
+	uint n = _data.elements();
+	uint sampleSize = qMax(1u, _data.sampleSize());
+	m_linear.resize(n);
+	_data.copyTo(m_linear);
+	float const *in = m_linear.data();
+
+	if (m_mode == Lossless)
+	{	o_out.resize(4 + n * 4 + (n + 31) / 32);
+		uchar *out = putWord((uchar *)o_out.data(), sampleSize);
+		if ((uint)m_last.size() != sampleSize)
+			m_last.fill(0, sampleSize);
+		uint32_t *last = m_last.data();
+		uint32_t block[32];
+		for (uint i = 0, s = 0; i < n; )
+		{	uint count = qMin(32u, n - i);
+			uint32_t any = 0;
+			for (uint j = 0; j < count; j++, i++)
+			{	uint32_t b = bitsOf(in[i]);
+				block[j] = b ^ last[s];
+				last[s] = b;
+				any |= block[j];
+				if (++s == sampleSize)
+					s = 0;
+			}
+			uint width = 0;
+			while (width < 32 && (any >> width))
+				width++;
+			*(out++) = width;
+			uint64_t acc = 0;
+			uint bits = 0;
+			for (uint j = 0; j < count; j++)
+			{	acc |= uint64_t(block[j]) << bits;
+				for (bits += width; bits >= 8; bits -= 8, acc >>= 8)
+					*(out++) = acc;
+			}
+			if (bits)
+				*(out++) = acc;
+		}
+		o_out.resize(out - (uchar *)o_out.data());
+		return;
+	}
+
+	// The exact elements are the type's reserved ones, at the end of each
+	// sample (e.g. a Mark's timestamp). The rest take the range of the same
+	// element of the type, or the one range given for all of them.
+	uint exact = qMin(m_exact, sampleSize);
+	uint data = sampleSize - exact;
+	QVector<float> mins = m_mins, maxs = m_maxs;
+	if (mins.isEmpty())
+	{	float lo = FLT_MAX, hi = -FLT_MAX;
+		for (uint i = 0; i < n; i++)
+			if (i % sampleSize < data && fabs(in[i]) <= FLT_MAX)
+			{	lo = qMin(lo, in[i]);
+				hi = qMax(hi, in[i]);
+			}
+		if (lo > hi)
+			lo = hi = 0.f;
+		mins.append(lo);
+		maxs.append(hi);
+	}
+	uint ranges = exact || mins.size() > 1 ? sampleSize : 1;
+	QVector<float> los(ranges, NAN), his(ranges, NAN);
+	for (uint r = 0; r < ranges && r < data; r++)
+	{	los[r] = mins[qMin(r, (uint)mins.size() - 1)];
+		his[r] = maxs[qMin(r, (uint)maxs.size() - 1)];
+	}
+
+	o_out.resize(8 + ranges * 8 + n * 4);
+	uchar *out = putWord((uchar *)o_out.data(), sampleSize);
+	out = putWord(out, ranges);
+	for (uint r = 0; r < ranges; r++)
+	{	out = putWord(out, bitsOf(los[r]));
+		out = putWord(out, bitsOf(his[r]));
+	}
+	float levels = m_mode == Quantised8 ? 255.f : 65535.f;
+	for (uint i = 0, s = 0; i < n; i++)
+	{	uint r = ranges == 1 ? 0 : s;
+		float lo = los[r];
+		float hi = his[r];
+		float x = in[i];
+		if (lo != lo)
+			out = putWord(out, bitsOf(x));
+		else if (m_mode == Half)
+		{	uint16_t h = halfOf(x);
+			*(out++) = h;
+			*(out++) = h >> 8;
+		}
+		else
+		{	x = x > lo ? x < hi ? x : hi : lo;
+			uint q = hi > lo ? uint((x - lo) * (levels / (hi - lo)) + .5f) : 0;
+			*(out++) = q;
+			if (m_mode == Quantised16)
+				*(out++) = q >> 8;
+		}
+		if (++s == sampleSize)
+			s = 0;
+	}
+	o_out.resize(out - (uchar *)o_out.data());
+}
+
+bool LinkCodec::decode(QByteArray const& _in, BufferData& o_data)
+{
+	assert(m_mode != Raw);
+	uchar const *in = (uchar const *)_in.data();
+	uchar const *end = in + _in.size();
+	if (end - in < 4)
+		return false;
+	uint sampleSize = getWord(in);
+	in += 4;
+	if (!sampleSize)
+		return false;
+	uint n = o_data.elements();
+	m_linear.resize(n);
+	float *out = m_linear.data();
+
+	if (m_mode == Lossless)
+	{	if ((uint)m_last.size() != sampleSize)
+			m_last.fill(0, sampleSize);
+		uint32_t *last = m_last.data();
+		for (uint i = 0, s = 0; i < n; )
+		{	uint count = qMin(32u, n - i);
+			if (in == end)
+				return false;
+			uint width = *(in++);
+			if (width > 32 || uint(end - in) < (count * width + 7) / 8)
+				return false;
+			uint32_t mask = width == 32 ? 0xffffffff : (1u << width) - 1;
+			uint64_t acc = 0;
+			uint bits = 0;
+			for (uint j = 0; j < count; j++, i++)
+			{	for (; bits < width; bits += 8)
+					acc |= uint64_t(*(in++)) << bits;
+				uint32_t b = (uint32_t(acc) & mask) ^ last[s];
+				acc >>= width;
+				bits -= width;
+				last[s] = b;
+				out[i] = floatOf(b);
+				if (++s == sampleSize)
+					s = 0;
+			}
+		}
+	}
+	else
+	{	if (end - in < 4)
+			return false;
+		uint ranges = getWord(in);
+		in += 4;
+		if ((ranges != 1 && ranges != sampleSize) || uint(end - in) / 8 < ranges)
+			return false;
+		QVector<float> mins(ranges), maxs(ranges);
+		for (uint r = 0; r < ranges; r++, in += 8)
+		{	mins[r] = floatOf(getWord(in));
+			maxs[r] = floatOf(getWord(in + 4));
+		}
+		float levels = m_mode == Quantised8 ? 255.f : 65535.f;
+		uint width = m_mode == Quantised8 ? 1 : 2;
+		for (uint i = 0, s = 0; i < n; i++)
+		{	uint r = ranges == 1 ? 0 : s;
+			float lo = mins[r];
+			float hi = maxs[r];
+			if (lo != lo)
+			{	if (end - in < 4)
+					return false;
+				out[i] = floatOf(getWord(in));
+				in += 4;
+			}
+			else
+			{	if (uint(end - in) < width)
+					return false;
+				uint q = in[0] | (width == 2 ? uint(in[1]) << 8 : 0);
+				in += width;
+				out[i] = m_mode == Half ? floatOfHalf(q) : lo + q * ((hi - lo) / levels);
+			}
+			if (++s == sampleSize)
+				s = 0;
+		}
+	}
+	if (in != end)
+		return false;
+	o_data.copyFrom(m_linear);
+	return true;
+}
+
+char const* LinkCodec::name(Mode _mode)
+{
+	switch (_mode)
+	{
+	case Raw: return "Raw";
+	case Lossless: return "Lossless";
+	case Half: return "Half";
+	case Quantised16: return "Quantised16";
+	case Quantised8: return "Quantised8";
+	}
+	return "Unknown";
+}
+
+}
+
+#undef MESSAGES
@@ -0,0 +1,135 @@
+/* Copyright 2003, 2004, 2005, 2007, 2009, 2010 Gavin Wood <gav@kde.org>
+ *
+ * This file is part of Exscalibar.
+ *
+ * Exscalibar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Exscalibar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Exscalibar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <QByteArray>
+#include <QVector>
+
+#include <exscalibar.h>
+#ifdef __GEDDEI_BUILD
+#include "type.h"
+#else
+#include <geddei/type.h>
+#endif
+using namespace Geddei;
+
+namespace Geddei
+{
+
+class BufferData;
+
+/** @ingroup Geddei
+ * @brief Compresses signal data for sending over a remote link.
+ * @author Gav Wood <gav@kde.org>
+ *
+ * Remote connections (and DomProcessor's remote workers) may send their data
+ * through a LinkCodec rather than as raw floats, trading CPU for bandwidth.
+ * Which one is given when the link is made; see Processor::connect() and
+ * DomProcessor::createAndAddWorker().
+ *
+ * Lossless XORs each element with the same element of the sample before and
+ * packs what's left into as few bits as it needs, in blocks of 32. Slowly
+ * changing data, such as spectra or self-similarity matrices, shrinks well;
+ * noise barely at all. It remembers the last sample sent, so the two sides
+ * must each use one LinkCodec for the whole of the link.
+ *
+ * The rest are lossy. Half keeps each element as a 16-bit float. Quantised16
+ * and Quantised8 keep each as a 16 or 8-bit step between the minimum and
+ * maximum of the type (Contiguous::min() and friends, or Mark::min() for each
+ * element of a Mark); anything outside is clamped. Types without a range are
+ * quantised against that of each transfer's own data. The reserved() elements
+ * of a type (e.g. a Mark's timestamp) are always sent exactly.
+ *
+ * The encoded data is in a fixed byte order, and carries all the decoder needs
+ * bar the mode, so only the encoding side need know the type.
+ */
+class DLLEXPORT LinkCodec
+{
+public:
+	enum Mode { Raw = 0, Lossless, Half, Quantised16, Quantised8 };
+
+	/**
+	 * Basic constructor.
+	 */
+	LinkCodec(Mode _mode = Raw): m_mode(_mode), m_exact(0) {}
+
+	/**
+	 * @return The mode we code in.
+	 */
+	Mode mode() const { return m_mode; }
+
+	/**
+	 * Sets the mode. Forgets the last sample.
+	 */
+	void setMode(Mode _mode) { m_mode = _mode; reset(); }
+
+	/**
+	 * Takes the ranges against which to quantise from @a _type, and which
+	 * elements must be exact. Forgets the last sample.
+	 */
+	void setType(Type const& _type);
+
+	/**
+	 * Forgets the last sample, as will the other side at the same point in
+	 * the stream.
+	 */
+	void reset() { m_last.clear(); }
+
+	/**
+	 * Encodes @a _data into @a o_out, replacing what was there.
+	 * Not for Raw.
+	 */
+	void encode(BufferData const& _data, QByteArray& o_out);
+
+	/**
+	 * Decodes @a _in, as made by encode(), into @a o_data, which must have
+	 * the same number of elements as was encoded.
+	 *
+	 * @return false if @a _in isn't valid for @a o_data.
+	 */
+	bool decode(QByteArray const& _in, BufferData& o_data);
+
+	/**
+	 * @return The most bytes encode() can make of @a _elements elements, so
+	 * that a decoder can refuse anything bigger off the wire.
+	 */
+	uint maxEncodedSize(uint _elements) const { return m_mode == Lossless ? 4 + _elements * 4 + (_elements + 31) / 32 : 8 + _elements * 12; }
+
+	/**
+	 * @return true if @a _mode is a mode we know.
+	 */
+	static bool isValid(uint _mode) { return _mode <= Quantised8; }
+
+	/**
+	 * @return A name for @a _mode, for diagnostics.
+	 */
+	static char const* name(Mode _mode);
+
+private:
+	Mode m_mode;
+	uint m_exact;
+	QVector<float> m_mins;
+	QVector<float> m_maxs;
+	QVector<uint32_t> m_last;
+	QVector<float> m_linear;
+};
+
+}
@@ -31,6 +31,7 @@ namespace Geddei
 
 LLConnection::LLConnection(Source *newSource, uint sourceIndex, Sink *newSink, uint newSinkIndex, uint bufferSize): LxConnectionReal(newSource, sourceIndex), xLConnectionReal(newSink, newSinkIndex, bufferSize)
 {
+	theBuffer.setWriterTask(dynamic_cast<QTask *>(theSource));
 }
 
 bool LLConnection::pullType()
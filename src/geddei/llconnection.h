@@ -44,6 +44,8 @@ class Source;
  */
 class DLLEXPORT LLConnection: public LxConnectionReal, public xLConnectionReal
 {
+	friend class Processor;
+
 	//* Reimplementations from LxConnection
 	virtual bool waitUntilReady();
 	virtual Tristate isReadyYet();
@@ -60,6 +62,7 @@ class DLLEXPORT LLConnection: public LxConnectionReal, public xLConnectionReal
 	virtual void noMorePlungers();
 	virtual uint freeInDestinationBuffer(uint minimum) { while (bufferElementsFree() < minimum) bufferWaitForFree(); return bufferElementsFree(); }
 	virtual uint freeInDestinationBufferEver() { return theBuffer.size(); }
+	virtual PortCounters writeCounters() const { return theBuffer.counters(); }
 
 	//* Reimplementation from xLConnection.
 	virtual bool pullType();
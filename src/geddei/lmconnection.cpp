@@ -32,6 +32,7 @@ namespace Geddei
 LMConnection::LMConnection(Source *source, uint sourceIndex, uint bufferSize)
 	: LxConnectionReal(source, sourceIndex), theBuffer(bufferSize), m_minRead(0), m_minWrite(0)
 {
+	theBuffer.setWriterTask(dynamic_cast<QTask *>(theSource));
 }
 
 LMConnection::~LMConnection()
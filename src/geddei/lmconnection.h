@@ -64,6 +64,7 @@ class DLLEXPORT LMConnection: public LxConnectionReal
 	virtual void noMorePlungers();
 	virtual uint freeInDestinationBuffer(uint minimum = 1);
 	virtual uint freeInDestinationBufferEver();
+	virtual PortCounters writeCounters() const { return theBuffer.counters(); }
 	virtual void enforceMinimum(uint elements);
 	virtual void enforceMinimumRead(uint elements);
 	virtual void enforceMinimumWrite(uint elements);
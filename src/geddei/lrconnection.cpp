@@ -31,7 +31,7 @@ using namespace Geddei;
 namespace Geddei
 {
 
-LRConnection::LRConnection(Source *newSource, uint sourceIndex, QTcpSocket *sinkSocketDevice) : LxConnectionReal(newSource, sourceIndex), theSink(sinkSocketDevice)
+LRConnection::LRConnection(Source *newSource, uint sourceIndex, QIODevice *sinkSocketDevice) : LxConnectionReal(newSource, sourceIndex), theSink(sinkSocketDevice), theCredit(0)
 {
 	if (MESSAGES) qDebug("LRC: Handshaking...");
 	theSink.handshake(true);
@@ -101,6 +101,7 @@ void LRConnection::enforceMinimum(uint size)
 void LRConnection::setType(Type const& _type)
 {
 	LxConnectionReal::setType(_type);
+	theCodec.setType(_type);
 	theSink.sendByte(SetType);
 	_type->send(theSink);
 }
@@ -118,12 +119,78 @@ Type const& LRConnection::type() const
 	return theType;
 }
 
+void LRConnection::collectCredit()
+{
+	while (theSink.isOpen() && theSink.waitForData())
+	{	uchar reply = theSink.receiveByte();
+		if (reply == Credit)
+			theCredit += theSink.safeReceiveWord<uint32_t>();
+		else
+			qWarning("*** WARNING: LRConnection: Unexpected reply (%d) from remote side. Ignoring.", (int)reply);
+	}
+}
+
+bool LRConnection::receiveReply(uchar& o_reply)
+{
+	while (!trapdoor() && theSink.isOpen())
+		if (theSink.waitForData(502))
+		{	o_reply = theSink.receiveByte();
+			if (o_reply == Credit)
+				theCredit += theSink.safeReceiveWord<uint32_t>();
+			return theSink.isOpen();
+		}
+	return false;
+}
+
+void LRConnection::shareRing(uint elements)
+{
+	QHostAddress peer = theSink.peerAddress();
+	if (!theSink.isOpen() || !(peer == theSink.localAddress() || peer == QHostAddress::LocalHost || peer == QHostAddress::LocalHostIPv6))
+		return;
+	// We make it, about as big as the remote buffer, so that we're seldom
+	// left with credit but no room in the ring.
+	if (!theRing.create(qMax(elements, 16384u)))
+		return;
+	if (MESSAGES) qDebug("= LRC::shareRing(): Offering %s (%d elements).", theRing.name().constData(), theRing.capacity());
+	theSink.sendByte(ShareRing);
+	theSink.sendString(theRing.name());
+	theSink.safeSendWord(theRing.nonce());
+	uchar reply = Nak;
+	while (receiveReply(reply) && reply == Credit) {}
+	// Either it's attached or it never will; the name's no more use.
+	theRing.unlink();
+	if (reply != Ack)
+		theRing.close();
+	if (MESSAGES) qDebug("= LRC::shareRing(): %s.", theRing.isOpen() ? "Shared" : "Not shared");
+}
+
+bool LRConnection::setCodec(LinkCodec::Mode codec)
+{
+	if (!theSink.isOpen())
+		return false;
+	theSink.sendByte(SetLinkCodec);
+	theSink.safeSendWord((uint32_t)codec);
+	uchar reply = Nak;
+	while (receiveReply(reply) && reply == Credit) {}
+	if (reply == Ack)
+		theCodec.setMode(codec);
+	if (MESSAGES) qDebug("= LRC::setCodec(): %s.", LinkCodec::name(theCodec.mode()));
+	return reply == Ack;
+}
+
 void LRConnection::bufferWaitForFree()
 {
 	if (MESSAGES) qDebug("> LRC::bWFF()");
-	if (theSink.isOpen())
-	{	theSink.sendByte(BufferWaitForFree);
-		while (!trapdoor() && theSink.isOpen() && !theSink.waitForAck(502)) {}
+	collectCredit();
+	uint wanted = qMax(1u, theType.size());
+	if (theCredit < wanted && theSink.isOpen())
+	{	if (MESSAGES) qDebug("= LRC::bWFF(): Out of credit (%d); asking for %d.", theCredit, wanted);
+		theSink.sendByte(BufferWaitForFreeElements);
+		theSink.safeSendWord((uint32_t)wanted);
+		uchar reply;
+		while (theCredit < wanted && receiveReply(reply))
+			if (reply != Credit)
+				qWarning("*** WARNING: LRConnection: Unexpected reply (%d) from remote side. Ignoring.", (int)reply);
 	}
 	theSource->checkExit();
 	if (MESSAGES) qDebug("< LRC::bWFF()");
@@ -131,15 +198,8 @@ void LRConnection::bufferWaitForFree()
 
 uint LRConnection::bufferElementsFree()
 {
-	if (MESSAGES) qDebug("> LRC::bEF()");
-	uint ret;
-	if (theSink.isOpen())
-	{	theSink.sendByte(BufferSpaceFree);
-		ret = theSink.safeReceiveWord<int>();
-	}
-	else ret = 0;
-	if (MESSAGES) qDebug("< LRC::bEF()");
-	return ret;
+	collectCredit();
+	return theSink.isOpen() ? theCredit : 0;
 }
 
 bool LRConnection::waitUntilReady()
@@ -148,7 +208,8 @@ bool LRConnection::waitUntilReady()
 	if (theSink.isOpen())
 	{	theSink.sendByte(WaitUntilReady);
 		if (MESSAGES) qDebug("= LRC::wUR(): isOpen() = %d", theSink.isOpen());
-		while (!trapdoor() && theSink.isOpen() && !theSink.waitForAck(503)) {}
+		uchar reply;
+		while (receiveReply(reply) && reply == Credit) {}
 	}
 	if (MESSAGES) qDebug("= LRC::wUR(): checkExit() (isOpen() = %d)", theSink.isOpen());
 	theSource->checkExit();
@@ -163,7 +224,9 @@ Connection::Tristate LRConnection::isReadyYet()
 	if (theSink.isOpen())
 	{	theSink.sendByte(IsReadyYet);
 		if (MESSAGES) qDebug("= LRC::iRY(): isOpen() = %d", theSink.isOpen());
-		if (!trapdoor() && theSink.isOpen()) ret = (Tristate)theSink.receiveByte();
+		uchar reply = Failed;
+		while (receiveReply(reply) && reply == Credit) {}
+		if (!trapdoor() && theSink.isOpen()) ret = (Tristate)reply;
 	}
 	if (MESSAGES) qDebug("= LRC::iRY(): checkExit() (isOpen() = %d)", theSink.isOpen());
 	theSource->checkExit();
@@ -177,17 +240,53 @@ void LRConnection::transport(const BufferData &data)
 	// TODO: Currently this silently discards the data.
 	// It should really block until the connection is remade or until it's stopped.
 	// But I dont need to implement that until i want dynamic connections sorted.
-	if (theSink.isOpen())
-	{	theSink.sendByte(Transfer);
+	if (theSink.isOpen() && theRing.isOpen() && data.elements() <= theRing.capacity())
+	{	// The remote side empties the ring in order, so it will have room as
+		// soon as it has caught up with the last few transfers.
+		while (!trapdoor() && theSink.isOpen() && !theRing.waitForSpace(data.elements(), 502)) {}
+		if (!trapdoor() && theSink.isOpen())
+		{	if (data.rollsOver())
+			{	theRing.write(data.firstPart(), data.sizeFirstPart());
+				theRing.write(data.secondPart(), data.sizeSecondPart());
+			}
+			else
+				theRing.write(data.firstPart(), data.sizeOnlyPart());
+			theRing.commit();
+			uchar command = SharedTransfer;
+			uint32_t elements = data.elements();
+			QSocketSession::Chunk frame[2] = { QSocketSession::Chunk(&command, 1), QSocketSession::Chunk(&elements, 4) };
+			theSink.sendChunks(frame, 2);
+			assert(data.elements() <= theCredit);
+			theCredit -= data.elements();
+			if (MESSAGES) qDebug("= LRC::transport(): Transport (shared) completed.");
+		}
+	}
+	else if (theSink.isOpen() && theCodec.mode() != LinkCodec::Raw)
+	{	theCodec.encode(data, theEncoded);
+		uchar command = EncodedTransfer;
+		uint32_t words[2] = { data.elements(), theEncoded.size() };
+		QSocketSession::Chunk frame[3] = { QSocketSession::Chunk(&command, 1), QSocketSession::Chunk(words, 8), QSocketSession::Chunk(theEncoded.data(), theEncoded.size()) };
+		theSink.sendChunks(frame, 3);
+		assert(data.elements() <= theCredit);
+		theCredit -= data.elements();
+		if (MESSAGES) qDebug("= LRC::transport(): Transport (%d bytes coded) completed.", theEncoded.size());
+	}
+	else if (theSink.isOpen())
+	{	// Header and data go in one send, straight from the buffer.
 		// FIXME: thread could block here if opposite processor is stopped; trapdoor wouldn't work then.
-
-		theSink.safeSendWord(data.elements());
+		uchar command = Transfer;
+		uint32_t elements = data.elements();
+		QSocketSession::Chunk frame[4] = { QSocketSession::Chunk(&command, 1), QSocketSession::Chunk(&elements, 4) };
 		if (data.rollsOver())
-		{	theSink.safeSendWordArray((int *)data.firstPart(), data.sizeFirstPart());
-			theSink.safeSendWordArray((int *)data.secondPart(), data.sizeSecondPart());
+		{	frame[2] = QSocketSession::Chunk(data.firstPart(), 4 * data.sizeFirstPart());
+			frame[3] = QSocketSession::Chunk(data.secondPart(), 4 * data.sizeSecondPart());
 		}
 		else
-			theSink.safeSendWordArray((int *)data.firstPart(), data.sizeOnlyPart());
+			frame[2] = QSocketSession::Chunk(data.firstPart(), 4 * data.sizeOnlyPart());
+		theSink.sendChunks(frame, data.rollsOver() ? 4 : 3);
+		// pushBE() never sends more than bufferElementsFree() said we could.
+		assert(data.elements() <= theCredit);
+		theCredit -= data.elements();
 		if (MESSAGES) qDebug("= LRC::transport(): Transport completed.");
 	}
 	theSource->checkExit();
@@ -24,14 +24,18 @@
 #ifdef __GEDDEI_BUILD
 
 #include "qsocketsession.h"
+#include "qsharedring.h"
 #include "lxconnectionreal.h"
+#include "linkcodec.h"
 #else
 #include <qtextra/qsocketsession.h>
+#include <qtextra/qsharedring.h>
 #include <geddei/lxconnectionreal.h>
+#include <geddei/linkcodec.h>
 #endif
 using namespace Geddei;
 
-class QTcpSocket;
+class QIODevice;
 
 namespace Geddei
 {
@@ -45,6 +49,17 @@ class ProcessorForwarder;
  * A realisation of the Connection flow-control class framework.
  * This shunts data from a processor object, to a network socket, along with any control
  * signals neccessary (such as for type identification/synchronisation).
+ *
+ * Flow control is by credit: the remote side (RLConnection) sends a Credit
+ * frame whenever it has enough space free in its buffer, granting us that
+ * many more elements. We may transport() as much as we have credit for
+ * without waiting on the remote side at all; only once it's spent do we ask
+ * for more and wait. Credit frames may turn up at any time, so any reply we
+ * wait for is read with receiveReply(), which banks them along the way.
+ *
+ * If the remote side is on the same host, the data itself needn't go through
+ * the socket at all; see shareRing(). Otherwise it may be compressed on the
+ * way; see setCodec().
  */
 class DLLEXPORT LRConnection: public LxConnectionReal
 {
@@ -76,6 +91,53 @@ class DLLEXPORT LRConnection: public LxConnectionReal
 	uint theRemoteKey, theRemoteIndex;
 
 	QSocketSession theSink;
+
+	/**
+	 * Elements we may send before the remote buffer could be full.
+	 */
+	uint theCredit;
+
+	/**
+	 * Banks any credit frames waiting on the socket, without blocking.
+	 */
+	void collectCredit();
+
+	/**
+	 * Blocks until a reply comes from the remote side, banking it if it's
+	 * credit. Gives up if the trapdoor opens or the connection fails.
+	 *
+	 * @param o_reply Populated with the reply's command code.
+	 * @return true if a reply was received.
+	 */
+	bool receiveReply(uchar& o_reply);
+
+	/**
+	 * Shared memory through which transport() sends data, if open.
+	 */
+	QSharedRing theRing;
+
+	/**
+	 * If the remote side is on this host, offers it a QSharedRing of
+	 * @a elements elements through which to send data from then on. Transfers
+	 * too big for it still go through the socket, as does everything else.
+	 * If it's not taken up, nothing changes.
+	 */
+	void shareRing(uint elements);
+
+	/**
+	 * How transport() codes data that goes through the socket, and where.
+	 */
+	LinkCodec theCodec;
+	QByteArray theEncoded;
+
+	/**
+	 * Asks the remote side to take data coded by @a codec from now on. If it
+	 * won't, nothing changes.
+	 *
+	 * @return true if it will.
+	 */
+	bool setCodec(LinkCodec::Mode codec);
+
 	QFastMutex theTrapdoor;
 	void openTrapdoor() { theTrapdoor.lock(); }
 	void closeTrapdoor() { theTrapdoor.unlock(); }
@@ -86,7 +148,7 @@ class DLLEXPORT LRConnection: public LxConnectionReal
 	 * Used from ProcessorForwarder object.
 	 */
 	friend class ProcessorForwarder;
-	LRConnection(Source *newSource, uint newSourceIndex, QTcpSocket *newSink);
+	LRConnection(Source *newSource, uint newSourceIndex, QIODevice *newSink);
 
 	/**
 	 * Simple destructor.
@@ -61,7 +61,7 @@ void LxConnection::push(BufferData const& _data)
 			d.copyData(0, _data);
 			BufferDatas e(1);
 			e.copyData(0, _data);
-			m_sub->processOwnChunks(d, e, chunks);
+			m_sub->doOwnChunks(d, e, chunks);
 			type()->polishData(e[0], theSource, theSourceIndex);
 			pushBE(_data);
 		}
@@ -76,7 +76,7 @@ void LxConnection::push(BufferData const& _data)
 				BufferDatas e(1);
 				e.copyData(0, makeScratchElements(chunks * theType.size() * m_sub->theOut, false));
 
-				m_sub->processOwnChunks(d, e, chunks);
+				m_sub->doOwnChunks(d, e, chunks);
 				type()->polishData(e[0], theSource, theSourceIndex);
 				pushBE(e[0]);
 				assert(m_midScratch.count() >= (int)((chunks * m_sub->theStep + samplesForNextTime) * m_midType.size()));
@@ -22,10 +22,12 @@
 #ifdef __GEDDEI_BUILD
 #include "connection.h"
 #include "bufferdata.h"
+#include "counters.h"
 #include "type.h"
 #else
 #include <geddei/connection.h>
 #include <geddei/bufferdata.h>
+#include <geddei/counters.h>
 #include <geddei/type.h>
 #endif
 using namespace Geddei;
@@ -74,6 +76,15 @@ public:
 	 */
 	virtual uint bufferElementsFree() = 0;
 
+	/**
+	 * Get a snapshot of the performance counters for this (the writing) end
+	 * of the connection.
+	 *
+	 * @return An empty PortCounters if there is no buffer on this side of the
+	 * connection.
+	 */
+	virtual PortCounters writeCounters() const { return PortCounters(); }
+
 	/**
 	 * Create a new scratch pad with which data may be sent efficiently.
 	 *
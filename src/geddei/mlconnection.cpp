@@ -34,6 +34,7 @@ MLConnection::MLConnection(Sink *sink, uint sinkIndex, LMConnection *connection)
 {
 	theConnection->theConnections.append(this);
 	theReader = new BufferReader(&(theConnection->theBuffer));
+	theReader->setTask(dynamic_cast<QTask *>(theSink));
 	m_samplesRead = 0;
 	m_latestPeeked = 0;
 	m_latestTime = 0.0;
@@ -103,7 +104,9 @@ void MLConnection::killReader()
 void MLConnection::resurectReader()
 {
 	if (!theReader)
-		theReader = new BufferReader(&(theConnection->theBuffer));
+	{	theReader = new BufferReader(&(theConnection->theBuffer));
+		theReader->setTask(dynamic_cast<QTask *>(theSink));
+	}
 }
 
 BufferReader *MLConnection::newReader()
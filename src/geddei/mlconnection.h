@@ -63,6 +63,7 @@ class DLLEXPORT MLConnection: public xLConnection
 	virtual void resurectReader();
 	virtual bool plungeSync(uint samples) const;
 	virtual uint capacity() const;
+	virtual PortCounters readCounters() const { return theReader ? theReader->counters() : PortCounters(); }
 	virtual bool require(uint samples, uint preferSamples = Undefined);
 
 protected:
@@ -166,6 +166,12 @@ public:
 	 */
 	uint multiplicity() const { return theGivenMultiplicity; }
 
+	/**
+	 * @return true iff our Processor objects have been created, and so may
+	 * be accessed with processor().
+	 */
+	bool isInitialised() const { return theIsInitialised; }
+
 	Processor* processor(uint _index) const { assert(theIsInitialised); assert(_index < theGivenMultiplicity); assert(_index < (uint)theProcessors.size()); return theProcessors[_index]; }
 
 private:
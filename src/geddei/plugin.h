@@ -38,12 +38,14 @@
 #include "qfactoryexporter.h"
 #include "processor.h"
 #include "subprocessor.h"
+#include "typedsubprocessor.h"
 #include "bufferdata.h"
 #include "coretypes.h"
 #else
 #include <qtextra/qfactoryexporter.h>
 #include <geddei/processor.h>
 #include <geddei/subprocessor.h>
+#include <geddei/typedsubprocessor.h>
 #include <geddei/bufferdata.h>
 #include <geddei/coretypes.h>
 #endif
@@ -22,6 +22,9 @@ using namespace std;
 
 #include <qstring.h>
 
+#include "qfiber.h"
+#include "qscheduler.h"
+
 #include "mlconnection.h"
 #include "lmconnection.h"
 #include "lrconnection.h"
@@ -137,6 +140,56 @@ void Processor::plungerSent(uint index)
 	if (pMESSAGES) qDebug("< Processor::plungerSent() [%s]: [aHI: %d] %d left, %d notified, %d finished", qPrintable(name()), alreadyHadIt, thePlungersLeft[index], thePlungersNotified[index], thePlungersEnded);
 }
 
+Processor* Processor::localSink(uint _i, uint* _sinkIndex) const
+{
+	LLConnection* c = dynamic_cast<LLConnection*>(theOutputs[_i]);
+	if (!c)
+		return 0;
+	xLConnection* x = c;
+	if (_sinkIndex)
+		*_sinkIndex = x->theSinkIndex;
+	return dynamic_cast<Processor*>(x->theSink);
+}
+
+Processor* Processor::localSource(uint _i, uint* _sourceIndex) const
+{
+	LLConnection* c = dynamic_cast<LLConnection*>(theInputs[_i]);
+	if (!c)
+		return 0;
+	LxConnection* x = c;
+	if (_sourceIndex)
+		*_sourceIndex = x->theSourceIndex;
+	return dynamic_cast<Processor*>(x->theSource);
+}
+
+void Processor::adoptOutput(uint _i, Processor* _from, uint _j)
+{
+	assert(!isRunning() && !_from->isRunning());
+	delete theOutputs[_i];
+	LxConnection* c = _from->theOutputs[_j];
+	_from->theOutputs[_j] = 0;
+	if (c)
+	{	c->theSource = this;
+		c->theSourceIndex = _i;
+		// The buffer must now wake us, not _from, when it has room.
+		if (LLConnection* l = dynamic_cast<LLConnection*>(c))
+			l->theBuffer.setWriterTask(dynamic_cast<QTask*>(this));
+		else if (LMConnection* m = dynamic_cast<LMConnection*>(c))
+			m->theBuffer.setWriterTask(dynamic_cast<QTask*>(this));
+	}
+	theOutputs[_i] = c;
+	resetTypes();
+}
+
+void Processor::adoptOutputs(Processor* _from)
+{
+	for (uint i = 0; i < (uint)theOutputs.size(); i++)
+		delete theOutputs[i];
+	theOutputs.fill(0, _from->theOutputs.size());
+	for (uint i = 0; i < (uint)theOutputs.size(); i++)
+		adoptOutput(i, _from, i);
+}
+
 void Processor::disconnectAll()
 {
 	if (isRunning())
@@ -450,6 +503,8 @@ void Processor::doInit(const QString &name, ProcessorGroup *g, const Properties
 	theHardMultiplicity = properties.keys().contains("Multiplicity") ? p["Multiplicity"].toInt() : 0;
 	if (!theHardMultiplicity) theHardMultiplicity = Undefined;
 	theGivenMultiplicity = theHardMultiplicity;
+	if (isPooled())
+		dynamic_cast<QTask*>(this)->setPool(properties.keys().contains("Pool") ? properties["Pool"].toString() : QString());
 
 	theName = name;
 	setGroup(*g);
@@ -467,10 +522,12 @@ void Processor::onMultiplicitySet(uint _m)
 
 const PropertiesInfo Processor::properties() const
 {
+	PropertiesInfo ret = specifyProperties();
 	if (theMulti && !(theMulti&Const))
-		return specifyProperties()("Multiplicity", 0, "Force the multiplicity of the object to be a value [> 0 to force].");
-	else
-		return specifyProperties();
+		ret("Multiplicity", 0, "Force the multiplicity of the object to be a value [> 0 to force].");
+	if (isPooled())
+		ret("Pool", "", "The QScheduler worker pool to run in. [Empty for the default pool]");
+	return ret;
 }
 
 bool Processor::draw(QPainter& _p, QSizeF const& _s) const
@@ -900,7 +957,7 @@ const Connection *Processor::connect(uint _sourceIndex, Sink *_sink, uint _sinkI
 	}
 }
 
-const Connection *Processor::connect(uint sourceIndex, const QString &sinkHost, uint sinkKey, const QString &sinkProcessorName, uint sinkIndex, uint bufferSize)
+const Connection *Processor::connect(uint sourceIndex, const QString &sinkHost, uint sinkKey, const QString &sinkProcessorName, uint sinkIndex, uint bufferSize, LinkCodec::Mode codec)
 {
 	if (isRunning())
 	{	qWarning("*** ERROR: Processor::connect: %s[%d]: Cannot change connection states while running.", qPrintable(name()), sourceIndex);
@@ -914,7 +971,7 @@ const Connection *Processor::connect(uint sourceIndex, const QString &sinkHost,
 	// TODO: Need remote version of readyRegisterIn
 
 	if (theOutputs[sourceIndex] == 0)
-		return ProcessorForwarder::createConnection(this, sourceIndex, bufferSize, sinkHost, sinkKey, sinkProcessorName, sinkIndex);
+		return ProcessorForwarder::createConnection(this, sourceIndex, bufferSize, sinkHost, sinkKey, sinkProcessorName, sinkIndex, codec);
 	else
 	{	Splitter *s = dynamic_cast<Splitter *>(theOutputs[sourceIndex]);
 
@@ -924,7 +981,7 @@ const Connection *Processor::connect(uint sourceIndex, const QString &sinkHost,
 			return 0;
 		}
 
-		return ProcessorForwarder::createConnection(s, 0, bufferSize, sinkHost, sinkKey, sinkProcessorName, sinkIndex);
+		return ProcessorForwarder::createConnection(s, 0, bufferSize, sinkHost, sinkKey, sinkProcessorName, sinkIndex, codec);
 	}
 }
 
@@ -997,6 +1054,28 @@ QString Processor::error() const
 	}
 }
 
+ProcessorCounters Processor::counters() const
+{
+	ProcessorCounters ret;
+	ret.name = name();
+	ret.type = type();
+	ret.time = QScheduler::steadyTime();
+	ret.cycles = theGuardsCrossed;
+	if (QTask const* t = dynamic_cast<QTask const*>(this))
+	{	ret.dispatches = t->tasksComplete();
+		ret.busyTime = t->timeInTask();
+	}
+	ret.inputs.resize(theInputs.size());
+	for (int i = 0; i < theInputs.size(); i++)
+		if (theInputs[i])
+			ret.inputs[i] = theInputs[i]->readCounters();
+	ret.outputs.resize(theOutputs.size());
+	for (int i = 0; i < theOutputs.size(); i++)
+		if (theOutputs[i])
+			ret.outputs[i] = theOutputs[i]->writeCounters();
+	return ret;
+}
+
 bool Processor::waitUntilReady()
 {
 	return waitUntilGoing() == NoError;
@@ -1168,12 +1247,66 @@ void Processor::initFromProperties(Properties const& _p)
 	initFromProperties();
 }
 
+/** @internal @ingroup Geddei
+ * @brief Runs a Cooperative HeavyProcessor's thread body as a fiber.
+ * @author Gav Wood <gav@kde.org>
+ */
+class HeavyFiber: public QFiber
+{
+public:
+	HeavyFiber(HeavyProcessor* _p): m_processor(_p) {}
+
+	virtual void wake() { m_processor->QTask::wake(); }
+
+private:
+	virtual void fiberMain() { m_processor->run(); }
+
+	HeavyProcessor* m_processor;
+};
+
 HeavyProcessor::HeavyProcessor(QString const& _type, MultiplicityType _m, uint _flags):
 	QThread(0),
 	Processor(_type, _m),
+	m_fiber(0),
 	thePaused(false),
 	theFlags(_flags)
 {
+#if !defined(HAVE_LINUX) || defined(SINGLE_THREADED)
+	// Waits can't yield here, so we'd just tie up a worker.
+	theFlags &= ~Cooperative;
+#endif
+}
+
+HeavyProcessor::~HeavyProcessor()
+{
+	delete m_fiber;
+}
+
+void HeavyProcessor::start()
+{
+	if (theFlags & Cooperative)
+	{
+		delete m_fiber;
+		m_fiber = new HeavyFiber(this);
+		QTask::start();
+	}
+	else
+		QThread::start();
+}
+
+int HeavyProcessor::doWork()
+{
+	// The fiber must stay on the thread it started on. Others' tasks share
+	// it, though, so it needs telling that it's ours each time.
+	pinToWorker();
+	setThreadProcessor();
+	bool done = m_fiber->resume();
+	unsetThreadProcessor();
+	if (done)
+		return WillNeverWork;
+	// Whatever it waits on will wake us, so we need only look again if the wait has a time limit.
+	unsigned long left = m_fiber->waitLeft();
+	return left < (unsigned long)-AwaitingWake ? -qMax<int>(1, left) : AwaitingWake;
 }
 
 void HeavyProcessor::pause()
@@ -1287,9 +1420,20 @@ void HeavyProcessor::waitUntilDone()
 		theAllDoneChanged.wait(&theStop);
 }
 
-CoProcessor::CoProcessor(QString const& _type, MultiplicityType _m):
-	Processor(_type, _m)
+CoProcessor::CoProcessor(QString const& _type, MultiplicityType _m, uint _flags):
+	Processor(_type, _m),
+	theFlags(_flags),
+	m_starved(0),
+	m_stalled(0)
+{
+}
+
+ProcessorCounters CoProcessor::counters() const
 {
+	ProcessorCounters ret = Processor::counters();
+	ret.starved = m_starved;
+	ret.stalled = m_stalled;
+	return ret;
 }
 
 void CoProcessor::waitUntilDone()
@@ -1299,37 +1443,52 @@ void CoProcessor::waitUntilDone()
 
 int CoProcessor::cyclesReady()
 {
-	QVector<uint> mData(numInputs());
-	specifyInputSpace(mData);
-	QVector<uint> rData(numInputs());
-	requireInputSpace(rData);
-	QVector<uint> mSpace(numOutputs());
-	specifyOutputSpace(mSpace);
+	m_inputSpace.resize(numInputs());
+	m_inputSpace.fill(0);
+	specifyInputSpace(m_inputSpace);
+	m_inputRequired.resize(numInputs());
+	m_inputRequired.fill(0);
+	requireInputSpace(m_inputRequired);
+	m_outputSpace.resize(numOutputs());
+	m_outputSpace.fill(0);
+	specifyOutputSpace(m_outputSpace);
 
 	uint cycles = UINT_MAX;
 	for (uint i = 0; i < numOutputs(); i++)
 	{
 		uint bFree = min<uint>(UINT_MAX / 2, theOutputs[i]->maximumScratchSamples(0));
-		if (bFree < mSpace[i])
+		if (bFree < m_outputSpace[i])
+		{	m_stalled++;
 			return 0;
-		else if (mSpace[i] > 0)
-			cycles = min(cycles, bFree / mSpace[i]);
+		}
+		else if (m_outputSpace[i] > 0)
+			cycles = min(cycles, bFree / m_outputSpace[i]);
 	}
 
 	if (numInputs())
 	{
-		QVector<uint> is(numInputs());
+		m_inputCycles.resize(numInputs());
 		for (uint i = 0; i < numInputs(); i++)
-			if (theInputs[i]->require(rData[i], mData[i]))
-				is[i] = min<uint>(UINT_MAX / 2, theInputs[i]->samplesReady() / max(1u, mData[i]));
+			if (theInputs[i]->require(m_inputRequired[i], m_inputSpace[i]))
+				m_inputCycles[i] = min<uint>(UINT_MAX / 2, theInputs[i]->samplesReady() / max(1u, m_inputSpace[i]));
 			else
-				is[i] = Undefined;
-		cycles = min(cycles, cyclesAvailable(is));
+				m_inputCycles[i] = Undefined;
+		cycles = min(cycles, cyclesAvailable(m_inputCycles));
+		if (!cycles)
+			m_starved++;
 	}
 
 	return cycles;
 }
 
+int CoProcessor::processCycles(uint _cycles)
+{
+	int ret = DidWork;
+	for (uint i = 0; i < _cycles && ret == DidWork; i++)
+		ret = process();
+	return ret;
+}
+
 int CoProcessor::doWork()
 {
 	if (MESSAGES&&0) qDebug("Processor[%s]: > doWork()", qPrintable(name()));
@@ -1383,7 +1542,13 @@ int CoProcessor::doWork()
 			if (ret > 0)
 			{
 				int cr = cyclesReady();
-				if (cr > 0)
+				if (cr > 0 && (theFlags & Batched))
+				{
+					uint cycles = min<uint>(cr, MaxBatch);
+					theGuardsCrossed += cycles;
+					ret = processCycles(cycles);
+				}
+				else if (cr > 0)
 				{
 					theGuardsCrossed++;
 					ret = process();
@@ -31,6 +31,8 @@
 #include "qcleaner.h"
 #include "globals.h"
 #include "bufferdata.h"
+#include "linkcodec.h"
+#include "counters.h"
 #include "lxconnection.h"
 #include "xlconnection.h"
 #include "rlconnection.h"
@@ -48,6 +50,8 @@
 #include <qtextra/qcleaner.h>
 #include <geddei/globals.h>
 #include <geddei/bufferdata.h>
+#include <geddei/linkcodec.h>
+#include <geddei/counters.h>
 #include <geddei/lxconnection.h>
 #include <geddei/xlconnection.h>
 #include <geddei/rlconnection.h>
@@ -226,6 +230,15 @@ protected:
 	mutable uint theGuardsCrossed;
 public:
 	uint guardsCrossed() const { return theGuardsCrossed; }
+
+	/**
+	 * Takes a snapshot of our performance counters, together with those of
+	 * each of our input and output connections. It's cheap enough to call
+	 * periodically while running.
+	 *
+	 * @sa ProcessorGroup::counters() ProcessorCounters::dump()
+	 */
+	virtual ProcessorCounters counters() const;
 private:
 
 	//@{
@@ -724,10 +737,13 @@ public:
 	 * @param sinkIndex The input port of @a sink that you wish to connect to.
 	 * @param bufferSize The minimum size of the connection buffer in elements. Defaults
 	 * to 1. Under normal circumstances this will not need to be changed.
+	 * @param codec How the data should be coded on the wire. Defaults to raw
+	 * floats; see LinkCodec for the others. If the remote side won't take it,
+	 * raw floats are used.
 	 * @return A pointer to the outbound connection, if creation was successful,
 	 * otherwise 0.
 	 */
-	const Connection *connect(uint sourceIndex, const QString &sinkHost, uint sinkKey, const QString &sinkProcessorName, uint sinkIndex, uint bufferSize = 1);
+	const Connection *connect(uint sourceIndex, const QString &sinkHost, uint sinkKey, const QString &sinkProcessorName, uint sinkIndex, uint bufferSize = 1, LinkCodec::Mode codec = LinkCodec::Raw);
 
 	bool isConnected(uint _sourceIndex) const { return theOutputs[_sourceIndex]; }
 
@@ -749,6 +765,43 @@ public:
 	 */
 	void disconnectAll();
 
+	/** @internal
+	 * Finds what's on the other end of an output, if it's a plain one-to-one
+	 * connection to another Processor object in this program (i.e. not
+	 * split, shared or remote).
+	 *
+	 * @param index The output port.
+	 * @param sinkIndex Filled with the sink's input port, if given.
+	 * @return The sink, or zero if there's no such connection.
+	 */
+	Processor* localSink(uint index, uint* sinkIndex = 0) const;
+
+	/** @internal
+	 * Finds what's on the other end of an input, if it's a plain one-to-one
+	 * connection from another Processor object in this program.
+	 *
+	 * @param index The input port.
+	 * @param sourceIndex Filled with the source's output port, if given.
+	 * @return The source, or zero if there's no such connection.
+	 */
+	Processor* localSource(uint index, uint* sourceIndex = 0) const;
+
+	/** @internal
+	 * Deletes any connection on our output @a index and takes over output
+	 * @a fromIndex of @a from in its place, along with whatever is on the
+	 * other end of it. Neither Processor may be running. Our types will need
+	 * confirming again.
+	 *
+	 * Used by ProcessorGroup::optimise() to splice Processor objects out.
+	 */
+	void adoptOutput(uint index, Processor* from, uint fromIndex);
+
+	/** @internal
+	 * As adoptOutput(), but for every output of @a from, which replace all
+	 * of ours.
+	 */
+	void adoptOutputs(Processor* from);
+
 	/**
 	 * Returns convenience object that represents one of this object's input/outputs.
 	 * Can be used for creating connections.
@@ -784,6 +837,9 @@ public:
 
 	virtual bool isRunning() const { return false; }
 
+	/// @return true if we're run as a QTask by a QScheduler pool, and so take the "Pool" property.
+	virtual bool isPooled() const { return false; }
+
 	/**
 	 * Blocks until processor is active, and gives error information if processor startup
 	 * failed along the way.
@@ -986,16 +1042,37 @@ public:
 class DLLEXPORT CoProcessor: public Processor, public QTask
 {
 public:
-	CoProcessor(const QString &type, const MultiplicityType multi = NotMulti);
+	enum
+	{	Batched = 1 ///< Indicates process() never consumes or produces more than one cycle's worth (see specifyInputSpace()/specifyOutputSpace()), so several cycles may be done per dispatch.
+	};
+
+	CoProcessor(const QString &type, const MultiplicityType multi = NotMulti, uint flags = 0);
 
 	virtual bool isRunning() const { return QTask::isRunning(); }
+	virtual bool isPooled() const { return true; }
 	virtual void waitUntilDone();
+	virtual ProcessorCounters counters() const;
 
 protected:
 	virtual int process() { return WillNeverWork; }
 	virtual int canProcess() { return CanWork; }
 	virtual QString taskName() const { return name(); }
 
+	/**
+	 * Reimplement to do @a _cycles cycles' worth of processing in one go. This
+	 * is only used by Batched processors; there is guaranteed to be enough
+	 * input and output space for all @a _cycles cycles.
+	 *
+	 * The default implementation simply calls process() @a _cycles times,
+	 * stopping early should it return anything other than DidWork.
+	 *
+	 * @return As for process().
+	 */
+	virtual int processCycles(uint _cycles);
+
+	/// Makes sure we get run so that we notice we're stopping. Call this if you reimplement it.
+	virtual void wantToStopNow() { wake(); }
+
 private:
 	virtual void start() { QTask::start(); }
 	virtual void wait() { QTask::wait(); }
@@ -1003,19 +1080,43 @@ private:
 	virtual int doWork();
 	virtual void onStopped();
 
+	/**
+	 * @return The number of cycles that could be done now. Zero if there's
+	 * too little input or output space, in which case m_starved or m_stalled
+	 * is bumped accordingly.
+	 */
 	virtual int cyclesReady();
+
+	/// The most cycles a Batched processor will be asked to do at once, so others get a look in.
+	enum { MaxBatch = 256 };
+
+	/// Scratch space for cyclesReady(), kept to save reallocating each time.
+	QVector<uint> m_inputSpace, m_inputRequired, m_outputSpace, m_inputCycles;
+
+	uint theFlags;
+
+	/// Dispatches that found too little input (starved) or output space (stalled) to do anything.
+	quint64 m_starved, m_stalled;
 };
 
-class DLLEXPORT HeavyProcessor: protected QThread, public Processor
+class HeavyFiber;
+
+class DLLEXPORT HeavyProcessor: protected QThread, public Processor, public QTask
 {
+	friend class HeavyFiber;
+
 public:
 	enum
-	{	Guarded = 1 ///< Indicates a subclass is able to finish when input EOS is given.
+	{	Guarded = 1, ///< Indicates a subclass is able to finish when input EOS is given.
+		Cooperative = 2 ///< Indicates processor() may be run as a fiber on the shared QWorker pool rather than on a thread of its own, staying on whichever worker first runs it. It must block only on Buffer (or other QFastWaitCondition) waits.
 	};
 
 	HeavyProcessor(const QString &type, const MultiplicityType multi = NotMulti, uint flags = 0);
+	virtual ~HeavyProcessor();
 
-	virtual bool isRunning() const { return QThread::isRunning(); }
+	virtual bool isRunning() const { return (theFlags & Cooperative) ? QTask::isRunning() : QThread::isRunning(); }
+	/// Only a Cooperative one; otherwise we have a thread of our own.
+	virtual bool isPooled() const { return theFlags & Cooperative; }
 	virtual void waitUntilDone();
 
 	virtual void pause();
@@ -1074,14 +1175,22 @@ protected:
 
 	bool guard();
 
+	virtual QString taskName() const { return name(); }
+
 private:
-	virtual void start() { QThread::start(); }
-	virtual void wait() { QThread::wait(); }
+	virtual void start();
+	virtual void wait() { if (theFlags & Cooperative) QTask::wait(); else QThread::wait(); }
 	virtual void getReadyForStopping();
+	virtual void wantToStopNow() { wake(); }
 
 	/** Thread subsystem. @sa threadProcessor() */
 	virtual void run();
 
+	/** Cooperative subsystem; resumes processor() until it next has to wait. */
+	virtual int doWork();
+
+	HeavyFiber* m_fiber;
+
 	//@{
 	/** Pausing subsystem. */
 	mutable QFastMutex thePause;
@@ -24,6 +24,7 @@
 #include "drcoupling.h"
 #include "rscoupling.h"
 #include "lrconnection.h"
+#include "qmultiplexedlink.h"
 #include "qsocketsession.h"
 using namespace Geddei;
 
@@ -34,6 +35,16 @@ using namespace Geddei;
 namespace Geddei
 {
 
+// Reads a line of a connection header straight from the device, so that (unlike
+// with a QTextStream) none of what follows it is taken.
+static QString readHeaderLine(QIODevice *_link)
+{
+	while (!_link->canReadLine())
+		if (!_link->waitForReadyRead(30000))
+			return QString();
+	return QString::fromUtf8(_link->readLine()).trimmed();
+}
+
 QFastMutex *ProcessorForwarder::theReaper;
 QList<RLConnection*> ProcessorForwarder::theGraveyard;
 
@@ -41,10 +52,13 @@ ProcessorForwarder::ProcessorForwarder(uint port)
 {
 	listen(QHostAddress::LocalHost, port ? port : GEDDEI_PORT);
 	if (MESSAGES) qDebug("Starting server on port: %d.", port ? port : GEDDEI_PORT);
+	// Hosts we link to may then use the link to reach us too.
+	QMultiplexedLink::setAcceptor(this, serverPort());
 }
 
 ProcessorForwarder::~ProcessorForwarder()
 {
+	QMultiplexedLink::forgetAcceptor(this);
 	while (theGraveyard.size())
 		delete theGraveyard.takeLast();
 }
@@ -66,7 +80,11 @@ void ProcessorForwarder::incomingConnection(int socket)
 {
 	if (MESSAGES) qDebug("> newConnection()");
 	clearGraveyard();
-	if (MESSAGES) qDebug("= newConnection(): Graveyard cleared. Creating socket device");
+	if (MESSAGES) qDebug("= newConnection(): Graveyard cleared. Checking for a multiplexed link");
+
+	// If it's a link, we'll get its channels through customEvent().
+	if (QMultiplexedLink::adopt(socket, this))
+		return;
 
 	// SocketDevice must be a pointer since we need to pass it to RLC and it will
 	// get closed on destruction, which would be a problem if stiored on the stack.
@@ -75,24 +93,37 @@ void ProcessorForwarder::incomingConnection(int socket)
 	// we sort of look after the deletion of the RLC.
 	QTcpSocket *link = new QTcpSocket;
 	link->setSocketDescriptor(socket);
-	if (MESSAGES) qDebug("= newConnection(): Created. Creating stream and encoding.");
+	serve(link);
+}
 
+void ProcessorForwarder::customEvent(QEvent *e)
+{
+	if (e->type() == QMultiplexedLink::ChannelEvent::Type)
+	{	if (MESSAGES) qDebug("> newConnection(): Multiplexed channel");
+		clearGraveyard();
+		serve(static_cast<QMultiplexedLink::ChannelEvent *>(e)->channel());
+	}
+}
+
+void ProcessorForwarder::serve(QIODevice *link)
+{
+	if (MESSAGES) qDebug("= newConnection(): Creating stream and encoding.");
 	{
 		QTextStream header(link);
 		header.setCodec("UTF-8");
 
 		if (MESSAGES) qDebug("= newConnection(): Done. Reading key...");
-		uint key = header.readLine().toUInt();
+		uint key = readHeaderLine(link).toUInt();
 		if (MESSAGES) qDebug("Received key: %d.", key);
-		QString command = header.readLine();
+		QString command = readHeaderLine(link);
 		if (command == "connect")
 		{
-			QString procName = header.readLine();
+			QString procName = readHeaderLine(link);
 			if (MESSAGES) qDebug("Received proc name: %s.", qPrintable(procName));
 			Processor *processor = lookup(key, procName);
 			if (MESSAGES) qDebug("Processor is %p", processor);
-			int input = header.readLine().toInt();
-			uint bufferSize = header.readLine().toUInt();
+			int input = readHeaderLine(link).toInt();
+			uint bufferSize = readHeaderLine(link).toUInt();
 
 			// TODO: check if already connected - do something if it is
 			if (!processor)
@@ -106,12 +137,12 @@ void ProcessorForwarder::incomingConnection(int socket)
 		}
 		else if (command == "disconnect")
 		{
-			QString procName = header.readLine();
+			QString procName = readHeaderLine(link);
 			if (MESSAGES) qDebug("Received proc name: %s.", qPrintable(procName));
 			// Need QFastMutexLocker for the group here.
 			Processor *processor = lookup(key, procName);
 			if (MESSAGES) qDebug("Processor is %p", processor);
-			int input = header.readLine().toInt();
+			int input = readHeaderLine(link).toInt();
 			if (!processor)
 			{	qWarning("*** ERROR: Invalid connection header---Processor reference or key invalid.\n"
 						 "           (processor=%p, key=%d)", processor, key);
@@ -125,7 +156,7 @@ void ProcessorForwarder::incomingConnection(int socket)
 		{
 			if (MESSAGES) qDebug("Got COUPLE command:");
 			// Create a subProc, then create a RSCoupling. Associate them.
-			QString type = header.readLine();
+			QString type = readHeaderLine(link);
 			if (MESSAGES) qDebug("Received proc type: %s", qPrintable(type));
 			SubProcessor *sub = SubProcessorFactory::create(type);
 			if (MESSAGES) qDebug("Created SubProcessor at %p", sub);
@@ -139,7 +170,7 @@ void ProcessorForwarder::incomingConnection(int socket)
 		{
 			if (MESSAGES) qDebug("Got DECOUPLE command:");
 			// grab the subProc pointer.
-			SubProcessor *sub = (SubProcessor *)(header.readLine().toUInt());
+			SubProcessor *sub = (SubProcessor *)(readHeaderLine(link).toUInt());
 			RSCoupling *coupling = dynamic_cast<RSCoupling *>(sub->coupling());
 			if (MESSAGES) qDebug("Deleting SubProcessor at %p...", sub);
 			delete sub;
@@ -152,16 +183,13 @@ void ProcessorForwarder::incomingConnection(int socket)
 	delete link;
 }
 
-LRConnection *ProcessorForwarder::createConnection(Source *source, uint sourceIndex, uint bufferSize, const QString &sinkHost, uint sinkKey, const QString &sinkProcessorName, uint sinkIndex)
+LRConnection *ProcessorForwarder::createConnection(Source *source, uint sourceIndex, uint bufferSize, const QString &sinkHost, uint sinkKey, const QString &sinkProcessorName, uint sinkIndex, LinkCodec::Mode codec)
 {
 	LRConnection *ret;
-	QTcpSocket *link = new QTcpSocket;
 	if (MESSAGES) qDebug("> ProcessorForwarder::createConnection() : sinkHost = %s", qPrintable(sinkHost));
-	link->connectToHost(QHostAddress(sinkHost), sinkKey < 65536 ? sinkKey : GEDDEI_PORT);
-	if (!link->waitForConnected())
-	{	qWarning("*** ERROR: Couldn't connect to sink host (%s). Code %d.", qPrintable(sinkHost), (int)link->error());
+	QIODevice *link = login(sinkHost, sinkKey);
+	if (!link)
 		return 0;
-	}
 	else
 	{	QTextStream header(link);
 		if (MESSAGES) qDebug("Setting codec...");
@@ -171,6 +199,9 @@ LRConnection *ProcessorForwarder::createConnection(Source *source, uint sourceIn
 		if (MESSAGES) qDebug("Sent. Creating LRC...");
 		ret = new LRConnection(source, sourceIndex, link);
 		ret->setCredentials(sinkHost, sinkKey, sinkProcessorName, sinkIndex);
+		ret->shareRing(bufferSize);
+		if (codec != LinkCodec::Raw && !ret->setCodec(codec))
+			qWarning("*** WARNING: Remote side won't take the %s codec; sending raw.", LinkCodec::name(codec));
 		if (MESSAGES) qDebug("Done. Exiting.");
 	}
 	return ret;
@@ -178,38 +209,44 @@ LRConnection *ProcessorForwarder::createConnection(Source *source, uint sourceIn
 
 bool ProcessorForwarder::deleteConnection(const QString &sinkHost, uint sinkKey, const QString &sinkProcessorName, uint sinkIndex)
 {
-	QTcpSocket link;
 	if (MESSAGES) qDebug("> ProcessorForwarder::deleteConnection() : sinkHost = %s", qPrintable(sinkHost));
-	link.connectToHost(QHostAddress(sinkHost), sinkKey < 65536 ? sinkKey : GEDDEI_PORT);
-	if (!link.waitForConnected())
-	{	qWarning("*** ERROR: Couldn't connect to sink host (%s). Code %d.", qPrintable(sinkHost), (int)link.error());
+	QIODevice *link = login(sinkHost, sinkKey);
+	if (!link)
 		return false;
-	}
-	QTextStream header(&link);
+	QTextStream header(link);
 	if (MESSAGES) qDebug("Setting codec...");
 	header.setCodec("UTF-8");
 	if (MESSAGES) qDebug("Sending credentials (key=%d, name=%s)", sinkKey, qPrintable(sinkProcessorName));
 	header << sinkKey << endl << "disconnect" << endl << sinkProcessorName << endl << sinkIndex << endl;
 	if (MESSAGES) qDebug("Done. Verifying...");
-	return header.readLine() == "OK";
+	bool ret = readHeaderLine(link) == "OK";
+	delete link;
+	return ret;
 }
 
-QTcpSocket *ProcessorForwarder::login(const QString &host, uint key)
+QIODevice *ProcessorForwarder::login(const QString &host, uint key)
 {
-	QTcpSocket *link = new QTcpSocket;
 	if (MESSAGES) qDebug("> ProcessorForwarder::login() : host = %s, key = %d", qPrintable(host), key);
-	link->connectToHost(QHostAddress(host), key < 65536 ? key : GEDDEI_PORT);
+	quint16 port = key < 65536 ? key : GEDDEI_PORT;
+	// All connections to a host share the one link if we can make it.
+	if (QMultiplexedChannel *channel = QMultiplexedLink::open(QHostAddress(host), port))
+	{	if (MESSAGES) qDebug("< ProcessorForwarder::login() : Logged in OK (multiplexed)");
+		return channel;
+	}
+	QTcpSocket *link = new QTcpSocket;
+	link->connectToHost(QHostAddress(host), port);
 	if (!link->waitForConnected())
 	{	qWarning("*** ERROR: Couldn't connect to sink host (%s). Code %d.", qPrintable(host), (int)link->error());
+		delete link;
 		return 0;
 	}
 	if (MESSAGES) qDebug("< ProcessorForwarder::login() : Logged in OK");
 	return link;
 }
 
-DRCoupling *ProcessorForwarder::createCoupling(DomProcessor *dom, const QString &host, uint key, const QString &type)
+DRCoupling *ProcessorForwarder::createCoupling(DomProcessor *dom, const QString &host, uint key, const QString &type, LinkCodec::Mode codec)
 {
-	QTcpSocket *link = login(host, key);
+	QIODevice *link = login(host, key);
 	if (!link) return 0;
 	DRCoupling *ret;
 	QTextStream header(link);
@@ -218,17 +255,19 @@ DRCoupling *ProcessorForwarder::createCoupling(DomProcessor *dom, const QString
 	if (MESSAGES) qDebug("Sending credentials (key=%d, type=%s)", key, qPrintable(type));
 	header << key << endl << "couple" << endl << type << endl;
 	if (MESSAGES) qDebug("Sent. Reading subProcKey...");
-	uint sPK = header.readLine().toUInt();
+	uint sPK = readHeaderLine(link).toUInt();
 	if (MESSAGES) qDebug("Got %d. Creating DRC...", sPK);
 	ret = new DRCoupling(dom, link);
 	ret->setCredentials(host, key, sPK);
+	if (codec != LinkCodec::Raw && !ret->setCodec(codec))
+		qWarning("*** WARNING: Remote side won't take the %s codec; sending raw.", LinkCodec::name(codec));
 	if (MESSAGES) qDebug("Done. Exiting.");
 	return ret;
 }
 
 bool ProcessorForwarder::deleteCoupling(const QString &host, uint key, uint sPK)
 {
-	QTcpSocket *link = login(host, key);
+	QIODevice *link = login(host, key);
 	if (!link) return false;
 	QTextStream header(link);
 	if (MESSAGES) qDebug("Setting codec...");
@@ -236,7 +275,7 @@ bool ProcessorForwarder::deleteCoupling(const QString &host, uint key, uint sPK)
 	if (MESSAGES) qDebug("Sending credentials (key=%d, subProcKey=%d)", key, sPK);
 	header << key << endl << "decouple" << endl << sPK << endl;
 	if (MESSAGES) qDebug("Done. Verifying...");
-	bool ret = header.readLine() == "OK";
+	bool ret = readHeaderLine(link) == "OK";
 	delete link;
 	return ret;
 }
@@ -57,6 +57,15 @@ class DLLEXPORT ProcessorForwarder: public QTcpServer
 	//* Reimplementation from QServerSocket.
 	virtual void incomingConnection(int socket);
 
+	//* Reimplementation from QObject; takes channels of adopted links.
+	virtual void customEvent(QEvent *e);
+
+	/**
+	 * Reads the header from the new connection @a link and acts on it. @a link
+	 * is either adopted by the connection or coupling it makes, or deleted.
+	 */
+	void serve(QIODevice *link);
+
 	/**
 	 * Subclass this method to derive processor from key and name.
 	 * Will be different on basic UI than on node servers.
@@ -64,13 +73,15 @@ class DLLEXPORT ProcessorForwarder: public QTcpServer
 	virtual Processor *lookup(uint key, const QString &name) = 0;
 
 	/**
-	 * Initiates a connection with a remote ProcessorForwarder.
-	 * Returns a new QSocketDevice * allocated on the heap. This is not owned
+	 * Initiates a connection with a remote ProcessorForwarder. This is a
+	 * channel of the QMultiplexedLink to its host where possible, or a
+	 * socket of its own otherwise.
+	 * Returns a new QIODevice * allocated on the heap. This is not owned
 	 * by this method, and must be deleted by the caller.
 	 * This point is moot though, since the returned QSD is adopted by a connection
 	 * or coupling.
 	 */
-	static QTcpSocket *login(const QString &host, uint key);
+	static QIODevice *login(const QString &host, uint key);
 
 public:
 	/**
@@ -79,7 +90,7 @@ public:
 	 * code close to each other (code originally from Processor).
 	 * Method is static to show lack of home for code.
 	 */
-	static LRConnection *createConnection(Source *source, uint sourceIndex, uint bufferSize, const QString &sinkHost, uint sinkKey, const QString &sinkProcessorName, uint sinkIndex);
+	static LRConnection *createConnection(Source *source, uint sourceIndex, uint bufferSize, const QString &sinkHost, uint sinkKey, const QString &sinkProcessorName, uint sinkIndex, LinkCodec::Mode codec = LinkCodec::Raw);
 
 	/**
 	 * Delete an existing connection.
@@ -99,7 +110,7 @@ public:
 	 * remote subprocessor described by @a host, @a key and @a subProcessorKey.
 	 * The DomProcessor is given by @a dom.
 	 */
-	static DRCoupling *createCoupling(DomProcessor *dom, const QString &host, uint key, const QString &type);
+	static DRCoupling *createCoupling(DomProcessor *dom, const QString &host, uint key, const QString &type, LinkCodec::Mode codec = LinkCodec::Raw);
 
 	/**
 	 * Initiates a remote deletion request on @a host with session @a key.
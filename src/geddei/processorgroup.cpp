@@ -16,8 +16,11 @@
  * along with Exscalibar.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <QThread>
+
 #include "processor.h"
 #include "domprocessor.h"
+#include "multiprocessor.h"
 #include "processorgroup.h"
 using namespace Geddei;
 
@@ -26,8 +29,25 @@ using namespace Geddei;
 namespace Geddei
 {
 
-ProcessorGroup::ProcessorGroup(bool adopt) : theAdopt(adopt)
+ProcessorGroup::ProcessorGroup(bool adopt):
+	theAdopt(adopt),
+	m_coreBudget(qMax(0, QThread::idealThreadCount() - 1)),
+	m_coresFree(m_coreBudget)
+{
+}
+
+void ProcessorGroup::setCoreBudget(uint _cores)
 {
+	m_coresFree.fetchAndAddOrdered(int(_cores) - m_coreBudget);
+	m_coreBudget = _cores;
+}
+
+bool ProcessorGroup::claimCore()
+{
+	for (int f = m_coresFree; f > 0; f = m_coresFree)
+		if (m_coresFree.testAndSetOrdered(f, f - 1))
+			return true;
+	return false;
 }
 
 ProcessorGroup::~ProcessorGroup()
@@ -112,6 +132,45 @@ bool ProcessorGroup::confirmTypes() const
 	return ret;
 }
 
+uint ProcessorGroup::optimise()
+{
+	if (!confirmTypes())
+		return 0;
+
+	QList<DomProcessor*> removed;
+	for (bool again = true; again;)
+	{
+		again = false;
+		foreach (Groupable* i, theMembers.values())
+			if (DomProcessor* d = dynamic_cast<DomProcessor*>(i))
+				if (DomProcessor* n = d->fusable())
+				{
+					d->fuse(n);
+					remove(n);
+					removed += n;
+					again = true;
+					// Types must be confirmed again before we look for more.
+					confirmTypes();
+					break;
+				}
+	}
+	foreach (Groupable* i, theMembers.values())
+		if (DomProcessor* d = dynamic_cast<DomProcessor*>(i))
+			if (d->foldable())
+			{
+				d->fold();
+				remove(d);
+				removed += d;
+			}
+
+	if (MESSAGES) qDebug("ProcessorGroup::optimise(): Removed %d processors.", removed.count());
+	if (theAdopt)
+		foreach (DomProcessor* d, removed)
+			delete d;
+	confirmTypes();
+	return removed.count();
+}
+
 void ProcessorGroup::deleteAll()
 {
 	foreach (Groupable* i, theMembers.values())
@@ -167,6 +226,19 @@ const QString ProcessorGroup::error() const
 	return ret;
 }
 
+QList<ProcessorCounters> ProcessorGroup::counters() const
+{
+	QList<ProcessorCounters> ret;
+	foreach (Groupable* i, theMembers)
+		if (Processor* p = dynamic_cast<Processor*>(i))
+			ret << p->counters();
+		else if (MultiProcessor* m = dynamic_cast<MultiProcessor*>(i))
+			if (m->isInitialised())
+				for (uint j = 0; j < m->multiplicity(); j++)
+					ret << m->processor(j)->counters();
+	return ret;
+}
+
 void ProcessorGroup::stop(bool resetToo) const
 {
 	foreach (Groupable* i, theMembers)
@@ -20,12 +20,16 @@
 
 #include <QString>
 #include <QMap>
+#include <QList>
+#include <QAtomicInt>
 
 #include <exscalibar.h>
 #ifdef __GEDDEI_BUILD
 #include "groupable.h"
+#include "counters.h"
 #else
 #include <geddei/groupable.h>
+#include <geddei/counters.h>
 #endif
 
 namespace Geddei
@@ -51,6 +55,8 @@ class DLLEXPORT ProcessorGroup
 	mutable Groupable* m_errorProc;
 	bool theAdopt;
 	QMap<QString, Groupable*> theMembers;
+	int m_coreBudget;
+	QAtomicInt m_coresFree;
 
 	friend class Groupable;
 	void add(Groupable *o);
@@ -66,6 +72,32 @@ public:
 	bool confirmTypes() const;
 	Groupable* errorProc() const { return m_errorProc; }
 
+	/**
+	 * Simplifies the network before it is started. Two passes are made, each
+	 * of which removes a Processor object from the group:
+	 *
+	 * - Each chain of DomProcessor objects connected one to one by local
+	 * connections is fused into the first of them, running a Fusion of their
+	 * SubProcessors. This saves a Buffer and a round of scheduling for each
+	 * link in the chain, and keeps the data between them in cache.
+	 * - Each DomProcessor with an in-place SubProcessor and no workers is
+	 * folded into the connection feeding it, which then does its work on the
+	 * way through.
+	 *
+	 * Only Processor objects in this group, and connections between them, are
+	 * touched. The removed Processor objects are left with no group and no
+	 * connections; they are deleted if the group adopts its members. The
+	 * names of the survivors don't change, so anything wanting the output of
+	 * a removed Processor should look to the one that took it over.
+	 *
+	 * Call it after everything is connected but before go(). It is optional;
+	 * the network's output is the same either way.
+	 *
+	 * @return The number of Processor objects removed, or zero if the types
+	 * did not confirm.
+	 */
+	uint optimise();
+
 	/**
 	 * Start all Processor objects in the group. Note this returns once all have
 	 * been "primed". If you want to wait until they are actually going (or not
@@ -132,6 +164,56 @@ public:
 	 */
 	void disconnectAll();
 
+	/**
+	 * Takes a snapshot of the performance counters of every Processor object
+	 * in the group. The Processor objects of any MultiProcessor are each
+	 * given separately.
+	 *
+	 * @return The snapshots, ordered by name.
+	 *
+	 * @sa Processor::counters()
+	 */
+	QList<ProcessorCounters> counters() const;
+
+	/**
+	 * Takes a snapshot of the performance counters of every Processor object
+	 * in the group and gives it in dump format (see ProcessorCounters). Call
+	 * periodically and append to a file for offline analysis.
+	 *
+	 * @return The snapshot in dump format.
+	 */
+	QString dumpCounters() const { return Geddei::dumpCounters(counters()); }
+
+	/**
+	 * Sets the most cores that the autotuning DomProcessor objects in the
+	 * group may take for their workers between them. Defaults to one fewer
+	 * than QThread::idealThreadCount(), leaving one for everything else.
+	 *
+	 * Cores already taken are not given back if the budget goes down; it
+	 * just takes longer before any more are handed out.
+	 *
+	 * @param cores The number of cores.
+	 */
+	void setCoreBudget(uint cores);
+
+	/**
+	 * @return The most cores that the group's autotuning DomProcessor objects
+	 * may take between them.
+	 */
+	uint coreBudget() const { return m_coreBudget; }
+
+	/** @internal
+	 * Takes one core from the budget. Safe to call from any thread.
+	 *
+	 * @return true iff there was one free.
+	 */
+	bool claimCore();
+
+	/** @internal
+	 * Gives back a core taken with claimCore(). Safe to call from any thread.
+	 */
+	void releaseCore() { m_coresFree.fetchAndAddOrdered(1); }
+
 	/**
 	 * Checks for the existance of a named Processor in the group.
 	 *
@@ -23,6 +23,7 @@ using namespace std;
 #include "processor.h"
 #include "bufferdata.h"
 #include "commandcodes.h"
+#include "qmultiplexedlink.h"
 #include "rlconnection.h"
 using namespace Geddei;
 
@@ -31,15 +32,23 @@ using namespace Geddei;
 namespace Geddei
 {
 
-RLConnection::RLConnection(QTcpSocket *sourceSocketDevice, Sink *newSink, int newSinkIndex, uint bufferSize) : xLConnectionReal(newSink, newSinkIndex, bufferSize), QThread(0), theSource(sourceSocketDevice)
+RLConnection::RLConnection(QIODevice *sourceSocketDevice, Sink *newSink, int newSinkIndex, uint bufferSize) : xLConnectionReal(newSink, newSinkIndex, bufferSize), QThread(0), theSource(sourceSocketDevice)
 {
 	theBeingDeleted = false;
 	theHaveType = false;
+	theGranted = theReceived = 0;
+#if defined(HAVE_LINUX) && !defined(SINGLE_THREADED)
+	theOnFiber = dynamic_cast<QMultiplexedChannel *>(sourceSocketDevice);
+#else
+	theOnFiber = false;
+#endif
 	if (MESSAGES) qDebug("RLC: Handshaking...");
 	theSource.handshake(false);
 	if (MESSAGES) qDebug("RLC: Handshaking finished.");
-	if (theSource.isOpen())
-		start(HighPriority);
+	if (theSource.isOpen() && theOnFiber)
+		QFiberTask::start();
+	else if (theSource.isOpen())
+		QThread::start(HighPriority);
 	else
 		qWarning("*** CRITICAL: RLConnection failed. Remote side not handshaking.");
 }
@@ -50,23 +59,50 @@ RLConnection::~RLConnection()
 	// this is here for a fail-safe.
 
 	theBeingDeleted = true;
-	if (isRunning())
+	if (theOnFiber ? QFiberTask::isRunning() : QThread::isRunning())
 	{	if (MESSAGES) qDebug("RLConnection::~RLConnection(): Thread still running on RLConnection destruction. Safely stopping...");
 		theSource.close();
 		theBuffer.openTrapdoor(0);
-		if (!wait(2000))
+		if (theOnFiber ? !QFiberTask::wait(2000) : !QThread::wait(2000))
 		{	qWarning("*** WARNING: Thread not responding. Terminating anyway.");
-			terminate();
-			wait(10000);
+			if (theOnFiber)
+				QFiberTask::stop();
+			else
+			{	terminate();
+				QThread::wait(10000);
+			}
 		}
 		theBuffer.closeTrapdoor(0);
 	}
 }
 
+void RLConnection::grantCredit(bool _always)
+{
+	uint owed = theGranted - theReceived;
+	uint free = theBuffer.elementsFree();
+	uint grant = free > owed ? free - owed : 0;
+	if (_always || (grant && grant >= theBuffer.size() / 4))
+	{	if (MESSAGES) qDebug("= RLC::grantCredit(): Granting %d (free=%d, owed=%d).", grant, free, owed);
+		theSource.sendByte(Credit);
+		theSource.safeSendWord((uint32_t)grant);
+		theGranted += grant;
+	}
+}
+
+bool RLConnection::isValidTransfer(uint _size) const
+{
+	// However much credit it thinks it has, it can't send more than fits.
+	if (_size <= theBuffer.size())
+		return true;
+	qWarning("*** ERROR: RLConnection: Transfer of %d elements into a buffer of %d. Closing.", _size, theBuffer.size());
+	return false;
+}
+
 void RLConnection::run()
 {
 	if (MESSAGES) qDebug("> RLC::run(): isOpen() = %d", theSource.isOpen());
 	bool breakOut = false;
+	grantCredit();
 	while (theSource.isOpen())
 	{
 		if (MESSAGES) qDebug("= RLC::run(): Receiving...");
@@ -77,22 +113,20 @@ void RLConnection::run()
 		if (MESSAGES) qDebug("= RLC::run(): command = %d", (int)command);
 		switch (command)
 		{
-		case BufferWaitForFree:
-		{	if (MESSAGES) qDebug("= RLC::run(): BufferWaitForFree");
-			theBuffer.waitForFreeElements(1);
-			if (MESSAGES) qDebug("= RLC::run(): Acking.");
-			theSource.ack();
-			break;
-		}
-		case BufferSpaceFree:
-		{	if (MESSAGES) qDebug("= RLC::run(): BufferSpaceFree");
-			theSource.safeSendWord(theBuffer.elementsFree());
-			if (MESSAGES) qDebug("= RLC::run(): Done.");
+		case BufferWaitForFreeElements:
+		{	// Its credit and our grant add up to all that's free, so wait until
+			// that's at least what it wants.
+			uint wanted = theSource.safeReceiveWord<uint32_t>();
+			if (MESSAGES) qDebug("= RLC::run(): BufferWaitForFreeElements (%d)", wanted);
+			theBuffer.waitForFreeElements(wanted);
+			grantCredit(true);
+			if (MESSAGES) qDebug("= RLC::run(): Granted.");
 			break;
 		}
 		case Transfer:
 		{	if (MESSAGES) qDebug("= RLC::run(): Received transfer request.");
-			int size = theSource.safeReceiveWord<int>();
+			uint size = theSource.safeReceiveWord<uint32_t>();
+			if (!isValidTransfer(size)) { breakOut = true; break; }
 			if (MESSAGES) qDebug("= RLC::run(): Creating buffer (size=%d).", size);
 			BufferData data = theBuffer.makeScratchElements(size, false);
 			if (!theSource.isOpen()) { breakOut = true; break; }
@@ -105,12 +139,75 @@ void RLConnection::run()
 				theSource.safeReceiveWordArray((int *)data.firstPart(), data.sizeOnlyPart());
 			if (MESSAGES) qDebug("= RLC::run(): Pushing data.");
 			theBuffer.push(data);
+			theReceived += size;
 			if (MESSAGES) qDebug("= RLC::run(): Transfer completed.");
 			break;
 		}
+		case SharedTransfer:
+		{	if (MESSAGES) qDebug("= RLC::run(): Received shared transfer request.");
+			uint size = theSource.safeReceiveWord<uint32_t>();
+			if (!isValidTransfer(size)) { breakOut = true; break; }
+			BufferData data = theBuffer.makeScratchElements(size, false);
+			// It's written before we're told, so this shouldn't wait.
+			while (theSource.isOpen() && !theRing.waitForData(size, 501)) {}
+			if (!theSource.isOpen()) { breakOut = true; break; }
+			if (data.rollsOver())
+			{	theRing.read(data.firstPart(), data.sizeFirstPart());
+				theRing.read(data.secondPart(), data.sizeSecondPart());
+			}
+			else
+				theRing.read(data.firstPart(), data.sizeOnlyPart());
+			theRing.release();
+			theBuffer.push(data);
+			theReceived += size;
+			if (MESSAGES) qDebug("= RLC::run(): Shared transfer completed.");
+			break;
+		}
+		case EncodedTransfer:
+		{	uint size = theSource.safeReceiveWord<uint32_t>();
+			uint bytes = theSource.safeReceiveWord<uint32_t>();
+			if (MESSAGES) qDebug("= RLC::run(): Received coded transfer (size=%d, bytes=%d).", size, bytes);
+			if (!isValidTransfer(size)) { breakOut = true; break; }
+			if (bytes > theCodec.maxEncodedSize(size))
+			{	qWarning("*** ERROR: RLConnection: %s transfer of %d elements claims %d bytes, more than it could be. Closing.", LinkCodec::name(theCodec.mode()), size, bytes);
+				breakOut = true;
+				break;
+			}
+			BufferData data = theBuffer.makeScratchElements(size, false);
+			if (!theSource.isOpen()) { breakOut = true; break; }
+			theEncoded.resize(bytes);
+			theSource.receiveChunk((uchar *)theEncoded.data(), bytes);
+			if (!theSource.isOpen()) { breakOut = true; break; }
+			if (!theCodec.decode(theEncoded, data))
+			{	qWarning("*** ERROR: RLConnection: Couldn't decode %s transfer. Closing.", LinkCodec::name(theCodec.mode()));
+				breakOut = true;
+				break;
+			}
+			theBuffer.push(data);
+			theReceived += size;
+			if (MESSAGES) qDebug("= RLC::run(): Coded transfer completed.");
+			break;
+		}
+		case SetLinkCodec:
+		{	uint codec = theSource.safeReceiveWord<uint32_t>();
+			if (MESSAGES) qDebug("= RLC::run(): SetLinkCodec (%d)", codec);
+			if (LinkCodec::isValid(codec))
+				theCodec.setMode((LinkCodec::Mode)codec);
+			theSource.ack(LinkCodec::isValid(codec));
+			break;
+		}
+		case ShareRing:
+		{	QByteArray name = theSource.receiveString();
+			uint32_t nonce = theSource.safeReceiveWord<uint32_t>();
+			if (MESSAGES) qDebug("= RLC::run(): ShareRing (%s)", name.constData());
+			theSource.ack(theRing.attach(name, nonce));
+			break;
+		}
 		case SetType:
 		{	if (MESSAGES) qDebug("= RLC::run(): SetType");
 			theType = TransmissionType::receive(theSource);
+			// The other side's codec starts afresh with a new type.
+			theCodec.reset();
 			if (MESSAGES) qDebug("= RLC::run(): theBuffer.setType()");
 			theBuffer.setType(theType);
 			if (MESSAGES) qDebug("= RLC::run(): Make lock");
@@ -184,6 +281,7 @@ void RLConnection::run()
 		}
 
 		if (breakOut) break;
+		grantCredit();
 	}
 
 	if (MESSAGES) qDebug("= RLC::run(): EXITING. isOpen() = %d", theSource.isOpen());
@@ -25,16 +25,23 @@
 #ifdef __GEDDEI_BUILD
 
 #include "qfastwaitcondition.h"
+#include "qfibertask.h"
 #include "qsocketsession.h"
+#include "qsharedring.h"
 #include "xlconnectionreal.h"
+#include "linkcodec.h"
 #else
 #include <qtextra/qfastwaitcondition.h>
+#include <qtextra/qfibertask.h>
 #include <qtextra/qsocketsession.h>
+#include <qtextra/qsharedring.h>
 #include <geddei/xlconnectionreal.h>
+#include <geddei/linkcodec.h>
 #endif
+using namespace QtExtra;
 using namespace Geddei;
 
-class QTcpSocket;
+class QIODevice;
 
 namespace Geddei
 {
@@ -49,15 +56,49 @@ class Processor;
  * This shunts data from a network socket into it's buffer for use (on the front-line)
  * with the processor object, along with looking after any other comms neccessary,
  * such as for type identifiation/synchronisation.
+ *
+ * The remote side is kept going with credit (see LRConnection): we grant it
+ * elements of our buffer's free space, in lumps of at least a quarter of
+ * the buffer, as they come free, and straight away when it asks for them.
+ *
+ * When on the same host, the remote side may send the data of its transfers
+ * through a QSharedRing it offers us rather than the socket, and data that
+ * does come through the socket may be coded with a LinkCodec.
+ *
+ * Over a socket of its own it has a thread to read it. Over a
+ * QMultiplexedChannel, whose waits all yield, it runs as a fiber on the
+ * worker pool instead, so the channels of a link don't each need a thread.
  */
-class DLLEXPORT RLConnection: public xLConnectionReal, protected QThread
+class DLLEXPORT RLConnection: public xLConnectionReal, protected QThread, protected QFiberTask
 {
-	bool theBeingDeleted, theHaveType;
+	bool theBeingDeleted, theHaveType, theOnFiber;
 	QSocketSession theSource;
+	QSharedRing theRing;
+	LinkCodec theCodec;
+	QByteArray theEncoded;
 	QFastWaitCondition theGotType;
 	QFastMutex theGotTypeM;
 
-	//* Reimplementation from QThread.
+	/**
+	 * Elements of credit granted and of data received, ever. The difference is
+	 * credit the remote side still has (or data still in flight), which must
+	 * be kept free in the buffer.
+	 */
+	uint theGranted, theReceived;
+
+	/**
+	 * Grants the remote side all the free space in the buffer it doesn't yet
+	 * have credit for, if it's worth sending or @a _always.
+	 */
+	void grantCredit(bool _always = false);
+
+	/**
+	 * @return true if a transfer of @a _size elements, as read off the
+	 * socket, could fit in our buffer. Warns if not, so we can close.
+	 */
+	bool isValidTransfer(uint _size) const;
+
+	//* Reimplementation from QThread and QFiberTask.
 	virtual void run();
 
 	//* Reimplementation from xLConnection.
@@ -67,7 +108,7 @@ public:
 	/**
 	 * Simple constructor, for developer's use.
 	 */
-	RLConnection(QTcpSocket *sourceSocketDevice, Sink *newSink, int newSinkIndex, uint bufferSize);
+	RLConnection(QIODevice *sourceSocketDevice, Sink *newSink, int newSinkIndex, uint bufferSize);
 
 	/**
 	 * Simple destructor.
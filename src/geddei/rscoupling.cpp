@@ -16,7 +16,10 @@
  * along with Exscalibar.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <QVarLengthArray>
+
 #include "commandcodes.h"
+#include "qmultiplexedlink.h"
 #include "rscoupling.h"
 #include "properties.h"
 #include "types.h"
@@ -27,14 +30,21 @@ using namespace Geddei;
 namespace Geddei
 {
 
-RSCoupling::RSCoupling(QTcpSocket *dev, SubProcessor *sub) : xSCoupling(sub), QThread(0), theSession(dev)
+RSCoupling::RSCoupling(QIODevice *dev, SubProcessor *sub) : xSCoupling(sub), QThread(0), theSession(dev), m_codec(LinkCodec::Raw)
 {
 	theBeingDeleted = false;
+#if defined(HAVE_LINUX) && !defined(SINGLE_THREADED)
+	theOnFiber = dynamic_cast<QMultiplexedChannel *>(dev);
+#else
+	theOnFiber = false;
+#endif
 	if (MESSAGES) qDebug("RSC: Handshaking...");
 	theSession.handshake(false);
 	if (MESSAGES) qDebug("RSC: Handshaking finished.");
-	if (theSession.isOpen())
-		start(HighPriority);
+	if (theSession.isOpen() && theOnFiber)
+		QFiberTask::start();
+	else if (theSession.isOpen())
+		QThread::start(HighPriority);
 	else
 		qWarning("*** CRITICAL: RSCoupling failed. Remote side not handshaking.");
 }
@@ -44,14 +54,18 @@ RSCoupling::~RSCoupling()
 	// This flag should never have to be used as the thread should be stopped before deletion, however
 	// this is here for a fail-safe.
 	theBeingDeleted = true;
-	if (isRunning())
+	if (theOnFiber ? QFiberTask::isRunning() : QThread::isRunning())
 	{	if (MESSAGES) qDebug("RSCoupling::~RSCoupling(): Thread still running on RSCoupling destruction. Safely stopping...");
 		theSession.close();
 		// Trapdoor opening needed?
-		if (!wait(2000))
+		if (theOnFiber ? !QFiberTask::wait(2000) : !QThread::wait(2000))
 		{	qWarning("*** WARNING: Thread not responding. Terminating anyway.");
-			terminate();
-			wait(10000);
+			if (theOnFiber)
+				QFiberTask::stop();
+			else
+			{	terminate();
+				QThread::wait(10000);
+			}
 		}
 		// Trapdoor closing needed?
 	}
@@ -91,6 +105,13 @@ void RSCoupling::run()
 			for (uint i = 0; i < outTypes.count(); i++)
 				outTypes[i] = TransmissionType::receive(theSession);
 
+			m_inCodecs.fill(LinkCodec(m_codec), inTypes.count());
+			m_outCodecs.fill(LinkCodec(m_codec), outTypes.count());
+			for (uint i = 0; i < outTypes.count(); i++)
+				m_outCodecs[i].setType(outTypes[i]);
+			m_encoded.resize(outTypes.count());
+			m_outTypes = outTypes;
+
 			Types dummyOutTypes(outTypes.count());
 			if (!theSubProc->proxyVSTypes(inTypes, dummyOutTypes))
 				qDebug("*** CRITICAL: SubProcessor does not verify previously validated types.");
@@ -103,13 +124,32 @@ void RSCoupling::run()
 			uint channels = theSession.safeReceiveWord<int>();
 			if (MESSAGES) qDebug("RSC: BufferDatas size = %d", channels);
 			BufferDatas ins(channels);
-			for (uint i = 0; i < ins.size(); i++)
+			bool coded = m_codec != LinkCodec::Raw;
+			if (coded && (uint)m_inCodecs.size() != channels)
+				m_inCodecs.fill(LinkCodec(m_codec), channels);
+			bool failed = false;
+			for (uint i = 0; i < ins.size() && !failed; i++)
 			{	uint size = theSession.safeReceiveWord<int>();
 				uint sampleSize = theSession.safeReceiveWord<int>();
 				BufferData *data = new BufferData(size, sampleSize);
-				theSession.safeReceiveWordArray((int *)data->firstPart(), size);
+				if (coded)
+				{	QByteArray in(theSession.safeReceiveWord<int>(), 0);
+					theSession.receiveChunk((uchar *)in.data(), in.size());
+					if (!m_inCodecs[i].decode(in, *data))
+					{	qWarning("*** ERROR: RSCoupling: Couldn't decode %s input. Closing.", LinkCodec::name(m_codec));
+						theSession.close();
+						failed = true;
+					}
+				}
+				else
+					theSession.safeReceiveWordArray((int *)data->firstPart(), size);
 				ins.setData(i, data);
 			}
+			if (failed)
+			{	ins.nullify();
+				breakOut = true;
+				break;
+			}
 			BufferDatas outs(theSession.safeReceiveWord<int>());
 			for (uint i = 0; i < outs.count(); i++)
 			{
@@ -119,20 +159,45 @@ void RSCoupling::run()
 			}
 			uint chunks = theSession.safeReceiveWord<int>();
 			if (MESSAGES) qDebug("RSC: BufferDatas chunks = %d", chunks);
-			theSubProc->processChunks(ins, outs, chunks);
-			for (uint i = 0; i < ins.size(); i++)
-				if (outs[i].rollsOver())
-				{	theSession.safeSendWordArray((int *)outs[i].firstPart(), outs[i].sizeFirstPart());
-					theSession.safeSendWordArray((int *)outs[i].secondPart(), outs[i].sizeSecondPart());
+			theSubProc->doChunks(ins, outs, chunks);
+			// All the results and the terminating word in one send.
+			QVarLengthArray<QSocketSession::Chunk, 16> reply;
+			QVarLengthArray<int32_t, 16> sizes(outs.size());
+			if (coded && (uint)m_outCodecs.size() != outs.size())
+			{	m_outCodecs.fill(LinkCodec(m_codec), outs.size());
+				for (uint i = 0; i < outs.size() && i < m_outTypes.count(); i++)
+					m_outCodecs[i].setType(m_outTypes[i]);
+				m_encoded.resize(outs.size());
+			}
+			for (uint i = 0; i < outs.size(); i++)
+				if (coded)
+				{	m_outCodecs[i].encode(outs[i], m_encoded[i]);
+					sizes[i] = m_encoded[i].size();
+					reply.append(QSocketSession::Chunk(&sizes[i], 4));
+					reply.append(QSocketSession::Chunk(m_encoded[i].data(), m_encoded[i].size()));
+				}
+				else if (outs[i].rollsOver())
+				{	reply.append(QSocketSession::Chunk(outs[i].firstPart(), 4 * outs[i].sizeFirstPart()));
+					reply.append(QSocketSession::Chunk(outs[i].secondPart(), 4 * outs[i].sizeSecondPart()));
 				}
 				else
-					theSession.safeSendWordArray((int *)outs[i].firstPart(), outs[i].sizeOnlyPart());
-			theSession.safeSendWord(0);
+					reply.append(QSocketSession::Chunk(outs[i].firstPart(), 4 * outs[i].sizeOnlyPart()));
+			int32_t done = 0;
+			reply.append(QSocketSession::Chunk(&done, 4));
+			theSession.sendChunks(reply.data(), reply.size());
 			ins.nullify();
 			outs.nullify();
 			if (MESSAGES) qDebug("RSC: ProcessChunks: Done.");
 			break;
 		}
+		case SetLinkCodec:
+		{
+			uint codec = theSession.safeReceiveWord<uint32_t>();
+			if (LinkCodec::isValid(codec))
+				m_codec = (LinkCodec::Mode)codec;
+			theSession.ack(LinkCodec::isValid(codec));
+			break;
+		}
 		case DefineIO:
 		{
 			uint i = theSession.safeReceiveWord<int>();
@@ -22,12 +22,19 @@
 
 #include <exscalibar.h>
 #ifdef __GEDDEI_BUILD
+#include "qfibertask.h"
 #include "qsocketsession.h"
 #include "xscoupling.h"
+#include "linkcodec.h"
+#include "types.h"
 #else
+#include <qtextra/qfibertask.h>
 #include <qtextra/qsocketsession.h>
 #include <geddei/xscoupling.h>
+#include <geddei/linkcodec.h>
+#include <geddei/types.h>
 #endif
+using namespace QtExtra;
 using namespace Geddei;
 
 namespace Geddei
@@ -37,26 +44,38 @@ namespace Geddei
  * @brief Embodiment of Coupling between remote socket and local SubProcessor object.
  * @author Gav Wood <gav@kde.org>
  *
+ * Like RLConnection, it runs as a fiber on the worker pool when it comes over
+ * a QMultiplexedChannel, and has a thread of its own otherwise.
  */
-class RSCoupling: public xSCoupling, protected QThread
+class RSCoupling: public xSCoupling, protected QThread, protected QFiberTask
 {
 	friend class ProcessorForwarder;
 
 	/**
 	 * Simple constructor.
 	 */
-	RSCoupling(QTcpSocket *dev, SubProcessor *sub);
+	RSCoupling(QIODevice *dev, SubProcessor *sub);
 
 	/**
 	 * Simple destructor.
 	 */
 	virtual ~RSCoupling();
 
-	//* Reimplementation from QThread.
+	//* Reimplementation from QThread and QFiberTask.
 	virtual void run();
 
 	QSocketSession theSession;
-	bool theBeingDeleted;
+	bool theBeingDeleted, theOnFiber;
+
+	/**
+	 * The codec for each input and output, as DRCoupling has them, the output
+	 * types they quantise against, and space for the coded data of each output.
+	 */
+	LinkCodec::Mode m_codec;
+	QVector<LinkCodec> m_inCodecs;
+	QVector<LinkCodec> m_outCodecs;
+	QVector<QByteArray> m_encoded;
+	Types m_outTypes;
 };
 
 }
@@ -16,6 +16,7 @@
  * along with Exscalibar.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "rdtsc.h"
 #include "domprocessor.h"
 #include "subprocessor.h"
 using namespace Geddei;
@@ -116,6 +117,24 @@ void SubProcessor::processOwnChunks(const BufferDatas &in, BufferDatas &out, uin
 	processChunks(in, out, chunks);
 }
 
+void SubProcessor::doChunks(const BufferDatas &in, BufferDatas &out, uint chunks) const
+{
+	realTime s = rdtsc();
+	processChunks(in, out, chunks);
+	m_counters.time += rdtscElapsed(s);
+	m_counters.calls++;
+	m_counters.chunks += chunks;
+}
+
+void SubProcessor::doOwnChunks(const BufferDatas &in, BufferDatas &out, uint chunks)
+{
+	realTime s = rdtsc();
+	processOwnChunks(in, out, chunks);
+	m_counters.time += rdtscElapsed(s);
+	m_counters.calls++;
+	m_counters.chunks += chunks;
+}
+
 void SubProcessor::defineIO(uint numInputs, uint numOutputs)
 {
 	theNumInputs = numInputs;
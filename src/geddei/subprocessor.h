@@ -28,6 +28,7 @@
 #include "properties.h"
 #include "autoproperties.h"
 #include "bufferdatas.h"
+#include "counters.h"
 #include "types.h"
 #else
 #include <qtextra/qfastwaitcondition.h>
@@ -35,6 +36,7 @@
 #include <geddei/properties.h>
 #include <geddei/bufferdatas.h>
 #include <geddei/autoproperties.h>
+#include <geddei/counters.h>
 #include <geddei/types.h>
 #endif
 
@@ -108,6 +110,7 @@ class RSCoupling;
 class DLLEXPORT SubProcessor: public AutoProperties
 {
 	friend class Combination;
+	friend class Fusion;
 	friend class xSCoupling;
 	friend class DSCoupling;
 	friend class RSCoupling;
@@ -162,6 +165,11 @@ public:
 	uint numOutputs() const { return theNumOutputs; }
 
 	void setFlag(int _flag, bool _set = true) { m_flags = (m_flags & ~_flag); if (_set) m_flags |= _flag; }
+	/**
+	 * @return A snapshot of our performance counters.
+	 */
+	SubProcessorCounters counters() const { return m_counters; }
+
 	bool isInplace() const { return (m_flags & SubInplace) && theIn == 1 && theOut == 1 && theStep == 1 && m_inTypes.size() == m_outTypes.size() && m_inTypes.size() == 1 && m_inTypes[0].size() == m_outTypes[0].size(); }
 
 protected:
@@ -356,6 +364,16 @@ private:
 	 */
 	void defineIO(uint numInputs, uint numOutputs);
 
+	//@{
+	/** @internal
+	 * Call processChunks() or processOwnChunks() respectively, keeping count.
+	 * Always use these, rather than calling either directly.
+	 */
+	void doChunks(const BufferDatas &in, BufferDatas &out, uint chunks) const;
+	void doOwnChunks(const BufferDatas &in, BufferDatas &out, uint chunks);
+	mutable SubProcessorCounters m_counters;
+	//@}
+
 	//@{
 	/** @internal
 	 * Records the DomProcessor that we are the primary of. Used only by
@@ -392,10 +410,51 @@ private:
 	QStringList m_dynamics;
 };
 
+/** @ingroup Geddei
+ * @brief Base class for a SubProcessor whose output depends on what came before its input.
+ * @author Gav Wood <gav@kde.org>
+ *
+ * A DomProcessor splits each batch into contiguous segments for its workers.
+ * A stateful SubProcessor can only be given one of those that doesn't follow
+ * on from the last chunk it did if it can catch up. By default it can't, and
+ * the DomProcessor does everything with its primary. To be split, reimplement
+ * warmUpChunks() and resetState(), and exportState() and importState() if
+ * there's any state to speak of.
+ *
+ * A segment that doesn't start the batch is done after resetState() and
+ * with warmUpChunks() chunks of the input before it, whose output is thrown
+ * away. The state at the end of each batch is handed on with exportState()
+ * and importState() to whichever does the first segment of the next.
+ */
 class StatefulSubProcessor: public SubProcessor
 {
 public:
 	StatefulSubProcessor(const QString &type, MultiplicityType multi = NotMulti): SubProcessor(type, multi) {}
+
+	/**
+	 * Reimplement to say how many chunks we need to see after resetState()
+	 * before our output is (near enough) what it would have been had we seen
+	 * everything. Zero if resetState() is all that's needed.
+	 *
+	 * @return The number of chunks, or Undefined if we may never be split.
+	 */
+	virtual uint warmUpChunks() const { return Undefined; }
+
+	/**
+	 * Reimplement to forget everything we've seen, as if we were new.
+	 */
+	virtual void resetState() {}
+
+	/**
+	 * Reimplement to give our state, for importState() on another of our type.
+	 */
+	virtual QVector<float> exportState() const { return QVector<float>(); }
+
+	/**
+	 * Reimplement to take on the state of another of our type, as given by its
+	 * exportState().
+	 */
+	virtual void importState(QVector<float> const&) {}
 };
 
 }
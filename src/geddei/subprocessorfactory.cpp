@@ -25,6 +25,7 @@
 #include "domprocessor.h"
 #include "subprocessorfactory.h"
 #include "combination.h"
+#include "fusion.h"
 
 namespace Geddei
 {
@@ -43,7 +44,14 @@ QFactoryManager<SubProcessor> &SubProcessorFactory::factory()
 
 bool SubProcessorFactory::available(const QString &type)
 {
-	if (type.contains("&"))
+	if (type.contains("|"))
+	{
+		foreach (QString t, type.split("|"))
+			if (!available(t))
+				return false;
+		return true;
+	}
+	else if (type.contains("&"))
 		return available(type.section("&", 0, 0)) && available(type.section("&", 1));
 	else
 		return factory().isAvailable(type);
@@ -51,7 +59,14 @@ bool SubProcessorFactory::available(const QString &type)
 
 int SubProcessorFactory::versionId(const QString &type)
 {
-	if (type.contains("&"))
+	if (type.contains("|"))
+	{
+		int ret = versionId(type.section("|", 0, 0));
+		foreach (QString t, type.section("|", 1).split("|"))
+			ret = min(ret, versionId(t));
+		return ret;
+	}
+	else if (type.contains("&"))
 		return min(versionId(type.section("&", 0, 0)), versionId(type.section("&", 1)));
 	else
 		return factory().getVersion(type);
@@ -62,7 +77,14 @@ SubProcessor *SubProcessorFactory::create(const QString &type)
 	if (!available(type))
 		qFatal("*** FATAL: You are attempting to create a SubProcessor type that is not\n"
 			   "           available (%s).", qPrintable(type));
-	if (type.contains("&"))
+	if (type.contains("|"))
+	{
+		QList<SubProcessor*> stages;
+		foreach (QString t, type.split("|"))
+			stages.append(create(t));
+		return new Fusion(stages);
+	}
+	else if (type.contains("&"))
 		return new Combination(create(type.section("&", 0, 0)), create(type.section("&", 1)));
 	else
 		return factory()[type];
@@ -64,6 +64,7 @@ class DLLEXPORT Typeds
 	friend class DSCoupling;
 	friend class DomProcessor;
 	friend class Combination;
+	friend class Fusion;
 
 public:
 	/**
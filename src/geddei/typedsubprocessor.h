@@ -0,0 +1,134 @@
+/* Copyright 2003, 2004, 2005, 2007, 2009, 2010 Gavin Wood <gav@kde.org>
+ *
+ * This file is part of Exscalibar.
+ *
+ * Exscalibar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Exscalibar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Exscalibar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <exscalibar.h>
+#ifdef __GEDDEI_BUILD
+#include "subprocessor.h"
+#include "bufferdata.h"
+#else
+#include <geddei/subprocessor.h>
+#include <geddei/bufferdata.h>
+#endif
+
+namespace Geddei
+{
+
+/** @ingroup Geddei
+ * @brief Base class for a single input, single output SubProcessor working on plain arrays.
+ * @author Gav Wood <gav@kde.org>
+ *
+ * SubProcessor::processChunk() is a virtual call for each chunk, and each
+ * element of it is got at through BufferData's masked index. For a simple
+ * per-chunk transformation on a high-rate stream that is most of the cost.
+ *
+ * Derive from this, giving your own class as @a Derived, and it does the
+ * loop over the chunks itself on contiguous arrays, calling your kernel()
+ * directly (it's not virtual, so it may be inlined and the loop vectorised):
+ *
+ * @code
+ * class Gain: public TypedSubProcessor<Gain>
+ * {
+ *	friend class TypedSubProcessor<Gain>;
+ *	inline void kernel(float const* _in, float* _out) const
+ *	{
+ *		for (uint i = 0; i < m_arity; i++)
+ *			_out[i] = _in[i] * 2.f;
+ *	}
+ *	virtual bool verifyTypes(Types const& _inTypes, Types& _outTypes)
+ *	{
+ *		_outTypes = _inTypes;
+ *		m_arity = _inTypes[0].arity();
+ *		return true;
+ *	}
+ *	uint m_arity;
+ * public:
+ *	Gain(): TypedSubProcessor<Gain>("Gain") {}
+ * };
+ * @endcode
+ *
+ * kernel() is given @a In samples of input and @a Out samples of output;
+ * each chunk's input is @a Step samples on from the last's. These are fixed
+ * here, so don't call setupSamplesIO(). To do better than a call per chunk
+ * (e.g. to hoist a branch out of the loop) give your own kernels() instead,
+ * taking the whole run at once.
+ *
+ * Types are checked in verifyTypes() rather than verifyAndSpecifyTypes(),
+ * which is ours so we can note the size of the samples.
+ */
+template<class Derived, uint In = 1, uint Step = In, uint Out = 1>
+class TypedSubProcessor: public SubProcessor
+{
+public:
+	/**
+	 * @a _flags are as for SubProcessor's constructor, e.g. SubInplace if
+	 * kernels() may be given the same array for input and output.
+	 */
+	TypedSubProcessor(QString const& _type, int _flags = 0): SubProcessor(_type, NotMulti, _flags) { setupSamplesIO(In, Step, Out); }
+
+protected:
+	/**
+	 * Reimplement as you would verifyAndSpecifyTypes().
+	 */
+	virtual bool verifyTypes(Types const& _inTypes, Types& _outTypes) = 0;
+
+	/**
+	 * Elements between the start of each chunk's input; Step samples.
+	 */
+	uint inStride() const { return m_inStride; }
+
+	/**
+	 * Elements between the start of each chunk's output; Out samples.
+	 */
+	uint outStride() const { return m_outStride; }
+
+	/**
+	 * Processes @a _chunks chunks, each with kernel(). Shadow it in @a Derived
+	 * to take them all at once.
+	 */
+	inline void kernels(float const* _in, float* _out, uint _chunks) const
+	{
+		Derived const* d = static_cast<Derived const*>(this);
+		for (uint c = 0; c < _chunks; c++, _in += m_inStride, _out += m_outStride)
+			d->kernel(_in, _out);
+	}
+
+private:
+	virtual bool verifyAndSpecifyTypes(Types const& _inTypes, Types& _outTypes)
+	{
+		if (!verifyTypes(_inTypes, _outTypes))
+			return false;
+		m_inStride = Step * _inTypes[0].size();
+		m_outStride = Out * _outTypes[0].size();
+		return true;
+	}
+
+	virtual void processChunks(BufferDatas const& _ins, BufferDatas& _outs, uint _chunks) const
+	{
+		float const* in = _ins[0].readPointer();
+		float* out = _outs[0].writePointer();
+		static_cast<Derived const*>(this)->kernels(in, out, _chunks);
+		_outs[0].endWritePointer();
+	}
+
+	uint m_inStride;
+	uint m_outStride;
+};
+
+}
@@ -24,11 +24,13 @@
 #include "connection.h"
 #include "bufferdata.h"
 #include "bufferreader.h"
+#include "counters.h"
 #include "type.h"
 #else
 #include <geddei/connection.h>
 #include <geddei/bufferdata.h>
 #include <geddei/bufferreader.h>
+#include <geddei/counters.h>
 #include <geddei/type.h>
 #endif
 using namespace Geddei;
@@ -243,6 +245,15 @@ public:
 	 */
 	virtual float filled() const { return 0.; }
 
+	/**
+	 * Get a snapshot of the performance counters for this (the reading) end
+	 * of the connection.
+	 *
+	 * @return An empty PortCounters if there is no buffer on this side of the
+	 * connection.
+	 */
+	virtual PortCounters readCounters() const { return PortCounters(); }
+
 protected:
 	/** @internal
 	 * Simple constructor.
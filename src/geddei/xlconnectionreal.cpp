@@ -35,6 +35,7 @@ xLConnectionReal::xLConnectionReal(Sink *newSink, uint newSinkIndex, uint buffer
 	: xLConnection(newSink, newSinkIndex), theBuffer(bufferSize), m_minRead(0), m_minWrite(0)
 {
 	theReader = new BufferReader(&theBuffer);
+	theReader->setTask(dynamic_cast<QTask *>(theSink));
 	m_samplesRead = 0;
 	m_latestPeeked = 0;
 	m_latestTime = 0.0;
@@ -54,7 +55,9 @@ void xLConnectionReal::killReader()
 void xLConnectionReal::resurectReader()
 {
 	if (!theReader)
-		theReader = new BufferReader(&theBuffer);
+	{	theReader = new BufferReader(&theBuffer);
+		theReader->setTask(dynamic_cast<QTask *>(theSink));
+	}
 }
 
 void xLConnectionReal::enforceMinimumRead(uint _elements)
@@ -101,6 +101,7 @@ private:
 	virtual void resurectReader();
 	virtual uint capacity() const { return theBuffer.size() / theType->size(); }
 	virtual float filled() const { return 1.0 - float(theBuffer.elementsFree()) / float(theBuffer.size()); }
+	virtual PortCounters readCounters() const { return theReader ? theReader->counters() : PortCounters(); }
 	virtual bool plungeSync(uint samples) const;
 	virtual bool require(uint samples, uint preferSamples = Undefined);
 	virtual double secondsPassed() const { return type().isA<Contiguous>() ? m_latestPeeked / (double)(type().asA<Contiguous>().frequency()) : m_latestTime; }
@@ -90,6 +90,20 @@ void GeddeiNite::doSave(const QString& _filename)
 	QDomDocument doc;
 	QDomElement root = doc.createElement("network");
 	doc.appendChild(root);
+	foreach (QString n, QScheduler::pools())
+	{
+		QScheduler* s = QScheduler::pool(n);
+		QDomElement pool = doc.createElement("pool");
+		pool.setAttribute("name", n);
+		pool.setAttribute("workers", s->workerCount());
+		QStringList cpus;
+		foreach (int c, s->affinity())
+			cpus << QString::number(c);
+		pool.setAttribute("cpus", cpus.join(","));
+		pool.setAttribute("priority", s->priority());
+		pool.setAttribute("realtime", s->isRealTime());
+		root.appendChild(pool);
+	}
 	foreach (BaseItem* pi, filterRelaxed<BaseItem>(theScene.items()))
 		pi->saveYourself(root, doc);
 	foreach (MultipleConnectionItem* ci, filter<MultipleConnectionItem>(theScene.items()))
@@ -125,6 +139,16 @@ void GeddeiNite::doLoad(const QString &filename)
 	{	QDomElement elem = n.toElement();
 		if (elem.isNull())
 			continue;
+		else if (elem.tagName() == "pool")
+		{
+			QScheduler* s = QScheduler::pool(elem.attribute("name"));
+			s->setWorkers(elem.attribute("workers", "-1").toInt());
+			QList<int> cpus;
+			foreach (QString c, elem.attribute("cpus").split(",", QString::SkipEmptyParts))
+				cpus << c.toInt();
+			s->setAffinity(cpus);
+			s->setPriority(elem.attribute("priority").toInt(), elem.attribute("realtime").toInt());
+		}
 		else if (elem.tagName() == "processor")
 			ProcessorItem::fromDom(elem, &theScene);
 		else if (elem.tagName() == "domprocessor")
@@ -19,24 +19,28 @@
 #include <Plugin>
 using namespace Geddei;
 
-class Gain: public SubProcessor
+#include "qvectormath.h"
+using namespace QtExtra;
+
+class Gain: public TypedSubProcessor<Gain>
 {
+	friend class TypedSubProcessor<Gain>;
+
 public:
-	Gain() : SubProcessor("Gain", NotMulti, SubInplace) {}
+	Gain() : TypedSubProcessor<Gain>("Gain", SubInplace) {}
 
 private:
 	virtual QString simpleText() const { return ""; }
 
 	virtual PropertiesInfo specifyProperties() const;
 	virtual void initFromProperties() { setupVisual(0, 0); }
-	virtual bool verifyAndSpecifyTypes(Types const& _inTypes, Types& o_outTypes);
-	virtual void processChunks(BufferDatas const& _ins, BufferDatas& _outs, uint _c) const;
+	virtual bool verifyTypes(Types const& _inTypes, Types& o_outTypes);
+	inline void kernels(float const* _in, float* _out, uint _c) const;
 
 	float m_gain;
 	DECLARE_1_PROPERTY(Gain, m_gain);
 
 	bool m_isMark;
-	uint m_arity;
 };
 
 PropertiesInfo Gain::specifyProperties() const
@@ -44,32 +48,24 @@ PropertiesInfo Gain::specifyProperties() const
 	return PropertiesInfo("Gain", 1.f, "The gain.", true, "x", AV("-", "-", -1.f) AVand(0.001f, 1000.f, AllowedValue::Log2));
 }
 
-bool Gain::verifyAndSpecifyTypes(Types const& _inTypes, Types& o_outTypes)
+bool Gain::verifyTypes(Types const& _inTypes, Types& o_outTypes)
 {
 	m_isMark = _inTypes[0].isA<Mark>();
 	o_outTypes = _inTypes;
-	m_arity = _inTypes[0].arity();
 	return true;
 }
 
-void Gain::processChunks(BufferDatas const& _ins, BufferDatas& _outs, uint _c) const
+void Gain::kernels(float const* _in, float* _out, uint _c) const
 {
-	if (m_gain == 1)
-		return;
+	// When in-place, _in is _out and unity gain is nothing to do.
+	// A Mark's chunks carry its reserved elements (the timestamp) after the
+	// arity, which are copied across untouched with the rest.
 	if (m_isMark)
-	{
-		for (uint c = 0; c < _c; c++)
-			for (uint i	= 0; i < m_arity; i++)
-				_outs[0](c, i) = i ? _ins[0](c, i) : (m_gain * _ins[0](c, i));
-//		Mark::setTimestamp(_outs[0], Mark::timestamp(_ins[0]));
-	}
-	else
-		for (uint c = 0; c < _c; c++)
-		{
-			BufferData d = _outs[0].samples(c);
-			for (uint i	= 0; i < m_arity; i++)
-				d[i] *= m_gain;// _ins[0](c, i);
-		}
+		for (uint c = 0; c < _c; c++, _in += inStride(), _out += outStride())
+			for (uint i = 0; i < inStride(); i++)
+				_out[i] = i ? _in[i] : (m_gain * _in[i]);
+	else if (m_gain != 1.f || _in != _out)
+		vscale(_in, m_gain, 0.f, _out, _c * inStride());
 }
 
 EXPORT_CLASS(Gain, 0,2,0, SubProcessor);
@@ -28,27 +28,27 @@ using namespace std;
 #include "transmissiontype.h"
 #include "bufferdata.h"
 #include "subprocessor.h"
+#include "typedsubprocessor.h"
 #include "buffer.h"
 using namespace Geddei;
 
-class Exp : public SubProcessor
+#include "qvectormath.h"
+using namespace QtExtra;
+
+class Exp : public TypedSubProcessor<Exp>
 {
+	friend class TypedSubProcessor<Exp>;
+
 	uint m_arity;
 
-	virtual void processChunk(const BufferDatas &in, BufferDatas &out) const;
-	virtual bool verifyAndSpecifyTypes(const Types &inTypes, Types &outTypes);
+	inline void kernels(float const* _in, float* _out, uint _c) const { vexp(_in, _out, _c * m_arity); }
+	virtual bool verifyTypes(const Types &inTypes, Types &outTypes);
 
 public:
-	Exp() : SubProcessor("Exp") {}
+	Exp() : TypedSubProcessor<Exp>("Exp") {}
 };
 
-void Exp::processChunk(const BufferDatas &ins, BufferDatas &outs) const
-{
-	for (uint i = 0; i < m_arity; i++)
-		outs[0][i] = exp(ins[0][i]);
-}
-
-bool Exp::verifyAndSpecifyTypes(const Types &inTypes, Types &outTypes)
+bool Exp::verifyTypes(const Types &inTypes, Types &outTypes)
 {
 	outTypes[0] = inTypes[0];
 	m_arity = inTypes[0].arity();
@@ -28,27 +28,27 @@ using namespace std;
 #include "transmissiontype.h"
 #include "bufferdata.h"
 #include "subprocessor.h"
+#include "typedsubprocessor.h"
 #include "buffer.h"
 using namespace Geddei;
 
-class Log : public SubProcessor
+#include "qvectormath.h"
+using namespace QtExtra;
+
+class Log : public TypedSubProcessor<Log>
 {
+	friend class TypedSubProcessor<Log>;
+
 	uint m_arity;
 
-	virtual void processChunk(const BufferDatas &in, BufferDatas &out) const;
-	virtual bool verifyAndSpecifyTypes(const Types &inTypes, Types &outTypes);
+	inline void kernels(float const* _in, float* _out, uint _c) const { vlog(_in, _out, _c * m_arity); }
+	virtual bool verifyTypes(const Types &inTypes, Types &outTypes);
 
 public:
-	Log() : SubProcessor("Log") {}
+	Log() : TypedSubProcessor<Log>("Log") {}
 };
 
-void Log::processChunk(const BufferDatas &ins, BufferDatas &outs) const
-{
-	for (uint i = 0; i < m_arity; i++)
-		outs[0][i] = log(ins[0][i]);
-}
-
-bool Log::verifyAndSpecifyTypes(const Types &inTypes, Types &outTypes)
+bool Log::verifyTypes(const Types &inTypes, Types &outTypes)
 {
 	outTypes[0] = inTypes[0];
 	m_arity = inTypes[0].arity();
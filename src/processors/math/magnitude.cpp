@@ -29,19 +29,24 @@ using namespace std;
 #include "coretypes.h"
 using namespace Geddei;
 
-class Magnitude: public SubProcessor
+#include "qvectormath.h"
+using namespace QtExtra;
+
+class Magnitude: public TypedSubProcessor<Magnitude>
 {
+	friend class TypedSubProcessor<Magnitude>;
+
 public:
-	Magnitude(): SubProcessor("Magnitude") {}
+	Magnitude(): TypedSubProcessor<Magnitude>("Magnitude") {}
 
 private:
-	virtual bool verifyAndSpecifyTypes(const Types &in, Types &out);
-	virtual void processChunk(const BufferDatas &in, BufferDatas &out) const;
+	virtual bool verifyTypes(const Types &in, Types &out);
+	inline void kernel(float const* _in, float* _out) const { *_out = sqrt(vdot(_in, _in, m_arity)); }
 
 	uint m_arity;
 };
 
-bool Magnitude::verifyAndSpecifyTypes(Types const& _in, Types& _out)
+bool Magnitude::verifyTypes(Types const& _in, Types& _out)
 {
 	Typed<Spectrum> i(_in[0]);
 	if (!i) return false;
@@ -50,12 +55,4 @@ bool Magnitude::verifyAndSpecifyTypes(Types const& _in, Types& _out)
 	return true;
 }
 
-void Magnitude::processChunk(BufferDatas const& _in, BufferDatas& _out) const
-{
-	_out[0][0] = 0.;
-	for (uint i = 0; i < m_arity; i++)
-		_out[0][0] += _in[0][i] * _in[0][i];
-	_out[0][0] = sqrt(_out[0][0]);
-}
-
 EXPORT_CLASS(Magnitude, 0,1,0, SubProcessor);
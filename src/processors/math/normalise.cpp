@@ -47,7 +47,7 @@ public:
 	Normalise();
 };
 
-Normalise::Normalise(): HeavyProcessor("Normalise", NotMulti, Guarded)
+Normalise::Normalise(): HeavyProcessor("Normalise", NotMulti, Guarded | Cooperative)
 {
 }
 
@@ -43,29 +43,43 @@ using namespace std;
 #include <Plugin>
 using namespace Geddei;
 
-class ISO226: public SubProcessor
+#include "qvectormath.h"
+using namespace QtExtra;
+
+class ISO226: public TypedSubProcessor<ISO226>
 {
+	friend class TypedSubProcessor<ISO226>;
+
 public:
-	ISO226(): SubProcessor("ISO226") {}
+	ISO226(): TypedSubProcessor<ISO226>("ISO226") {}
 
 private:
 	virtual QString simpleText() const { return "ISO"; }
 	virtual QColor specifyOutlineColour() const { return QColor::fromHsv(30, 160, 128); }
-	virtual bool verifyAndSpecifyTypes(Types const& _inTypes, Types& _outTypes);
-	virtual void processChunk(BufferDatas const& _ins, BufferDatas& _outs) const;
+	virtual bool verifyTypes(Types const& _inTypes, Types& _outTypes);
+	inline void kernel(float const* _in, float* _out) const;
 
-	QVector<float> m_Tf;
-	QVector<float> m_Lu;
-	QVector<float> m_af;
+	// Per bin, with Tf, Lu and af from the standard:
+	// m_gain = af ln(10) / 10, m_offset = Lu - 94, m_threshold = -(0.4 10^((Tf + Lu) / 10 - 9))^af
+	QVector<float> m_gain;
+	QVector<float> m_offset;
+	QVector<float> m_threshold;
 };
 
-void ISO226::processChunk(BufferDatas const& _ins, BufferDatas& _outs) const
+void ISO226::kernel(float const* _in, float* _out) const
 {
-	for (int i = 0; i < m_af.size(); i++)
-		_outs[0][i] = log10((pow(10.f, (_ins[0][i] - 94.f + m_Lu.at(i)) / 10.f * m_af.at(i)) - pow(0.4f * pow(10.f, (m_Tf.at(i) + m_Lu.at(i)) / 10.f - 9.f), m_af.at(i))) / 4.47e-3f + 1.15f) / 0.025f;
+	// log10((10^((in + Lu - 94) / 10 af) - (0.4 10^((Tf + Lu) / 10 - 9))^af) / 4.47e-3 + 1.15) / 0.025
+	uint n = m_gain.size();
+	vadd(_in, m_offset.constData(), _out, n);
+	vmul(_out, m_gain.constData(), _out, n);
+	vexp(_out, _out, n);
+	vadd(_out, m_threshold.constData(), _out, n);
+	vscale(_out, 1.f / 4.47e-3f, 1.15f, _out, n);
+	vlog(_out, _out, n);
+	vscale(_out, 1.f / (2.30258509f * 0.025f), 0.f, _out, n);
 }
 
-bool ISO226::verifyAndSpecifyTypes(Types const& _inTypes, Types& _outTypes)
+bool ISO226::verifyTypes(Types const& _inTypes, Types& _outTypes)
 {
 	Typed<Spectrum> in(_inTypes[0]);
 	if (!in) return false;
@@ -75,15 +89,18 @@ bool ISO226::verifyAndSpecifyTypes(Types const& _inTypes, Types& _outTypes)
 	static const float s_Lu[] = { -31.6, -27.2, -23.0, -19.1, -15.9, -13.0, -10.3, -8.1, -6.2, -4.5, -3.1, -2.0, -1.1, -0.4, 0.0, 0.3, 0.5, 0.0, -2.7, -4.1, -1.0, 1.7, 2.5, 1.2, -2.1, -7.1, -11.2, -10.7, -3.1 };
 	static const float s_Tf[] = { 78.5, 68.7, 59.5, 51.1, 44.0, 37.5, 31.5, 26.5, 22.1, 17.9, 14.4, 11.4, 8.6, 6.2, 4.4, 3.0, 2.2, 2.4, 3.5, 1.7, -1.3, -4.2, -6.0, -5.4, -1.5, 6.0, 12.6, 13.9, 12.3 };
 
-	m_Tf.resize(in->bins());
-	m_Lu.resize(in->bins());
-	m_af.resize(in->bins());
-	for (int i = 0; i < m_Tf.size(); i++)
+	m_gain.resize(in->bins());
+	m_offset.resize(in->bins());
+	m_threshold.resize(in->bins());
+	for (int i = 0; i < m_gain.size(); i++)
 	{
 		float b = interpolateValue(s_fr, 29, in->bandFrequency(i));
-		m_Tf[i] = cubicInterpolateIndex(s_Tf, 29, b);
-		m_Lu[i] = cubicInterpolateIndex(s_Lu, 29, b);
-		m_af[i] = cubicInterpolateIndex(s_af, 29, b);
+		float Tf = cubicInterpolateIndex(s_Tf, 29, b);
+		float Lu = cubicInterpolateIndex(s_Lu, 29, b);
+		float af = cubicInterpolateIndex(s_af, 29, b);
+		m_gain[i] = af * 2.30258509f / 10.f;
+		m_offset[i] = Lu - 94.f;
+		m_threshold[i] = -pow(0.4f * pow(10.f, (Tf + Lu) / 10.f - 9.f), af);
 	}
 
 	// TODO: Set range to what it really is given band range and in's range.
@@ -20,33 +20,45 @@
 #include <Plugin>
 using namespace Geddei;
 
-class DeciBel : public SubProcessor
+#include "qvectormath.h"
+using namespace QtExtra;
+
+class DeciBel : public TypedSubProcessor<DeciBel>
 {
+	friend class TypedSubProcessor<DeciBel>;
+
 public:
-	DeciBel() : SubProcessor("DeciBel") {}
+	DeciBel() : TypedSubProcessor<DeciBel>("DeciBel") {}
 
 private:
 	virtual QColor specifyOutlineColour() const { return QColor::fromHsv(30, 160, 160); }
 	virtual QString simpleText() const { return "dB"; }
 	virtual PropertiesInfo specifyProperties() const;
-	virtual bool verifyAndSpecifyTypes(Types const& _inTypes, Types& _outTypes);
-	virtual void processChunk(BufferDatas const& _in, BufferDatas& _out) const;
+	virtual bool verifyTypes(Types const& _inTypes, Types& _outTypes);
+	inline void kernel(float const* _in, float* _out) const
+	{
+		// 10 log10((in - min) * scale) + spl, floored at 0; 10 / ln(10) is 4.3429...
+		vscale(_in, m_scale, -m_min * m_scale, _out, m_bins);
+		vlog(_out, _out, m_bins);
+		vscale(_out, 4.34294482f, m_spl, _out, m_bins);
+		vmax(_out, 0.f, _out, m_bins);
+	}
 
 	float m_spl;
 	DECLARE_1_PROPERTY(DeciBel, m_spl);
 
 	uint m_bins;
 	float m_min;
-	float m_delta;
+	float m_scale;
 };
 
-bool DeciBel::verifyAndSpecifyTypes(Types const& _inTypes, Types& _outTypes)
+bool DeciBel::verifyTypes(Types const& _inTypes, Types& _outTypes)
 {
 	Typed<Spectrum> in = _inTypes[0];
 	if (!in) return false;
 
 	m_min = in->min();
-	m_delta = in->max() - m_min;
+	m_scale = 1.f / (in->max() - m_min);
 	m_bins = in->bins();
 	in->setRange(0, 60);
 	_outTypes[0] = in;
@@ -54,12 +66,6 @@ bool DeciBel::verifyAndSpecifyTypes(Types const& _inTypes, Types& _outTypes)
 	return true;
 }
 
-void DeciBel::processChunk(BufferDatas const& _ins, BufferDatas& _outs) const
-{
-	for (uint i = 0; i < m_bins; i++)
-		_outs[0](0, i) = max<float>(0.f, 10.f * log10((_ins[0](0, i) - m_min) / m_delta) + m_spl);
-}
-
 PropertiesInfo DeciBel::specifyProperties() const
 {
 	return PropertiesInfo("Spl", 90.f, "The SPL calibration offset. Specifies the SPL that the input corresponds to at maximum power.", true, ":", AV(30.f, 120.f));
@@ -35,6 +35,12 @@ private:
 	virtual void initFromProperties();
 	virtual bool verifyAndSpecifyTypes(Types const& _inTypes, Types& _outTypes);
 	virtual void processChunk(BufferDatas const& _in, BufferDatas& _out) const;
+	inline void count(float* _hist, float const* _sample, float _weight) const
+	{
+		for (uint c = 0; c < m_columns; ++c)
+			for (uint r = 0; float(r + 1) / float(m_rows) < _sample[c] * _weight; ++r)
+				_hist[r + c * m_rows] += 1.f;
+	}
 
 	uint m_rows;
 	float m_period;
@@ -78,22 +84,27 @@ bool Histogram::verifyAndSpecifyTypes(Types const& inTypes, Types& outTypes)
 
 void Histogram::processChunk(BufferDatas const& in, BufferDatas& out) const
 {
-	float mout = 0.f;
-	for (uint i = 0; i < m_columns * m_rows; ++i)
-		out[0][i] = 0.f;
-	for (uint s = 0; s < m_count; ++s)
-	{	for (uint c = 0; c < m_columns; ++c)
-		{	for (uint r = 0; float(r + 1) / float(m_rows) < in[0](s, c) * m_window[s]; ++r)
-			{
-				out[0][r + c * m_rows] += 1.f;
-				mout = max(mout, out[0][r + c * m_rows]);
-			}
+	QVector<float> hist(m_columns * m_rows, 0.f);
+	QVector<float> lone(m_columns);
+	BufferData::ConstSpan sp[2];
+	uint straddle;
+	uint s = 0;
+	for (uint p = 0, n = in[0].sampleSpans(sp, &straddle); p < n; p++)
+	{	if (p && straddle != Undefined)
+		{	in[0].sample(straddle).copyTo(lone);
+			count(hist.data(), lone.constData(), m_window[s++]);
 		}
+		for (float const* d = sp[p].data; d < sp[p].data + sp[p].elements; d += m_columns)
+			count(hist.data(), d, m_window[s++]);
 	}
+
+	float mout = 0.f;
+	for (int i = 0; i < hist.size(); ++i)
+		mout = max(mout, hist[i]);
 	if (mout > 0.f)
-		for (uint c = 0; c < m_columns; ++c)
-			for (uint r = 0; r < m_rows; ++r)
-				out[0][r + c * m_rows] /= mout;
+		for (int i = 0; i < hist.size(); ++i)
+			hist[i] /= mout;
+	out[0].copyFrom(hist);
 }
 
 EXPORT_CLASS(Histogram, 1,0,1, SubProcessor);
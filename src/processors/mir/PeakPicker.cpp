@@ -22,7 +22,7 @@ using namespace Geddei;
 class PeakPicker : public CoProcessor
 {
 public:
-	PeakPicker(): CoProcessor("PeakPicker") {}
+	PeakPicker(): CoProcessor("PeakPicker", NotMulti, Batched) {}
 
 private:
 	virtual QString simpleText() const { return QChar(0x21FB); }
@@ -33,7 +33,8 @@ private:
 	virtual void specifyInputSpace(QVector<uint>& _s) { _s.fill(1); }
 	virtual void requireInputSpace(QVector<uint>& _s) { _s.fill(1); }
 	virtual void specifyOutputSpace(QVector<uint>& _s) { _s.fill(m_type->bins() / 2); }
-	virtual int process();
+	virtual int process() { return processCycles(1); }
+	virtual int processCycles(uint _cycles);
 
 	int m_peaks;
 	DECLARE_1_PROPERTY(PeakPicker, m_peaks);
@@ -56,34 +57,37 @@ bool PeakPicker::verifyAndSpecifyTypes(Types const& _inTypes, Types& _outTypes)
 	return true;
 }
 
-int PeakPicker::process()
+int PeakPicker::processCycles(uint _cycles)
 {
-	const BufferData in = input(0).readSample();
-
-	bool gu = false;
+	const BufferData ins = input(0).readSamples(_cycles);
 	int b = m_type->bins() - 1;
-	for (int i = 1; i < b; i++)
+	for (uint s = 0; s < _cycles; s++)
 	{
-		float const& a = in[i - 1];
-		float const& b = in[i];
-		float const& c = in[i + 1];
-		if ((a < b && b <= c) || (a <= b && b < c))
-			gu = true;
-		else if ((a < b && b > c) || gu)
+		const BufferData in = ins.sample(s);
+		bool gu = false;
+		for (int i = 1; i < b; i++)
 		{
-			BufferData out = output(0).makeScratchSample();
-			float p = (a - c) / 2 / (a - 2 * b + c);
-			out[SpectralPeak::Frequency] = m_type->bandFrequency(i + p);
-			out[SpectralPeak::Value] = b - (a - c) * p / 4.f;
-			out[SpectralPeak::Spread] = 0.f;
-			out[SpectralPeak::HalfSpread] = 0.f;
-			output(0) << out;
-			gu = false;
+			float const& a = in[i - 1];
+			float const& b = in[i];
+			float const& c = in[i + 1];
+			if ((a < b && b <= c) || (a <= b && b < c))
+				gu = true;
+			else if ((a < b && b > c) || gu)
+			{
+				BufferData out = output(0).makeScratchSample();
+				float p = (a - c) / 2 / (a - 2 * b + c);
+				out[SpectralPeak::Frequency] = m_type->bandFrequency(i + p);
+				out[SpectralPeak::Value] = b - (a - c) * p / 4.f;
+				out[SpectralPeak::Spread] = 0.f;
+				out[SpectralPeak::HalfSpread] = 0.f;
+				output(0) << out;
+				gu = false;
+			}
 		}
+		BufferData out = output(0).makeScratchSample();
+		Mark::setEndOfTime(out);
+		output(0) << out;
 	}
-	BufferData out = output(0).makeScratchSample();
-	Mark::setEndOfTime(out);
-	output(0) << out;
 	return DidWork;
 }
 
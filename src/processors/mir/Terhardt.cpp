@@ -23,15 +23,23 @@ using namespace std;
 #include <Plugin>
 using namespace Geddei;
 
+#include "qvectormath.h"
+using namespace QtExtra;
+
 // NOTE this class is deprecated. Use ISO226 instead.
-class Terhardt : public SubProcessor
+class Terhardt : public TypedSubProcessor<Terhardt>
 {
+	friend class TypedSubProcessor<Terhardt>;
+
 public:
-	Terhardt() : SubProcessor("Terhardt") {}
+	Terhardt() : TypedSubProcessor<Terhardt>("Terhardt") {}
 
 private:
-	virtual void processChunk(const BufferDatas &in, BufferDatas &out) const;
-	virtual bool verifyAndSpecifyTypes(const Types &inTypes, Types &outTypes);
+	inline void kernel(float const* _in, float* _out) const
+	{
+		vmul(_in, theMult.constData(), _out, theMult.size());
+	}
+	virtual bool verifyTypes(const Types &inTypes, Types &outTypes);
 	virtual QString simpleText() const { return "T"; }
 
 	uint m_bins;
@@ -39,13 +47,7 @@ private:
 	QVector<float> theMult;
 };
 
-void Terhardt::processChunk(const BufferDatas &ins, BufferDatas &outs) const
-{
-	for (int i = 0; i < theMult.size(); i++)
-		outs[0][i] = ins[0][i] * theMult[i];
-}
-
-bool Terhardt::verifyAndSpecifyTypes(Types const& _inTypes, Types& _outTypes)
+bool Terhardt::verifyTypes(Types const& _inTypes, Types& _outTypes)
 {
 	Typed<Spectrum> in(_inTypes[0]);
 	if (!in) return false;
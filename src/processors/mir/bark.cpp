@@ -19,34 +19,41 @@
 #include <Plugin>
 using namespace Geddei;
 
-class Bark: public SubProcessor
+class Bark: public TypedSubProcessor<Bark>
 {
+	friend class TypedSubProcessor<Bark>;
+
 public:
-	Bark() : SubProcessor("Bark") {}
+	Bark() : TypedSubProcessor<Bark>("Bark") {}
 
 private:
-	virtual void processChunk(const BufferDatas &in, BufferDatas &out) const;
-	virtual bool verifyAndSpecifyTypes(const Types &inTypes, Types &outTypes);
+	inline void kernel(float const* _in, float* _out) const;
+	virtual bool verifyTypes(const Types &inTypes, Types &outTypes);
 	virtual QString simpleText() const { return "B"; }
 
 	QVector<int> m_bins;
 	QVector<int> m_counts;
+	QVector<float> m_scales;	///< Reciprocal of each of m_counts.
 };
 
 static const uint s_barkBands[26] = { 100, 200, 300, 400, 510, 630, 770, 920, 1080, 1270, 1480, 1720, 2000, 2320, 2700, 3150, 3700, 4400, 5300, 6400, 7700, 9500, 12000, 15500, 20500, 27000 };
 static const uint s_barkCentres[26] = { 50, 150, 250, 350, 450, 570, 700, 840, 1000, 1170, 1370, 1600, 1850, 2150, 2500, 2900, 3400, 4000, 4800, 5800, 7000, 8500, 10500, 13500, 17500, 22500 };
 
-void Bark::processChunk(BufferDatas const& _ins, BufferDatas& _outs) const
+void Bark::kernel(float const* _in, float* _out) const
 {
-	for (int i = 0; i < m_counts.size(); i++)
-		_outs[0][i] = 0.f;
-	for (int i = 0; i < m_bins.size(); i++)
-		_outs[0][m_bins[i]] += _ins[0][i];
-	for (int i = 0; i < m_counts.size(); i++)
-		_outs[0][i] /= m_counts[i];
+	int const* bins = m_bins.constData();
+	float const* scales = m_scales.constData();
+	uint bands = m_scales.size();
+	uint binCount = m_bins.size();
+	for (uint i = 0; i < bands; i++)
+		_out[i] = 0.f;
+	for (uint i = 0; i < binCount; i++)
+		_out[bins[i]] += _in[i];
+	for (uint i = 0; i < bands; i++)
+		_out[i] *= scales[i];
 }
 
-bool Bark::verifyAndSpecifyTypes(Types const& _inTypes, Types& _outTypes)
+bool Bark::verifyTypes(Types const& _inTypes, Types& _outTypes)
 {
 	Typed<Spectrum> in = _inTypes[0];
 	if (!in) return false;
@@ -68,6 +75,9 @@ bool Bark::verifyAndSpecifyTypes(Types const& _inTypes, Types& _outTypes)
 	m_counts = QVector<int>(maxBin - minBin + 1, 0);
 	for (int i = 0; i < m_bins.size(); i++)
 		m_counts[m_bins[i] -= minBin]++;
+	m_scales.resize(m_counts.size());
+	for (int i = 0; i < m_counts.size(); i++)
+		m_scales[i] = 1.f / m_counts[i];
 
 	QVector<float> bands(maxBin - minBin + 1);
 	for (int i = 0; i < bands.count(); i++)
@@ -42,6 +42,7 @@ class Checkerboard : public CoProcessor
 
 	virtual bool processorStarted();
 	virtual int process();
+	virtual int processCycles(uint _cycles);
 	virtual void processorStopped();
 	virtual bool verifyAndSpecifyTypes(const Types &inTypes, Types &outTypes);
 	virtual PropertiesInfo specifyProperties() const;
@@ -52,7 +53,7 @@ public:
 	Checkerboard();
 };
 
-Checkerboard::Checkerboard(): CoProcessor("Checkerboard")
+Checkerboard::Checkerboard(): CoProcessor("Checkerboard", NotMulti, Batched)
 {
 	theBoard = 0;
 }
@@ -76,12 +77,21 @@ bool Checkerboard::processorStarted()
 
 int Checkerboard::process()
 {
-	const BufferData in = input(0).readSample();
-	BufferData out = output(0).makeScratchSamples(1);
-	out[0] = 0;
-	for (uint i = 0; i < theSize * theSize; i++)
-		out[0] += theBoard[i] * in[i];
-	out[0] /= m_max;
+	return processCycles(1);
+}
+
+int Checkerboard::processCycles(uint _cycles)
+{
+	const BufferData in = input(0).readSamples(_cycles);
+	BufferData out = output(0).makeScratchSamples(_cycles);
+	uint n = theSize * theSize;
+	for (uint s = 0; s < _cycles; s++)
+	{
+		float o = 0;
+		for (uint i = 0; i < n; i++)
+			o += theBoard[i] * in[s * n + i];
+		out[s] = o / m_max;
+	}
 	output(0) << out;
 	return DidWork;
 }
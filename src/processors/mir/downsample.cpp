@@ -16,6 +16,9 @@
  * along with Exscalibar.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cstring>
+using namespace std;
+
 #include "qfactoryexporter.h"
 
 #include "contiguous.h"
@@ -32,6 +35,7 @@ class DownSample : public SubProcessor
 	uint theConsolidate;
 
 	virtual QString simpleText() const { return QChar(0x290B); }
+	inline void consolidate(float* _acc, float const* _sample, bool _first) const;
 	virtual void processChunks(const BufferDatas &in, BufferDatas &out, uint chunks) const;
 	virtual bool verifyAndSpecifyTypes(const Types &inTypes, Types &outTypes);
 	virtual PropertiesInfo specifyProperties() const;
@@ -51,31 +55,47 @@ void DownSample::processChunks(const BufferDatas &ins, BufferDatas &outs, uint c
 			for (uint i = 0; i < chunks; i++)
 				outs[0][i] = ins[0][i * theStep];
 	else
-	{	for (uint j = 0; j < chunks; j++)
-			for (uint i = 0; i < theArity; i++)
-				outs[0](j, i) = 0;
+	{	QVector<float> acc(theArity);
+		QVector<float> lone(theArity);
 		for (uint j = 0; j < chunks; j++)
-		{	for (uint i = 0; i < theCount; i++)
-			{	BufferData d = ins[0].sample(i + j*theStep);
-				const float *inSample = d.readPointer();
-				if (theConsolidate == Mean)
-					for (uint k = 0; k < theArity; k++)
-						outs[0](j, k) += inSample[k];
-				else if (theConsolidate == Max)
-					for (uint k = 0; k < theArity; k++)
-						if (outs[0](j, k) < inSample[k] || !k) outs[0](j, k) = inSample[k];
-				else if (theConsolidate == Min)
-					for (uint k = 0; k < theArity; k++)
-						if (outs[0](j, k) > inSample[k] || !k) outs[0](j, k) = inSample[k];
+		{	BufferData const window = ins[0].samples(j * theStep, theCount);
+			BufferData::ConstSpan s[2];
+			uint straddle;
+			bool first = true;
+			for (uint p = 0, n = window.sampleSpans(s, &straddle); p < n; p++)
+			{	if (p && straddle != Undefined)
+				{	window.sample(straddle).copyTo(lone);
+					consolidate(acc.data(), lone.constData(), first);
+					first = false;
+				}
+				for (float const* d = s[p].data; d < s[p].data + s[p].elements; d += theArity)
+				{	consolidate(acc.data(), d, first);
+					first = false;
+				}
 			}
+			if (theConsolidate == Mean)
+				for (uint k = 0; k < theArity; k++)
+					acc[k] /= theCount;
+			outs[0].sample(j).copyFrom(acc);
 		}
-		if (theConsolidate == Mean)
-			for (uint j = 0; j < chunks; j++)
-				for (uint i = 0; i < theArity; i++)
-					outs[0](j, i) /= theCount;
 	}
 }
 
+void DownSample::consolidate(float* _acc, float const* _sample, bool _first) const
+{
+	if (_first)
+		memcpy(_acc, _sample, theArity * sizeof(float));
+	else if (theConsolidate == Mean)
+		for (uint k = 0; k < theArity; k++)
+			_acc[k] += _sample[k];
+	else if (theConsolidate == Max)
+		for (uint k = 0; k < theArity; k++)
+			_acc[k] = max(_acc[k], _sample[k]);
+	else if (theConsolidate == Min)
+		for (uint k = 0; k < theArity; k++)
+			_acc[k] = min(_acc[k], _sample[k]);
+}
+
 bool DownSample::verifyAndSpecifyTypes(const Types &inTypes, Types &outTypes)
 {
 	if (!inTypes[0].isA<Contiguous>())
@@ -20,28 +20,33 @@
 
 #include "bufferdata.h"
 #include "subprocessor.h"
+#include "typedsubprocessor.h"
 #include "buffer.h"
 using namespace Geddei;
 
 #include "value.h"
 using namespace Geddei;
 
-class Rectify: public SubProcessor
+#include "qvectormath.h"
+using namespace QtExtra;
+
+class Rectify: public TypedSubProcessor<Rectify>
 {
+	friend class TypedSubProcessor<Rectify>;
+
 public:
 	enum { HalfWaveRectification = 0, FullWaveRectification = 1, SquaredRectification = 2 };
 
-	Rectify(): SubProcessor("Rectify") {}
+	Rectify(): TypedSubProcessor<Rectify>("Rectify") {}
 
 private:
 	virtual QString simpleText() const { return QChar(0x236D); }
 	virtual PropertiesInfo specifyProperties() const;
 	virtual void updateFromProperties(const Properties &properties);
-	virtual bool verifyAndSpecifyTypes(Types const& _inTypes, Types& _outTypes);
-	virtual void processChunks(BufferDatas const& _ins, BufferDatas& _outs, uint _c) const;
+	virtual bool verifyTypes(Types const& _inTypes, Types& _outTypes);
+	inline void kernels(float const* _in, float* _out, uint _c) const;
 
 	int m_type;
-	uint m_arity;
 };
 
 PropertiesInfo Rectify::specifyProperties() const
@@ -54,23 +59,22 @@ void Rectify::updateFromProperties(Properties const& _p)
 	m_type = _p.get("Type").toInt();
 }
 
-bool Rectify::verifyAndSpecifyTypes(Types const& _inTypes, Types& _outTypes)
+bool Rectify::verifyTypes(Types const& _inTypes, Types& _outTypes)
 {
 	_outTypes = _inTypes[0];
-	m_arity = _inTypes[0]->arity();
 	return true;
 }
 
-void Rectify::processChunks(BufferDatas const& _in, BufferDatas& _out, uint _c) const
+void Rectify::kernels(float const* _in, float* _out, uint _c) const
 {
-	for (uint c = 0; c < _c; c++)
-		for (uint i = 0; i < m_arity; i++)
-			if (m_type == HalfWaveRectification)
-				_out[0](c, i) = _in[0](c, i) < 0.f ? 0.f : _in[0](c, i);
-			else if (m_type == FullWaveRectification)
-				_out[0](c, i) = _in[0](c, i) < 0.f ? -_in[0](c, i) : _in[0](c, i);
-			else if (m_type == SquaredRectification)
-				_out[0](c, i) = _in[0](c, i) * _in[0](c, i);
+	// Input and output are the same shape, so it's one run over the lot.
+	uint n = _c * inStride();
+	if (m_type == HalfWaveRectification)
+		vmax(_in, 0.f, _out, n);
+	else if (m_type == FullWaveRectification)
+		vabs(_in, _out, n);
+	else if (m_type == SquaredRectification)
+		vmul(_in, _in, _out, n);
 }
 
 EXPORT_CLASS(Rectify, 0,3,0, SubProcessor);
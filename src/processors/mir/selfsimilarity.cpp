@@ -113,7 +113,7 @@ PropertiesInfo Distance::specifyProperties() const
 
 EXPORT_CLASS(Distance, 0,2,0, SubProcessor);
 
-class SelfSimilarity : public SubProcessor
+class SelfSimilarity : public StatefulSubProcessor
 {
 	uint theSize;
 	uint theBandWidth;
@@ -121,6 +121,11 @@ class SelfSimilarity : public SubProcessor
 	float(*theDistance)(const float *, const float *, uint);
 
 	virtual void processOwnChunks(const BufferDatas &in, BufferDatas &out, uint chunks);
+	// The matrix is only a cache of what's in the input window, so forgetting it is enough.
+	virtual uint warmUpChunks() const { return 0; }
+	virtual void resetState() { theMatrix.clear(); }
+	virtual QVector<float> exportState() const { return theMatrix; }
+	virtual void importState(QVector<float> const& _s) { theMatrix = _s; }
 	virtual void initFromProperties(const Properties &properties);
 	virtual void updateFromProperties(const Properties &properties);
 	virtual bool verifyAndSpecifyTypes(const Types &inTypes, Types &outTypes);
@@ -129,7 +134,7 @@ class SelfSimilarity : public SubProcessor
 	virtual QColor specifyOutlineColour() const { return QColor::fromHsv(40, 96, 160); }
 
 public:
-	SelfSimilarity() : SubProcessor("SelfSimilarity") {}
+	SelfSimilarity() : StatefulSubProcessor("SelfSimilarity") {}
 };
 
 void SelfSimilarity::processOwnChunks(const BufferDatas &in, BufferDatas &out, uint chunks)
@@ -57,7 +57,7 @@ protected:
 	virtual void specifyInputSpace(QVector<uint> &samples) { samples[0] = theSize; }
 	virtual void specifyOutputSpace(QVector<uint> &samples) { samples[0] = 1; }
 public:
-	Similarity(): HeavyProcessor("Similarity") {}
+	Similarity(): HeavyProcessor("Similarity", NotMulti, Cooperative) {}
 };
 
 void Similarity::processor()
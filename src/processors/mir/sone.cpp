@@ -22,31 +22,48 @@ using namespace std;
 #include <Plugin>
 using namespace Geddei;
 
-class PhonToSone: public SubProcessor
+#include "qvectormath.h"
+using namespace QtExtra;
+
+class PhonToSone: public TypedSubProcessor<PhonToSone>
 {
+	friend class TypedSubProcessor<PhonToSone>;
+
 public:
-	PhonToSone(): SubProcessor("PhonToSone") {}
+	PhonToSone(): TypedSubProcessor<PhonToSone>("PhonToSone") {}
 
 private:
 	virtual QString simpleText() const { return "S"; }
 	virtual QColor specifyOutlineColour() const { return QColor::fromHsv(30, 160, 128); }
-	virtual bool verifyAndSpecifyTypes(Types const& _inTypes, Types& _outTypes);
-	virtual void processChunk(BufferDatas const& _ins, BufferDatas& _outs) const;
+	virtual bool verifyTypes(Types const& _inTypes, Types& _outTypes);
+	inline void kernels(float const* _in, float* _out, uint _c) const;
 
 	uint m_bins;
 };
 
-void PhonToSone::processChunk(BufferDatas const& _ins, BufferDatas& _outs) const
+void PhonToSone::kernels(float const* _in, float* _out, uint _c) const
 {
-	for (uint i = 0; i < m_bins; i++)
+	// Both curves are worked out for everything, a block at a time, then the
+	// right one picked: above 40 phon 2^((p - 40) / 10), i.e.
+	// exp(p ln(2) / 10 - 4 ln(2)), otherwise (p / 40)^2.642. Both are 1 at 40,
+	// so (p / 40)^2.642 > 1 picks the first.
+	float low[256];
+	uint n = _c * m_bins;
+	for (uint b = 0; b < n; b += 256, _in += 256, _out += 256)
 	{
-		float dBSPL = _ins[0][i];
-		if (dBSPL < 0.f) dBSPL = 0.f;
-		_outs[0][i] = dBSPL > 40.f ? pow(2.f, (dBSPL - 40.f) / 10.f) : pow(dBSPL / 40.f, 2.642f);
+		uint m = min<uint>(256, n - b);
+		vmax(_in, 0.f, _out, m);
+		vscale(_out, 1.f / 40.f, 0.f, low, m);
+		vpow(low, 2.642f, low, m);
+		vscale(_out, 0.0693147181f, -2.77258872f, _out, m);
+		vexp(_out, _out, m);
+		for (uint i = 0; i < m; i++)
+			if (low[i] <= 1.f)
+				_out[i] = low[i];
 	}
 }
 
-bool PhonToSone::verifyAndSpecifyTypes(Types const& _inTypes, Types& _outTypes)
+bool PhonToSone::verifyTypes(Types const& _inTypes, Types& _outTypes)
 {
 	Typed<Spectrum> in = _inTypes[0];
 	if (!in) return false;
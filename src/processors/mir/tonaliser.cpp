@@ -39,6 +39,7 @@ private:
 	virtual void updateFromProperties(Properties const&properties);
 	virtual bool verifyAndSpecifyTypes(Types const& _inTypes, Types& _outTypes);
 	virtual void processChunks(BufferDatas const& _ins, BufferDatas& _outs, uint _c) const;
+	inline void tonalise(float* _out, float const* _in) const;
 
 	QVector<int> m_bands;
 	QVector<int> m_bc;
@@ -87,17 +88,38 @@ bool Tonaliser::verifyAndSpecifyTypes(Types const& _inTypes, Types& _outTypes)
 	return true;
 }
 
+void Tonaliser::tonalise(float* _out, float const* _in) const
+{
+	int const* bands = m_bands.constData();
+	for (int ob = 0; ob < m_bc.count(); ob++)
+		_out[ob] = 0.f;
+	for (int b = 0; b < m_bands.count(); b++)
+		if (bands[b] != -1)
+			_out[bands[b]] += _in[b];
+	for (int ob = 0; ob < m_bc.count(); ob++)
+		_out[ob] /= m_bc[ob];
+}
+
 void Tonaliser::processChunks(BufferDatas const& _in, BufferDatas& _out, uint _ch) const
 {
-	for (uint i = 0; i < _ch; i++)
+	QVector<float> acc(m_bc.count());
+	QVector<float> lone(m_bands.count());
+	BufferData::ConstSpan s[2];
+	uint straddle;
+	uint i = 0;
+	for (uint p = 0, n = _in[0].sampleSpans(s, &straddle); p < n && i < _ch; p++)
 	{
-		for (int ob = 0; ob < m_bc.count(); ob++)
-			_out[0](i, ob) = 0.f;
-		for (int b = 0; b < m_bands.count(); b++)
-			if (m_bands[b] != -1)
-				_out[0](i, m_bands[b]) += _in[0](i, b);
-		for (int ob = 0; ob < m_bc.count(); ob++)
-			_out[0](i, ob) /= m_bc[ob];
+		if (p && straddle != Undefined)
+		{
+			_in[0].sample(straddle).copyTo(lone);
+			tonalise(acc.data(), lone.constData());
+			_out[0].sample(i++).copyFrom(acc);
+		}
+		for (float const* d = s[p].data; d < s[p].data + s[p].elements && i < _ch; d += m_bands.count())
+		{
+			tonalise(acc.data(), d);
+			_out[0].sample(i++).copyFrom(acc);
+		}
 	}
 }
 
@@ -55,7 +55,14 @@ private:
 		}
 	}
 
+	inline void accumulate(float* _acc, float const* _sample, float _weight) const
+	{
+		for (uint s = 0; s < m_arity; s++)
+			_acc[s] += _sample[s] * _weight;
+	}
+
 	virtual void processOwnChunks(const BufferDatas &in, BufferDatas &out, uint chunks);
+	virtual uint warmUpChunks() const { return 0; }
 	virtual void initFromProperties(const Properties &properties);
 	virtual void updateFromProperties(const Properties &properties);
 	virtual bool verifyAndSpecifyTypes(const Types &inTypes, Types &outTypes);
@@ -71,14 +78,26 @@ private:
 
 void Convolver::processOwnChunks(BufferDatas const& _in, BufferDatas& _out, uint _ch)
 {
+	QVector<float> acc(m_arity);
+	QVector<float> lone(m_arity);
 	for (uint i = 0; i < _ch; i++)
 	{
-		for (uint s = 0; s < m_arity; s++)
+		acc.fill(0.f);
+		float const* w = m_convolution.constData();
+		BufferData const window = _in[0].samples(i, m_convolution.size());
+		BufferData::ConstSpan s[2];
+		uint straddle;
+		for (uint p = 0, n = window.sampleSpans(s, &straddle); p < n; p++)
 		{
-			_out[0](i, s) = 0.f;
-			for (int c = 0; c < m_convolution.size(); c++)
-				_out[0](i, s) += _in[0](i + c, s) * m_convolution[c];
+			if (p && straddle != Undefined)
+			{
+				window.sample(straddle).copyTo(lone);
+				accumulate(acc.data(), lone.constData(), *w++);
+			}
+			for (float const* d = s[p].data; d < s[p].data + s[p].elements; d += m_arity)
+				accumulate(acc.data(), d, *w++);
 		}
+		_out[0].sample(i).copyFrom(acc);
 	}
 }
 
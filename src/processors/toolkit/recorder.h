@@ -75,5 +75,5 @@ public:
 	/**
 	 * Basic constructor.
 	 */
-	Recorder(): HeavyProcessor("Recorder", NotMulti, Guarded) {}
+	Recorder(): HeavyProcessor("Recorder", NotMulti, Guarded | Cooperative) {}
 };
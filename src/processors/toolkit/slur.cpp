@@ -44,6 +44,10 @@ private:
 	}
 
 	virtual void processOwnChunks(const BufferDatas &in, BufferDatas &out, uint chunks);
+	virtual uint warmUpChunks() const;
+	virtual void resetState() { m_current.fill(0.f); }
+	virtual QVector<float> exportState() const { return m_current; }
+	virtual void importState(QVector<float> const& _s) { m_current = _s; }
 	virtual void initFromProperties(const Properties &properties);
 	virtual void updateFromProperties(const Properties &properties);
 	virtual bool verifyAndSpecifyTypes(const Types &inTypes, Types &outTypes);
@@ -63,6 +67,16 @@ void Slur::processOwnChunks(BufferDatas const& _in, BufferDatas& _out, uint _ch)
 			_out[0](i, s) = m_current[s] = lerp(m_current[s], maxAround(_in[0], i, s, m_current.size()), m_quantity);
 }
 
+uint Slur::warmUpChunks() const
+{
+	// Whatever we started with counts for (1 - Q)^n after n chunks; call it
+	// gone once below 16-bit resolution.
+	if (m_quantity <= 0.f || m_quantity >= 1.f)
+		return 0;
+	double n = ceil(log(1.0 / 65536.0) / log(1.0 - m_quantity));
+	return n < 65536.0 ? uint(n) : Undefined;
+}
+
 bool Slur::verifyAndSpecifyTypes(const Types &inTypes, Types &outTypes)
 {
 	outTypes = inTypes;
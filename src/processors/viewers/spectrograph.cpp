@@ -38,7 +38,8 @@ class Spectrograph: public CoProcessor
 	uint m_bins;
 
 	virtual bool processorStarted();
-	virtual int process();
+	virtual int process() { return processCycles(1); }
+	virtual int processCycles(uint _cycles);
 	virtual void processorStopped();
 	virtual bool verifyAndSpecifyTypes(const Types &inTypes, Types &outTypes);
 	virtual PropertiesInfo specifyProperties() const;
@@ -48,17 +49,20 @@ class Spectrograph: public CoProcessor
 	virtual QColor specifyOutlineColour() const { return QColor::fromHsv(120, 96, 160); }
 
 public:
-	Spectrograph(): CoProcessor("Spectrograph") {}
+	Spectrograph(): CoProcessor("Spectrograph", NotMulti, Batched) {}
 };
 
-int Spectrograph::process()
+int Spectrograph::processCycles(uint _cycles)
 {
-	BufferData d = input(0).readSample();
+	BufferData d = input(0).readSamples(_cycles);
 	QVector<float> x;
 	x.resize(m_bins);
-	d.copyTo(x);
 	l_points.lock();
-	m_points.append(x);
+	for (uint i = 0; i < _cycles; i++)
+	{
+		d.sample(i).copyTo(x);
+		m_points.append(x);
+	}
 	while ((uint)m_points.size() > m_viewWidthSamples)
 		m_points.removeFirst();
 	l_points.unlock();
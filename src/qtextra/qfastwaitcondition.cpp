@@ -0,0 +1,188 @@
+/* Copyright 2003, 2004, 2005, 2007, 2009, 2010 Gavin Wood <gav@kde.org>
+ *
+ * This file is part of Exscalibar.
+ *
+ * Exscalibar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Exscalibar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Exscalibar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qfiber.h"
+#include "qfastwaitcondition.h"
+using namespace QtExtra;
+
+#if defined(HAVE_LINUX) && !defined(SINGLE_THREADED)
+
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+static inline void cpuRelax()
+{
+#if defined(__i386__) || defined(__x86_64__)
+	asm volatile("pause" ::: "memory");
+#else
+	__sync_synchronize();
+#endif
+}
+
+bool QFastWaitCondition::waitFrom(int _sequence, QFastMutex *_mutex, unsigned long _time)
+{
+	if (QFiber::current())
+		return yieldFrom(_sequence, _mutex, _time);
+
+	// Register ourselves before letting go of the mutex, so any wake that
+	// changes the state we're waiting on after this point will either move
+	// m_sequence on before we sleep or see us and call the kernel.
+	__sync_fetch_and_add(&m_waiters, 1);
+	if (_mutex)
+		_mutex->unlock();
+
+	bool ret = true;
+	int spin = m_spin;
+	int i = 0;
+	for (; i < spin && __sync_fetch_and_add(&m_sequence, 0) == _sequence; i++)
+		cpuRelax();
+
+	if (i < spin)
+		// Spinning paid off; be a little more patient next time.
+		m_spin.fetchAndStoreRelaxed(qMin<int>(spin * 2, MaxSpin));
+	else
+	{
+		m_spin.fetchAndStoreRelaxed(qMax<int>(spin / 2, MinSpin));
+		timespec deadline;
+		if (_time != ULONG_MAX)
+		{	clock_gettime(CLOCK_MONOTONIC, &deadline);
+			deadline.tv_sec += _time / 1000;
+			deadline.tv_nsec += (_time % 1000) * 1000000;
+			if (deadline.tv_nsec >= 1000000000)
+			{	deadline.tv_sec++;
+				deadline.tv_nsec -= 1000000000;
+			}
+		}
+		// FUTEX_WAIT returns immediately if m_sequence has already moved on.
+		// After a spurious wake we sleep only for whatever time is left.
+		while (__sync_fetch_and_add(&m_sequence, 0) == _sequence)
+		{
+			timespec left;
+			if (_time != ULONG_MAX)
+			{	timespec now;
+				clock_gettime(CLOCK_MONOTONIC, &now);
+				left.tv_sec = deadline.tv_sec - now.tv_sec;
+				left.tv_nsec = deadline.tv_nsec - now.tv_nsec;
+				if (left.tv_nsec < 0)
+				{	left.tv_sec--;
+					left.tv_nsec += 1000000000;
+				}
+				if (left.tv_sec < 0)
+				{	ret = false;
+					break;
+				}
+			}
+			if (syscall(SYS_futex, &m_sequence, FUTEX_WAIT_PRIVATE, _sequence, _time == ULONG_MAX ? 0 : &left, 0, 0) == -1 && errno == ETIMEDOUT)
+			{	ret = false;
+				break;
+			}
+		}
+	}
+
+	__sync_fetch_and_sub(&m_waiters, 1);
+	if (_mutex)
+		_mutex->lock();
+	return ret;
+}
+
+bool QFastWaitCondition::yieldFrom(int _sequence, QFastMutex *_mutex, unsigned long _time)
+{
+	// We're on a fiber, so rather than tie up the thread we give it back to
+	// whoever resumed us and check again when we're next resumed. Being on
+	// our list (and counted as a waiter) means any wake from here on tells
+	// the fiber, so it needn't be resumed before then.
+	QFiber* f = QFiber::current();
+	timespec start;
+	if (_time != ULONG_MAX)
+		clock_gettime(CLOCK_MONOTONIC, &start);
+	__sync_fetch_and_add(&m_waiters, 1);
+	addFiber(f);
+	if (_mutex)
+		_mutex->unlock();
+
+	bool ret = true;
+	while (__sync_fetch_and_add(&m_sequence, 0) == _sequence)
+	{
+		if (_time != ULONG_MAX)
+		{
+			timespec now;
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			long spent = (now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000;
+			if (spent >= (long)_time)
+			{	ret = false;
+				break;
+			}
+			f->m_waitLeft = _time - spent;
+		}
+		QFiber::yield();
+	}
+
+	f->m_waitLeft = ULONG_MAX;
+	removeFiber(f);
+	__sync_fetch_and_sub(&m_waiters, 1);
+	if (_mutex)
+		_mutex->lock();
+	return ret;
+}
+
+static inline void lockFibers(int* _lock)
+{
+	while (__sync_lock_test_and_set(_lock, 1))
+		cpuRelax();
+}
+
+static inline void unlockFibers(int* _lock)
+{
+	__sync_lock_release(_lock);
+}
+
+void QFastWaitCondition::addFiber(QFiber* _f)
+{
+	lockFibers(&m_fibersLock);
+	_f->m_nextWaiting = m_fibers;
+	_f->m_waitingOn = this;
+	m_fibers = _f;
+	unlockFibers(&m_fibersLock);
+}
+
+void QFastWaitCondition::removeFiber(QFiber* _f)
+{
+	lockFibers(&m_fibersLock);
+	for (QFiber** i = &m_fibers; *i; i = &(*i)->m_nextWaiting)
+		if (*i == _f)
+		{	*i = _f->m_nextWaiting;
+			break;
+		}
+	_f->m_nextWaiting = 0;
+	_f->m_waitingOn = 0;
+	unlockFibers(&m_fibersLock);
+}
+
+void QFastWaitCondition::wakeWaiters(int _count)
+{
+	syscall(SYS_futex, &m_sequence, FUTEX_WAKE_PRIVATE, _count, 0, 0, 0);
+	lockFibers(&m_fibersLock);
+	for (QFiber* f = m_fibers; f; f = f->m_nextWaiting)
+		f->wake();
+	unlockFibers(&m_fibersLock);
+}
+
+#endif
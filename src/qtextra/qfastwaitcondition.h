@@ -25,6 +25,7 @@
 #include <climits>
 
 #include <qmutex.h>
+#include <qatomic.h>
 
 #include <sched.h>
 
@@ -32,6 +33,8 @@
 
 //#define SINGLE_THREADED 1
 
+namespace QtExtra { class QFiber; }
+
 #ifdef SINGLE_THREADED
 
 class DLLEXPORT QFastMutex
@@ -58,15 +61,119 @@ typedef QMutexLocker QFastMutexLocker;
 
 #endif
 
+#ifdef SINGLE_THREADED
+
 class DLLEXPORT QFastWaitCondition
 {
 public:
 	bool wait(unsigned long  = ULONG_MAX) { sched_yield(); return true; }
 	bool wait(QFastMutex * mutex, unsigned long  = ULONG_MAX) { mutex->unlock(); sched_yield(); mutex->lock(); return true; }
+	int sequence() { return 0; }
+	bool waitFrom(int, QFastMutex *mutex = 0, unsigned long = ULONG_MAX) { if (mutex) mutex->unlock(); sched_yield(); if (mutex) mutex->lock(); return true; }
 	void wakeOne() {}
 	void wakeAll() {}
+
+private:
+	friend class QtExtra::QFiber;
+	void removeFiber(QtExtra::QFiber*) {}
+};
+
+#else
+
+/** @internal @ingroup QtExtra
+ * @brief Futex-based wait condition with adaptive spinning.
+ * @author Gav Wood <gav@kde.org>
+ *
+ * Drop-in replacement for QWaitCondition. A waiter first spins for a short
+ * while (in case the wake is imminent, as it usually is between two busy
+ * Processors) and then sleeps on a futex until woken. The spin length
+ * adapts: it grows while spinning tends to pay off and shrinks while it
+ * doesn't.
+ *
+ * wakeOne() and wakeAll() never block and make no system call unless there
+ * is somebody actually asleep, so they are cheap enough to call on every
+ * Buffer push.
+ *
+ * As with QWaitCondition, a wait(mutex) only sees wakes that happen after
+ * it's called, so the state it waits on must be changed and woken about with
+ * the mutex held. A waker that doesn't hold the mutex should instead be paired
+ * with a ticketed wait: take sequence() before checking the condition and
+ * then, if it isn't yet met, waitFrom() that ticket. Any wake made after the
+ * ticket was taken ends the wait at once.
+ *
+ * A wait made from within a QFiber doesn't block; the fiber yields until it
+ * is next resumed and the wake has happened (or the time is up). A wake calls
+ * QFiber::wake() on each fiber waiting, so that it may be resumed promptly.
+ */
+class DLLEXPORT QFastWaitCondition
+{
+public:
+	QFastWaitCondition(): m_sequence(0), m_waiters(0), m_spin(MinSpin), m_fibers(0), m_fibersLock(0) {}
+
+	/**
+	 * Waits for a wake without any associated mutex. Only wakes that happen
+	 * after the call will be noticed.
+	 *
+	 * @param time The maximum number of milliseconds to wait for.
+	 * @return false if we timed out.
+	 */
+	bool wait(unsigned long time = ULONG_MAX) { return waitFrom(sequence(), 0, time); }
+
+	/**
+	 * Atomically unlocks @a mutex and waits for a wake. @a mutex is locked
+	 * again before returning.
+	 *
+	 * @param time The maximum number of milliseconds to wait for.
+	 * @return false if we timed out.
+	 */
+	bool wait(QFastMutex *mutex, unsigned long time = ULONG_MAX) { return waitFrom(sequence(), mutex, time); }
+
+	/**
+	 * @return A ticket for waitFrom(). Take it before checking the condition
+	 * to be waited on.
+	 */
+	int sequence() { return __sync_fetch_and_add(&m_sequence, 0); }
+
+	/**
+	 * Waits for a wake made since @a ticket was taken with sequence();
+	 * returns at once if there's been one. @a mutex, if given, is unlocked
+	 * meanwhile and locked again before returning.
+	 *
+	 * @param time The maximum number of milliseconds to wait for.
+	 * @return false if we timed out.
+	 */
+	bool waitFrom(int ticket, QFastMutex *mutex = 0, unsigned long time = ULONG_MAX);
+
+	void wakeOne() { wake(1); }
+	void wakeAll() { wake(INT_MAX); }
+
+private:
+	friend class QtExtra::QFiber;
+
+	enum { MinSpin = 16, MaxSpin = 4096 };
+
+	bool yieldFrom(int _sequence, QFastMutex *_mutex, unsigned long _time);
+	void addFiber(QtExtra::QFiber* _f);
+	void removeFiber(QtExtra::QFiber* _f);
+	void wake(int _count)
+	{
+		__sync_fetch_and_add(&m_sequence, 1);
+		if (__sync_fetch_and_add(&m_waiters, 0))
+			wakeWaiters(_count);
+	}
+	void wakeWaiters(int _count);
+
+	int m_sequence;
+	int m_waiters;
+	QAtomicInt m_spin;	///< Only a hint, shared by all waiters, so relaxed is enough.
+
+	/// The fibers yielded in a wait on us, linked through QFiber::m_nextWaiting; guarded by the spin lock m_fibersLock.
+	QtExtra::QFiber* m_fibers;
+	int m_fibersLock;
 };
 
+#endif
+
 #else
 
 #include <qwaitcondition.h>
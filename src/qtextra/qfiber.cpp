@@ -0,0 +1,112 @@
+/* Copyright 2003, 2004, 2005, 2007, 2009, 2010 Gavin Wood <gav@kde.org>
+ *
+ * This file is part of Exscalibar.
+ *
+ * Exscalibar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Exscalibar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Exscalibar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "qfastwaitcondition.h"
+#include "qfiber.h"
+using namespace QtExtra;
+
+__thread QFiber* QFiber::s_current = 0;
+
+QFiber::QFiber(uint _stackSize):
+	m_stack(0),
+	m_started(false),
+	m_finished(false),
+	m_waitLeft(ULONG_MAX),
+	m_waitingOn(0),
+	m_nextWaiting(0)
+{
+	// Keep a page below the stack inaccessible so an overflow faults rather
+	// than scribbling on the heap. Untouched pages cost nothing.
+	uint page = sysconf(_SC_PAGESIZE);
+	m_stackSize = (_stackSize + page - 1) / page * page + page;
+	void* s = mmap(0, m_stackSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (s == MAP_FAILED)
+		qFatal("*** FATAL: QFiber: Couldn't allocate a stack of %d bytes.", m_stackSize);
+	mprotect(s, page, PROT_NONE);
+	m_stack = (char*)s;
+}
+
+QFiber::~QFiber()
+{
+	if (m_started && !m_finished)
+		qWarning("*** WARNING: QFiber: Destroying a fiber that hasn't finished; anything on its\n"
+				 "             stack will be leaked.");
+	if (m_waitingOn)
+		m_waitingOn->removeFiber(this);
+	munmap(m_stack, m_stackSize);
+}
+
+void QFiber::entry(int _hi, int _lo)
+{
+	QFiber* f = (QFiber*)(((unsigned long long)(uint)_hi << 32) | (unsigned long long)(uint)_lo);
+	f->fiberMain();
+	f->m_finished = true;
+	// Never to return.
+	swapcontext(&f->m_context, &f->m_caller);
+}
+
+bool QFiber::resume()
+{
+	if (m_finished)
+		return true;
+	if (!m_started)
+	{
+		getcontext(&m_context);
+		m_context.uc_stack.ss_sp = m_stack;
+		m_context.uc_stack.ss_size = m_stackSize;
+		m_context.uc_link = 0;
+		unsigned long long p = (unsigned long long)this;
+		makecontext(&m_context, (void(*)())&QFiber::entry, 2, int(p >> 32), int(p & 0xffffffff));
+		m_started = true;
+	}
+	QFiber* outer = s_current;
+	s_current = this;
+	swapcontext(&m_caller, &m_context);
+	s_current = outer;
+	return m_finished;
+}
+
+void QFiber::yield()
+{
+	QFiber* f = s_current;
+	Q_ASSERT(f);
+	swapcontext(&f->m_context, &f->m_caller);
+}
+
+void QFiber::sleep(unsigned long _ms)
+{
+	QFiber* f = s_current;
+	Q_ASSERT(f);
+	timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while (true)
+	{
+		timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		long spent = (now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000;
+		if (spent >= (long)_ms)
+			break;
+		f->m_waitLeft = _ms - spent;
+		yield();
+	}
+	f->m_waitLeft = ULONG_MAX;
+}
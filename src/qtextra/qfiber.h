@@ -0,0 +1,112 @@
+/* Copyright 2003, 2004, 2005, 2007, 2009, 2010 Gavin Wood <gav@kde.org>
+ *
+ * This file is part of Exscalibar.
+ *
+ * Exscalibar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Exscalibar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Exscalibar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <ucontext.h>
+
+#include <QtGlobal>
+
+#include <exscalibar.h>
+
+class QFastWaitCondition;
+
+namespace QtExtra
+{
+
+/** @internal @ingroup QtExtra
+ * @brief A stackful coroutine.
+ * @author Gav Wood <gav@kde.org>
+ *
+ * Reimplement fiberMain() and call resume() to run it on the current thread
+ * until it either returns or calls yield(), at which point resume() returns.
+ * The next resume() carries on from where it left off. That must be on the
+ * same thread: code on the fiber's stack may have kept the address of some
+ * thread-local (errno, say), and QObjects made on it belong to the thread.
+ *
+ * QFastWaitCondition knows about fibers: a wait made from within one yields
+ * rather than blocking the thread, so code written to block may be run on a
+ * QWorker without tying it up. The condition calls wake() when it's woken, so
+ * whoever resumes the fiber needn't poll.
+ */
+class DLLEXPORT QFiber
+{
+public:
+	enum { DefaultStackSize = 1024 * 1024 };
+
+	QFiber(uint _stackSize = DefaultStackSize);
+	virtual ~QFiber();
+
+	/**
+	 * Runs the fiber until it next yields or finishes. Must not be called from
+	 * within the fiber itself.
+	 *
+	 * @return true iff fiberMain() has returned.
+	 */
+	bool resume();
+
+	bool isFinished() const { return m_finished; }
+
+	/// @return The fiber running on this thread, or zero if there is none.
+	static QFiber* current() { return s_current; }
+
+	/// Hands control back to whoever resumed the current fiber.
+	static void yield();
+
+	/**
+	 * Yields the current fiber for at least @a _ms milliseconds, telling
+	 * whoever resumes it (through waitLeft()) when it next needs to be.
+	 */
+	static void sleep(unsigned long _ms);
+
+	/**
+	 * @return How many milliseconds until the wait the fiber last yielded
+	 * in times out, or ULONG_MAX if it doesn't.
+	 */
+	unsigned long waitLeft() const { return m_waitLeft; }
+
+	/**
+	 * Called, from any thread, when what the fiber is waiting on may have
+	 * changed, so it should be resumed soon.
+	 */
+	virtual void wake() {}
+
+protected:
+	virtual void fiberMain() = 0;
+
+private:
+	friend class ::QFastWaitCondition;
+
+	static void entry(int _hi, int _lo);
+
+	ucontext_t m_context;
+	ucontext_t m_caller;
+	char* m_stack;
+	uint m_stackSize;
+	bool m_started;
+	bool m_finished;
+
+	// Set by QFastWaitCondition while we're yielded in one of its waits.
+	unsigned long m_waitLeft;
+	QFastWaitCondition* m_waitingOn;
+	QFiber* m_nextWaiting;
+
+	static __thread QFiber* s_current;
+};
+
+}
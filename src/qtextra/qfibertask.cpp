@@ -0,0 +1,75 @@
+/* Copyright 2003, 2004, 2005, 2007, 2009, 2010 Gavin Wood <gav@kde.org>
+ *
+ * This file is part of Exscalibar.
+ *
+ * Exscalibar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Exscalibar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Exscalibar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qworker.h"
+#include "qfibertask.h"
+using namespace QtExtra;
+
+class QFiberTask::Fiber: public QFiber
+{
+public:
+	Fiber(QFiberTask* _t, uint _stackSize): QFiber(_stackSize), m_task(_t) {}
+
+	virtual void wake() { m_task->wake(); }
+
+private:
+	virtual void fiberMain() { m_task->run(); }
+
+	QFiberTask* m_task;
+};
+
+QFiberTask::QFiberTask(uint _stackSize):
+	m_fiber(0),
+	m_stackSize(_stackSize)
+{
+}
+
+QFiberTask::~QFiberTask()
+{
+	if (isRunning())
+		stop();
+	delete m_fiber;
+}
+
+void QFiberTask::start()
+{
+	delete m_fiber;
+	m_fiber = new Fiber(this, m_stackSize);
+	QTask::start();
+}
+
+bool QFiberTask::wait(unsigned long _ms)
+{
+	for (unsigned long i = 0; isRunning() && i < _ms; i++)
+		if (QFiber::current())
+			QFiber::sleep(1);
+		else
+			QWorker::msleep(1);
+	return !isRunning();
+}
+
+int QFiberTask::doWork()
+{
+	// The fiber must stay on the thread it started on.
+	pinToWorker();
+	if (m_fiber->resume())
+		return WillNeverWork;
+	// Whatever it waits on will wake us, so we need only look again if the wait has a time limit.
+	unsigned long left = m_fiber->waitLeft();
+	return left < (unsigned long)-AwaitingWake ? -qMax<int>(1, left) : AwaitingWake;
+}
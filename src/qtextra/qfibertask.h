@@ -0,0 +1,77 @@
+/* Copyright 2003, 2004, 2005, 2007, 2009, 2010 Gavin Wood <gav@kde.org>
+ *
+ * This file is part of Exscalibar.
+ *
+ * Exscalibar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Exscalibar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Exscalibar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <exscalibar.h>
+#include "qfiber.h"
+#include "qtask.h"
+
+namespace QtExtra
+{
+
+/** @ingroup QtExtra
+ * @brief A QTask that runs blocking code as a QFiber on the worker pool.
+ * @author Gav Wood <gav@kde.org>
+ *
+ * A stand-in for a QThread whose run() only ever blocks in
+ * QFastWaitCondition waits (say, on a QMultiplexedChannel or a Buffer).
+ * Rather than a thread of its own, it takes a worker only while it has
+ * something to do, so many of them may share a few threads.
+ *
+ * Reimplement run() and call start(). A subclass that's also a QThread may
+ * share the one run() and pick which of the two starts it.
+ */
+class DLLEXPORT QFiberTask: public QTask
+{
+public:
+	QFiberTask(uint _stackSize = QFiber::DefaultStackSize);
+
+	/**
+	 * Stops the task if it's still running; whatever run() has on its stack
+	 * is then leaked. Subclasses should see it has returned before their
+	 * members go.
+	 */
+	virtual ~QFiberTask();
+
+	/// Starts run() afresh on a fiber in our pool.
+	void start();
+
+	/**
+	 * Waits up to @a _ms milliseconds for run() to return.
+	 *
+	 * @return true iff it has returned (or was never started).
+	 */
+	bool wait(unsigned long _ms);
+
+protected:
+	/// Reimplement to do the work. Should wait only on QFastWaitConditions.
+	virtual void run() = 0;
+
+private:
+	class Fiber;
+	friend class Fiber;
+
+	//* Reimplementation from QTask; resumes run() until it next has to wait.
+	virtual int doWork();
+
+	Fiber* m_fiber;
+	uint m_stackSize;
+};
+
+}
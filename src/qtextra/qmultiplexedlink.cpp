@@ -0,0 +1,680 @@
+/* Copyright 2003, 2004, 2005, 2007, 2009, 2010 Gavin Wood <gav@kde.org>
+ *
+ * This file is part of Exscalibar.
+ *
+ * Exscalibar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Exscalibar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Exscalibar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <climits>
+#include <cstring>
+
+#include <QCoreApplication>
+#include <QThread>
+#include <QTime>
+
+#include "qmultiplexedlink.h"
+
+#ifdef HAVE_LINUX
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#endif
+
+#define MESSAGES 0
+
+// Each frame is a 9-byte header, then the data (for Data frames):
+//   word channel id, byte kind, word length; words big-endian.
+// Channels opened by the connecting side have odd ids, by the accepting side
+// even, so neither need ask the other for one.
+enum { FrameHeader = 9 };
+
+static inline void putFrameWord(char *_p, uint32_t _w)
+{
+	_p[0] = _w >> 24; _p[1] = _w >> 16; _p[2] = _w >> 8; _p[3] = _w;
+}
+
+static inline uint32_t getFrameWord(const char *_p)
+{
+	const uchar *p = (const uchar *)_p;
+	return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+// Waits on _c for up to _msecs (-1 for ever) until _done() says so.
+#define WAIT_UNTIL(_c, _lock, _msecs, _done) \
+	do { QTime t; t.start(); \
+		while (!(_done)) \
+		{	int left = _msecs < 0 ? -1 : _msecs - t.elapsed(); \
+			if (_msecs >= 0 && left <= 0) break; \
+			_c.wait(_lock, left < 0 ? ULONG_MAX : (unsigned long)left); \
+		} \
+	} while (0)
+
+#ifdef HAVE_LINUX
+
+/** @internal @ingroup QtExtra
+ * @brief The thread that does the socket work of every QMultiplexedLink.
+ * @author Gav Wood <gav@kde.org>
+ */
+class QMultiplexedLinkThread: public QThread
+{
+public:
+	static QMultiplexedLinkThread *get();
+
+	/**
+	 * Wakes the thread to look for anything new to send.
+	 */
+	void wake() { uint64_t one = 1; if (::write(m_wake, &one, 8)) {} }
+
+	/**
+	 * Guards m_links and the acceptor, and must be held to add a link or
+	 * look one up.
+	 */
+	QFastMutex m_lock;
+
+	/**
+	 * The acceptor given to the links open() makes, and the port it serves.
+	 */
+	QObject *m_acceptor;
+	quint16 m_acceptorPort;
+
+	QMultiplexedLink *find(QString const& _key);
+	void add(QMultiplexedLink *_link);
+
+	/**
+	 * Gives each link whose acceptor is @a _old @a _new instead. Must be
+	 * called with m_lock held.
+	 */
+	void replaceAcceptor(QObject *_old, QObject *_new);
+
+private:
+	QMultiplexedLinkThread();
+
+	virtual void run();
+
+	/**
+	 * Has epoll watch @a _link for @a _events, or not at all if there are
+	 * none, lest a hangup keep waking us for a link we can't read.
+	 */
+	void poll(QMultiplexedLink *_link, uint _events);
+
+	/**
+	 * Drops the failed @a _link. Must be called with m_lock held.
+	 */
+	void drop(QMultiplexedLink *_link);
+
+	int m_epoll;
+	int m_wake;
+	QList<QMultiplexedLink *> m_links;
+};
+
+static QFastMutex s_multiplexedLinkThreadLock;
+static QMultiplexedLinkThread *s_multiplexedLinkThread = 0;
+
+QMultiplexedLinkThread *QMultiplexedLinkThread::get()
+{
+	QFastMutexLocker lock(&s_multiplexedLinkThreadLock);
+	if (!s_multiplexedLinkThread)
+	{	s_multiplexedLinkThread = new QMultiplexedLinkThread;
+		s_multiplexedLinkThread->start(HighPriority);
+	}
+	return s_multiplexedLinkThread;
+}
+
+QMultiplexedLinkThread::QMultiplexedLinkThread(): QThread(0), m_acceptor(0), m_acceptorPort(0)
+{
+	m_epoll = epoll_create(16);
+	m_wake = eventfd(0, EFD_NONBLOCK);
+	epoll_event e;
+	e.events = EPOLLIN;
+	e.data.ptr = 0;
+	epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wake, &e);
+}
+
+QMultiplexedLink *QMultiplexedLinkThread::find(QString const& _key)
+{
+	foreach (QMultiplexedLink *l, m_links)
+		if (l->m_key == _key)
+			return l;
+	return 0;
+}
+
+void QMultiplexedLinkThread::add(QMultiplexedLink *_link)
+{
+	m_links.append(_link);
+	poll(_link, EPOLLIN);
+	wake();
+}
+
+void QMultiplexedLinkThread::replaceAcceptor(QObject *_old, QObject *_new)
+{
+	foreach (QMultiplexedLink *l, m_links)
+	{	QFastMutexLocker lock(&l->m_lock);
+		if (l->m_acceptor == _old)
+			l->m_acceptor = _new;
+	}
+}
+
+void QMultiplexedLinkThread::poll(QMultiplexedLink *_link, uint _events)
+{
+	if (_events == _link->m_polling)
+		return;
+	epoll_event e;
+	e.events = _events;
+	e.data.ptr = _link;
+	epoll_ctl(m_epoll, !_events ? EPOLL_CTL_DEL : _link->m_polling ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, _link->m_fd, &e);
+	_link->m_polling = _events;
+}
+
+void QMultiplexedLinkThread::drop(QMultiplexedLink *_link)
+{
+	if (MESSAGES) qDebug("QMultiplexedLink: Dropping link to %s.", qPrintable(_link->m_peer.toString()));
+	poll(_link, 0);
+	::close(_link->m_fd);
+	_link->m_fd = -1;
+	m_links.removeAll(_link);
+	// Otherwise the last of its channels deletes it.
+	if (_link->fail())
+		delete _link;
+}
+
+void QMultiplexedLinkThread::run()
+{
+	epoll_event events[64];
+	while (true)
+	{
+		int n = epoll_wait(m_epoll, events, 64, -1);
+		if (n < 0 && errno != EINTR)
+		{	qWarning("*** CRITICAL: QMultiplexedLink: epoll_wait failed (%d). Links are dead.", errno);
+			return;
+		}
+		for (int i = 0; i < n; i++)
+			if (!events[i].data.ptr)
+			{	uint64_t count;
+				if (::read(m_wake, &count, 8)) {}
+			}
+			else
+			{	QMultiplexedLink *l = (QMultiplexedLink *)events[i].data.ptr;
+				if ((events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) && !l->receive())
+				{	QFastMutexLocker lock(&m_lock);
+					drop(l);
+				}
+			}
+
+		QFastMutexLocker lock(&m_lock);
+		foreach (QMultiplexedLink *l, m_links)
+		{	if (!l->send())
+			{	drop(l);
+				continue;
+			}
+			// Once a full channel has been read from, the frames held back
+			// can go, and the socket be read again.
+			bool held = l->isHeld();
+			if (!held && (!(l->m_polling & EPOLLIN) || l->m_rx.size() >= FrameHeader))
+			{	if (!l->receive())
+				{	drop(l);
+					continue;
+				}
+				held = l->isHeld();
+			}
+			poll(l, (held ? 0 : EPOLLIN) | (l->m_wantWrite ? EPOLLOUT : 0));
+		}
+	}
+}
+
+QMultiplexedLink::QMultiplexedLink(int _fd, QObject *_acceptor, uint32_t _firstId): m_fd(_fd), m_wantWrite(false), m_polling(0), m_acceptor(_acceptor), m_failed(false), m_heldBy(0), m_next(0), m_nextId(_firstId), m_wireSent(0)
+{
+	int one = 1;
+	setsockopt(m_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) | O_NONBLOCK);
+	sockaddr_storage a;
+	socklen_t l = sizeof(a);
+	if (getpeername(m_fd, (sockaddr *)&a, &l) == 0)
+		m_peer = QHostAddress((sockaddr *)&a);
+	l = sizeof(a);
+	if (getsockname(m_fd, (sockaddr *)&a, &l) == 0)
+		m_local = QHostAddress((sockaddr *)&a);
+}
+
+QMultiplexedChannel *QMultiplexedLink::newChannel()
+{
+	QFastMutexLocker lock(&m_lock);
+	QMultiplexedChannel *ret = new QMultiplexedChannel(this, m_nextId);
+	m_nextId += 2;
+	m_channels.append(ret);
+	queueFrame(ret->m_id, Open);
+	return ret;
+}
+
+QMultiplexedChannel *QMultiplexedLink::open(QHostAddress const& _host, quint16 _port)
+{
+	QMultiplexedLinkThread *t = QMultiplexedLinkThread::get();
+	QString key = _host.toString() + ":" + QString::number(_port);
+
+	QMultiplexedChannel *ret = 0;
+	quint16 acceptorPort;
+	{	QFastMutexLocker lock(&t->m_lock);
+		if (QMultiplexedLink *link = t->find(key))
+			ret = link->newChannel();
+		acceptorPort = t->m_acceptor ? t->m_acceptorPort : 0;
+	}
+	if (!ret)
+	{	// Connect without the lock, so as not to hold up the other links.
+		addrinfo hints;
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_flags = AI_NUMERICHOST | AI_NUMERICSERV;
+		addrinfo *ai = 0;
+		if (getaddrinfo(_host.toString().toLatin1().constData(), QByteArray::number(_port).constData(), &hints, &ai) != 0 || !ai)
+			return 0;
+		int fd = ::socket(ai->ai_family, SOCK_STREAM, 0);
+		bool ok = fd >= 0 && ::connect(fd, ai->ai_addr, ai->ai_addrlen) == 0;
+		freeaddrinfo(ai);
+		// Magic, then the port we take links on, if any.
+		char hello[8];
+		putFrameWord(hello, Magic);
+		putFrameWord(hello + 4, acceptorPort);
+		ok = ok && ::write(fd, hello, 8) == 8;
+		if (!ok)
+		{	if (MESSAGES) qDebug("QMultiplexedLink: Couldn't connect to %s.", qPrintable(key));
+			if (fd >= 0)
+				::close(fd);
+			return 0;
+		}
+
+		QFastMutexLocker lock(&t->m_lock);
+		QMultiplexedLink *link = t->find(key);
+		if (link)
+			::close(fd);
+		else
+		{	link = new QMultiplexedLink(fd, t->m_acceptor, 1);
+			link->m_key = key;
+			t->add(link);
+			if (MESSAGES) qDebug("QMultiplexedLink: New link to %s.", qPrintable(key));
+		}
+		ret = link->newChannel();
+	}
+	t->wake();
+	return ret;
+}
+
+// Receives exactly _size bytes from the blocking _socket, or fails after a
+// few seconds without any.
+static bool receiveHello(int _socket, char *_data, int _size)
+{
+	for (int have = 0; have < _size;)
+	{	pollfd p = { _socket, POLLIN, 0 };
+		if (::poll(&p, 1, 5000) <= 0)
+			return false;
+		int r = ::recv(_socket, _data + have, _size - have, 0);
+		if (r <= 0)
+			return false;
+		have += r;
+	}
+	return true;
+}
+
+bool QMultiplexedLink::adopt(int _socket, QObject *_acceptor)
+{
+	// The first thing sent by open() is Magic; anything else (e.g. the
+	// header of an ordinary connection) will differ within four bytes.
+	char magic[4];
+	putFrameWord(magic, Magic);
+	char got[4];
+	int have = 0;
+	while (have < 4)
+	{	pollfd p = { _socket, POLLIN, 0 };
+		if (::poll(&p, 1, 5000) <= 0)
+			return false;
+		have = ::recv(_socket, got, 4, MSG_PEEK);
+		if (have <= 0 || memcmp(got, magic, have))
+			return false;
+		if (have < 4)
+			usleep(1000);
+	}
+	char port[4];
+	if (::recv(_socket, got, 4, 0) != 4 || !receiveHello(_socket, port, 4))
+		return false;
+
+	QMultiplexedLinkThread *t = QMultiplexedLinkThread::get();
+	QMultiplexedLink *link = new QMultiplexedLink(_socket, _acceptor, 2);
+	QFastMutexLocker lock(&t->m_lock);
+	// If the other side takes links too, our own open() to it can use this
+	// one, unless it's already made another.
+	link->m_key = link->m_peer.toString() + ":" + QString::number(getFrameWord(port));
+	if (!getFrameWord(port) || t->find(link->m_key))
+		link->m_key = "<" + link->m_peer.toString() + ">";
+	t->add(link);
+	if (MESSAGES) qDebug("QMultiplexedLink: Adopted link from %s.", qPrintable(link->m_key));
+	return true;
+}
+
+void QMultiplexedLink::setAcceptor(QObject *_acceptor, quint16 _port)
+{
+	QMultiplexedLinkThread *t = QMultiplexedLinkThread::get();
+	QFastMutexLocker lock(&t->m_lock);
+	if (t->m_acceptor)
+		t->replaceAcceptor(t->m_acceptor, _acceptor);
+	t->m_acceptor = _acceptor;
+	t->m_acceptorPort = _port;
+}
+
+void QMultiplexedLink::forgetAcceptor(QObject *_acceptor)
+{
+	QMultiplexedLinkThread *t = QMultiplexedLinkThread::get();
+	QFastMutexLocker lock(&t->m_lock);
+	t->replaceAcceptor(_acceptor, 0);
+	if (t->m_acceptor == _acceptor)
+		t->m_acceptor = 0;
+}
+
+void QMultiplexedLink::queueFrame(uint32_t _id, Kind _kind, const char *_data, uint _size)
+{
+	char h[FrameHeader];
+	putFrameWord(h, _id);
+	h[4] = _kind;
+	putFrameWord(h + 5, _size);
+	m_wire.append(h, FrameHeader);
+	if (_size)
+		m_wire.append(_data, _size);
+}
+
+bool QMultiplexedLink::isHeld() const
+{
+	QFastMutexLocker lock(&m_lock);
+	return m_heldBy;
+}
+
+bool QMultiplexedLink::receive()
+{
+	bool ok = true;
+	char buffer[65536];
+	// While a channel is full, what's still to come stays in the socket. We
+	// stop short of ReadLimit in any case; epoll will tell us of the rest.
+	while (!isHeld() && m_rx.size() < ReadLimit)
+	{	ssize_t r = ::read(m_fd, buffer, sizeof(buffer));
+		if (r > 0)
+			m_rx.append(buffer, r);
+		else if (r < 0 && errno == EINTR)
+			continue;
+		else
+		{	ok = r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+			break;
+		}
+	}
+
+	QFastMutexLocker lock(&m_lock);
+	int i = 0;
+	while (m_rx.size() - i >= FrameHeader)
+	{	const char *h = m_rx.constData() + i;
+		uint32_t id = getFrameWord(h);
+		uint kind = (uchar)h[4];
+		uint32_t size = getFrameWord(h + 5);
+		if (m_rx.size() - i - FrameHeader < (int)size)
+			break;
+		i += FrameHeader;
+		QMultiplexedChannel *c = 0;
+		foreach (QMultiplexedChannel *x, m_channels)
+			if (x->m_id == id)
+			{	c = x;
+				break;
+			}
+		if (kind == Open && !c)
+		{	if (m_acceptor)
+			{	c = new QMultiplexedChannel(this, id);
+				m_channels.append(c);
+				QCoreApplication::postEvent(m_acceptor, new ChannelEvent(c));
+			}
+			else
+				queueFrame(id, Close);
+		}
+		else if (kind == Data && c && !c->m_closed && c->m_in.size() >= ReadLimit)
+		{	// Leave it (and all after it) until the channel's been read.
+			m_heldBy = c;
+			i -= FrameHeader;
+			break;
+		}
+		else if (kind == Data && c && !c->m_closed)
+		{	c->m_in.append(m_rx.constData() + i, size);
+			c->m_readable.wakeAll();
+		}
+		else if (kind == Close && c)
+		{	c->m_remoteClosed = true;
+			c->m_readable.wakeAll();
+			c->m_writable.wakeAll();
+		}
+		i += size;
+	}
+	m_rx.remove(0, i);
+	return ok;
+}
+
+bool QMultiplexedLink::send()
+{
+	QFastMutexLocker lock(&m_lock);
+
+	// A frame from each channel in turn, until there's plenty to send.
+	for (int tried = 0; tried < m_channels.size() && m_wire.size() - m_wireSent < 4 * Quantum;)
+	{	if (m_next >= m_channels.size())
+			m_next = 0;
+		QMultiplexedChannel *c = m_channels[m_next++];
+		int pending = c->m_out.size() - c->m_outSent;
+		if (pending)
+		{	int n = qMin(pending, (int)Quantum);
+			queueFrame(c->m_id, Data, c->m_out.constData() + c->m_outSent, n);
+			c->m_outSent += n;
+			if (c->m_outSent == c->m_out.size())
+			{	c->m_out.clear();
+				c->m_outSent = 0;
+			}
+			else if (c->m_outSent > WriteLimit / 2)
+			{	c->m_out.remove(0, c->m_outSent);
+				c->m_outSent = 0;
+			}
+			c->m_writable.wakeAll();
+			tried = 0;
+		}
+		else
+		{	if (c->m_closing && !c->m_closed)
+			{	queueFrame(c->m_id, Close);
+				c->m_closed = true;
+				// Data for it is dropped now, so it can hold nothing back.
+				if (m_heldBy == c)
+					m_heldBy = 0;
+				c->m_writable.wakeAll();
+			}
+			tried++;
+		}
+	}
+
+	while (m_wireSent < m_wire.size())
+	{	ssize_t r = ::write(m_fd, m_wire.constData() + m_wireSent, m_wire.size() - m_wireSent);
+		if (r > 0)
+			m_wireSent += r;
+		else if (r < 0 && errno == EINTR)
+			continue;
+		else if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+		else
+			return false;
+	}
+	if (m_wireSent == m_wire.size())
+	{	m_wire.clear();
+		m_wireSent = 0;
+	}
+	else if (m_wireSent > 4 * Quantum)
+	{	m_wire.remove(0, m_wireSent);
+		m_wireSent = 0;
+	}
+
+	// Look again once the socket will take more, or once a channel has more.
+	bool more = false;
+	foreach (QMultiplexedChannel *c, m_channels)
+		more = more || c->m_out.size() > c->m_outSent || (c->m_closing && !c->m_closed);
+	m_wantWrite = m_wireSent < m_wire.size() || more;
+	return true;
+}
+
+bool QMultiplexedLink::fail()
+{
+	QFastMutexLocker lock(&m_lock);
+	m_failed = true;
+	foreach (QMultiplexedChannel *c, m_channels)
+	{	c->m_remoteClosed = true;
+		c->m_readable.wakeAll();
+		c->m_writable.wakeAll();
+	}
+	return m_channels.isEmpty();
+}
+
+static inline void wakeMultiplexedLinkThread()
+{
+	QMultiplexedLinkThread::get()->wake();
+}
+
+#else
+
+bool QMultiplexedLink::receive() { return false; }
+bool QMultiplexedLink::send() { return false; }
+bool QMultiplexedLink::isHeld() const { return false; }
+bool QMultiplexedLink::fail() { return true; }
+QMultiplexedChannel *QMultiplexedLink::newChannel() { return 0; }
+QMultiplexedChannel *QMultiplexedLink::open(QHostAddress const&, quint16) { return 0; }
+bool QMultiplexedLink::adopt(int, QObject *) { return false; }
+void QMultiplexedLink::setAcceptor(QObject *, quint16) {}
+void QMultiplexedLink::forgetAcceptor(QObject *) {}
+void QMultiplexedLink::queueFrame(uint32_t, Kind, const char *, uint) {}
+static inline void wakeMultiplexedLinkThread() {}
+
+#endif
+
+QMultiplexedChannel::QMultiplexedChannel(QMultiplexedLink *_link, uint32_t _id): QIODevice(0), m_link(_link), m_id(_id), m_outSent(0), m_closing(false), m_closed(false), m_remoteClosed(false)
+{
+	setOpenMode(ReadWrite | Unbuffered);
+}
+
+QMultiplexedChannel::~QMultiplexedChannel()
+{
+	close();
+	bool last;
+	{	QFastMutexLocker lock(&m_link->m_lock);
+		WAIT_UNTIL(m_writable, &m_link->m_lock, 2000, m_closed || m_remoteClosed);
+		m_link->m_channels.removeAll(this);
+		if (m_link->m_heldBy == this)
+			m_link->m_heldBy = 0;
+		last = m_link->m_failed && m_link->m_channels.isEmpty();
+	}
+	// A failed link has been dropped by the I/O thread; it's ours to delete.
+	if (last)
+		delete m_link;
+	else
+		wakeMultiplexedLinkThread();
+}
+
+void QMultiplexedChannel::close()
+{
+	{	QFastMutexLocker lock(&m_link->m_lock);
+		m_closing = true;
+	}
+	wakeMultiplexedLinkThread();
+	QIODevice::close();
+}
+
+bool QMultiplexedChannel::atEnd() const
+{
+	QFastMutexLocker lock(&m_link->m_lock);
+	return m_remoteClosed && m_in.isEmpty() && QIODevice::bytesAvailable() == 0;
+}
+
+qint64 QMultiplexedChannel::bytesAvailable() const
+{
+	QFastMutexLocker lock(&m_link->m_lock);
+	return m_in.size() + QIODevice::bytesAvailable();
+}
+
+qint64 QMultiplexedChannel::bytesToWrite() const
+{
+	QFastMutexLocker lock(&m_link->m_lock);
+	return m_out.size() - m_outSent;
+}
+
+bool QMultiplexedChannel::canReadLine() const
+{
+	QFastMutexLocker lock(&m_link->m_lock);
+	return m_in.contains('\n') || QIODevice::canReadLine();
+}
+
+bool QMultiplexedChannel::waitForReadyRead(int _msecs)
+{
+	if (QIODevice::bytesAvailable())
+		return true;
+	QFastMutexLocker lock(&m_link->m_lock);
+	WAIT_UNTIL(m_readable, &m_link->m_lock, _msecs, !m_in.isEmpty() || m_remoteClosed);
+	return !m_in.isEmpty();
+}
+
+bool QMultiplexedChannel::waitForBytesWritten(int _msecs)
+{
+	QFastMutexLocker lock(&m_link->m_lock);
+	WAIT_UNTIL(m_writable, &m_link->m_lock, _msecs, m_out.size() == m_outSent || m_remoteClosed);
+	return m_out.size() == m_outSent;
+}
+
+qint64 QMultiplexedChannel::readData(char *_data, qint64 _maxSize)
+{
+	int n;
+	bool resume = false;
+	{	QFastMutexLocker lock(&m_link->m_lock);
+		n = qMin((qint64)m_in.size(), _maxSize);
+		if (!n)
+			return m_remoteClosed ? -1 : 0;
+		memcpy(_data, m_in.constData(), n);
+		m_in.remove(0, n);
+		// If we held the link back, let it go once we've room again.
+		if (m_link->m_heldBy == this && m_in.size() < QMultiplexedLink::ReadLimit / 2)
+		{	m_link->m_heldBy = 0;
+			resume = true;
+		}
+	}
+	if (resume)
+		wakeMultiplexedLinkThread();
+	return n;
+}
+
+qint64 QMultiplexedChannel::writeData(const char *_data, qint64 _size)
+{
+	{	QFastMutexLocker lock(&m_link->m_lock);
+		// Hold back if too much is still to go, but not for ever.
+		WAIT_UNTIL(m_writable, &m_link->m_lock, 30000, m_out.size() - m_outSent < QMultiplexedLink::WriteLimit || m_remoteClosed);
+		if (m_remoteClosed || m_closing)
+			return -1;
+		if (m_out.size() - m_outSent >= QMultiplexedLink::WriteLimit)
+		{	qWarning("*** WARNING: QMultiplexedChannel: Nothing sent for 30s. Giving up.");
+			return -1;
+		}
+		m_out.append(_data, _size);
+	}
+	wakeMultiplexedLinkThread();
+	return _size;
+}
+
+#undef WAIT_UNTIL
+#undef MESSAGES
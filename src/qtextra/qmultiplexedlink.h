@@ -0,0 +1,247 @@
+/* Copyright 2003, 2004, 2005, 2007, 2009, 2010 Gavin Wood <gav@kde.org>
+ *
+ * This file is part of Exscalibar.
+ *
+ * Exscalibar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Exscalibar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Exscalibar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <QByteArray>
+#include <QEvent>
+#include <QHostAddress>
+#include <QIODevice>
+#include <QList>
+
+#include "qfastwaitcondition.h"
+
+#include <exscalibar.h>
+
+class QMultiplexedLink;
+
+/** @ingroup QtExtra
+ * @brief One of the logical streams carried by a QMultiplexedLink.
+ * @author Gav Wood <gav@kde.org>
+ *
+ * A QMultiplexedChannel behaves as a sequential QIODevice much like a
+ * QTcpSocket, so it may be given to a QSocketSession (or a QTextStream) in
+ * place of one. All the actual socket work is done by the link's I/O thread;
+ * reads take from what it has already received for this channel, and writes
+ * queue data for it to send. Writes block only when a good deal is queued
+ * and not yet sent, and fail if none of it goes for 30 seconds.
+ *
+ * All its waits are on QFastWaitConditions, so code that blocks on it may be
+ * run as a QFiberTask, on the worker pool, rather than a thread of its own.
+ *
+ * Like a QTcpSocket, it should be used by one thread (or fiber) at a time.
+ */
+class DLLEXPORT QMultiplexedChannel: public QIODevice
+{
+	friend class QMultiplexedLink;
+
+public:
+	/**
+	 * Closes the channel, waiting a short while for what's queued to be sent.
+	 */
+	virtual ~QMultiplexedChannel();
+
+	/**
+	 * @return The link that carries us.
+	 */
+	QMultiplexedLink *link() const { return m_link; }
+
+	//* Reimplementations from QIODevice.
+	virtual bool isSequential() const { return true; }
+	virtual void close();
+	virtual bool atEnd() const;
+	virtual qint64 bytesAvailable() const;
+	virtual qint64 bytesToWrite() const;
+	virtual bool canReadLine() const;
+	virtual bool waitForReadyRead(int msecs);
+	virtual bool waitForBytesWritten(int msecs);
+
+protected:
+	//* Reimplementations from QIODevice.
+	virtual qint64 readData(char *data, qint64 maxSize);
+	virtual qint64 writeData(const char *data, qint64 maxSize);
+
+private:
+	QMultiplexedChannel(QMultiplexedLink *_link, uint32_t _id);
+
+	QMultiplexedLink *m_link;
+	uint32_t m_id;
+
+	// All below are guarded by the link's mutex.
+	QByteArray m_in;
+	QByteArray m_out;
+	int m_outSent;
+	bool m_closing;
+	bool m_closed;
+	bool m_remoteClosed;
+	QFastWaitCondition m_readable;
+	QFastWaitCondition m_writable;
+};
+
+/** @ingroup QtExtra
+ * @brief A single TCP connection to a host, carrying many logical streams.
+ * @author Gav Wood <gav@kde.org>
+ *
+ * Rather than a socket (and handshake) for each connection to some host, all
+ * of them may go through one QMultiplexedLink to it, each as a
+ * QMultiplexedChannel. open() gives a new channel to a host and port, making
+ * the link the first time; the other side takes the link over with adopt()
+ * when it's accepted, and is told of each new channel as it opens. If this
+ * side has an acceptor (see setAcceptor()) the other may open channels back
+ * over the same link, rather than make a second one.
+ *
+ * The sockets of all links are served by a single I/O thread using epoll.
+ * Data is sent in frames of at most Quantum bytes, taking a frame from each
+ * channel that has something to send in turn, so that a big transfer on one
+ * channel doesn't hold up the others for long. Once a channel has ReadLimit
+ * bytes received but not read, the link takes nothing more from its socket
+ * until they're read, so TCP holds back the other side.
+ *
+ * A link whose socket fails is dropped; its channels all close, and the next
+ * open() to that host makes a new one. It's deleted once its last channel is.
+ *
+ * Only available on Linux; elsewhere open() and adopt() always fail, so the
+ * caller should fall back to a socket of its own.
+ */
+class DLLEXPORT QMultiplexedLink
+{
+	friend class QMultiplexedChannel;
+	friend class QMultiplexedLinkThread;
+
+public:
+	enum { Quantum = 16384, WriteLimit = 1048576, ReadLimit = 1048576 };
+
+	/**
+	 * Posted to the acceptor given to adopt() for each channel the other side
+	 * opens. The receiver owns the channel.
+	 */
+	class ChannelEvent: public QEvent
+	{
+	public:
+		enum { Type = QEvent::User + 1661 };
+		ChannelEvent(QMultiplexedChannel *_channel): QEvent((QEvent::Type)Type), m_channel(_channel) {}
+		QMultiplexedChannel *channel() const { return m_channel; }
+
+	private:
+		QMultiplexedChannel *m_channel;
+	};
+
+	/**
+	 * Opens a new channel to @a host on @a port, over the existing link there
+	 * if there is one.
+	 *
+	 * @return The channel, owned by the caller, or 0 if there's no link and
+	 * one can't be made.
+	 */
+	static QMultiplexedChannel *open(QHostAddress const& host, quint16 port);
+
+	/**
+	 * Looks at the newly accepted connection @a socket and, if it's from
+	 * open() at the other side, takes it over as a link. New channels on it
+	 * are posted as ChannelEvents to @a acceptor.
+	 *
+	 * @return true if it was taken over; otherwise @a socket is untouched.
+	 */
+	static bool adopt(int socket, QObject *acceptor);
+
+	/**
+	 * Makes @a acceptor, which takes connections on @a port, the acceptor of
+	 * the links made by open(). The other side of each is told @a port, so
+	 * its own open() to us here can go over the same link.
+	 */
+	static void setAcceptor(QObject *acceptor, quint16 port);
+
+	/**
+	 * Stops posting new channels to @a acceptor, e.g. as it's deleted.
+	 */
+	static void forgetAcceptor(QObject *acceptor);
+
+	/**
+	 * @return The address of the other side.
+	 */
+	QHostAddress peerAddress() const { return m_peer; }
+
+	/**
+	 * @return The address of this side.
+	 */
+	QHostAddress localAddress() const { return m_local; }
+
+private:
+	enum { Magic = 0x474d5558 };
+	enum Kind { Data = 0, Open, Close };
+
+	QMultiplexedLink(int _fd, QObject *_acceptor, uint32_t _firstId);
+
+	/**
+	 * Opens a new channel on the link. Must be called with the I/O thread's
+	 * lock held, so the link can't be dropped meanwhile.
+	 */
+	QMultiplexedChannel *newChannel();
+
+	/**
+	 * Must be called with m_lock held.
+	 */
+	void queueFrame(uint32_t _id, Kind _kind, const char *_data = 0, uint _size = 0);
+
+	/**
+	 * Called from the I/O thread when the socket has something for us.
+	 *
+	 * @return false if the link has failed.
+	 */
+	bool receive();
+
+	/**
+	 * Called from the I/O thread; frames whatever the channels have queued
+	 * and sends as much as the socket will take.
+	 *
+	 * @return false if the link has failed.
+	 */
+	bool send();
+
+	/**
+	 * @return true if a channel is too full for us to read the socket.
+	 */
+	bool isHeld() const;
+
+	/**
+	 * Closes all channels; called once the link has failed.
+	 *
+	 * @return true if there are none, so the link may be deleted.
+	 */
+	bool fail();
+
+	int m_fd;
+	QHostAddress m_peer;
+	QHostAddress m_local;
+	QString m_key;
+	bool m_wantWrite;
+	uint m_polling;
+
+	mutable QFastMutex m_lock;
+	QObject *m_acceptor;
+	bool m_failed;
+	QMultiplexedChannel *m_heldBy;
+	QList<QMultiplexedChannel *> m_channels;
+	int m_next;
+	uint32_t m_nextId;
+	QByteArray m_wire;
+	int m_wireSent;
+	QByteArray m_rx;
+};
@@ -16,6 +16,8 @@
  * along with Exscalibar.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cmath>
+
 #include <QThread>
 
 #include <exscalibar.h>
@@ -26,17 +28,68 @@
 using namespace QtExtra;
 
 QScheduler* QScheduler::s_this = 0;
+QMap<QString, QScheduler*> QScheduler::s_pools;
+QFastMutex QScheduler::s_poolsLock;
 
-QScheduler::QScheduler(int _workers):
-	m_robin(0)
+QScheduler::QScheduler(QString const& _name, int _workers):
+	m_taskCount(0),
+	m_current(new QList<QWorker*>),
+	m_name(_name),
+	m_robin(0),
+	m_priority(0),
+	m_realTime(false),
+	m_policy(0),
+	m_wakes(0),
+	m_parked(0),
+	m_startRdtsc(rdtsc())
 {
 	setWorkers(_workers);
 }
 
+QScheduler* QScheduler::pool(QString const& _name)
+{
+	QFastMutexLocker l(&s_poolsLock);
+	if (!s_pools.contains(_name))
+		s_pools[_name] = new QScheduler(_name, _name.isEmpty() ? -1 : 1);
+	return s_pools[_name];
+}
+
+QStringList QScheduler::pools()
+{
+	QFastMutexLocker l(&s_poolsLock);
+	return s_pools.keys();
+}
+
+void QScheduler::setAffinity(QList<int> const& _cpus)
+{
+	{
+		QFastMutexLocker l(&l_workers);
+		m_cpus = _cpus;
+	}
+	m_policy.ref();
+	wakeAllWorkers();
+}
+
+void QScheduler::setPriority(int _priority, bool _realTime)
+{
+	{
+		QFastMutexLocker l(&l_workers);
+		m_priority = _priority;
+		m_realTime = _realTime;
+	}
+	m_policy.ref();
+	wakeAllWorkers();
+}
+
 QScheduler::~QScheduler()
 {
-	setWorkers(0);
+	// With no tasks left, none is pinned, so every worker can finish.
 	clearTasks();
+	setWorkers(0);
+	reapWorkers();
+	foreach (QList<QWorker*>* l, m_superseded)
+		delete l;
+	delete (QList<QWorker*>*)m_current;
 }
 
 void QScheduler::registerTask(QTask* _p)
@@ -50,8 +103,12 @@ void QScheduler::registerTask(QTask* _p)
 			w->beginAgain();
 	}
 	m_tasks.append(_p);
+	m_taskCount = m_tasks.count();
 	_p->m_scheduler = this;
 	_p->m_lastStatus = QTask::DidWork;
+	_p->m_idle = false;
+	_p->m_worker = 0;
+	assignTask(_p);
 }
 
 void QScheduler::unregisterTask(QTask* _p)
@@ -59,7 +116,9 @@ void QScheduler::unregisterTask(QTask* _p)
 	QFastMutexLocker l(&l_tasks);
 	_p->guaranteeStopped();
 	m_tasks.removeAll(_p);
+	m_taskCount = m_tasks.count();
 	_p->m_scheduler = 0;
+	forgetTask(_p);
 	_p->releaseGuarantee();
 	_p->onStopped();
 }
@@ -76,99 +135,391 @@ void QScheduler::clearTasks()
 	{
 		m_tasks.last()->guaranteeStopped();
 		QTask* t = m_tasks.takeLast();
+		m_taskCount = m_tasks.count();
 		t->m_scheduler = 0;
+		forgetTask(t);
 		t->releaseGuarantee();
 		t->onStopped();
 	}
 }
 
+void QScheduler::forgetTask(QTask* _t)
+{
+	// Whoever last ran it may still be setting it aside, so look at each
+	// worker under its own lock rather than trusting m_sleepingOn. Only a
+	// worker there already can have been running it, and none is deleted
+	// before we are.
+	l_workers.lock();
+	QList<QWorker*> all = m_workers + m_retired;
+	l_workers.unlock();
+	foreach (QWorker* w, all)
+	{
+		QFastMutexLocker l(&w->l_sleepers);
+		if ((QWorker*)_t->m_sleepingOn == w)
+		{
+			w->m_sleepers.remove(_t->m_dueTime, _t);
+			_t->m_sleepingOn = 0;
+		}
+	}
+
+	QFastMutexLocker l(&l_workers);
+	foreach (QWorker* w, m_workers)
+		w->removeTask(_t);
+	foreach (QWorker* w, m_retired)
+		w->removeTask(_t);
+	m_orphans.removeAll(_t);
+}
+
+void QScheduler::publishWorkers()
+{
+	QList<QWorker*>* old = m_current.fetchAndStoreOrdered(new QList<QWorker*>(m_workers));
+	m_superseded.append(old);
+}
+
+void QScheduler::assignTask(QTask* _t)
+{
+	QList<QWorker*> const& ws = currentWorkers();
+	if (ws.isEmpty())
+	{
+		// setWorkers() takes the orphans under l_workers, so look again under it.
+		QFastMutexLocker l(&l_workers);
+		if (m_workers.isEmpty())
+		{
+			m_orphans.append(_t);
+			return;
+		}
+	}
+	QWorker* w = currentWorkers()[uint(m_robin.fetchAndAddRelaxed(1)) % currentWorkers().count()];
+	w->pushTask(_t);
+	reclaimTasks(w);
+}
+
+void QScheduler::handOverTask(QTask* _t)
+{
+	QList<QWorker*> const& ws = currentWorkers();
+	if (ws.isEmpty())
+	{
+		// As with QWorker::requeueTask(), checking m_scheduler under the
+		// lock unregisterTask() sweeps m_orphans under means we can't put
+		// back a swept task.
+		QFastMutexLocker l(&l_workers);
+		if (!_t->m_scheduler)
+			return;
+		if (m_workers.isEmpty())
+		{
+			m_orphans.append(_t);
+			return;
+		}
+	}
+	QWorker* w = currentWorkers()[uint(m_robin.fetchAndAddRelaxed(1)) % currentWorkers().count()];
+	w->requeueTask(_t);
+	reclaimTasks(w);
+}
+
+void QScheduler::reclaimTasks(QWorker* _w)
+{
+	// We may have given it a task after it retired, even after it finished,
+	// in which case nobody else would pass the task on. It's told it's
+	// retiring before it's unpublished, so we can't miss that.
+	if (int(_w->m_retiring))
+		foreach (QTask* t, _w->takeUnpinnedTasks())
+			handOverTask(t);
+}
+
 void QScheduler::setWorkers(int _n)
 {
 	if (_n == -1)
 		_n = QThread::idealThreadCount();
 
+	QList<QWorker*> retiring;
+	l_workers.lock();
 	while (m_workers.count() > _n)
-		delete m_workers.takeLast();
+	{
+		QWorker* w = m_workers.takeLast();
+		w->m_retiring.fetchAndStoreOrdered(1);
+		m_retired.append(w);
+		retiring.append(w);
+	}
 	while (m_workers.count() < _n)
 		m_workers.append(new QWorker(this, m_workers.count()));
+	publishWorkers();
+	QList<QTask*> orphans = m_orphans;
+	m_orphans.clear();
+	l_workers.unlock();
+
+	foreach (QTask* t, orphans)
+		assignTask(t);
+	foreach (QWorker* w, retiring)
+		foreach (QTask* t, w->takeUnpinnedTasks())
+			handOverTask(t);
+
+	// Get them out of park, so they notice.
+	wakeAllWorkers();
+	foreach (QWorker* w, retiring)
+		while (!w->QThread::wait(10))
+			if (hasTasksPinnedTo(w))
+				break;
 }
 
-QTask* QScheduler::nextTask(QTask* _last, QWorker* _w)
+void QScheduler::reapWorkers()
 {
-	// Always runs from a QWorker thread.
+	l_workers.lock();
+	QList<QWorker*> done = m_retired;
+	m_retired.clear();
+	l_workers.unlock();
+	// With no tasks left, their deques and sleepers are empty, so nobody can look at them any more.
+	foreach (QWorker* w, done)
+		delete w;
+}
 
-	int ls = 0;
-	if (m_tasks.contains(_last))
+QTask* QScheduler::stealTask(QWorker* _thief)
+{
+	QList<QWorker*> const& ws = currentWorkers();
+	int n = ws.count();
+	double now = steadyTime();
+	for (int i = 1; i < n; i++)
 	{
-		_last->l_execution.unlock();
-		ls = _last->m_lastStatus;
+		QWorker* w = ws[(_thief->m_index + i) % n];
+		// It may be too busy to notice its idle tasks coming due; if we
+		// can get at them without waiting, we'll take any that have.
+		if (w->l_sleepers.tryLock())
+		{
+			double due = now;
+			bool roused = rouseDueTasks(w, now, due);
+			w->l_sleepers.unlock();
+			// They went to our own deque, bar those pinned to it.
+			if (roused)
+				if (QTask* t = _thief->takeDueTask(_thief))
+					return t;
+		}
+		if (QTask* t = w->takeDueTask(_thief))
+			return t;
+	}
+	return 0;
+}
+
+void QScheduler::sleepTask(QTask* _t, QWorker* _w)
+{
+	// Nobody else has it, since it's on no deque, so its idle state is
+	// ours to read; it's only written again once it's been readied.
+	QFastMutexLocker l(&_w->l_sleepers);
+	if (!_t->m_scheduler)
+		return;
+	// Pairs with QTask::wake(), which bumps m_wakeCount before looking at
+	// m_sleepingOn: one of us is sure to see the other.
+	_t->m_sleepingOn.fetchAndStoreOrdered(_w);
+	if (int(_t->m_wakeCount) != _t->m_idleWakeCount)
+	{
+		// Woken while it was running; it's due already.
+		_t->m_sleepingOn = 0;
+		if (int(_w->m_retiring) && _t->m_worker != _w)
+			handOverTask(_t);
+		else
+			_w->requeueTask(_t);
 	}
+	else
+		_w->m_sleepers.insert(_t->m_dueTime, _t);
+}
+
+void QScheduler::readyTask(QTask* _t)
+{
+	// Done under l_sleepers so that a retiring worker never sees a task
+	// pinned to it as neither asleep nor queued.
+	_t->m_sleepingOn = 0;
+	QWorker* w = QWorker::current();
+	if (_t->m_worker)
+		_t->m_worker->requeueTask(_t);
+	else if (w && w->m_boss == this && !int(w->m_retiring))
+		w->requeueTask(_t);
+	else
+		handOverTask(_t);
+}
 
-	l_tasks.lock();
+void QScheduler::rouseTask(QTask* _t)
+{
+	QWorker* w = _t->m_sleepingOn;
+	if (!w)
+		return;
+	QFastMutexLocker l(&w->l_sleepers);
+	// It may have been readied meanwhile (and even set aside again, but then
+	// only after it had been run since our wake).
+	if ((QWorker*)_t->m_sleepingOn != w)
+		return;
+	w->m_sleepers.remove(_t->m_dueTime, _t);
+	readyTask(_t);
+}
 
-	if (m_tasks.contains(_last))
+bool QScheduler::rouseDueTasks(QWorker* _w, double _now, double& _due)
+{
+	QMultiMap<double, QTask*>& s = _w->m_sleepers;
+	bool ret = false;
+	while (!s.isEmpty() && s.begin().key() <= _now)
 	{
-		if (ls == QTask::WillNeverWork)
+		QTask* t = s.begin().value();
+		s.erase(s.begin());
+		readyTask(t);
+		ret = true;
+	}
+	if (!s.isEmpty())
+		_due = qMin(_due, s.begin().key());
+	return ret;
+}
+
+void QScheduler::handOverSleepers(QWorker* _w)
+{
+	QFastMutexLocker l(&_w->l_sleepers);
+	QMultiMap<double, QTask*>& s = _w->m_sleepers;
+	for (QMultiMap<double, QTask*>::iterator i = s.begin(); i != s.end();)
+		if (i.value()->m_worker == _w)
+			++i;
+		else
 		{
-			_last->guaranteeStopped();
-			m_tasks.removeAll(_last);
-			_last->m_scheduler = 0;
-			_last->releaseGuarantee();
-			_last->onStopped();
+			// It'll be run early, but an idle task just goes back to sleep.
+			QTask* t = i.value();
+			i = s.erase(i);
+			readyTask(t);
 		}
-		else if (ls < 0)
+}
+
+bool QScheduler::hasTasksPinnedTo(QWorker* _w) const
+{
+	// Only its own worker runs a pinned task, so it's set aside there.
+	QFastMutexLocker l(&_w->l_sleepers);
+	foreach (QTask* t, _w->m_sleepers)
+		if (t->m_worker == _w)
+			return true;
+	return _w->hasPinnedTasks();
+}
+
+void QScheduler::wakeTask(QTask* _t)
+{
+	if ((QWorker*)_t->m_sleepingOn)
+		rouseTask(_t);
+
+	QWorker* w = QWorker::current();
+	// Set just once per start(), by the worker that then keeps it.
+	QWorker* pinned = _t->m_worker;
+	if (w && w->m_boss == this && w->m_running && w->m_running != _t && !w->m_continuation && w->m_chain < MaxChain && (pinned ? pinned == w : !int(w->m_retiring)))
+		// We'll run it ourselves next; no need to disturb anyone else.
+		w->m_continuation = _t;
+	else if (pinned)
+		// Only its own worker may run it, and we can't wake that one alone.
+		wakeAllWorkers();
+	else
+		wakeWorker();
+}
+
+QTask* QScheduler::takeTask(QWorker* _w, QTask* _t)
+{
+	if (QTask* t = _w->takeTask(_w, _t))
+		return t;
+	foreach (QWorker* w, currentWorkers())
+		if (w != _w)
+			if (QTask* t = w->takeTask(_w, _t))
+				return t;
+	return 0;
+}
+
+void QScheduler::wakeParked(bool _all)
+{
+	// Taking l_idle means that anyone who has counted themselves parked is
+	// now actually waiting, so can't miss this.
+	QFastMutexLocker l(&l_idle);
+	if (_all)
+		m_workAvailable.wakeAll();
+	else
+		m_workAvailable.wakeOne();
+}
+
+void QScheduler::park(int _ticket, unsigned long _ms)
+{
+	{
+		QFastMutexLocker l(&l_idle);
+		m_parked.ref();
+		// If a wake came after we took our ticket, it may have been for a
+		// task we passed over, so go round again.
+		if (int(m_wakes) == _ticket)
+			m_workAvailable.wait(&l_idle, _ms);
+		m_parked.deref();
+	}
+}
+
+QTask* QScheduler::nextTask(QTask* _last, QWorker* _w)
+{
+	// Always runs from a QWorker thread.
+	// We hold _last's l_execution, so nobody can unregister it under our feet.
+
+	if (_last)
+	{
+		int ls = _last->m_lastStatus;
+		_last->l_execution.unlock();
+
+		if (ls == QTask::WillNeverWork)
 		{
-			_w->m_sinceLastWorked++;
-			_w->m_waitPeriod = qMin((int)_w->m_waitPeriod, -ls);
-			if (_w->m_sinceLastWorked >= m_tasks.count())
+			// Nobody else has it, since it's on no deque, so it's ours to retire.
+			QFastMutexLocker l(&l_tasks);
+			if (_last->m_scheduler)
 			{
-				uint wp = _w->m_waitPeriod;
-				foreach (QWorker* w, m_workers)
-					if (w->m_sinceLastWorked < m_tasks.count())
-					{
-						wp = 1;
-						break;
-					}
-					else
-						wp = qMin(wp, w->m_waitPeriod);
-				l_tasks.unlock();
-				QWorker::setTerminationEnabled(true);
-//				qDebug("WORKER %d: SLEEPING FOR %d ms", _w->m_index, wp);
-				QThread::msleep(wp);
-				QWorker::setTerminationEnabled(false);
-				l_tasks.lock();
-				_w->m_waitPeriod = (int)-QTask::NoWork;
-				_w->m_sinceLastWorked = 0;
+				_last->guaranteeStopped();
+				m_tasks.removeAll(_last);
+				m_taskCount = m_tasks.count();
+				_last->m_scheduler = 0;
+				_last->releaseGuarantee();
+				_last->onStopped();
 			}
 		}
+		else if (_last->m_idle)
+			sleepTask(_last, _w);
+		else if (int(_w->m_retiring) && _last->m_worker != _w)
+			handOverTask(_last);
 		else
-		{
-			_w->m_waitPeriod = (int)-QTask::NoWork;
-			_w->m_sinceLastWorked = 0;
-		}
+			_w->requeueTask(_last);
+	}
+
+	bool retiring = int(_w->m_retiring);
+	if (retiring)
+	{
+		// Pass on our idle tasks, and anything woken for us meanwhile that may have been handed to us.
+		handOverSleepers(_w);
+		foreach (QTask* t, _w->takeUnpinnedTasks())
+			handOverTask(t);
+		if (!_w->m_continuation && !hasTasksPinnedTo(_w))
+			return 0;
 	}
 
-	QTask* ret = 0;
-	while (!ret)
+	if (_w->m_policy != int(m_policy))
+		_w->applyPolicy();
+
+	if (QTask* c = _w->m_continuation)
 	{
-		if (m_tasks.count() == 0)
+		_w->m_continuation = 0;
+		if (QTask* t = takeTask(_w, c))
 		{
-			l_tasks.unlock();
-			QWorker::setTerminationEnabled(true);
-			QThread::msleep(100);
-			QWorker::setTerminationEnabled(false);
-			l_tasks.lock();
-		}
-		else
-		{
-			ret = m_tasks[(m_tasks.indexOf(_last) + 1) % m_tasks.count()];
-			if (!ret->l_execution.tryLock())
-			{
-				_last = ret;
-				ret = 0;
-			}
+			_w->m_chain++;
+			return t;
 		}
+		// Someone else has it or it's gone; either way we kept quiet about
+		// it, so make up for that now.
+		wakeWorker();
+	}
+	_w->m_chain = 0;
+
+	while (true)
+	{
+		int ticket = m_wakes;
+		double now = steadyTime();
+		// With nothing registered there's nothing to wake us, so check back now and again.
+		double due = now + 0.1;
+		_w->l_sleepers.lock();
+		rouseDueTasks(_w, now, due);
+		_w->l_sleepers.unlock();
+		QTask* ret = _w->takeDueTask(_w);
+		if (!ret && !retiring)
+			ret = stealTask(_w);
+		if (ret)
+			return ret;
+
+		// Nothing is due; sleep until something is woken or the earliest idle task's time is up.
+		park(ticket, qMax<unsigned long>(1, (unsigned long)ceil((due - now) * 1000.0)));
 	}
-	l_tasks.unlock();
-	return ret;
 }
@@ -19,7 +19,11 @@
 #pragma once
 
 #include <QString>
+#include <QStringList>
 #include <QList>
+#include <QMap>
+#include <QAtomicInt>
+#include <QAtomicPointer>
 
 #include "qfastwaitcondition.h"
 #include "rdtsc.h"
@@ -32,18 +36,80 @@ namespace QtExtra
 class QTask;
 class QWorker;
 
+/** @internal @ingroup QtExtra
+ * @brief Distributes QTasks between a pool of QWorker threads.
+ * @author Gav Wood <gav@kde.org>
+ *
+ * Each registered task lives in exactly one worker's deque (or is being run
+ * by exactly one worker). Workers run their own tasks round-robin and steal
+ * from each other when they run out, so picking the next task is O(1) and
+ * l_tasks is only taken on (un)registration. The workers are published as
+ * an immutable list whenever they change, so stealing and handing tasks over
+ * needn't take l_workers either.
+ *
+ * Tasks that return a negative status are idle and are set aside by the worker
+ * that ran them, ordered by when they're due, until either their time is up
+ * or somebody calls QTask::wake() on them (as Buffer does when data or space
+ * arrives). The deques only ever hold tasks that are due, so neither running
+ * nor stealing has to look past the end of one. Each worker readies its own
+ * idle tasks, and those of busy workers when it has nothing else to do, so
+ * picking, setting aside and waking take no lock that all workers share.
+ * Workers with nothing due park until the next wake or their earliest idle
+ * task's time rather than polling.
+ *
+ * When a task wakes another while it's running (typically a producer pushing
+ * to its consumer), the worker notes the woken task and runs it next, while
+ * the data is still in its cache. Such chains are cut after MaxChain links so
+ * a busy pipeline can't keep the rest of the deque waiting.
+ *
+ * There may be several schedulers ("pools"), each with its own workers, CPU
+ * affinity and OS priority, so that, say, a real-time capture chain needn't
+ * compete with visualisation. A task is run by the pool named by
+ * QTask::pool(); get() is the default, unnamed, pool.
+ */
 class DLLEXPORT QScheduler
 {
+	friend class QWorker;
+
 public:
-	QScheduler(int _workers = -1);
+	QScheduler(QString const& _name = QString(), int _workers = -1);
 	~QScheduler();
 
-	static QScheduler* get() { if (!s_this) s_this = new QScheduler; return s_this; }
+	static QScheduler* get() { if (!s_this) s_this = pool(QString()); return s_this; }
+	/// @return The pool called @a _name, created (with a single worker) if need be.
+	static QScheduler* pool(QString const& _name);
+	static QStringList pools();
 
 	inline static double currentTime() { return rdtscElapsed(get()->m_startRdtsc); }
-
+	/// As currentTime(), but never jumps back when the default pool starts again.
+	inline static double steadyTime() { return rdtscElapsed(0); }
+
+	QString name() const { return m_name; }
+	int workerCount() const { QFastMutexLocker l(&l_workers); return m_workers.count(); }
+
+	/// Restricts our workers to the CPUs in @a _cpus; an empty list means any CPU.
+	void setAffinity(QList<int> const& _cpus);
+	QList<int> affinity() const { QFastMutexLocker l(&l_workers); return m_cpus; }
+
+	/**
+	 * Sets the OS priority of our workers. If @a _realTime, @a _priority is a
+	 * SCHED_FIFO priority (1 to 99), and we fall back to normal scheduling
+	 * where that isn't permitted. Otherwise it's a nice value (-20 to 19).
+	 */
+	void setPriority(int _priority, bool _realTime = false);
+	int priority() const { QFastMutexLocker l(&l_workers); return m_priority; }
+	bool isRealTime() const { QFastMutexLocker l(&l_workers); return m_realTime; }
+
+	/// @return The next task for @a _w to run, or zero if it has retired and has nothing left.
 	QTask* nextTask(QTask* _last, QWorker* _w);
 
+	/**
+	 * Starts or retires workers so that there are @a _n (or one per CPU if
+	 * -1). A retiring worker takes no more tasks and hands over those it has;
+	 * we return once it's finished, unless it still has tasks pinned to it,
+	 * in which case it finishes once it's done with them. Retired workers are
+	 * only deleted along with us, since a waker may yet look at one.
+	 */
 	void setWorkers(int _n = -1);
 
 	void registerTask(QTask* _p);
@@ -51,21 +117,90 @@ public:
 	void clearTasks();
 	void inDestructor(QTask* _p);
 
+	/// Wakes a parked worker, if any, since some task has become due.
+	void wakeWorker() { m_wakes.ref(); if (int(m_parked)) wakeParked(false); }
+	/// Notes that @a _t has become due; it'll be run next by this thread if it's a worker.
+	void wakeTask(QTask* _t);
+	/// Wakes all parked workers.
+	void wakeAllWorkers() { m_wakes.ref(); wakeParked(true); }
+
 	QList<QTask*> tasks() const { QList<QTask*> ret; l_tasks.lock(); foreach (QTask* t, m_tasks) ret << t; l_tasks.unlock(); return ret; }
 	QList<QWorker*> workers() const { QList<QWorker*> ret; l_workers.lock(); foreach (QWorker* w, m_workers) ret << w; l_workers.unlock(); return ret; }
 
 private:
+	/// Takes @a _t off every deque.
+	void forgetTask(QTask* _t);
+	/// @return The workers as they were last published; only valid until we're deleted.
+	QList<QWorker*> const& currentWorkers() const { return *(QList<QWorker*>*)m_current; }
+	/// Publishes m_workers as m_current. Must hold l_workers.
+	void publishWorkers();
+	/// Puts @a _t on the next worker's deque (round-robin).
+	void assignTask(QTask* _t);
+	/// As assignTask(), but only if @a _t is still registered; for tasks taken from a retiring worker.
+	void handOverTask(QTask* _t);
+	/// Hands over the tasks on @a _w's deque if it has retired since we picked it from m_current.
+	void reclaimTasks(QWorker* _w);
+	/// Waits for and deletes all the retired workers.
+	void reapWorkers();
+	/// Takes a task from some other worker's deque, if there is one.
+	QTask* stealTask(QWorker* _thief);
+	/// Takes @a _t from whichever deque it's on, or returns zero.
+	QTask* takeTask(QWorker* _w, QTask* _t);
+	/// Sets @a _t, which has just been run idle by @a _w, aside until it's due.
+	void sleepTask(QTask* _t, QWorker* _w);
+	/// Puts @a _t back on a deque if it was set aside. Must hold the l_sleepers of the worker it's asleep on.
+	void readyTask(QTask* _t);
+	/// Readies @a _t if it's asleep, since it's been woken.
+	void rouseTask(QTask* _t);
+	/**
+	 * Readies every task set aside by @a _w whose time is up by @a _now, and
+	 * brings @a _due forward to the next one's. Must hold @a _w's l_sleepers.
+	 *
+	 * @return true if any were readied.
+	 */
+	bool rouseDueTasks(QWorker* _w, double _now, double& _due);
+	/// Readies all the tasks set aside by @a _w, which is retiring, but for those pinned to it.
+	void handOverSleepers(QWorker* _w);
+	/// @return true if any task, queued or set aside, is pinned to @a _w.
+	bool hasTasksPinnedTo(QWorker* _w) const;
+	/// Waits up to @a _ms milliseconds for a wake, unless there has been one since @a _ticket.
+	void park(int _ticket, unsigned long _ms);
+	void wakeParked(bool _all);
+
 	mutable QFastMutex l_tasks;
 	QList<QTask*> m_tasks;
+	int m_taskCount;
 	mutable QFastMutex l_workers;
 	QList<QWorker*> m_workers;
-
-	int m_robin;
-	int m_sinceLastWorked;
+	/// A copy of m_workers, replaced whenever they change, for reading without l_workers.
+	QAtomicPointer<QList<QWorker*> > m_current;
+	/// Copies replaced in m_current, kept until we're deleted since a reader may still have one; guarded by l_workers.
+	QList<QList<QWorker*>*> m_superseded;
+	QList<QTask*> m_orphans;	///< Tasks waiting for a worker; guarded by l_workers.
+	QList<QWorker*> m_retired;	///< Workers retired but not yet deleted; guarded by l_workers.
+
+	enum { MaxChain = 8 };
+
+	QString m_name;
+	QAtomicInt m_robin;
+
+	// Guarded by l_workers; m_policy is bumped whenever they change so that
+	// workers know to apply them to themselves.
+	QList<int> m_cpus;
+	int m_priority;
+	bool m_realTime;
+	QAtomicInt m_policy;
+
+	QAtomicInt m_wakes;	///< Bumped on every wake, so a worker can tell if it missed one.
+	QAtomicInt m_parked;
+	QFastMutex l_idle;
+	QFastWaitCondition m_workAvailable;
 
 	realTime m_startRdtsc;
 
 	static QScheduler* s_this;
+	static QMap<QString, QScheduler*> s_pools;
+	static QFastMutex s_poolsLock;
 };
 
 }
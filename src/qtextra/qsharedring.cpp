@@ -0,0 +1,267 @@
+/* Copyright 2003, 2004, 2005, 2007, 2009, 2010 Gavin Wood <gav@kde.org>
+ *
+ * This file is part of Exscalibar.
+ *
+ * Exscalibar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Exscalibar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Exscalibar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdlib>
+#include <cstring>
+
+#include "qfastwaitcondition.h"
+#include "qsharedring.h"
+
+#ifdef HAVE_LINUX
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+#define MESSAGES 0
+
+// Lives at the start of the segment; the words follow on the next cache line.
+// m_head and m_tail count words ever written and released; they wrap, but
+// their difference never exceeds m_capacity. m_capacity is a power of two, so
+// a count masked with m_capacity - 1 is its offset even across the wrap.
+struct QSharedRing::Header
+{
+	enum { Magic = 0x67527331 };
+
+	uint32_t m_magic;
+	uint32_t m_nonce;
+	uint32_t m_capacity;
+	char m_pad1[52];
+	volatile int m_head;
+	volatile int m_readerWaiting;
+	char m_pad2[56];
+	volatile int m_tail;
+	volatile int m_writerWaiting;
+	char m_pad3[56];
+};
+
+#ifdef HAVE_LINUX
+
+// Not FUTEX_*_PRIVATE, since the futex is shared between processes.
+static bool sharedFutexWait(volatile int *_address, int _value, uint _timeOut)
+{
+	timespec ts;
+	ts.tv_sec = _timeOut / 1000;
+	ts.tv_nsec = (_timeOut % 1000) * 1000000;
+	return !(syscall(SYS_futex, _address, FUTEX_WAIT, _value, &ts, 0, 0) == -1 && errno == ETIMEDOUT);
+}
+
+static void sharedFutexWake(volatile int *_address)
+{
+	syscall(SYS_futex, _address, FUTEX_WAKE, INT_MAX, 0, 0, 0);
+}
+
+bool QSharedRing::map(int _fd, uint _bytes)
+{
+	void *base = mmap(0, _bytes, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+	::close(_fd);
+	if (base == MAP_FAILED)
+		return false;
+	m_header = (Header *)base;
+	m_data = (float *)(m_header + 1);
+	m_bytes = _bytes;
+	m_position = 0;
+	return true;
+}
+
+bool QSharedRing::create(uint _words)
+{
+	close();
+
+	uint words = 1;
+	while (words < _words)
+		words <<= 1;
+
+	static int s_count = 0;
+	m_name = "/geddei-" + QByteArray::number((int)getpid()) + "-" + QByteArray::number(__sync_fetch_and_add(&s_count, 1));
+	int fd = shm_open(m_name.constData(), O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+	if (fd == -1)
+	{	if (MESSAGES) qDebug("QSharedRing: Couldn't create %s.", m_name.constData());
+		return false;
+	}
+	uint bytes = sizeof(Header) + words * sizeof(float);
+	if (ftruncate(fd, bytes) != 0)
+		::close(fd);
+	else if (map(fd, bytes))
+		fd = -1;
+	if (fd != -1)
+	{	shm_unlink(m_name.constData());
+		m_name = QByteArray();
+		return false;
+	}
+	m_owner = true;
+
+	m_header->m_capacity = words;
+	m_header->m_nonce = rand();
+	m_header->m_head = m_header->m_tail = 0;
+	m_header->m_readerWaiting = m_header->m_writerWaiting = 0;
+	__sync_synchronize();
+	m_header->m_magic = Header::Magic;
+	return true;
+}
+
+bool QSharedRing::attach(QByteArray const& _name, uint32_t _nonce)
+{
+	close();
+
+	int fd = shm_open(_name.constData(), O_RDWR, 0);
+	if (fd == -1)
+		return false;
+	struct stat s;
+	if (fstat(fd, &s) != 0 || uint(s.st_size) < sizeof(Header))
+	{	::close(fd);
+		return false;
+	}
+	if (!map(fd, s.st_size))
+		return false;
+	m_name = _name;
+	m_owner = false;
+
+	if (m_header->m_magic != Header::Magic || m_header->m_nonce != _nonce || !m_header->m_capacity || (m_header->m_capacity & (m_header->m_capacity - 1)) || sizeof(Header) + m_header->m_capacity * sizeof(float) > m_bytes)
+	{	if (MESSAGES) qDebug("QSharedRing: %s isn't the one we're looking for.", _name.constData());
+		close();
+		return false;
+	}
+	return true;
+}
+
+void QSharedRing::unlink()
+{
+	if (m_owner && !m_name.isEmpty())
+		shm_unlink(m_name.constData());
+	m_owner = false;
+}
+
+void QSharedRing::close()
+{
+	unlink();
+	if (m_header)
+		munmap(m_header, m_bytes);
+	m_header = 0;
+	m_data = 0;
+	m_name = QByteArray();
+}
+
+bool QSharedRing::waitForSpace(uint _words, uint _timeOut)
+{
+	uint capacity = m_header->m_capacity;
+	for (;;)
+	{
+		int tail = m_header->m_tail;
+		if (capacity - (m_position - uint(tail)) >= _words)
+			return true;
+		// Say we're waiting, then look again; the reader moves m_tail and
+		// then looks to see if we're waiting, so one of us sees the other.
+		m_header->m_writerWaiting = 1;
+		__sync_synchronize();
+		if (m_header->m_tail == tail && !sharedFutexWait(&m_header->m_tail, tail, _timeOut))
+			return capacity - (m_position - uint(m_header->m_tail)) >= _words;
+	}
+}
+
+void QSharedRing::write(const float *_data, uint _words)
+{
+	uint capacity = m_header->m_capacity;
+	uint offset = m_position & (capacity - 1);
+	uint first = qMin(_words, capacity - offset);
+	memcpy(m_data + offset, _data, first * sizeof(float));
+	memcpy(m_data, _data + first, (_words - first) * sizeof(float));
+	m_position += _words;
+}
+
+void QSharedRing::commit()
+{
+	__sync_synchronize();
+	m_header->m_head = m_position;
+	__sync_synchronize();
+	if (m_header->m_readerWaiting)
+	{	m_header->m_readerWaiting = 0;
+		sharedFutexWake(&m_header->m_head);
+	}
+}
+
+bool QSharedRing::waitForData(uint _words, uint _timeOut)
+{
+	for (;;)
+	{
+		int head = m_header->m_head;
+		if (uint(head) - m_position >= _words)
+		{	__sync_synchronize();
+			return true;
+		}
+		m_header->m_readerWaiting = 1;
+		__sync_synchronize();
+		if (m_header->m_head == head && !sharedFutexWait(&m_header->m_head, head, _timeOut))
+		{	__sync_synchronize();
+			return uint(m_header->m_head) - m_position >= _words;
+		}
+	}
+}
+
+void QSharedRing::read(float *_data, uint _words)
+{
+	uint capacity = m_header->m_capacity;
+	uint offset = m_position & (capacity - 1);
+	uint first = qMin(_words, capacity - offset);
+	memcpy(_data, m_data + offset, first * sizeof(float));
+	memcpy(_data + first, m_data, (_words - first) * sizeof(float));
+	m_position += _words;
+}
+
+void QSharedRing::release()
+{
+	__sync_synchronize();
+	m_header->m_tail = m_position;
+	__sync_synchronize();
+	if (m_header->m_writerWaiting)
+	{	m_header->m_writerWaiting = 0;
+		sharedFutexWake(&m_header->m_tail);
+	}
+}
+
+#else
+
+bool QSharedRing::create(uint) { return false; }
+bool QSharedRing::attach(QByteArray const&, uint32_t) { return false; }
+void QSharedRing::unlink() {}
+void QSharedRing::close() {}
+bool QSharedRing::waitForSpace(uint, uint) { return false; }
+void QSharedRing::write(const float *, uint) {}
+void QSharedRing::commit() {}
+bool QSharedRing::waitForData(uint, uint) { return false; }
+void QSharedRing::read(float *, uint) {}
+void QSharedRing::release() {}
+
+#endif
+
+uint32_t QSharedRing::nonce() const
+{
+	return m_header ? m_header->m_nonce : 0;
+}
+
+uint QSharedRing::capacity() const
+{
+	return m_header ? m_header->m_capacity : 0;
+}
+
+#undef MESSAGES
@@ -0,0 +1,158 @@
+/* Copyright 2003, 2004, 2005, 2007, 2009, 2010 Gavin Wood <gav@kde.org>
+ *
+ * This file is part of Exscalibar.
+ *
+ * Exscalibar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Exscalibar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Exscalibar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <QByteArray>
+
+#include <exscalibar.h>
+
+/** @ingroup QtExtra
+ * @brief A ring of 32-bit words in memory shared between two processes.
+ * @author Gav Wood <gav@kde.org>
+ *
+ * QSharedRing lets a process pass words to another on the same host without
+ * going through the kernel. One side create()s it and passes name() (and
+ * nonce()) to the other by some other means (e.g. a QSocketSession), which
+ * then attach()es to it. Once both have it mapped, the creator may unlink()
+ * the name so nothing is left behind should either die.
+ *
+ * Exactly one side writes and the other reads. Each waits on the other with
+ * a futex in the shared memory itself, so neither needs to poll. Waits take a
+ * timeout so that the caller can check for the other side having gone away.
+ *
+ * Only available on Linux; elsewhere create() and attach() always fail.
+ *
+ * This is not thread-safe or reentrant.
+ */
+class DLLEXPORT QSharedRing
+{
+public:
+	/**
+	 * Basic constructor. The ring is not open until create() or attach().
+	 */
+	QSharedRing(): m_header(0), m_data(0), m_bytes(0), m_position(0), m_owner(false) {}
+
+	/**
+	 * Detaches, and unlinks if need be.
+	 */
+	~QSharedRing() { close(); }
+
+	/**
+	 * Creates a new shared segment with room for at least @a words words;
+	 * capacity() is @a words rounded up to a power of two.
+	 *
+	 * @return true if it was created ok.
+	 */
+	bool create(uint words);
+
+	/**
+	 * Attaches to the segment called @a name, as made by create() in some
+	 * other process, checking that its nonce() is @a nonce.
+	 *
+	 * @return true if it was attached ok.
+	 */
+	bool attach(QByteArray const& name, uint32_t nonce);
+
+	/**
+	 * Removes the name of the segment we created, so it goes once both sides
+	 * are done with it. Nothing more may attach() after this.
+	 */
+	void unlink();
+
+	/**
+	 * Detaches from the segment.
+	 */
+	void close();
+
+	/**
+	 * @return true if we're attached to a segment.
+	 */
+	bool isOpen() const { return m_header; }
+
+	/**
+	 * @return The name of the segment, to be given to attach().
+	 */
+	QByteArray const& name() const { return m_name; }
+
+	/**
+	 * @return A random number picked by create(), to make sure that attach()
+	 * has found the same segment rather than one of the same name elsewhere.
+	 */
+	uint32_t nonce() const;
+
+	/**
+	 * @return The most words the ring can hold.
+	 */
+	uint capacity() const;
+
+	/**
+	 * Blocks until there's room for @a words words, or @a timeOut
+	 * milliseconds pass. @a words must be no more than capacity().
+	 *
+	 * @return true if there is room.
+	 */
+	bool waitForSpace(uint words, uint timeOut);
+
+	/**
+	 * Appends @a words words from @a data. There must be room for them; see
+	 * waitForSpace(). They're not seen by the reader until commit().
+	 */
+	void write(const float *data, uint words);
+
+	/**
+	 * Makes everything written so far visible to the reader.
+	 */
+	void commit();
+
+	/**
+	 * Blocks until @a words words may be read, or @a timeOut milliseconds
+	 * pass.
+	 *
+	 * @return true if they may be read.
+	 */
+	bool waitForData(uint words, uint timeOut);
+
+	/**
+	 * Takes @a words words into @a data. They must be there; see
+	 * waitForData(). The space isn't given back to the writer until release().
+	 */
+	void read(float *data, uint words);
+
+	/**
+	 * Gives the space of everything read so far back to the writer.
+	 */
+	void release();
+
+private:
+	struct Header;
+
+	/**
+	 * Maps @a _bytes of @a _fd, which it closes either way.
+	 */
+	bool map(int _fd, uint _bytes);
+
+	Header *m_header;
+	float *m_data;
+	uint m_bytes;
+	uint m_position;
+	QByteArray m_name;
+	bool m_owner;
+};
@@ -17,14 +17,24 @@
  */
 
 #include <cstdlib>
+#include <climits>
 
 #include <QThread>
+#include <QVarLengthArray>
 
+#ifdef Q_OS_UNIX
+#include <errno.h>
+#include <poll.h>
+#include <sys/uio.h>
+#endif
+
+#include "qvectormath.h"
+#include "qmultiplexedlink.h"
 #include "qsocketsession.h"
 
 #define MESSAGES 0
 
-QSocketSession::QSocketSession(QTcpSocket *sd): theSD(sd)
+QSocketSession::QSocketSession(QIODevice *sd): theSD(sd), theSocket(dynamic_cast<QTcpSocket *>(sd))
 {
 	if (MESSAGES) qDebug("New QSocketSession...");
 	theClosed = false;
@@ -40,10 +50,28 @@ void QSocketSession::close()
 {
 	if (theClosed) return;
 	theClosed = true;
-	if (theSD->isValid())
+	if (theSocket ? theSocket->isValid() : theSD->isOpen())
 		theSD->close();
 }
 
+QHostAddress QSocketSession::peerAddress() const
+{
+	if (theSocket)
+		return theSocket->peerAddress();
+	if (QMultiplexedChannel *c = dynamic_cast<QMultiplexedChannel *>(theSD))
+		return c->link()->peerAddress();
+	return QHostAddress();
+}
+
+QHostAddress QSocketSession::localAddress() const
+{
+	if (theSocket)
+		return theSocket->localAddress();
+	if (QMultiplexedChannel *c = dynamic_cast<QMultiplexedChannel *>(theSD))
+		return c->link()->localAddress();
+	return QHostAddress();
+}
+
 void QSocketSession::handshake()
 {
 	if (MESSAGES) qDebug("Handshaking... (isOpen()=%d)", isOpen());
@@ -125,7 +153,7 @@ void QSocketSession::receiveChunk(uchar *buffer, uint size)
 {
 	int r = 1;
 	uint read = 0;
-	while (r > 0 && read < size && isOpen() && theSD->waitForReadyRead())
+	while (r > 0 && read < size && isOpen() && theSD->waitForReadyRead(30000))
 	{	r = theSD->read((char *)(buffer + read), size - read);
 		read += r;
 	}
@@ -135,14 +163,69 @@ void QSocketSession::receiveChunk(uchar *buffer, uint size)
 	}
 }
 
-void QSocketSession::sendChunk(const uchar *buffer, uint size)
+void QSocketSession::sendChunks(const Chunk *chunks, uint count)
 {
-	int r = 1;
+	uint size = 0;
+	for (uint i = 0; i < count; i++)
+		size += chunks[i].size;
 	uint sent = 0;
-	while (r > 0 && sent < size && isOpen())
-	{	r = theSD->write((const char *)(buffer + sent), size - sent);
-		theSD->waitForBytesWritten();
-		sent += r;
+#ifdef Q_OS_UNIX
+	if (theSocket)
+	{
+		// Anything sent through the socket before (e.g. by sendByte()) is
+		// still in its buffer, and must go first.
+		while (isOpen() && theSocket->bytesToWrite() > 0)
+			if (!theSocket->waitForBytesWritten())
+				close();
+
+		QVarLengthArray<iovec, 8> v;
+		for (uint i = 0; i < count; i++)
+			if (chunks[i].size)
+			{	iovec c = { chunks[i].data, chunks[i].size };
+				v.append(c);
+			}
+		int fd = theSocket->socketDescriptor();
+		for (int i = 0; i < v.size() && isOpen();)
+		{
+			ssize_t r = ::writev(fd, v.data() + i, qMin(v.size() - i, IOV_MAX));
+			if (r < 0)
+			{	if (errno == EAGAIN || errno == EWOULDBLOCK)
+				{	// The socket's non-blocking and its buffer is full.
+					pollfd p = { fd, POLLOUT, 0 };
+					if (::poll(&p, 1, 30000) <= 0)
+						break;
+				}
+				else if (errno != EINTR)
+					break;
+				continue;
+			}
+			sent += r;
+			for (; i < v.size() && size_t(r) >= v[i].iov_len; i++)
+				r -= v[i].iov_len;
+			if (i < v.size())
+			{	v[i].iov_base = (char *)v[i].iov_base + r;
+				v[i].iov_len -= r;
+			}
+		}
+	}
+	else
+#endif
+	// Other devices (e.g. QMultiplexedChannel) queue what they're given, so
+	// there's no need to wait on them.
+	for (uint i = 0; i < count && isOpen(); i++)
+	{	const uchar *buffer = (const uchar *)chunks[i].data;
+		uint done = 0;
+		int r = 1;
+		while (r > 0 && done < chunks[i].size && isOpen())
+		{	r = theSD->write((const char *)(buffer + done), chunks[i].size - done);
+			if (theSocket)
+				theSocket->waitForBytesWritten();
+			if (r > 0)
+				done += r;
+		}
+		sent += done;
+		if (done != chunks[i].size)
+			break;
 	}
 	if (sent != size)
 	{	qWarning("*** INFO: Couldn't transmit data. Attempted to send %d bytes, sent %d."
@@ -232,11 +315,9 @@ uint32_t QSocketSession::safeReceiveWord()
 template<>
 void QSocketSession::safeReceiveWordArray(float *t, uint32_t size)
 {
-	int32_t *array = (int32_t *)t;
-	receiveChunk((uchar *)array, 4 * size);
+	receiveChunk((uchar *)t, 4 * size);
 	if (!theSameByteOrder)
-		for (uint32_t i = 0; i < size; i++)
-			array[i] = bswap_32(array[i]);
+		QtExtra::vbswap((uint32_t *)t, (uint32_t *)t, size);
 }
 
 template<>
@@ -244,18 +325,15 @@ void QSocketSession::safeReceiveWordArray(int32_t *t, uint32_t size)
 {
 	receiveChunk((uchar *)t, 4 * size);
 	if (!theSameByteOrder)
-		for (uint32_t i = 0; i < size; i++)
-			t[i] = bswap_32(t[i]);
+		QtExtra::vbswap((uint32_t *)t, (uint32_t *)t, size);
 }
 
 template<>
 void QSocketSession::safeReceiveWordArray(uint32_t *t, uint32_t size)
 {
-	int32_t *array = (int32_t *)t;
-	receiveChunk((uchar *)array, 4 * size);
+	receiveChunk((uchar *)t, 4 * size);
 	if (!theSameByteOrder)
-		for (uint32_t i = 0; i < size; i++)
-			array[i] = bswap_32(array[i]);
+		QtExtra::vbswap((uint32_t *)t, (uint32_t *)t, size);
 }
 
 QByteArray QSocketSession::receiveString()
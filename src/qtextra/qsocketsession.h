@@ -31,9 +31,11 @@
  * @author Gav Wood <gav@kde.org>
  *
  * QSocketSession provides a suitable interface to TCP sockets for more
- * high-level uses. Through handshaking, it can determine if both hosts share
- * the same byte ordering for words, and through its "safe" methods can alter
- * transmissions accordingly transparently to the developer.
+ * high-level uses. It may also be given any other sequential QIODevice that
+ * behaves like a socket, such as a QMultiplexedChannel. Through handshaking,
+ * it can determine if both hosts share the same byte ordering for words, and
+ * through its "safe" methods can alter transmissions accordingly
+ * transparently to the developer.
  *
  * It also provides other methods to listen on timeouts and and send higher
  * level data such as QCStrings.
@@ -47,7 +49,8 @@
 class DLLEXPORT QSocketSession
 {
 	bool theIsMaster, theSameByteOrder, theClosed;
-	QTcpSocket *theSD;
+	QIODevice *theSD;
+	QTcpSocket *theSocket;
 
 	void findByteOrder();
 
@@ -61,7 +64,26 @@ public:
 	 */
 	//@{
 
-	QTcpSocket* sd() const { return theSD; }
+	/**
+	 * @return The socket we communicate through, or 0 if it's not a
+	 * QTcpSocket.
+	 */
+	QTcpSocket* sd() const { return theSocket; }
+
+	/**
+	 * @return The device we communicate through.
+	 */
+	QIODevice* device() const { return theSD; }
+
+	/**
+	 * @return The address of the other side of the connection.
+	 */
+	QHostAddress peerAddress() const;
+
+	/**
+	 * @return The address of this side of the connection.
+	 */
+	QHostAddress localAddress() const;
 
 	/**
 	 * Determine if the current connection is open.
@@ -70,7 +92,7 @@ public:
 	 */
 	bool isOpen()
 	{
-		if (!theSD->isValid())
+		if (theSocket ? !theSocket->isValid() : !theSD->isOpen() || theSD->atEnd())
 			theClosed = true;
 		return !theClosed;
 	}
@@ -115,7 +137,32 @@ public:
 	 *
 	 * @sa receiveChunk()
 	 */
-	void sendChunk(const uchar *buffer, uint size);
+	void sendChunk(const uchar *buffer, uint size) { Chunk c(buffer, size); sendChunks(&c, 1); }
+
+	/**
+	 * A piece of data for sendChunks().
+	 */
+	struct Chunk
+	{
+		Chunk(const void *_data = 0, uint _size = 0): data(const_cast<void *>(_data)), size(_size) {}
+		void *data;
+		uint size;
+	};
+
+	/**
+	 * Send a number of arrays of bytes down the connection one after another
+	 * as a single entity, without first copying them together. Where
+	 * possible it is done with a single system call, so it is much better
+	 * than a sendChunk() for each when sending e.g. a header and the two
+	 * parts of a rolled-over BufferData. Matches any receiveChunk() calls
+	 * that add up to the same total size.
+	 *
+	 * @param chunks The arrays, in order.
+	 * @param count The number of arrays.
+	 *
+	 * @sa sendChunk()
+	 */
+	void sendChunks(const Chunk *chunks, uint count);
 
 	/**
 	 * Receive a single byte from the connection. Matches sendByte().
@@ -154,6 +201,19 @@ public:
 		return theSD->bytesAvailable();
 	}
 
+	/**
+	 * Block until there is something to be received, the connection fails or
+	 * @a timeOut milliseconds pass. Unlike receiveChunk(), timing out leaves
+	 * the connection open, so this may be used to poll.
+	 *
+	 * @param timeOut Number of milliseconds to wait; 0 to just check.
+	 * @return true if there is something waiting to be received.
+	 */
+	bool waitForData(uint timeOut = 0)
+	{
+		return theSD->bytesAvailable() > 0 || (isOpen() && theSD->waitForReadyRead(timeOut));
+	}
+
 	/**
 	 * Receive some number of bytes from the connection. The number received is
 	 * stated in @a size.
@@ -346,11 +406,11 @@ public:
 	/**
 	 * Basic constructor.
 	 *
-	 * @param sd The QSocketDevice this session will use to do its
-	 * communications. It will adopt this and thus destroy it when this object
+	 * @param sd The socket (or other sequential QIODevice) this session will
+	 * use to do its communications. It will adopt this and thus destroy it when this object
 	 * gets destroyed. Deleting @a sd yourself will result in a memory error.
 	 */
-	QSocketSession(QTcpSocket *sd);
+	QSocketSession(QIODevice *sd);
 
 	/**
 	 * Safe destructor.
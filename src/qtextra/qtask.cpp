@@ -18,6 +18,7 @@
 
 #include <sys/time.h>
 
+#include "qfiber.h"
 #include "qscheduler.h"
 #include "qworker.h"
 #include "qtask.h"
@@ -26,7 +27,13 @@ using namespace QtExtra;
 
 QTask::QTask():
 	m_scheduler(0),
-	m_lastStatus(WillNeverWork)
+	m_lastStatus(WillNeverWork),
+	m_wakeCount(0),
+	m_sleepingOn(0),
+	m_idle(false),
+	m_idleWakeCount(0),
+	m_dueTime(0.0),
+	m_worker(0)
 {
 }
 
@@ -38,7 +45,7 @@ QTask::~QTask()
 
 void QTask::start()
 {
-	QScheduler::get()->registerTask(this);
+	QScheduler::pool(m_pool)->registerTask(this);
 	m_taskCount = 0;
 	m_totalTime = 0.0;
 }
@@ -50,14 +57,40 @@ void QTask::stop()
 
 void QTask::wait() const
 {
+	// On a fiber, so as not to hold up the worker it's on.
 	while (m_scheduler)
-		QWorker::msleep(1);
+		if (QFiber::current())
+			QFiber::sleep(1);
+		else
+			QWorker::msleep(1);
+}
+
+void QTask::wake()
+{
+	m_wakeCount.ref();
+	if (QScheduler* s = m_scheduler)
+		s->wakeTask(this);
+}
+
+void QTask::pinToWorker()
+{
+	if (!m_worker)
+		m_worker = QWorker::current();
 }
 
 void QTask::attemptProcess()
 {
+	// Anything that wakes us from here on might not have been seen by doWork().
+	int wc = m_wakeCount;
 	unsigned long long s = rdtsc();
 	m_lastStatus = doWork();
 	m_totalTime += rdtscElapsed(s);
 	m_taskCount++;
+
+	m_idle = m_lastStatus < 0 && m_lastStatus != WillNeverWork;
+	if (m_idle)
+	{
+		m_idleWakeCount = wc;
+		m_dueTime = QScheduler::steadyTime() + -m_lastStatus / 1000.0;
+	}
 }
@@ -20,6 +20,8 @@
 
 #include <QString>
 #include <QMutex>
+#include <QAtomicInt>
+#include <QAtomicPointer>
 
 #include <exscalibar.h>
 #include "qfastwaitcondition.h"
@@ -28,6 +30,7 @@ namespace QtExtra
 {
 
 class QScheduler;
+class QWorker;
 
 class DLLEXPORT QTask
 {
@@ -42,29 +45,62 @@ public:
 	// -ve for how long (in us) we will be ignored.
 	// WillNeverWork and we will be ignored forever.
 	// NoWork and we will be ignored until something else completes work (or 15ms).
-	enum { WillNeverWork = INT_MIN, NoWork = -15, ImminentWork = -1, DidWork = 0, NoMoreWork = 0, CanWork = 1, CanStillWork = 1 };
+	// AwaitingWake and we will be ignored until wake() (or, as a fail-safe, a second).
+	// In any case, wake() will make us due again immediately.
+	enum { WillNeverWork = INT_MIN, AwaitingWake = -1000, NoWork = -15, ImminentWork = -1, DidWork = 0, NoMoreWork = 0, CanWork = 1, CanStillWork = 1 };
 
 	void start();
 	void stop();
 	void wait() const;
 	bool isRunning() const { return m_scheduler; }
 
+	/// Sets the QScheduler pool we'll be run in the next time we start().
+	void setPool(QString const& _pool) { m_pool = _pool; }
+	QString pool() const { return m_pool; }
+
+	/**
+	 * Notes that something we may have been waiting on (e.g. input data or
+	 * output space) has changed, so that if we're idle we become due again
+	 * right away and, if a worker is parked, it gets woken to run us.
+	 *
+	 * Thread-safe and cheap; it never blocks.
+	 */
+	void wake();
+
+	/**
+	 * Keeps us on the worker that's running us until we're next started, e.g.
+	 * because doWork() resumes a QFiber. Only to be called from doWork().
+	 */
+	void pinToWorker();
+
 	virtual int doWork() { return WillNeverWork; }
 	virtual void onStopped() {}
 	virtual QString taskName() const { return QString::number((long uint)this); }
 
 	double timeInTask() const { return m_totalTime; }
-	uint tasksComplete() { return m_taskCount; }
+	uint tasksComplete() const { return m_taskCount; }
 
 private:
 	virtual void attemptProcess();
 	void guaranteeStopped() { l_execution.lock(); }
 	void releaseGuarantee() { l_execution.unlock(); }
 
+	/// @return true if @a _w may run us. Must hold l_execution, or have us queued, since only doWork() pins us.
+	bool runsOn(QWorker* _w) const { return !m_worker || m_worker == _w; }
+
 	QFastMutex l_execution;
 	QScheduler* m_scheduler;
+	QString m_pool;
 
 	int m_lastStatus;
+
+	QAtomicInt m_wakeCount;
+	QAtomicPointer<QWorker> m_sleepingOn;	///< The worker whose m_sleepers we're in, if any; only changed under its l_sleepers.
+	// Only touched with l_execution held.
+	bool m_idle;
+	int m_idleWakeCount;
+	double m_dueTime;
+	QWorker* m_worker;	///< The worker we're pinned to, if any.
 	uint m_taskCount;
 	double m_totalTime;
 };
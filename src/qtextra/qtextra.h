@@ -26,8 +26,10 @@
 #include "qfactorymanager.h"
 #include "qfastwaitcondition.h"
 #include "qkohonennet.h"
+#include "qmultiplexedlink.h"
 #include "qpca.h"
 #include "qsocketsession.h"
+#include "qvectormath.h"
 #else
 #include <qtextra/qcleaner.h>
 #include <qtextra/qcounter.h>
@@ -35,6 +37,8 @@
 #include <qtextra/qfactorymanager.h>
 #include <qtextra/qfastwaitcondition.h>
 #include <qtextra/qkohonennet.h>
+#include <qtextra/qmultiplexedlink.h>
 #include <qtextra/qpca.h>
 #include <qtextra/qsocketsession.h>
+#include <qtextra/qvectormath.h>
 #endif
@@ -5,6 +5,7 @@ target.path = $$PREFIX/lib
 headers.files += *.h
 headers.path = $$PREFIX/include/qtextra/
 LIBS += -lnewmat
+unix:LIBS += -lrt
 SOURCES += qtextra.cpp \
 	qpca.cpp \
 	qsocketsession.cpp \
@@ -14,7 +15,13 @@ SOURCES += qtextra.cpp \
 	qworker.cpp \
 	qkohonennet.cpp \
     rdtsc.cpp \
-    qring.cpp
+    qring.cpp \
+    qfastwaitcondition.cpp \
+    qfiber.cpp \
+    qfibertask.cpp \
+    qvectormath.cpp \
+    qsharedring.cpp \
+    qmultiplexedlink.cpp
 HEADERS += qcleaner.h \
 	qfactory.h \
 	qfactoryexporter.h \
@@ -23,6 +30,8 @@ HEADERS += qcleaner.h \
 	qsubapp.h \
 	qsocketsession.h \
 	qfastwaitcondition.h \
+	qfiber.h \
+	qfibertask.h \
 	qcounter.h \
 	qtextra.h \
 	qtask.h \
@@ -32,7 +41,10 @@ HEADERS += qcleaner.h \
 	qkohonennet.h \
     rdtsc.h \
     qring.h \
-    memberinfo.h
+    memberinfo.h \
+    qvectormath.h \
+    qsharedring.h \
+    qmultiplexedlink.h
 !isEmpty(COMPOSE):system("$$COMPOSE $$SOURCES") {
 	DEPLOYMENT += $$SOURCES
 	SOURCES = .composed.cpp
@@ -0,0 +1,412 @@
+/* Copyright 2003, 2004, 2005, 2007, 2009, 2010 Gavin Wood <gav@kde.org>
+ *
+ * This file is part of Exscalibar.
+ *
+ * Exscalibar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Exscalibar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Exscalibar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <cstring>
+#include <byteswap.h>
+using namespace std;
+
+#include "qvectormath.h"
+
+// Target regions, runtime CPU detection and the AVX-512 intrinsics we use
+// are all there from GCC 7.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 7 && (defined(__x86_64__) || defined(__i386__))
+#define QVM_X86 1
+#include <immintrin.h>
+#endif
+
+namespace QtExtra
+{
+
+namespace VectorMath
+{
+
+namespace Generic
+{
+
+struct V
+{
+	typedef float F;
+	typedef int I;
+	typedef bool M;
+	static const uint Width = 1;
+
+	static inline F load(float const* _p) { return *_p; }
+	static inline void store(float* _p, F _a) { *_p = _a; }
+	static inline F set(float _a) { return _a; }
+	static inline I seti(int _a) { return _a; }
+
+	static inline F add(F _a, F _b) { return _a + _b; }
+	static inline F sub(F _a, F _b) { return _a - _b; }
+	static inline F mul(F _a, F _b) { return _a * _b; }
+	static inline F fma(F _a, F _b, F _c) { return _a * _b + _c; }
+	static inline F min(F _a, F _b) { return _a < _b ? _a : _b; }
+	static inline F max(F _a, F _b) { return _a > _b ? _a : _b; }
+	static inline F sqrt(F _a) { return std::sqrt(_a); }
+	static inline F abs(F _a) { return std::fabs(_a); }
+	static inline float hsum(F _a) { return _a; }
+
+	static inline I toInt(F _a) { return int(floor(_a + 0.5f)); }
+	static inline F toFloat(I _a) { return float(_a); }
+	static inline I asInt(F _a) { I ret; memcpy(&ret, &_a, sizeof(ret)); return ret; }
+	static inline F asFloat(I _a) { F ret; memcpy(&ret, &_a, sizeof(ret)); return ret; }
+	static inline I addi(I _a, I _b) { return _a + _b; }
+	static inline I subi(I _a, I _b) { return _a - _b; }
+	static inline I andi(I _a, I _b) { return _a & _b; }
+	static inline I ori(I _a, I _b) { return _a | _b; }
+	static inline I shl23(I _a) { return int(uint(_a) << 23); }
+	static inline I shr23(I _a) { return int(uint(_a) >> 23); }
+	static inline I sra1(I _a) { return _a >> 1; }
+	static inline I loadi(int const* _p) { return *_p; }
+	static inline void storei(int* _p, I _a) { *_p = _a; }
+	static inline I bswap(I _a) { return bswap_32(_a); }
+
+	static inline M lt(F _a, F _b) { return _a < _b; }
+	static inline M gt(F _a, F _b) { return _a > _b; }
+	static inline M eq(F _a, F _b) { return _a == _b; }
+	static inline M ne(F _a, F _b) { return _a != _b; }
+	static inline F select(M _m, F _a, F _b) { return _m ? _a : _b; }
+};
+
+#include "qvectormathkernels.h"
+
+}
+
+#ifdef QVM_X86
+
+#pragma GCC push_options
+#pragma GCC target("sse2")
+namespace Sse2
+{
+
+struct V
+{
+	typedef __m128 F;
+	typedef __m128i I;
+	typedef __m128 M;
+	static const uint Width = 4;
+
+	static inline F load(float const* _p) { return _mm_loadu_ps(_p); }
+	static inline void store(float* _p, F _a) { _mm_storeu_ps(_p, _a); }
+	static inline F set(float _a) { return _mm_set1_ps(_a); }
+	static inline I seti(int _a) { return _mm_set1_epi32(_a); }
+
+	static inline F add(F _a, F _b) { return _mm_add_ps(_a, _b); }
+	static inline F sub(F _a, F _b) { return _mm_sub_ps(_a, _b); }
+	static inline F mul(F _a, F _b) { return _mm_mul_ps(_a, _b); }
+	static inline F fma(F _a, F _b, F _c) { return _mm_add_ps(_mm_mul_ps(_a, _b), _c); }
+	static inline F min(F _a, F _b) { return _mm_min_ps(_a, _b); }
+	static inline F max(F _a, F _b) { return _mm_max_ps(_a, _b); }
+	static inline F sqrt(F _a) { return _mm_sqrt_ps(_a); }
+	static inline F abs(F _a) { return _mm_and_ps(_a, asFloat(seti(0x7fffffff))); }
+	static inline float hsum(F _a) { F s = _mm_add_ps(_a, _mm_movehl_ps(_a, _a)); return _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, 1))); }
+
+	static inline I toInt(F _a) { return _mm_cvtps_epi32(_a); }
+	static inline F toFloat(I _a) { return _mm_cvtepi32_ps(_a); }
+	static inline I asInt(F _a) { return _mm_castps_si128(_a); }
+	static inline F asFloat(I _a) { return _mm_castsi128_ps(_a); }
+	static inline I addi(I _a, I _b) { return _mm_add_epi32(_a, _b); }
+	static inline I subi(I _a, I _b) { return _mm_sub_epi32(_a, _b); }
+	static inline I andi(I _a, I _b) { return _mm_and_si128(_a, _b); }
+	static inline I ori(I _a, I _b) { return _mm_or_si128(_a, _b); }
+	static inline I shl23(I _a) { return _mm_slli_epi32(_a, 23); }
+	static inline I shr23(I _a) { return _mm_srli_epi32(_a, 23); }
+	static inline I sra1(I _a) { return _mm_srai_epi32(_a, 1); }
+	static inline I loadi(int const* _p) { return _mm_loadu_si128((__m128i const*)_p); }
+	static inline void storei(int* _p, I _a) { _mm_storeu_si128((__m128i*)_p, _a); }
+	// Swap the bytes of each half, then the halves.
+	static inline I bswap(I _a) { _a = _mm_or_si128(_mm_slli_epi16(_a, 8), _mm_srli_epi16(_a, 8)); return _mm_shufflehi_epi16(_mm_shufflelo_epi16(_a, 0xb1), 0xb1); }
+
+	static inline M lt(F _a, F _b) { return _mm_cmplt_ps(_a, _b); }
+	static inline M gt(F _a, F _b) { return _mm_cmpgt_ps(_a, _b); }
+	static inline M eq(F _a, F _b) { return _mm_cmpeq_ps(_a, _b); }
+	static inline M ne(F _a, F _b) { return _mm_cmpneq_ps(_a, _b); }
+	static inline F select(M _m, F _a, F _b) { return _mm_or_ps(_mm_and_ps(_m, _a), _mm_andnot_ps(_m, _b)); }
+};
+
+#include "qvectormathkernels.h"
+
+}
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+namespace Avx2
+{
+
+struct V
+{
+	typedef __m256 F;
+	typedef __m256i I;
+	typedef __m256 M;
+	static const uint Width = 8;
+
+	static inline F load(float const* _p) { return _mm256_loadu_ps(_p); }
+	static inline void store(float* _p, F _a) { _mm256_storeu_ps(_p, _a); }
+	static inline F set(float _a) { return _mm256_set1_ps(_a); }
+	static inline I seti(int _a) { return _mm256_set1_epi32(_a); }
+
+	static inline F add(F _a, F _b) { return _mm256_add_ps(_a, _b); }
+	static inline F sub(F _a, F _b) { return _mm256_sub_ps(_a, _b); }
+	static inline F mul(F _a, F _b) { return _mm256_mul_ps(_a, _b); }
+	static inline F fma(F _a, F _b, F _c) { return _mm256_fmadd_ps(_a, _b, _c); }
+	static inline F min(F _a, F _b) { return _mm256_min_ps(_a, _b); }
+	static inline F max(F _a, F _b) { return _mm256_max_ps(_a, _b); }
+	static inline F sqrt(F _a) { return _mm256_sqrt_ps(_a); }
+	static inline F abs(F _a) { return _mm256_and_ps(_a, asFloat(seti(0x7fffffff))); }
+	static inline float hsum(F _a)
+	{
+		__m128 s = _mm_add_ps(_mm256_castps256_ps128(_a), _mm256_extractf128_ps(_a, 1));
+		s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+		return _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, 1)));
+	}
+
+	static inline I toInt(F _a) { return _mm256_cvtps_epi32(_a); }
+	static inline F toFloat(I _a) { return _mm256_cvtepi32_ps(_a); }
+	static inline I asInt(F _a) { return _mm256_castps_si256(_a); }
+	static inline F asFloat(I _a) { return _mm256_castsi256_ps(_a); }
+	static inline I addi(I _a, I _b) { return _mm256_add_epi32(_a, _b); }
+	static inline I subi(I _a, I _b) { return _mm256_sub_epi32(_a, _b); }
+	static inline I andi(I _a, I _b) { return _mm256_and_si256(_a, _b); }
+	static inline I ori(I _a, I _b) { return _mm256_or_si256(_a, _b); }
+	static inline I shl23(I _a) { return _mm256_slli_epi32(_a, 23); }
+	static inline I shr23(I _a) { return _mm256_srli_epi32(_a, 23); }
+	static inline I sra1(I _a) { return _mm256_srai_epi32(_a, 1); }
+	static inline I loadi(int const* _p) { return _mm256_loadu_si256((__m256i const*)_p); }
+	static inline void storei(int* _p, I _a) { _mm256_storeu_si256((__m256i*)_p, _a); }
+	static inline I bswap(I _a) { return _mm256_shuffle_epi8(_a, _mm256_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3, 12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3)); }
+
+	static inline M lt(F _a, F _b) { return _mm256_cmp_ps(_a, _b, _CMP_LT_OQ); }
+	static inline M gt(F _a, F _b) { return _mm256_cmp_ps(_a, _b, _CMP_GT_OQ); }
+	static inline M eq(F _a, F _b) { return _mm256_cmp_ps(_a, _b, _CMP_EQ_OQ); }
+	static inline M ne(F _a, F _b) { return _mm256_cmp_ps(_a, _b, _CMP_NEQ_UQ); }
+	static inline F select(M _m, F _a, F _b) { return _mm256_blendv_ps(_b, _a, _m); }
+};
+
+#include "qvectormathkernels.h"
+
+}
+#pragma GCC pop_options
+
+// GCC's own AVX-512 intrinsics leave their undefined operand uninitialised
+// and it then warns about them at each use.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+namespace Avx512
+{
+
+struct V
+{
+	typedef __m512 F;
+	typedef __m512i I;
+	typedef __mmask16 M;
+	static const uint Width = 16;
+
+	static inline F load(float const* _p) { return _mm512_loadu_ps(_p); }
+	static inline void store(float* _p, F _a) { _mm512_storeu_ps(_p, _a); }
+	static inline F set(float _a) { return _mm512_set1_ps(_a); }
+	static inline I seti(int _a) { return _mm512_set1_epi32(_a); }
+
+	static inline F add(F _a, F _b) { return _mm512_add_ps(_a, _b); }
+	static inline F sub(F _a, F _b) { return _mm512_sub_ps(_a, _b); }
+	static inline F mul(F _a, F _b) { return _mm512_mul_ps(_a, _b); }
+	static inline F fma(F _a, F _b, F _c) { return _mm512_fmadd_ps(_a, _b, _c); }
+	static inline F min(F _a, F _b) { return _mm512_min_ps(_a, _b); }
+	static inline F max(F _a, F _b) { return _mm512_max_ps(_a, _b); }
+	static inline F sqrt(F _a) { return _mm512_sqrt_ps(_a); }
+	static inline F abs(F _a) { return asFloat(_mm512_and_si512(asInt(_a), seti(0x7fffffff))); }
+	static inline float hsum(F _a) { return _mm512_reduce_add_ps(_a); }
+
+	static inline I toInt(F _a) { return _mm512_cvtps_epi32(_a); }
+	static inline F toFloat(I _a) { return _mm512_cvtepi32_ps(_a); }
+	static inline I asInt(F _a) { return _mm512_castps_si512(_a); }
+	static inline F asFloat(I _a) { return _mm512_castsi512_ps(_a); }
+	static inline I addi(I _a, I _b) { return _mm512_add_epi32(_a, _b); }
+	static inline I subi(I _a, I _b) { return _mm512_sub_epi32(_a, _b); }
+	static inline I andi(I _a, I _b) { return _mm512_and_si512(_a, _b); }
+	static inline I ori(I _a, I _b) { return _mm512_or_si512(_a, _b); }
+	static inline I shl23(I _a) { return _mm512_slli_epi32(_a, 23); }
+	static inline I shr23(I _a) { return _mm512_srli_epi32(_a, 23); }
+	static inline I sra1(I _a) { return _mm512_srai_epi32(_a, 1); }
+	static inline I loadi(int const* _p) { return _mm512_loadu_si512(_p); }
+	static inline void storei(int* _p, I _a) { _mm512_storeu_si512(_p, _a); }
+	// No byte shuffle without AVX-512BW, but rotating the odd and even bytes does it.
+	static inline I bswap(I _a) { return _mm512_or_si512(_mm512_rol_epi32(_mm512_and_si512(_a, seti(0x00ff00ff)), 24), _mm512_rol_epi32(_mm512_and_si512(_a, seti(0xff00ff00)), 8)); }
+
+	static inline M lt(F _a, F _b) { return _mm512_cmp_ps_mask(_a, _b, _CMP_LT_OQ); }
+	static inline M gt(F _a, F _b) { return _mm512_cmp_ps_mask(_a, _b, _CMP_GT_OQ); }
+	static inline M eq(F _a, F _b) { return _mm512_cmp_ps_mask(_a, _b, _CMP_EQ_OQ); }
+	static inline M ne(F _a, F _b) { return _mm512_cmp_ps_mask(_a, _b, _CMP_NEQ_UQ); }
+	static inline F select(M _m, F _a, F _b) { return _mm512_mask_blend_ps(_m, _b, _a); }
+};
+
+#include "qvectormathkernels.h"
+
+}
+#pragma GCC pop_options
+#pragma GCC diagnostic pop
+
+#endif
+
+struct Kernels
+{
+	void (*exp)(float const*, float*, uint);
+	void (*log)(float const*, float*, uint);
+	void (*pow)(float const*, float, float*, uint);
+	void (*sqrt)(float const*, float*, uint);
+	void (*scale)(float const*, float, float, float*, uint);
+	void (*add)(float const*, float const*, float*, uint);
+	void (*mul)(float const*, float const*, float*, uint);
+	void (*max)(float const*, float, float*, uint);
+	void (*abs)(float const*, float*, uint);
+	float (*dot)(float const*, float const*, uint);
+	void (*bswap)(uint32_t const*, uint32_t*, uint);
+};
+
+#define QVM_KERNELS(NS) { NS::expArray, NS::logArray, NS::powArray, NS::sqrtArray, NS::scaleArray, NS::addArray, NS::mulArray, NS::maxArray, NS::absArray, NS::dotArray, NS::bswapArray }
+
+// Indexed by VectorIsa.
+#ifdef QVM_X86
+static const Kernels s_kernels[] = { QVM_KERNELS(Generic), QVM_KERNELS(Sse2), QVM_KERNELS(Avx2), QVM_KERNELS(Avx512) };
+#else
+static const Kernels s_kernels[] = { QVM_KERNELS(Generic), QVM_KERNELS(Generic), QVM_KERNELS(Generic), QVM_KERNELS(Generic) };
+#endif
+
+#undef QVM_KERNELS
+
+static VectorIsa bestIsa()
+{
+#ifdef QVM_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+		return Avx512Isa;
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		return Avx2Isa;
+	if (__builtin_cpu_supports("sse2"))
+		return Sse2Isa;
+#endif
+	return GenericIsa;
+}
+
+// Racy on first use, but whoever wins writes the same thing.
+static int s_isa = -1;
+
+static inline Kernels const& kernels()
+{
+	if (s_isa < 0)
+		s_isa = bestIsa();
+	return s_kernels[s_isa];
+}
+
+}
+
+using namespace VectorMath;
+
+VectorIsa vectorIsa()
+{
+	kernels();
+	return VectorIsa(s_isa);
+}
+
+void setVectorIsa(VectorIsa _isa)
+{
+	VectorIsa best = bestIsa();
+	s_isa = _isa < best ? _isa : best;
+}
+
+char const* vectorIsaName(VectorIsa _isa)
+{
+	static char const* const s_names[] = { "Generic", "SSE2", "AVX2", "AVX-512" };
+	return s_names[_isa];
+}
+
+void vexp(float const* _in, float* _out, uint _n, VectorPrecision _p)
+{
+	if (_p == Exact)
+		for (uint i = 0; i < _n; i++)
+			_out[i] = exp(_in[i]);
+	else
+		kernels().exp(_in, _out, _n);
+}
+
+void vlog(float const* _in, float* _out, uint _n, VectorPrecision _p)
+{
+	if (_p == Exact)
+		for (uint i = 0; i < _n; i++)
+			_out[i] = log(_in[i]);
+	else
+		kernels().log(_in, _out, _n);
+}
+
+void vpow(float const* _in, float _exponent, float* _out, uint _n, VectorPrecision _p)
+{
+	if (_p == Exact)
+		for (uint i = 0; i < _n; i++)
+			_out[i] = pow(_in[i], _exponent);
+	else if (_exponent == 0.f)
+		// exp(0 * log(0)) would be NaN, but pow(0, 0) is 1.
+		for (uint i = 0; i < _n; i++)
+			_out[i] = 1.f;
+	else
+		kernels().pow(_in, _exponent, _out, _n);
+}
+
+void vsqrt(float const* _in, float* _out, uint _n)
+{
+	kernels().sqrt(_in, _out, _n);
+}
+
+void vscale(float const* _in, float _scale, float _offset, float* _out, uint _n)
+{
+	kernels().scale(_in, _scale, _offset, _out, _n);
+}
+
+void vadd(float const* _a, float const* _b, float* _out, uint _n)
+{
+	kernels().add(_a, _b, _out, _n);
+}
+
+void vmul(float const* _a, float const* _b, float* _out, uint _n)
+{
+	kernels().mul(_a, _b, _out, _n);
+}
+
+void vmax(float const* _in, float _floor, float* _out, uint _n)
+{
+	kernels().max(_in, _floor, _out, _n);
+}
+
+void vabs(float const* _in, float* _out, uint _n)
+{
+	kernels().abs(_in, _out, _n);
+}
+
+float vdot(float const* _a, float const* _b, uint _n)
+{
+	return kernels().dot(_a, _b, _n);
+}
+
+void vbswap(uint32_t const* _in, uint32_t* _out, uint _n)
+{
+	kernels().bswap(_in, _out, _n);
+}
+
+}
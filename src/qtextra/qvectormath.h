@@ -0,0 +1,131 @@
+/* Copyright 2003, 2004, 2005, 2007, 2009, 2010 Gavin Wood <gav@kde.org>
+ *
+ * This file is part of Exscalibar.
+ *
+ * Exscalibar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Exscalibar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Exscalibar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <QtGlobal>
+
+#include <exscalibar.h>
+
+/**
+ * @defgroup VectorMath Elementwise kernels over arrays of floats.
+ * @brief Vectorised exp/log/pow/sqrt and friends, picked to suit the CPU.
+ * @author Gav Wood <gav@kde.org>
+ *
+ * Each kernel works over @a n contiguous floats, and @a in may be the same
+ * array as @a out. The instruction set is picked the first time any is
+ * called, from the best of SSE2, AVX2 (with FMA) and AVX-512 that the CPU
+ * has, or plain C++ if none (or not on x86).
+ *
+ * The transcendental kernels have an Approximate mode (the default) that is
+ * vectorised, and an Exact mode that calls libm for each element. Wherever
+ * the result is a normal float, Approximate exp and log (of subnormals too)
+ * are within a couple of ulp (relative error below 2.5e-7); pow is exp(exponent * log(in)), so its
+ * relative error grows with the size of that product (to around 1e-5 near
+ * the top of the range). Infinities and NaNs come out as libm would give
+ * them, unless built with -ffast-math.
+ */
+
+namespace QtExtra
+{
+
+/** @ingroup VectorMath
+ * The instruction sets the kernels may be using, least first.
+ */
+enum VectorIsa { GenericIsa = 0, Sse2Isa, Avx2Isa, Avx512Isa };
+
+/** @ingroup VectorMath
+ * How exactly the transcendental kernels should work.
+ */
+enum VectorPrecision { Approximate = 0, Exact };
+
+/** @ingroup VectorMath
+ * @return The instruction set the kernels are using.
+ */
+DLLEXPORT VectorIsa vectorIsa();
+
+/** @ingroup VectorMath
+ * Makes the kernels use @a isa, or the best the CPU has if it has not got
+ * that. Useful for comparing them.
+ */
+DLLEXPORT void setVectorIsa(VectorIsa isa);
+
+/** @ingroup VectorMath
+ * @return A name for @a isa, for diagnostics.
+ */
+DLLEXPORT char const* vectorIsaName(VectorIsa isa);
+
+/** @ingroup VectorMath
+ * out[i] = exp(in[i])
+ */
+DLLEXPORT void vexp(float const* in, float* out, uint n, VectorPrecision p = Approximate);
+
+/** @ingroup VectorMath
+ * out[i] = log(in[i]), the natural logarithm.
+ */
+DLLEXPORT void vlog(float const* in, float* out, uint n, VectorPrecision p = Approximate);
+
+/** @ingroup VectorMath
+ * out[i] = pow(in[i], exponent). Each of @a in must be non-negative.
+ */
+DLLEXPORT void vpow(float const* in, float exponent, float* out, uint n, VectorPrecision p = Approximate);
+
+/** @ingroup VectorMath
+ * out[i] = sqrt(in[i]). Always exact.
+ */
+DLLEXPORT void vsqrt(float const* in, float* out, uint n);
+
+/** @ingroup VectorMath
+ * out[i] = in[i] * scale + offset
+ */
+DLLEXPORT void vscale(float const* in, float scale, float offset, float* out, uint n);
+
+/** @ingroup VectorMath
+ * out[i] = a[i] + b[i]
+ */
+DLLEXPORT void vadd(float const* a, float const* b, float* out, uint n);
+
+/** @ingroup VectorMath
+ * out[i] = a[i] * b[i]
+ */
+DLLEXPORT void vmul(float const* a, float const* b, float* out, uint n);
+
+/** @ingroup VectorMath
+ * out[i] = max(in[i], floor)
+ */
+DLLEXPORT void vmax(float const* in, float floor, float* out, uint n);
+
+/** @ingroup VectorMath
+ * out[i] = |in[i]|
+ */
+DLLEXPORT void vabs(float const* in, float* out, uint n);
+
+/** @ingroup VectorMath
+ * @return The sum of a[i] * b[i].
+ */
+DLLEXPORT float vdot(float const* a, float const* b, uint n);
+
+/** @ingroup VectorMath
+ * out[i] = in[i] with its bytes reversed, as for a host of the other byte
+ * order.
+ */
+DLLEXPORT void vbswap(uint32_t const* in, uint32_t* out, uint n);
+
+}
@@ -0,0 +1,205 @@
+/* Copyright 2003, 2004, 2005, 2007, 2009, 2010 Gavin Wood <gav@kde.org>
+ *
+ * This file is part of Exscalibar.
+ *
+ * Exscalibar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Exscalibar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Exscalibar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @internal
+// No include guard: qvectormath.cpp includes this once for each instruction
+// set, each time inside its own namespace and (for all but Generic) its own
+// GCC target region, so that everything here is compiled for that set. The
+// enclosing namespace must first define V, the vector operations; tails are
+// done with Generic::V.
+
+template<class T> inline typename T::F expOf(typename T::F _x)
+{
+	typedef typename T::F F;
+	typedef typename T::I I;
+
+	// x = n ln2 + r, with ln2 in two parts so r is exact.
+	F x = T::min(T::max(_x, T::set(-103.972084f)), T::set(88.7228391f));
+	I n = T::toInt(T::mul(x, T::set(1.44269504088896341f)));
+	F nf = T::toFloat(n);
+	F r = T::fma(nf, T::set(-0.693359375f), x);
+	r = T::fma(nf, T::set(2.12194440e-4f), r);
+
+	F y = T::set(1.9875691500e-4f);
+	y = T::fma(y, r, T::set(1.3981999507e-3f));
+	y = T::fma(y, r, T::set(8.3334519073e-3f));
+	y = T::fma(y, r, T::set(4.1665795894e-2f));
+	y = T::fma(y, r, T::set(1.6666665459e-1f));
+	y = T::fma(y, r, T::set(5.0000001201e-1f));
+	y = T::fma(T::mul(y, r), r, T::add(r, T::set(1.f)));
+
+	// Times 2^n, in two halves so that neither is out of range on its own.
+	I n1 = T::sra1(n);
+	I n2 = T::subi(n, n1);
+	y = T::mul(y, T::asFloat(T::shl23(T::addi(n1, T::seti(127)))));
+	y = T::mul(y, T::asFloat(T::shl23(T::addi(n2, T::seti(127)))));
+
+	y = T::select(T::gt(_x, T::set(88.7228391f)), T::asFloat(T::seti(0x7f800000)), y);
+	y = T::select(T::lt(_x, T::set(-103.972084f)), T::set(0.f), y);
+	return T::select(T::ne(_x, _x), _x, y);
+}
+
+template<class T> inline typename T::F logOf(typename T::F _x)
+{
+	typedef typename T::F F;
+	typedef typename T::I I;
+	typedef typename T::M M;
+
+	// x = m 2^e, with m in [sqrt(1/2), sqrt(2)). Subnormals are made normal
+	// by scaling by 2^23 first; zero, negatives, infinity and NaN are put
+	// right at the end.
+	M tiny = T::lt(_x, T::set(1.17549435e-38f));
+	F x = T::select(tiny, T::mul(T::max(_x, T::set(1.40129846e-45f)), T::set(8388608.f)), _x);
+	I bits = T::asInt(x);
+	F e = T::toFloat(T::subi(T::shr23(bits), T::seti(126)));
+	F m = T::asFloat(T::ori(T::andi(bits, T::seti(0x007fffff)), T::seti(0x3f000000)));
+	M small = T::lt(m, T::set(0.707106781186547524f));
+	e = T::sub(e, T::select(tiny, T::set(23.f), T::set(0.f)));
+	e = T::sub(e, T::select(small, T::set(1.f), T::set(0.f)));
+	m = T::sub(T::add(m, T::select(small, m, T::set(0.f))), T::set(1.f));
+
+	F z = T::mul(m, m);
+	F y = T::set(7.0376836292e-2f);
+	y = T::fma(y, m, T::set(-1.1514610310e-1f));
+	y = T::fma(y, m, T::set(1.1676998740e-1f));
+	y = T::fma(y, m, T::set(-1.2420140846e-1f));
+	y = T::fma(y, m, T::set(1.4249322787e-1f));
+	y = T::fma(y, m, T::set(-1.6668057665e-1f));
+	y = T::fma(y, m, T::set(2.0000714765e-1f));
+	y = T::fma(y, m, T::set(-2.4999993993e-1f));
+	y = T::fma(y, m, T::set(3.3333331174e-1f));
+	y = T::mul(T::mul(y, m), z);
+	y = T::fma(e, T::set(-2.12194440e-4f), y);
+	y = T::fma(z, T::set(-0.5f), y);
+	y = T::add(m, y);
+	y = T::fma(e, T::set(0.693359375f), y);
+
+	F inf = T::asFloat(T::seti(0x7f800000));
+	y = T::select(T::eq(_x, inf), inf, y);
+	y = T::select(T::eq(_x, T::set(0.f)), T::sub(T::set(0.f), inf), y);
+	y = T::select(T::lt(_x, T::set(0.f)), T::asFloat(T::seti(0x7fc00000)), y);
+	return T::select(T::ne(_x, _x), _x, y);
+}
+
+static void expArray(float const* _in, float* _out, uint _n)
+{
+	uint i = 0;
+	for (; i + V::Width <= _n; i += V::Width)
+		V::store(_out + i, expOf<V>(V::load(_in + i)));
+	for (; i < _n; i++)
+		_out[i] = expOf<Generic::V>(_in[i]);
+}
+
+static void logArray(float const* _in, float* _out, uint _n)
+{
+	uint i = 0;
+	for (; i + V::Width <= _n; i += V::Width)
+		V::store(_out + i, logOf<V>(V::load(_in + i)));
+	for (; i < _n; i++)
+		_out[i] = logOf<Generic::V>(_in[i]);
+}
+
+static void powArray(float const* _in, float _exponent, float* _out, uint _n)
+{
+	uint i = 0;
+	V::F e = V::set(_exponent);
+	for (; i + V::Width <= _n; i += V::Width)
+		V::store(_out + i, expOf<V>(V::mul(e, logOf<V>(V::load(_in + i)))));
+	for (; i < _n; i++)
+		_out[i] = expOf<Generic::V>(_exponent * logOf<Generic::V>(_in[i]));
+}
+
+static void sqrtArray(float const* _in, float* _out, uint _n)
+{
+	uint i = 0;
+	for (; i + V::Width <= _n; i += V::Width)
+		V::store(_out + i, V::sqrt(V::load(_in + i)));
+	for (; i < _n; i++)
+		_out[i] = Generic::V::sqrt(_in[i]);
+}
+
+static void scaleArray(float const* _in, float _scale, float _offset, float* _out, uint _n)
+{
+	uint i = 0;
+	V::F s = V::set(_scale);
+	V::F o = V::set(_offset);
+	for (; i + V::Width <= _n; i += V::Width)
+		V::store(_out + i, V::fma(V::load(_in + i), s, o));
+	for (; i < _n; i++)
+		_out[i] = _in[i] * _scale + _offset;
+}
+
+static void addArray(float const* _a, float const* _b, float* _out, uint _n)
+{
+	uint i = 0;
+	for (; i + V::Width <= _n; i += V::Width)
+		V::store(_out + i, V::add(V::load(_a + i), V::load(_b + i)));
+	for (; i < _n; i++)
+		_out[i] = _a[i] + _b[i];
+}
+
+static void mulArray(float const* _a, float const* _b, float* _out, uint _n)
+{
+	uint i = 0;
+	for (; i + V::Width <= _n; i += V::Width)
+		V::store(_out + i, V::mul(V::load(_a + i), V::load(_b + i)));
+	for (; i < _n; i++)
+		_out[i] = _a[i] * _b[i];
+}
+
+static void maxArray(float const* _in, float _floor, float* _out, uint _n)
+{
+	uint i = 0;
+	V::F f = V::set(_floor);
+	for (; i + V::Width <= _n; i += V::Width)
+		V::store(_out + i, V::max(V::load(_in + i), f));
+	for (; i < _n; i++)
+		_out[i] = Generic::V::max(_in[i], _floor);
+}
+
+static void absArray(float const* _in, float* _out, uint _n)
+{
+	uint i = 0;
+	for (; i + V::Width <= _n; i += V::Width)
+		V::store(_out + i, V::abs(V::load(_in + i)));
+	for (; i < _n; i++)
+		_out[i] = Generic::V::abs(_in[i]);
+}
+
+static float dotArray(float const* _a, float const* _b, uint _n)
+{
+	uint i = 0;
+	V::F acc = V::set(0.f);
+	for (; i + V::Width <= _n; i += V::Width)
+		acc = V::fma(V::load(_a + i), V::load(_b + i), acc);
+	float ret = V::hsum(acc);
+	for (; i < _n; i++)
+		ret += _a[i] * _b[i];
+	return ret;
+}
+
+static void bswapArray(uint32_t const* _in, uint32_t* _out, uint _n)
+{
+	int const* in = (int const*)_in;
+	int* out = (int*)_out;
+	uint i = 0;
+	for (; i + V::Width <= _n; i += V::Width)
+		V::storei(out + i, V::bswap(V::loadi(in + i)));
+	for (; i < _n; i++)
+		out[i] = Generic::V::bswap(in[i]);
+}
@@ -21,14 +21,28 @@
 #include <exscalibar.h>
 
 #include "qtask.h"
+#include "qscheduler.h"
 #include "qworker.h"
 using namespace QtExtra;
 
+#ifdef HAVE_LINUX
+#include <pthread.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#endif
+
+__thread QWorker* QWorker::s_current = 0;
+
 QWorker::QWorker(QScheduler* _boss, uint _index):
 	m_boss				(_boss),
 	m_index				(_index),
-	m_sinceLastWorked	(0),
-	m_waitPeriod		(0),
+	m_running			(0),
+	m_continuation		(0),
+	m_chain				(0),
+	m_policy			(-1),
+	m_retiring			(0),
 	m_timeSlices		(10000)
 {
 	QThread::start();
@@ -36,10 +50,113 @@ QWorker::QWorker(QScheduler* _boss, uint _index):
 
 QWorker::~QWorker()
 {
-	QThread::terminate();
+	// Our boss only deletes us once we've retired and finished.
 	QThread::wait();
 }
 
+void QWorker::requeueTask(QTask* _t)
+{
+	// QScheduler::unregisterTask() clears m_scheduler before sweeping the
+	// deques, so checking it under our lock means we can never put back a
+	// task after it has been swept.
+	QFastMutexLocker l(&l_deque);
+	if (_t->m_scheduler)
+		m_deque.append(_t);
+}
+
+bool QWorker::hasPinnedTasks() const
+{
+	QFastMutexLocker l(&l_deque);
+	foreach (QTask* t, m_deque)
+		if (t->m_worker == this)
+			return true;
+	return false;
+}
+
+QList<QTask*> QWorker::takeUnpinnedTasks()
+{
+	QFastMutexLocker l(&l_deque);
+	QList<QTask*> ret;
+	for (int i = 0; i < m_deque.count();)
+		if (m_deque[i]->m_worker == this)
+			i++;
+		else
+			ret.append(m_deque.takeAt(i));
+	return ret;
+}
+
+QTask* QWorker::takeDueTask(QWorker* _taker)
+{
+	QFastMutexLocker l(&l_deque);
+	int n = m_deque.count();
+	for (int i = 0; i < n; i++)
+	{
+		int j = _taker != this ? n - 1 - i : i;
+		QTask* t = m_deque[j];
+		if (!t->runsOn(_taker))
+			continue;
+		// Only unregisterTask()/clearTasks() could be holding it, since no
+		// other worker can have it; in that case it'll be swept soon enough.
+		if (!t->l_execution.tryLock())
+			continue;
+		m_deque.removeAt(j);
+		return t;
+	}
+	return 0;
+}
+
+void QWorker::applyPolicy()
+{
+	m_boss->l_workers.lock();
+	m_policy = m_boss->m_policy;
+	QList<int> cpus = m_boss->m_cpus;
+	int priority = m_boss->m_priority;
+	bool realTime = m_boss->m_realTime;
+	m_boss->l_workers.unlock();
+
+#ifdef HAVE_LINUX
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if (cpus.isEmpty())
+		for (int i = 0; i < CPU_SETSIZE; i++)
+			CPU_SET(i, &set);
+	else
+		foreach (int i, cpus)
+			CPU_SET(i, &set);
+	if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set))
+		qWarning("*** WARNING: QWorker: Couldn't set CPU affinity of worker %d in pool '%s'.", m_index, qPrintable(m_boss->name()));
+
+	sched_param sp;
+	sp.sched_priority = realTime ? qMax(1, qMin(99, priority)) : 0;
+	int e = pthread_setschedparam(pthread_self(), realTime ? SCHED_FIFO : SCHED_OTHER, &sp);
+	if (e == EPERM && realTime)
+	{
+		qWarning("*** WARNING: QWorker: Not permitted to use SCHED_FIFO for pool '%s'; using\n"
+				 "             normal scheduling instead.", qPrintable(m_boss->name()));
+		sp.sched_priority = 0;
+		pthread_setschedparam(pthread_self(), SCHED_OTHER, &sp);
+	}
+	// Linux keeps a nice value per thread.
+	if (!realTime)
+		setpriority(PRIO_PROCESS, syscall(SYS_gettid), priority);
+#else
+	Q_UNUSED(cpus);
+	Q_UNUSED(priority);
+	Q_UNUSED(realTime);
+#endif
+}
+
+QTask* QWorker::takeTask(QWorker* _taker, QTask* _t)
+{
+	QFastMutexLocker l(&l_deque);
+	// A continuation was usually just put on the back of its waker's deque.
+	int i = m_deque.lastIndexOf(_t);
+	if (i == -1 || !_t->runsOn(_taker) || !_t->l_execution.tryLock())
+		return 0;
+	m_deque.removeAt(i);
+	return _t;
+}
+
 void QWorker::beginAgain()
 {
 	m_timeSlices.clear();
@@ -47,11 +164,15 @@ void QWorker::beginAgain()
 
 void QWorker::run()
 {
-	for (QTask* t = 0;;)
+	s_current = this;
+	applyPolicy();
+	// Once we've retired, nextTask() gives us nothing when we've nothing left to run.
+	for (QTask* t = 0; (t = m_boss->nextTask(t, this));)
 	{
-		t = m_boss->nextTask(t, this);
 		double s = QScheduler::currentTime();
+		m_running = t;
 		t->attemptProcess();
+		m_running = 0;
 		double e = QScheduler::currentTime();
 		m_timeSlices.shift(TimeSlice(t, s, e));
 	}
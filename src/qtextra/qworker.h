@@ -20,7 +20,11 @@
 
 #include <QString>
 #include <QThread>
+#include <QList>
+#include <QMap>
+#include <QAtomicInt>
 
+#include "qfastwaitcondition.h"
 #include "qring.h"
 
 #include <exscalibar.h>
@@ -29,7 +33,27 @@ namespace QtExtra
 {
 
 class QScheduler;
+class QTask;
 
+/** @internal @ingroup QtExtra
+ * @brief Thread that repeatedly executes QTasks given to it by a QScheduler.
+ * @author Gav Wood <gav@kde.org>
+ *
+ * Each worker has its own deque of tasks. It takes from the front of its own
+ * deque and, having run a task, puts it on the back. When its deque is empty
+ * it steals from the back of another worker's, so the only contention is
+ * between a worker and the occasional thief. Tasks that are idle (see
+ * QTask::wake()), or pinned to another worker (see QTask::pinToWorker()),
+ * are passed over and stay put.
+ *
+ * Tasks we run that turn out to be idle are set aside with us, rather than
+ * the scheduler, until they're due or woken, so neither takes a lock that
+ * other workers contend for.
+ *
+ * A worker that's no longer wanted retires rather than being killed: it hands
+ * its tasks over to the others and finishes once it has none left, bar those
+ * pinned to it, which it keeps running until they're done.
+ */
 class DLLEXPORT QWorker: private QThread
 {
 	friend class QScheduler;
@@ -43,6 +67,9 @@ public:
 
 	uint index() const { return m_index; }
 
+	/// @return The worker whose thread this is, or zero if it isn't one.
+	static QWorker* current() { return s_current; }
+
 	QRing<TimeSlice> const& timeSlices() const { return m_timeSlices; }
 	void beginAgain();
 
@@ -50,16 +77,55 @@ private:
 	QWorker(QScheduler* _boss, uint _index);
 	~QWorker();
 
-	static void setTerminationEnabled(bool _e) { QThread::setTerminationEnabled(_e); }
-
 	virtual void run();
 
+	/// @return true if any task in our deque is pinned to us.
+	bool hasPinnedTasks() const;
+	/// Takes all tasks from our deque that aren't pinned to us.
+	QList<QTask*> takeUnpinnedTasks();
+
+	/// Applies our boss's CPU affinity and priority to this thread. Must be called from our own thread.
+	void applyPolicy();
+
+	/// Our end of the deque.
+	void pushTask(QTask* _t) { QFastMutexLocker l(&l_deque); m_deque.append(_t); }
+	/// As pushTask(), but only if @a _t is still registered.
+	void requeueTask(QTask* _t);
+
+	/**
+	 * Takes the task at the front of the deque, or at the back (the thief's
+	 * end) if @a _taker isn't us, passing over only those pinned elsewhere.
+	 * Everything in the deque is due, since idle tasks wait in m_sleepers, so
+	 * this is O(1) but for pinned tasks. The task is returned with its
+	 * l_execution held.
+	 */
+	QTask* takeDueTask(QWorker* _taker);
+	/// As takeDueTask(), but only for @a _t, which we look for from the back.
+	QTask* takeTask(QWorker* _taker, QTask* _t);
+
+	void removeTask(QTask* _t) { QFastMutexLocker l(&l_deque); m_deque.removeAll(_t); }
+	int taskCount() const { QFastMutexLocker l(&l_deque); return m_deque.count(); }
+
 	QScheduler* m_boss;
 	uint m_index;
-	int m_sinceLastWorked;
-	uint m_waitPeriod;
+
+	// Only touched from our own thread.
+	QTask* m_running;		///< The task we're currently running.
+	QTask* m_continuation;	///< A task woken by m_running, to be run next.
+	uint m_chain;			///< How many continuations we've run back-to-back.
+	int m_policy;			///< The version of our boss's policy we last applied.
+
+	QAtomicInt m_retiring;	///< Set once our boss no longer wants us.
+
+	mutable QFastMutex l_deque;
+	QList<QTask*> m_deque;
+	// Taken before our boss's l_workers or any l_deque, never after.
+	mutable QFastMutex l_sleepers;
+	QMultiMap<double, QTask*> m_sleepers;	///< Idle tasks we ran, keyed by their m_dueTime.
 
 	QRing<TimeSlice> m_timeSlices;
+
+	static __thread QWorker* s_current;
 };
 
 }
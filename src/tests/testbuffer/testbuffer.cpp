@@ -18,13 +18,143 @@
 
 #include <iostream>
 
+#include <QThread>
+
 #include "geddei.h"
 using namespace Geddei;
 
+#include "buffer.h"
+#include "bufferreader.h"
 #include "wave.h"
 
+// Pushes theTotal elements, counting up, in chunks of assorted sizes.
+class StressWriter: public QThread
+{
+public:
+	StressWriter(Buffer *_b, uint _total): theBuffer(_b), theTotal(_total) {}
+	virtual void run()
+	{
+		for (uint done = 0, i = 0; done < theTotal; i++)
+		{	uint n = qMin(1 + (i * 7) % 61, theTotal - done);
+			BufferData d = theBuffer->makeScratchElements(n, true);
+			for (uint j = 0; j < n; j++)
+				d[j] = done + j;
+			done += n;
+		}
+	}
+private:
+	Buffer *theBuffer;
+	uint theTotal;
+};
+
+// Reads theTotal elements in chunks of other sizes, checking the count.
+class StressReader: public QThread
+{
+public:
+	StressReader(BufferReader *_r, uint _total): theReader(_r), theTotal(_total), theErrors(0) {}
+	virtual void run()
+	{
+		for (uint done = 0, i = 0; done < theTotal; i++)
+		{	uint n = qMin(1 + (i * 13) % 97, theTotal - done);
+			BufferData d = theReader->readElements(n);
+			for (uint j = 0; j < d.elements(); j++)
+				if (d[j] != float(done + j) && theErrors++ < 10)
+					std::cout << "Expected " << done + j << ", read " << d[j] << std::endl;
+			done += d.elements();
+		}
+	}
+	uint errors() const { return theErrors; }
+private:
+	BufferReader *theReader;
+	uint theTotal;
+	uint theErrors;
+};
+
+// Keeps adding and removing a second reader, so the Buffer keeps leaving and
+// rejoining its lock-free path under the other two.
+class StressChurner: public QThread
+{
+public:
+	StressChurner(Buffer *_b): theBuffer(_b), theStop(false) {}
+	virtual void run()
+	{
+		while (!theStop)
+		{	delete new BufferReader(theBuffer);
+			yieldCurrentThread();
+		}
+	}
+	void stop() { theStop = true; }
+private:
+	Buffer *theBuffer;
+	volatile bool theStop;
+};
+
+// One writer and one reader as fast as they'll go; any lost wakeup hangs them
+// and any race on the lock-free path garbles the count.
+bool testStress()
+{
+	std::cout << "Stress... " << std::flush;
+	uint const total = 4000000;
+	Buffer b(256, Wave());
+	BufferReader *r = new BufferReader(&b);
+	StressWriter w(&b, total);
+	StressReader rd(r, total);
+	StressChurner c(&b);
+	rd.start();
+	w.start();
+	c.start();
+	bool finished = rd.wait(120000) && w.wait(10000);
+	c.stop();
+	c.wait();
+	if (!finished)
+	{	std::cout << "FAILED: hung." << std::endl;
+		// Can't safely tear down with the threads stuck.
+		exit(1);
+	}
+	std::cout << (rd.errors() ? "FAILED." : "OK.") << std::endl;
+	return !rd.errors();
+}
+
+// Windows of an awkward size keep drifting over the end of the ring, so
+// every write and read straddles where a mirrored buffer's two mappings meet.
+bool testWrap()
+{
+	std::cout << "Wrap... " << std::flush;
+	Buffer b(256, Wave());
+	BufferReader *r = new BufferReader(&b);
+	uint const n = b.size() / 3 + 1;
+	uint errors = 0;
+	uint rolled = 0;
+	for (uint i = 0, done = 0; i < 3 * b.size(); i++, done += n)
+	{
+		BufferData w = b.makeScratchElements(n);
+		float *wp = w.writePointer();
+		for (uint j = 0; j < n; j++)
+			wp[j] = done + j;
+		w.endWritePointer();
+		b << w;
+
+		BufferData const d = r->readElements(n);
+		BufferData::ConstSpan s[2];
+		if (d.spans(s) > 1)
+			rolled++;
+		float const *rp = d.readPointer();
+		for (uint j = 0; j < n; j++)
+			if ((rp[j] != float(done + j) || d[j] != float(done + j)) && errors++ < 10)
+				std::cout << "Expected " << done + j << ", read " << rp[j] << "/" << d[j] << std::endl;
+	}
+	// Only a plain power-of-2 ring, where mirroring isn't available, may roll over.
+	std::cout << (errors ? "FAILED." : "OK.") << (rolled ? " (not mirrored)" : " (mirrored)") << std::endl;
+	return !errors;
+}
+
 int main()
 {
+	if (!testWrap())
+		return 1;
+	if (!testStress())
+		return 1;
+
 /*	SignalTypes::Wave t;
 	Buffer x(16, &t), y(16, &t);
 	BufferReader a(&x), b(&x);
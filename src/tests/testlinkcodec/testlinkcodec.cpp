@@ -0,0 +1,112 @@
+/* Copyright 2003, 2004, 2005, 2007, 2009, 2010 Gavin Wood <gav@kde.org>
+ *
+ * This file is part of Exscalibar.
+ *
+ * Exscalibar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Exscalibar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Exscalibar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <limits>
+#include <iostream>
+
+#include "geddei.h"
+using namespace Geddei;
+
+#include "linkcodec.h"
+#include "bufferdata.h"
+#include "mark.h"
+#include "value.h"
+#include "wave.h"
+
+static uint s_seed = 69;
+static float rnd(float _lo, float _hi)
+{
+	s_seed = s_seed * 1103515245u + 12345u;
+	return _lo + (_hi - _lo) * ((s_seed >> 8) & 0xffff) / 65535.f;
+}
+
+// Sends two transfers of _samples samples through an encoder of _type and a
+// fresh decoder, checking the marks' timestamps come back exactly and each of
+// the other elements to within a step of the range _lo/_hi given for it.
+static bool testRoundTrip(char const* _name, Type const& _type, uint _samples, QVector<float> const& _lo, QVector<float> const& _hi, bool _marks, LinkCodec::Mode _mode)
+{
+	uint sampleSize = _type.isNull() ? _lo.size() : _type->size();
+	uint data = _marks ? sampleSize - 2 : sampleSize;
+	LinkCodec enc(_mode);
+	LinkCodec dec(_mode);
+	enc.setType(_type);
+	float levels = _mode == LinkCodec::Quantised8 ? 255.f : 65535.f;
+	uint errors = 0;
+	for (uint t = 0; t < 2; t++)
+	{	BufferData in(_samples * sampleSize, sampleSize);
+		BufferData out(_samples * sampleSize, sampleSize);
+		for (uint i = 0; i < _samples; i++)
+		{	for (uint s = 0; s < data; s++)
+				in(i, s) = rnd(_lo[s], _hi[s]);
+			if (_marks)
+				Mark::setTimestamp(in.sample(i), i == _samples - 1 && t ? -std::numeric_limits<double>::infinity() : 1e5 * t + i / 3.0);
+		}
+		QByteArray coded;
+		enc.encode(in, coded);
+		// Links refuse anything bigger than this off the wire.
+		if ((uint)coded.size() > dec.maxEncodedSize(in.elements()))
+		{	std::cout << _name << " " << LinkCodec::name(_mode) << ": coded to " << coded.size() << " bytes, more than the " << dec.maxEncodedSize(in.elements()) << " allowed." << std::endl;
+			return false;
+		}
+		if (!dec.decode(coded, out))
+		{	std::cout << _name << " " << LinkCodec::name(_mode) << ": couldn't decode." << std::endl;
+			return false;
+		}
+		for (uint i = 0; i < _samples; i++)
+		{	if (_marks && Mark::timestamp(out.sample(i)) != Mark::timestamp(in.sample(i)))
+			{	if (!errors++)
+					std::cout << _name << " " << LinkCodec::name(_mode) << ": timestamp " << Mark::timestamp(in.sample(i)) << " came back as " << Mark::timestamp(out.sample(i)) << std::endl;
+			}
+			for (uint s = 0; s < data; s++)
+			{	float x = in(i, s);
+				float tolerance = _mode == LinkCodec::Lossless ? 0.f : _mode == LinkCodec::Half ? fabs(x) / 1024.f + 1e-4f : (_hi[s] - _lo[s]) / levels;
+				if (fabs(out(i, s) - x) > tolerance && !errors++)
+					std::cout << _name << " " << LinkCodec::name(_mode) << ": element " << s << " " << x << " came back as " << out(i, s) << std::endl;
+			}
+		}
+	}
+	return !errors;
+}
+
+int main()
+{
+	LinkCodec::Mode modes[] = { LinkCodec::Lossless, LinkCodec::Half, LinkCodec::Quantised16, LinkCodec::Quantised8 };
+	bool ok = true;
+	for (uint m = 0; m < 4; m++)
+	{
+		// A SpectralPeak has its own range for each element but the last two.
+		QVector<float> lo, hi;
+		lo << 0.f << 0.f << 0.f << 0.f;
+		hi << 1.f << 24000.f << 1.f << 1.f;
+		ok = testRoundTrip("SpectralPeak", SpectralPeak(24000.f), 64, lo, hi, true, modes[m]) && ok;
+		lo.resize(1);
+		hi.resize(1);
+		hi[0] = 1.f;
+		ok = testRoundTrip("Mark", Mark(1), 64, lo, hi, true, modes[m]) && ok;
+		ok = testRoundTrip("Value", Value(), 256, lo, hi, false, modes[m]) && ok;
+		lo[0] = -1.f;
+		ok = testRoundTrip("Wave", Wave(), 256, lo, hi, false, modes[m]) && ok;
+		// No type, so ranged on the data itself.
+		lo.fill(-300.f, 3);
+		hi.fill(500.f, 3);
+		ok = testRoundTrip("Untyped", Type(), 128, lo, hi, false, modes[m]) && ok;
+	}
+	std::cout << (ok ? "OK." : "FAILED.") << std::endl;
+	return ok ? 0 : 1;
+}
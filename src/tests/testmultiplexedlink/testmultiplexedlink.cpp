@@ -0,0 +1,224 @@
+/* Copyright 2003, 2004, 2005, 2007, 2009, 2010 Gavin Wood <gav@kde.org>
+ *
+ * This file is part of Exscalibar.
+ *
+ * Exscalibar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Exscalibar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Exscalibar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+
+#include <QCoreApplication>
+#include <QHostAddress>
+#include <QThread>
+#include <QTime>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "qmultiplexedlink.h"
+
+static inline uchar pattern(uint _seed, uint _i) { return (_i * 7 + _seed) & 0xff; }
+
+// Writes theTotal bytes of pattern theSeed in chunks of assorted sizes.
+class Writer: public QThread
+{
+public:
+	Writer(QIODevice *_d, uint _total, uint _seed): theDevice(_d), theTotal(_total), theSeed(_seed), theErrors(0) {}
+	virtual void run()
+	{
+		QByteArray chunk;
+		for (uint done = 0, i = 0; done < theTotal; i++)
+		{	uint n = qMin(1 + (i * 4099) % 40000, theTotal - done);
+			chunk.resize(n);
+			for (uint j = 0; j < n; j++)
+				chunk[j] = pattern(theSeed, done + j);
+			if (theDevice->write(chunk) != (qint64)n)
+			{	std::cout << "Write failed at " << done << std::endl;
+				theErrors++;
+				return;
+			}
+			done += n;
+		}
+	}
+	uint errors() const { return theErrors; }
+
+private:
+	QIODevice *theDevice;
+	uint theTotal;
+	uint theSeed;
+	uint theErrors;
+};
+
+// Reads theTotal bytes, after a while, checking they're of pattern theSeed.
+class Reader: public QThread
+{
+public:
+	Reader(QIODevice *_d, uint _total, uint _seed, uint _delay): theDevice(_d), theTotal(_total), theSeed(_seed), theDelay(_delay), theErrors(0) {}
+	virtual void run()
+	{
+		msleep(theDelay);
+		char buffer[30000];
+		for (uint done = 0; done < theTotal;)
+		{	if (!theDevice->bytesAvailable() && !theDevice->waitForReadyRead(10000))
+			{	std::cout << "Read stalled at " << done << std::endl;
+				theErrors++;
+				return;
+			}
+			qint64 n = theDevice->read(buffer, qMin((uint)sizeof(buffer), theTotal - done));
+			if (n <= 0)
+			{	std::cout << "Read failed at " << done << std::endl;
+				theErrors++;
+				return;
+			}
+			for (uint i = 0; i < n; i++)
+				if ((uchar)buffer[i] != pattern(theSeed, done + i) && !theErrors++)
+					std::cout << "Expected " << (int)pattern(theSeed, done + i) << " at " << done + i << ", read " << (int)(uchar)buffer[i] << std::endl;
+			done += n;
+		}
+	}
+	uint errors() const { return theErrors; }
+
+private:
+	QIODevice *theDevice;
+	uint theTotal;
+	uint theSeed;
+	uint theDelay;
+	uint theErrors;
+};
+
+class Acceptor: public QObject
+{
+public:
+	QList<QMultiplexedChannel *> theChannels;
+
+	// Waits a few seconds for there to be _n channels.
+	bool waitFor(int _n)
+	{
+		QTime t;
+		t.start();
+		while (theChannels.size() < _n && t.elapsed() < 5000)
+		{	QCoreApplication::processEvents();
+			usleep(1000);
+		}
+		return theChannels.size() >= _n;
+	}
+
+protected:
+	virtual void customEvent(QEvent *_e)
+	{
+		if (_e->type() == QMultiplexedLink::ChannelEvent::Type)
+			theChannels.append(static_cast<QMultiplexedLink::ChannelEvent *>(_e)->channel());
+	}
+};
+
+// Opens _n channels to the loopback listener on _port, adopting the link
+// that makes; returns the adopted socket, or -1.
+static int link(int _listener, quint16 _port, Acceptor &_a, QMultiplexedChannel **o_channels, int _n)
+{
+	int had = _a.theChannels.size();
+	for (int i = 0; i < _n; i++)
+		if (!(o_channels[i] = QMultiplexedLink::open(QHostAddress(QHostAddress::LocalHost), _port)))
+			return -1;
+	int fd = ::accept(_listener, 0, 0);
+	if (fd < 0 || !QMultiplexedLink::adopt(fd, &_a) || !_a.waitFor(had + _n))
+		return -1;
+	return fd;
+}
+
+int main(int argc, char **argv)
+{
+	QCoreApplication app(argc, argv);
+
+	int listener = ::socket(AF_INET, SOCK_STREAM, 0);
+	sockaddr_in a;
+	memset(&a, 0, sizeof(a));
+	a.sin_family = AF_INET;
+	a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t l = sizeof(a);
+	if (listener < 0 || ::bind(listener, (sockaddr *)&a, sizeof(a)) || ::listen(listener, 4) || getsockname(listener, (sockaddr *)&a, &l))
+	{	std::cout << "FAILED: Couldn't listen." << std::endl;
+		return 1;
+	}
+	quint16 port = ntohs(a.sin_port);
+	Acceptor acceptor;
+	bool ok = true;
+
+	// Framing and interleaving: two channels over the one link, each sending
+	// several times the read and write limits, one read late enough that the
+	// link has to hold back.
+	std::cout << "Interleaving... " << std::flush;
+	QMultiplexedChannel *c[2];
+	int fd = link(listener, port, acceptor, c, 2);
+	if (fd < 0 || c[0]->link() != c[1]->link())
+	{	std::cout << "FAILED: Couldn't link." << std::endl;
+		return 1;
+	}
+	uint total = 4 * QMultiplexedLink::ReadLimit + 12345;
+	Writer w0(c[0], total, 0), w1(c[1], total, 101);
+	Reader r0(acceptor.theChannels[0], total, 0, 0), r1(acceptor.theChannels[1], total, 101, 500);
+	w0.start(); w1.start(); r0.start(); r1.start();
+	if (!w0.wait(60000) || !w1.wait(60000) || !r0.wait(60000) || !r1.wait(60000))
+	{	std::cout << "FAILED: hung." << std::endl;
+		exit(1);
+	}
+	bool passed = !w0.errors() && !w1.errors() && !r0.errors() && !r1.errors();
+	std::cout << (passed ? "OK." : "FAILED.") << std::endl;
+	ok = ok && passed;
+
+	// Close on fail: killing the socket closes every channel at both ends.
+	std::cout << "Failure... " << std::flush;
+	::shutdown(fd, SHUT_RDWR);
+	passed = true;
+	for (int i = 0; i < 2; i++)
+	{	QMultiplexedChannel *x = acceptor.theChannels[i];
+		passed = passed && !c[i]->waitForReadyRead(5000) && c[i]->atEnd() && c[i]->write("x", 1) == -1;
+		passed = passed && !x->waitForReadyRead(5000) && x->atEnd();
+	}
+	for (int i = 0; i < 2; i++)
+	{	delete c[i];
+		delete acceptor.theChannels[i];
+	}
+	acceptor.theChannels.clear();
+	std::cout << (passed ? "OK." : "FAILED.") << std::endl;
+	ok = ok && passed;
+
+	// The failed link is gone, so the next open() makes a new one. As we now
+	// say we take links (on a port with nothing behind it), the other side's
+	// open() back to us must use the same link.
+	std::cout << "Relinking... " << std::flush;
+	Acceptor back;
+	QMultiplexedLink::setAcceptor(&back, port + 1);
+	fd = link(listener, port, acceptor, c, 1);
+	char got[6] = "";
+	passed = fd >= 0 && c[0]->write("hello", 5) == 5 && acceptor.theChannels[0]->waitForReadyRead(5000);
+	passed = passed && acceptor.theChannels[0]->read(got, 5) == 5 && QByteArray(got) == "hello";
+	QMultiplexedChannel *reverse = passed ? QMultiplexedLink::open(QHostAddress(QHostAddress::LocalHost), port + 1) : 0;
+	passed = reverse && reverse->link() == acceptor.theChannels[0]->link() && back.waitFor(1);
+	passed = passed && reverse->write("again", 5) == 5 && back.theChannels[0]->waitForReadyRead(5000);
+	passed = passed && back.theChannels[0]->read(got, 5) == 5 && QByteArray(got) == "again";
+	QMultiplexedLink::forgetAcceptor(&back);
+	delete reverse;
+	while (back.theChannels.size())
+		delete back.theChannels.takeLast();
+	if (fd >= 0)
+	{	delete c[0];
+		delete acceptor.theChannels[0];
+	}
+	std::cout << (passed ? "OK." : "FAILED.") << std::endl;
+	ok = ok && passed;
+
+	::close(listener);
+	return ok ? 0 : 1;
+}
@@ -6,7 +6,10 @@ SUBDIRS += testbuffer \
            testmulti \
            testdemux \
            testall \
-           testproperties
+           testproperties \
+           testlinkcodec \
+           testmultiplexedlink \
+           testvectormath
 
 TEMPLATE = subdirs
 
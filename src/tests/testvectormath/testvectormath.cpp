@@ -0,0 +1,153 @@
+/* Copyright 2003, 2004, 2005, 2007, 2009, 2010 Gavin Wood <gav@kde.org>
+ *
+ * This file is part of Exscalibar.
+ *
+ * Exscalibar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Exscalibar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Exscalibar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <limits>
+#include <iostream>
+
+#include "qvectormath.h"
+using namespace QtExtra;
+
+// The bounds qvectormath.h claims for the Approximate kernels.
+static double const MaxRelative = 2.5e-7;
+static double const MaxPowRelative = 1e-5;
+
+static uint s_seed = 69;
+static float rnd(float _lo, float _hi)
+{
+	s_seed = s_seed * 1103515245u + 12345u;
+	return _lo + (_hi - _lo) * ((s_seed >> 8) & 0xffff) / 65535.f;
+}
+
+static bool same(float _a, double _b)
+{
+	if (std::isnan(_a) || std::isnan(_b))
+		return std::isnan(_a) && std::isnan(_b);
+	return _a == float(_b);
+}
+
+// Checks _got against _want (worked out in double) to within _bound,
+// relative. Non-finite wants must come out exactly.
+static void check(char const* _what, float _in, float _got, double _want, double _bound, double& o_worst, uint& o_errors)
+{
+	double e = std::isfinite(_want) ? fabs(_got - _want) / std::max(fabs(_want), double(std::numeric_limits<float>::min())) : (same(_got, _want) ? 0.0 : HUGE_VAL);
+	if (!(e <= _bound))
+	{
+		if (o_errors++ < 10)
+			std::cout << std::endl << _what << "(" << _in << ") = " << _got << ", want " << _want << std::flush;
+	}
+	else
+		o_worst = std::max(o_worst, e);
+}
+
+// As check(), for a want that libm has already rounded to a float. One that
+// isn't a normal float (bar zero) must come out exactly; subnormal results
+// aren't held to anything.
+static void checkSpecial(char const* _what, float _in, float _got, float _want, uint& o_errors)
+{
+	double dummy = 0.0;
+	if (!std::isfinite(_want) || _want == 0.f)
+		check(_what, _in, _got, _want, 0.0, dummy, o_errors);
+	else if (fabs(_want) >= std::numeric_limits<float>::min())
+		check(_what, _in, _got, _want, MaxRelative, dummy, o_errors);
+}
+
+static uint const Count = 100000;
+
+static bool testIsa(VectorIsa _isa)
+{
+	std::cout << vectorIsaName(_isa) << "... " << std::flush;
+	setVectorIsa(_isa);
+	if (vectorIsa() != _isa)
+	{
+		std::cout << "not on this CPU." << std::endl;
+		return true;
+	}
+
+	// Odd-sized, so the scalar tails get a look in too.
+	uint const n = Count + 3;
+	float* in = new float[n];
+	float* out = new float[n];
+	uint errors = 0;
+	double worstExp = 0.0, worstLog = 0.0, worstPow = 0.0;
+
+	// exp over all inputs with a normal result.
+	for (uint i = 0; i < n; i++)
+		in[i] = rnd(-87.33f, 88.72f);
+	vexp(in, out, n);
+	for (uint i = 0; i < n; i++)
+		check("exp", in[i], out[i], exp(double(in[i])), MaxRelative, worstExp, errors);
+
+	// log over every binade, subnormals included, and near 1 where it's
+	// smallest.
+	for (uint i = 0; i < n; i++)
+		in[i] = i % 4 ? ldexp(rnd(1.f, 2.f), int(i % 277) - 149) : rnd(0.9f, 1.1f);
+	vlog(in, out, n);
+	for (uint i = 0; i < n; i++)
+		if (in[i] != 1.f)
+			check("log", in[i], out[i], log(double(in[i])), MaxRelative, worstLog, errors);
+
+	// pow with the product anywhere the result stays normal.
+	float const exponents[] = { -3.5f, -1.f, 0.5f, 2.f, 7.25f };
+	for (uint k = 0; k < sizeof(exponents) / sizeof(float); k++)
+	{
+		float p = exponents[k];
+		for (uint i = 0; i < n; i++)
+			in[i] = exp(rnd(-87.f, 88.f) / fabs(p));
+		vpow(in, p, out, n);
+		for (uint i = 0; i < n; i++)
+			if (fabs(p * log(double(in[i]))) < 87.0)
+				check("pow", in[i], out[i], pow(double(in[i]), double(p)), MaxPowRelative, worstPow, errors);
+	}
+
+	// The special cases come out as libm gives them (as floats), and the
+	// rest of the wide path is still within bounds around them.
+	float const inf = std::numeric_limits<float>::infinity();
+	float const nan = std::numeric_limits<float>::quiet_NaN();
+	float const specials[] = { 0.f, -0.f, -1.f, inf, -inf, nan, 1.f, 1e-45f, 100.f, -100.f };
+	uint const s = sizeof(specials) / sizeof(float);
+	for (uint i = 0; i < 64; i++)
+		in[i] = specials[i % s];
+	double dummy = 0.0;
+	vexp(in, out, 64);
+	for (uint i = 0; i < 64; i++)
+		checkSpecial("exp", in[i], out[i], float(exp(double(in[i]))), errors);
+	vlog(in, out, 64);
+	for (uint i = 0; i < 64; i++)
+		checkSpecial("log", in[i], out[i], float(log(double(in[i]))), errors);
+	vpow(in, 0.f, out, 64);
+	for (uint i = 0; i < 64; i++)
+		check("pow", in[i], out[i], 1.0, 0.0, dummy, errors);
+
+	delete [] in;
+	delete [] out;
+	if (errors)
+		std::cout << std::endl << errors << " out of bounds. FAILED." << std::endl;
+	else
+		std::cout << "OK (worst relative: exp " << worstExp << ", log " << worstLog << ", pow " << worstPow << ")." << std::endl;
+	return !errors;
+}
+
+int main()
+{
+	bool ok = true;
+	VectorIsa const isas[] = { GenericIsa, Sse2Isa, Avx2Isa, Avx512Isa };
+	for (uint i = 0; i < sizeof(isas) / sizeof(VectorIsa); i++)
+		ok = testIsa(isas[i]) && ok;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,6 @@
+include(../../../exscalibar.pri)
+TARGETDEPS += $$DESTDIR/libqtextra.so 
+LIBS += -lqtextra
+INCLUDEPATH += $$SRCDIR/qtextra
+TEMPLATE = app 
+SOURCES += testvectormath.cpp 